@@ -0,0 +1,61 @@
+// Saves the dongle's packet capture to a file for tools/capture2pcap.cpp
+//
+// Usage: node captureDump.js [output file]
+//
+// Start a capture first with the "capture start" console command.
+const findAndOpenESP32 = require('./dongle');
+const fs = require('fs');
+
+const OUTPUT = process.argv[2] || 'capture.bin';
+const IDLE_TIMEOUT_MS = 3000;
+
+// End frame: magic, type 3, 4 byte payload, CRC
+const END_FRAME_PREFIX = Buffer.from([0xA5, 0x5C, 0x03, 0x04, 0x00]);
+const END_FRAME_SIZE = END_FRAME_PREFIX.length + 4 + 2;
+
+async function main() {
+    const port = await findAndOpenESP32();
+    if (!port) process.exit(1);
+
+    let chunks = [];
+    let received = 0;
+    let idleTimer = null;
+
+    const finish = (complete) => {
+        clearTimeout(idleTimer);
+        const data = Buffer.concat(chunks);
+        fs.writeFileSync(OUTPUT, data);
+        console.log(`${complete ? 'Saved' : 'Dump incomplete, saved'} ${data.length} bytes to ${OUTPUT}`);
+        port.close();
+        process.exit(complete ? 0 : 1);
+    };
+
+    const resetIdleTimer = () => {
+        clearTimeout(idleTimer);
+        idleTimer = setTimeout(() => finish(false), IDLE_TIMEOUT_MS);
+    };
+
+    port.on('data', data => {
+        chunks.push(data);
+        received += data.length;
+        resetIdleTimer();
+
+        // Only look at the last few chunks, the end frame is always at the end
+        const windowChunks = chunks.slice(-4);
+        const window = Buffer.concat(windowChunks);
+        const windowStart = received - window.length;
+        const end = window.indexOf(END_FRAME_PREFIX);
+        if (end !== -1 && window.length >= end + END_FRAME_SIZE) {
+            chunks = [Buffer.concat(chunks).subarray(0, windowStart + end + END_FRAME_SIZE)];
+            finish(true);
+        }
+    });
+
+    port.write('capture dump\n');
+    resetIdleTimer();
+}
+
+main().catch(err => {
+    console.error('Serial port error:', err);
+    process.exit(1);
+});
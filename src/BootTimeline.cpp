@@ -0,0 +1,26 @@
+#include "BootTimeline.h"
+
+#include "Serial.h"
+#include "hal/Clock.h"
+
+BootTimeline &BootTimeline::getInstance() {
+    return instance;
+}
+
+void BootTimeline::mark(const char *stage) {
+    if (stageCount < maxStages) {
+        stages[stageCount++] = {stage, SlimeVR::Hal::Clock::micros()};
+    }
+}
+
+void BootTimeline::print() {
+    Serial.println("[BOOT] Stage            at ms took ms");
+    uint64_t previousUs = 0;
+    for (size_t i = 0; i < stageCount; i++) {
+        const Stage &stage = stages[i];
+        Serial.printf("[BOOT] %-12s %9.1f %7.1f\n", stage.name, stage.us / 1000.0, (stage.us - previousUs) / 1000.0);
+        previousUs = stage.us;
+    }
+}
+
+BootTimeline BootTimeline::instance;
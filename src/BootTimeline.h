@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Timestamps of the init stages in setup(). Printed as a breakdown once boot
+// completes and again on the "boottime" console command, since the USB
+// console often isn't open yet when the first one goes out.
+class BootTimeline {
+public:
+    static BootTimeline &getInstance();
+
+    // Records that a stage finished now. Stages past maxStages are dropped.
+    void mark(const char *stage);
+    void print();
+
+private:
+    static BootTimeline instance;
+    BootTimeline() = default;
+
+    static constexpr size_t maxStages = 16;
+
+    struct Stage {
+        const char *name;
+        uint64_t us;  // Since reset
+    };
+
+    Stage stages[maxStages];
+    size_t stageCount = 0;
+};
@@ -0,0 +1,203 @@
+#pragma once
+
+// The compact HID transfer format: rotation+acceleration reports (packet
+// type 1) quantized to 9 bytes, so a 64-byte transfer carries 7 of them
+// instead of the 4 fixed 16-byte sub-reports of the legacy format. The host
+// opts in with the HID feature report, see PacketHandling::setReportFormat();
+// until then the dongle only sends legacy transfers.
+//
+// A compact transfer starts with one header byte, 0xf0 + the number of
+// entries (1-7). PacketHandling drops reports of those packet types, so no
+// legacy transfer starts with it. The entries follow,
+// unused ones are zero. An entry is the tracker ID and a 64-bit little-endian
+// word:
+//
+//   bits 0-1    which quaternion component was the largest, in the order of
+//               the legacy report
+//   bits 2-34   the other three components in that order, 11-bit two's
+//               complement, the largest made positive and the rest scaled so
+//               +-1/sqrt(2) is +-1023 ("smallest three")
+//   bits 35-36  acceleration exponent e
+//   bits 37-63  the three acceleration components, 9-bit two's complement in
+//               steps of 8 << e legacy units, e picked so the largest fits
+//
+// The largest component is rebuilt from the unit length. That keeps the
+// rotation within 0.15 degrees of the legacy report and the acceleration within
+// half a step, 4 legacy units or less than 1/255 of its largest component.
+// Acceleration components saturate at +-16320.
+//
+// Header-only so the tools in tools/ can decode the format too.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace CompactReport {
+constexpr size_t legacyReportSize = 16;
+constexpr uint8_t rotationAccelType = 1;  // The legacy packet type that has a compact entry
+
+constexpr size_t transferSize = 64;
+constexpr size_t entrySize = 9;
+constexpr size_t entriesPerTransfer = (transferSize - 1) / entrySize;
+constexpr uint8_t headerMarker = 0xf0;
+constexpr uint8_t headerMarkerMask = 0xf8;
+
+constexpr float quaternionScale = 32768.0f;  // Legacy int16 components, 1.0 is 1 << 15
+constexpr int32_t componentMax = 1023;       // Largest quantized smallest-three component
+constexpr float componentScale = componentMax * 1.41421356f;
+constexpr int32_t accelMax = 255;            // Largest quantized acceleration component
+constexpr int32_t accelMaxExponent = 3;
+
+inline bool isCompactTransfer(const uint8_t *transfer) {
+    return (transfer[0] & headerMarkerMask) == headerMarker && (transfer[0] & ~headerMarkerMask) != 0;
+}
+
+inline size_t entryCount(const uint8_t *transfer) {
+    return transfer[0] & ~headerMarkerMask;
+}
+
+inline int32_t quantizeComponent(float component) {
+    return std::clamp(static_cast<int32_t>(std::lround(component * componentScale)), -componentMax, componentMax);
+}
+
+inline float dequantizeComponent(int32_t value) {
+    return value / componentScale;
+}
+
+inline int16_t toLegacyComponent(float component) {
+    return static_cast<int16_t>(std::clamp(static_cast<int32_t>(std::lround(component * quaternionScale)), -32768, 32767));
+}
+
+inline int16_t readInt16(const uint8_t *bytes) {
+    return static_cast<int16_t>(bytes[0] | (bytes[1] << 8));
+}
+
+inline void writeInt16(uint8_t *bytes, int16_t value) {
+    bytes[0] = static_cast<uint16_t>(value) & 0xff;
+    bytes[1] = static_cast<uint16_t>(value) >> 8;
+}
+
+inline uint64_t toBits(int32_t value, unsigned bits) {
+    return static_cast<uint64_t>(value) & ((uint64_t(1) << bits) - 1);
+}
+
+inline int32_t fromBits(uint64_t word, unsigned shift, unsigned bits) {
+    int32_t value = static_cast<int32_t>((word >> shift) & ((uint64_t(1) << bits) - 1));
+    return value >= (1 << (bits - 1)) ? value - (1 << bits) : value;
+}
+
+// True if report is a legacy report with a compact entry: a type 1 report
+// whose quaternion isn't all zero
+inline bool canEncode(const uint8_t *report) {
+    if (report[0] != rotationAccelType) {
+        return false;
+    }
+    for (size_t i = 0; i < 4; i++) {
+        if (readInt16(&report[2 + 2 * i]) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Writes the entry for a report canEncode() accepted. The quaternion doesn't
+// need to be normalized.
+inline void encode(const uint8_t *report, uint8_t *entry) {
+    float q[4];
+    float lengthSquared = 0;
+    size_t largest = 0;
+    for (size_t i = 0; i < 4; i++) {
+        q[i] = readInt16(&report[2 + 2 * i]);
+        lengthSquared += q[i] * q[i];
+        if (std::fabs(q[i]) > std::fabs(q[largest])) {
+            largest = i;
+        }
+    }
+    // q and -q are the same rotation, flipping makes the largest positive
+    float scale = (q[largest] < 0 ? -1.0f : 1.0f) / std::sqrt(lengthSquared);
+
+    uint64_t word = largest;
+    unsigned shift = 2;
+    for (size_t i = 0; i < 4; i++) {
+        if (i != largest) {
+            word |= toBits(quantizeComponent(q[i] * scale), 11) << shift;
+            shift += 11;
+        }
+    }
+
+    int32_t accel[3];
+    int32_t accelLargest = 0;
+    for (size_t i = 0; i < 3; i++) {
+        accel[i] = readInt16(&report[10 + 2 * i]);
+        accelLargest = std::max(accelLargest, std::abs(accel[i]));
+    }
+    int32_t exponent = 0;
+    while (exponent < accelMaxExponent && accelLargest > accelMax * (8 << exponent)) {
+        exponent++;
+    }
+    word |= toBits(exponent, 2) << 35;
+    for (size_t i = 0; i < 3; i++) {
+        int32_t step = 8 << exponent;
+        // Round half away from zero, like std::lround
+        int32_t value = (accel[i] + (accel[i] < 0 ? -step / 2 : step / 2)) / step;
+        word |= toBits(std::clamp(value, -accelMax, accelMax), 9) << (37 + 9 * i);
+    }
+
+    entry[0] = report[1];
+    for (size_t i = 0; i < 8; i++) {
+        entry[1 + i] = word >> (8 * i);
+    }
+}
+
+// Rebuilds the legacy type 1 report of an entry. Byte 15, which type 1
+// leaves to the acceleration, is rebuilt too.
+inline void decode(const uint8_t *entry, uint8_t *report) {
+    uint64_t word = 0;
+    for (size_t i = 0; i < 8; i++) {
+        word |= static_cast<uint64_t>(entry[1 + i]) << (8 * i);
+    }
+
+    memset(report, 0, legacyReportSize);
+    report[0] = rotationAccelType;
+    report[1] = entry[0];
+
+    size_t largest = word & 0x3;
+    float q[4];
+    float sumSquares = 0;
+    unsigned shift = 2;
+    for (size_t i = 0; i < 4; i++) {
+        if (i != largest) {
+            q[i] = dequantizeComponent(fromBits(word, shift, 11));
+            sumSquares += q[i] * q[i];
+            shift += 11;
+        }
+    }
+    q[largest] = std::sqrt(std::max(0.0f, 1.0f - sumSquares));
+    for (size_t i = 0; i < 4; i++) {
+        writeInt16(&report[2 + 2 * i], toLegacyComponent(q[i]));
+    }
+
+    int32_t exponent = (word >> 35) & 0x3;
+    for (size_t i = 0; i < 3; i++) {
+        int32_t value = fromBits(word, 37 + 9 * i, 9) * (8 << exponent);
+        writeInt16(&report[10 + 2 * i], static_cast<int16_t>(std::clamp(value, -32768, 32767)));
+    }
+}
+
+// Writes the header and zeroes the unused entries once the first count
+// entries are encoded
+inline void finishTransfer(uint8_t *transfer, size_t count) {
+    transfer[0] = headerMarker | count;
+    memset(&transfer[1 + count * entrySize], 0, transferSize - 1 - count * entrySize);
+}
+
+inline uint8_t *entryAt(uint8_t *transfer, size_t index) {
+    return &transfer[1 + index * entrySize];
+}
+
+inline const uint8_t *entryAt(const uint8_t *transfer, size_t index) {
+    return &transfer[1 + index * entrySize];
+}
+}  // namespace CompactReport
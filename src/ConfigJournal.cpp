@@ -0,0 +1,442 @@
+#include "ConfigJournal.h"
+
+#include <algorithm>
+#include <bitset>
+#include <cstring>
+#include <utility>
+
+#include "logging/Logger.h"
+
+static SlimeVR::Logging::Logger logger("ConfigJournal");
+
+namespace {
+constexpr uint8_t magic[4] = {'S', 'V', 'C', 'J'};
+
+// CRC-32 (IEEE 802.3), nibble at a time to keep the table small
+uint32_t crc32(const uint8_t *data, size_t len, uint32_t crc = 0) {
+    static constexpr uint32_t table[16] = {
+        0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+        0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+    };
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc = table[(crc ^ data[i]) & 0x0f] ^ (crc >> 4);
+        crc = table[(crc ^ (data[i] >> 4)) & 0x0f] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+bool sameMac(const std::array<uint8_t, 6> &a, const uint8_t *b) {
+    return memcmp(a.data(), b, 6) == 0;
+}
+}  // namespace
+
+void ConfigJournal::Transaction::add(Op op, const uint8_t *payload, size_t len) {
+    ops.push_back(static_cast<uint8_t>(op));
+    ops.insert(ops.end(), payload, payload + len);
+}
+
+void ConfigJournal::Transaction::setSecurityCode(const uint8_t code[8]) {
+    add(Op::SECURITY_CODE, code, 8);
+}
+
+void ConfigJournal::Transaction::setWifiChannel(uint8_t channel) {
+    add(Op::WIFI_CHANNEL, &channel, 1);
+}
+
+void ConfigJournal::Transaction::pair(const uint8_t mac[6]) {
+    add(Op::PAIR, mac, 6);
+}
+
+void ConfigJournal::Transaction::unpair(const uint8_t mac[6]) {
+    add(Op::UNPAIR, mac, 6);
+}
+
+void ConfigJournal::Transaction::assignTrackerId(const uint8_t mac[6], uint8_t trackerId) {
+    uint8_t payload[7];
+    memcpy(payload, mac, 6);
+    payload[6] = trackerId;
+    add(Op::TRACKER_ID, payload, sizeof(payload));
+}
+
+void ConfigJournal::Transaction::clearTrackers() {
+    add(Op::CLEAR_TRACKERS, nullptr, 0);
+}
+
+int ConfigJournal::payloadSize(uint8_t op) {
+    switch (static_cast<Op>(op)) {
+    case Op::SECURITY_CODE:
+        return 8;
+    case Op::WIFI_CHANNEL:
+        return 1;
+    case Op::PAIR:
+    case Op::UNPAIR:
+        return 6;
+    case Op::TRACKER_ID:
+        return 7;
+    case Op::CLEAR_TRACKERS:
+        return 0;
+    }
+    return -1;
+}
+
+bool ConfigJournal::applyOps(const uint8_t *ops, size_t len, State *target) {
+    size_t offset = 0;
+    while (offset < len) {
+        uint8_t op = ops[offset++];
+        int size = payloadSize(op);
+        if (size < 0 || len - offset < static_cast<size_t>(size)) {
+            return false;
+        }
+        const uint8_t *payload = &ops[offset];
+        offset += size;
+        if (!target) {
+            continue;
+        }
+
+        auto &paired = target->pairedMacs;
+        auto &ids = target->trackerIds;
+        switch (static_cast<Op>(op)) {
+        case Op::SECURITY_CODE:
+            target->hasSecurityCode = true;
+            memcpy(target->securityCode.data(), payload, 8);
+            break;
+        case Op::WIFI_CHANNEL:
+            target->hasWifiChannel = true;
+            target->wifiChannel = payload[0];
+            break;
+        case Op::PAIR:
+            if (std::none_of(paired.begin(), paired.end(), [&](const auto &mac) { return sameMac(mac, payload); })) {
+                std::array<uint8_t, 6> mac;
+                memcpy(mac.data(), payload, 6);
+                paired.push_back(mac);
+            }
+            break;
+        case Op::UNPAIR:
+            paired.erase(std::remove_if(paired.begin(), paired.end(), [&](const auto &mac) { return sameMac(mac, payload); }), paired.end());
+            ids.erase(std::remove_if(ids.begin(), ids.end(), [&](const TrackerIdRecord &record) { return sameMac(record.mac, payload); }), ids.end());
+            break;
+        case Op::TRACKER_ID:
+            if (std::none_of(ids.begin(), ids.end(), [&](const TrackerIdRecord &record) { return sameMac(record.mac, payload); })) {
+                TrackerIdRecord record;
+                memcpy(record.mac.data(), payload, 6);
+                record.trackerId = payload[6];
+                ids.push_back(record);
+            }
+            break;
+        case Op::CLEAR_TRACKERS:
+            paired.clear();
+            ids.clear();
+            break;
+        }
+    }
+    return true;
+}
+
+// Transaction layout: 2-byte little-endian length of the operations, the
+// operations, then the CRC-32 of the length and operations, little-endian
+void ConfigJournal::appendTransaction(std::vector<uint8_t> &data, const std::vector<uint8_t> &ops) {
+    size_t start = data.size();
+    data.push_back(ops.size() & 0xff);
+    data.push_back(ops.size() >> 8);
+    data.insert(data.end(), ops.begin(), ops.end());
+    uint32_t crc = crc32(&data[start], data.size() - start);
+    for (int i = 0; i < 4; i++) {
+        data.push_back(crc >> (8 * i));
+    }
+}
+
+bool ConfigJournal::load() {
+    state = State();
+    pending.clear();
+    fileSize = 0;
+    compactedSize = 0;
+    needsRewrite = false;
+
+    opened = storage.begin();
+    if (!opened) {
+        SVR_LOGE(logger, "Could not open %s storage", storage.getName());
+        return false;
+    }
+    readStored();
+    return true;
+}
+
+void ConfigJournal::finishOpen() {
+    opened = true;
+    if (needsRewrite) {
+        // reset() replaced the whole state, the stored journal is replaced
+        // with it anyway
+        return;
+    }
+
+    // The changes committed so far go on top of what the storage holds, as
+    // if it had been read at boot
+    std::vector<uint8_t> committed = std::move(pending);
+    state = State();
+    pending.clear();
+    readStored();
+    if (committed.empty()) {
+        return;
+    }
+    State stored = state;
+    std::vector<uint8_t> data = header();
+    data.insert(data.end(), committed.begin(), committed.end());
+    replay(data, state, "The changes made before the storage opened");
+
+    // A code or channel committed since was only there because none had been
+    // read, the trackers paired before still use the stored ones
+    if (stored.hasSecurityCode) {
+        state.securityCode = stored.securityCode;
+    }
+    if (stored.hasWifiChannel) {
+        state.wifiChannel = stored.wifiChannel;
+    }
+    moveCollidingTrackerIds(stored);
+
+    // The commits no longer describe the state, it replaces the journal whole
+    needsRewrite = true;
+}
+
+void ConfigJournal::moveCollidingTrackerIds(const State &stored) {
+    auto isStored = [&](const TrackerIdRecord &record) {
+        return std::any_of(stored.trackerIds.begin(), stored.trackerIds.end(), [&](const TrackerIdRecord &storedRecord) { return storedRecord.mac == record.mac; });
+    };
+    // TRACKER_ID keeps a MAC's first record, so stored MACs have their
+    // stored IDs and only the IDs allocated since can collide
+    std::bitset<256> used;
+    for (const TrackerIdRecord &record : state.trackerIds) {
+        if (isStored(record)) {
+            used.set(record.trackerId);
+        }
+    }
+    std::vector<TrackerIdRecord *> colliding;
+    for (TrackerIdRecord &record : state.trackerIds) {
+        if (!isStored(record)) {
+            if (used.test(record.trackerId)) {
+                colliding.push_back(&record);
+            } else {
+                used.set(record.trackerId);
+            }
+        }
+    }
+    for (TrackerIdRecord *record : colliding) {
+        const uint8_t *mac = record->mac.data();
+        size_t newId = 0;
+        while (newId < 255 && used.test(newId)) {
+            newId++;
+        }
+        if (newId == 255) {
+            SVR_LOGW(logger, "Tracker ID %u of %02x:%02x:%02x:%02x:%02x:%02x is stored for another tracker and none is free, dropping it", record->trackerId, mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+            record->trackerId = 255;
+            continue;
+        }
+        SVR_LOGW(logger, "Tracker ID %u of %02x:%02x:%02x:%02x:%02x:%02x is stored for another tracker, moving it to %u", record->trackerId, mac[0], mac[1], mac[2], mac[3], mac[4], mac[5], static_cast<unsigned>(newId));
+        record->trackerId = newId;
+        used.set(newId);
+    }
+    auto &ids = state.trackerIds;
+    ids.erase(std::remove_if(ids.begin(), ids.end(), [](const TrackerIdRecord &record) { return record.trackerId == 255; }), ids.end());
+}
+
+void ConfigJournal::readStored() {
+    std::vector<uint8_t> data;
+    if (!storage.read(data)) {
+        migrate();
+        return;
+    }
+
+    size_t valid = replay(data, state, "The stored journal");
+    if (valid == 0) {
+        // Written by newer firmware or damaged. Appending after an unreadable
+        // header would never be read back, so the first change replaces it.
+        SVR_LOGW(logger, "Starting from defaults");
+        needsRewrite = true;
+        return;
+    }
+    fileSize = valid;
+    if (valid < data.size()) {
+        SVR_LOGW(logger, "Dropped %u bytes of an incomplete transaction at the end of the journal", static_cast<unsigned>(data.size() - valid));
+        compactNow();
+    }
+}
+
+size_t ConfigJournal::replay(const std::vector<uint8_t> &data, State &target, const char *source) {
+    if (data.size() < headerSize || memcmp(data.data(), magic, sizeof(magic)) != 0) {
+        SVR_LOGE(logger, "%s is not a configuration journal", source);
+        return 0;
+    }
+    if (data[4] != version) {
+        SVR_LOGE(logger, "%s has version %u, this firmware reads version %u", source, data[4], version);
+        return 0;
+    }
+
+    size_t offset = headerSize;
+    size_t transactions = 0;
+    while (data.size() - offset >= 6) {
+        size_t len = data[offset] | (data[offset + 1] << 8);
+        if (data.size() - offset - 6 < len) {
+            break;
+        }
+        const uint8_t *ops = &data[offset + 2];
+        const uint8_t *stored = ops + len;
+        uint32_t crc = stored[0] | (stored[1] << 8) | (stored[2] << 16) | (static_cast<uint32_t>(stored[3]) << 24);
+        if (crc != crc32(&data[offset], len + 2) || !applyOps(ops, len, nullptr)) {
+            break;
+        }
+        applyOps(ops, len, &target);
+        offset += len + 6;
+        transactions++;
+    }
+    SVR_LOGD(logger, "Replayed %u transactions, %u bytes", static_cast<unsigned>(transactions), static_cast<unsigned>(offset));
+    return offset;
+}
+
+void ConfigJournal::migrate() {
+    bool migrated = false;
+    std::vector<uint8_t> data;
+    Transaction transaction;
+    if (storage.readLegacyFile(legacySecurityCodePath, data) && data.size() >= 8) {
+        transaction.setSecurityCode(data.data());
+        migrated = true;
+    }
+    if (storage.readLegacyFile(legacyWifiChannelPath, data) && !data.empty()) {
+        transaction.setWifiChannel(data[0]);
+        migrated = true;
+    }
+    if (storage.readLegacyFile(legacyPairedTrackersPath, data)) {
+        for (size_t i = 0; i + 6 <= data.size(); i += 6) {
+            transaction.pair(&data[i]);
+        }
+        migrated = true;
+    }
+    // Only the first record for a MAC was ever looked up, and TRACKER_ID
+    // keeps the first too
+    if (storage.readLegacyFile(legacyTrackerIdsPath, data)) {
+        for (size_t i = 0; i + 7 <= data.size(); i += 7) {
+            transaction.assignTrackerId(&data[i], data[i + 6]);
+        }
+        migrated = true;
+    }
+    if (!migrated) {
+        return;
+    }
+
+    applyOps(transaction.ops.data(), transaction.ops.size(), &state);
+    if (!compactNow()) {
+        // Keep the old files for the next attempt
+        return;
+    }
+    for (const char *legacyPath : {legacySecurityCodePath, legacyWifiChannelPath, legacyPairedTrackersPath, legacyTrackerIdsPath}) {
+        storage.removeLegacyFile(legacyPath);
+    }
+    SVR_LOGI(logger, "Migrated %u paired trackers and %u tracker IDs to the %s journal", static_cast<unsigned>(state.pairedMacs.size()), static_cast<unsigned>(state.trackerIds.size()), storage.getName());
+}
+
+bool ConfigJournal::parseExport(const std::vector<uint8_t> &data, State &target) {
+    target = State();
+    size_t valid = replay(data, target, "The imported data");
+    if (valid != 0 && valid != data.size()) {
+        SVR_LOGE(logger, "The imported data is cut short or damaged after %u of %u bytes", static_cast<unsigned>(valid), static_cast<unsigned>(data.size()));
+    }
+    return valid != 0 && valid == data.size();
+}
+
+void ConfigJournal::commit(const Transaction &transaction) {
+    if (transaction.empty()) {
+        return;
+    }
+    applyOps(transaction.ops.data(), transaction.ops.size(), &state);
+    appendTransaction(pending, transaction.ops);
+}
+
+void ConfigJournal::reset(const State &newState) {
+    state = newState;
+    pending.clear();
+    needsRewrite = true;
+}
+
+bool ConfigJournal::takePendingWrite(PendingWrite &write) {
+    // Kept for finishOpen() to merge with what the storage holds
+    if (!opened || !hasPendingWrite()) {
+        return false;
+    }
+    write.rewrite = needsRewrite || fileSize == 0 || fileSize + pending.size() > compactedSize + compactThreshold;
+    if (write.rewrite) {
+        // The snapshot already holds the queued transactions
+        write.data = snapshot();
+    } else {
+        write.data = std::move(pending);
+    }
+    pending.clear();
+    needsRewrite = false;
+    return true;
+}
+
+bool ConfigJournal::writePending(const PendingWrite &write) const {
+    if (!opened) {
+        return false;
+    }
+    if (write.rewrite) {
+        return storage.replace(write.data.data(), write.data.size());
+    }
+    return storage.append(write.data.data(), write.data.size());
+}
+
+void ConfigJournal::finishWrite(const PendingWrite &write, bool written) {
+    if (!written) {
+        // A partly appended transaction would hide everything appended after
+        // it, and the state in RAM still has all changes
+        SVR_LOGE(logger, "Couldn't %s the %s journal, rewriting it with the next change", write.rewrite ? "rewrite" : "append to", storage.getName());
+        needsRewrite = true;
+        return;
+    }
+    if (write.rewrite) {
+        SVR_LOGD(logger, "Compacted the journal from %u to %u bytes", static_cast<unsigned>(fileSize), static_cast<unsigned>(write.data.size()));
+        fileSize = write.data.size();
+        compactedSize = fileSize;
+    } else {
+        fileSize += write.data.size();
+    }
+}
+
+bool ConfigJournal::compactNow() {
+    PendingWrite write;
+    write.rewrite = true;
+    write.data = snapshot();
+    pending.clear();
+    needsRewrite = false;
+    bool written = writePending(write);
+    finishWrite(write, written);
+    return written;
+}
+
+std::vector<uint8_t> ConfigJournal::header() {
+    // Magic, version, 3 reserved bytes
+    std::vector<uint8_t> data(headerSize);
+    memcpy(data.data(), magic, sizeof(magic));
+    data[4] = version;
+    return data;
+}
+
+std::vector<uint8_t> ConfigJournal::snapshot() const {
+    Transaction snapshot;
+    if (state.hasSecurityCode) {
+        snapshot.setSecurityCode(state.securityCode.data());
+    }
+    if (state.hasWifiChannel) {
+        snapshot.setWifiChannel(state.wifiChannel);
+    }
+    for (const auto &mac : state.pairedMacs) {
+        snapshot.pair(mac.data());
+    }
+    for (const TrackerIdRecord &record : state.trackerIds) {
+        snapshot.assignTrackerId(record.mac.data(), record.trackerId);
+    }
+
+    std::vector<uint8_t> data = header();
+    if (!snapshot.empty()) {
+        appendTransaction(data, snapshot.ops);
+    }
+    return data;
+}
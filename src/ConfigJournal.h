@@ -0,0 +1,172 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "hal/ConfigStorage.h"
+
+// All persistent dongle configuration, kept in one append-only journal on a
+// Hal::ConfigStorage backend. Every
+// change is appended as a transaction: its length, one or more operations and
+// a CRC-32 over both. On load a transaction is applied whole or not at all.
+// The first one with a bad CRC, typically cut short by a power loss, ends the
+// journal and is dropped with everything after it. Changes to several fields,
+// such as unpairing a tracker (its pairing and its tracker ID), therefore
+// can't be left half done.
+//
+// Commits only change the state in RAM and queue the transaction. The owner
+// takes the queued writes in a batch and writes them to flash when it
+// chooses (see Configuration's flush task), so a burst of changes costs one
+// append. If the journal would grow compactThreshold bytes past its last
+// compaction, the batch is instead the current state as a single
+// transaction, which replaces the stored journal in one step.
+//
+// The first load without a journal migrates the older per-field LittleFS
+// files into it and removes them. Loading writes to flash directly, it only
+// runs at boot.
+//
+// Not thread-safe, Configuration serializes access.
+class ConfigJournal {
+public:
+    struct TrackerIdRecord {
+        std::array<uint8_t, 6> mac;
+        uint8_t trackerId;
+    };
+
+    struct State {
+        bool hasSecurityCode = false;
+        std::array<uint8_t, 8> securityCode = {};
+        bool hasWifiChannel = false;
+        uint8_t wifiChannel = 0;
+        // In the order the trackers were paired and their IDs allocated. A MAC
+        // appears at most once in each.
+        std::vector<std::array<uint8_t, 6>> pairedMacs;
+        std::vector<TrackerIdRecord> trackerIds;
+    };
+
+    enum class Op : uint8_t {
+        SECURITY_CODE = 1,   // 8-byte code
+        WIFI_CHANNEL = 2,    // 1-byte channel
+        PAIR = 3,            // 6-byte MAC, ignored if already paired
+        UNPAIR = 4,          // 6-byte MAC, removes the pairing and tracker ID
+        TRACKER_ID = 5,      // 6-byte MAC + ID, ignored if the MAC has one
+        CLEAR_TRACKERS = 6,  // No payload, removes all pairings and tracker IDs
+    };
+
+    // Changes that are committed together
+    class Transaction {
+    public:
+        void setSecurityCode(const uint8_t code[8]);
+        void setWifiChannel(uint8_t channel);
+        void pair(const uint8_t mac[6]);
+        void unpair(const uint8_t mac[6]);
+        void assignTrackerId(const uint8_t mac[6], uint8_t trackerId);
+        void clearTrackers();
+        bool empty() const { return ops.empty(); }
+
+    private:
+        friend class ConfigJournal;
+        void add(Op op, const uint8_t *payload, size_t len);
+
+        std::vector<uint8_t> ops;
+    };
+
+    // A batch of queued changes: bytes to append, or a whole new file
+    struct PendingWrite {
+        bool rewrite = false;
+        std::vector<uint8_t> data;
+    };
+
+    static constexpr uint8_t version = 1;
+    static constexpr size_t compactThreshold = 4096;
+
+    explicit ConfigJournal(SlimeVR::Hal::ConfigStorage &storage) : storage(storage) {}
+
+    // Opens the storage and replays the journal, or migrates the older files
+    // if there is none. Returns false if the storage can't be opened; the
+    // state is then the defaults and nothing is written until it is.
+    bool load();
+    bool isOpen() const { return opened; }
+    // Tries again to open the storage after load() couldn't. Touches no
+    // journal state, like writePending().
+    bool openStorage() const { return storage.begin(); }
+    // Once openStorage() succeeded: reads the stored journal as load() would
+    // and applies everything committed since on top of it. The stored
+    // security code and WiFi channel win over ones committed since, and
+    // tracker IDs allocated since that are stored for another MAC move to
+    // free ones. The merged state replaces the journal with the next write.
+    void finishOpen();
+    const char *getStorageName() const { return storage.getName(); }
+    const State &getState() const { return state; }
+
+    // Applies the transaction to the state and queues it for writing
+    void commit(const Transaction &transaction);
+    // Replaces the whole state and queues a rewrite of the journal
+    void reset(const State &newState);
+
+    // The current state as a journal of one transaction, the format pairing
+    // exports use. Versioned and CRC-protected like the stored journal.
+    std::vector<uint8_t> exportState() const { return snapshot(); }
+    // Reads an export into state. Returns false unless data is a whole,
+    // intact journal this firmware can read.
+    static bool parseExport(const std::vector<uint8_t> &data, State &state);
+
+    bool hasPendingWrite() const { return needsRewrite || !pending.empty(); }
+    // Takes everything committed since the last call. Returns false if there
+    // is nothing to write or the storage isn't open.
+    bool takePendingWrite(PendingWrite &write);
+    // Writes a batch to flash. Touches no journal state, so it can run
+    // without the lock the owner holds around everything else.
+    bool writePending(const PendingWrite &write) const;
+    // Records how writePending went. After a failure the next batch rewrites
+    // the whole file.
+    void finishWrite(const PendingWrite &write, bool written);
+
+    // Bytes of the journal file, for diagnostics
+    size_t getFileSize() const { return fileSize; }
+
+private:
+    static constexpr char legacySecurityCodePath[] = "/securityCode.bin";
+    static constexpr char legacyWifiChannelPath[] = "/wifiChannel.bin";
+    static constexpr char legacyPairedTrackersPath[] = "/pairedTrackers.bin";
+    static constexpr char legacyTrackerIdsPath[] = "/trackerIds.bin";
+    static constexpr size_t headerSize = 8;
+
+    // Bytes an operation's payload takes, or -1 for an unknown operation
+    static int payloadSize(uint8_t op);
+    // Checks every operation in ops and, if target is set, applies them to it.
+    // Returns false for an unknown operation or a cut-off payload.
+    static bool applyOps(const uint8_t *ops, size_t len, State *target);
+    static void appendTransaction(std::vector<uint8_t> &data, const std::vector<uint8_t> &ops);
+    // An empty journal file
+    static std::vector<uint8_t> header();
+    // The whole file for the current state
+    std::vector<uint8_t> snapshot() const;
+
+    // Applies data's transactions to target. Returns the offset after the
+    // last intact transaction, 0 if the header isn't valid. source names
+    // the data in error logs.
+    static size_t replay(const std::vector<uint8_t> &data, State &target, const char *source);
+    // The rest of load() once the storage is open
+    void readStored();
+    // For finishOpen(): gives tracker IDs the state took from commits a free
+    // ID if stored holds them for another MAC, drops them if none is free
+    void moveCollidingTrackerIds(const State &stored);
+    void migrate();
+    // Rewrites the file from the current state, bypassing the queue
+    bool compactNow();
+
+    SlimeVR::Hal::ConfigStorage &storage;
+    State state;
+    // Transactions committed but not taken for writing yet
+    std::vector<uint8_t> pending;
+    size_t fileSize = 0;
+    // Size right after the last compaction, what the state alone takes
+    size_t compactedSize = 0;
+    // Set when the file on flash can't be appended to, or the state was
+    // replaced
+    bool needsRewrite = false;
+    bool opened = false;
+};
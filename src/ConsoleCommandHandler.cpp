@@ -1,7 +1,12 @@
 #include "ConsoleCommandHandler.h"
-#include <LittleFS.h>
+#include "BootTimeline.h"
+#include "LoadGenerator.h"
 #include "configuration.h"
 #include "espnow/espnow.h"
+#include "espnow/PacketCapture.h"
+#include "hal/Console.h"
+#include "hal/Radio.h"
+#include "packetHandling.h"
 
 void ConsoleCommandHandler::update() {
     static String serialBuffer;
@@ -11,11 +16,10 @@ void ConsoleCommandHandler::update() {
             serialBuffer.trim();
             if (serialBuffer.length() > 0) {
                 if (serialBuffer.equalsIgnoreCase("factoryreset")) {
-                    Serial.println("[CMD] Factory reset: deleting pairedTrackers.bin, securityCode.bin, trackerIds.bin");
-                    LittleFS.remove("/pairedTrackers.bin");
-                    LittleFS.remove("/securityCode.bin");
-                    LittleFS.remove("/trackerIds.bin");
+                    Serial.println("[CMD] Factory reset: clearing paired trackers, tracker IDs and the security code");
+                    Configuration::getInstance().factoryReset();
                     Serial.println("[CMD] Factory reset complete");
+                    Serial.flush();
                     ESP.restart();
                 } else if (serialBuffer.equalsIgnoreCase("pair")) {
                     bool pairing = !ESPNowCommunication::getInstance().isInPairingMode();
@@ -45,9 +49,7 @@ void ConsoleCommandHandler::update() {
                             code[i] = (hi << 4) | lo;
                         }
                         if (valid) {
-                            auto file = LittleFS.open("/securityCode.bin", "w", true);
-                            file.write(code, 8);
-                            file.close();
+                            Configuration::getInstance().setSecurityCode(code);
                             Serial.print("[CMD] Security code set to: ");
                             for (int i = 0; i < 8; i++) Serial.printf("%02x", code[i]);
                             Serial.println();
@@ -212,13 +214,132 @@ void ConsoleCommandHandler::update() {
                     }
                 } else if (serialBuffer.equalsIgnoreCase("reboot") || serialBuffer.equalsIgnoreCase("restart")) {
                     Serial.println("[CMD] Rebooting device...");
+                    Configuration::getInstance().flush();
+                    Serial.flush();
                     delay(100);
                     ESP.restart();
+                } else if (serialBuffer.equalsIgnoreCase("exportpairing")) {
+                    std::vector<uint8_t> data = Configuration::getInstance().exportPairing();
+                    Serial.print("[CMD] Pairing export: ");
+                    for (uint8_t byte : data) Serial.printf("%02x", byte);
+                    Serial.println();
+                } else if (serialBuffer.startsWith("importpairing ")) {
+                    String hexStr = serialBuffer.substring(14);
+                    hexStr.trim();
+                    auto hexCharToNibble = [](char c) -> int {
+                        if (c >= '0' && c <= '9') return c - '0';
+                        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+                        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+                        return -1;
+                    };
+                    std::vector<uint8_t> data;
+                    bool valid = hexStr.length() % 2 == 0;
+                    for (unsigned i = 0; valid && i < hexStr.length(); i += 2) {
+                        int hi = hexCharToNibble(hexStr[i]);
+                        int lo = hexCharToNibble(hexStr[i + 1]);
+                        if (hi < 0 || lo < 0) { valid = false; break; }
+                        data.push_back((hi << 4) | lo);
+                    }
+                    if (!valid) {
+                        Serial.println("[CMD] Invalid hex string. Paste the output of exportpairing.");
+                    } else if (Configuration::getInstance().importPairing(data)) {
+                        Serial.printf("[CMD] Imported %u paired trackers, all trackers disconnected to reconnect with the imported settings.\n", static_cast<unsigned>(Configuration::getInstance().getAllPairedTrackerMacs().size()));
+                    } else {
+                        Serial.println("[CMD] Import failed, nothing was changed. See the log for why.");
+                    }
+                } else if (serialBuffer.equalsIgnoreCase("events")) {
+                    using TrackerEvent = ESPNowCommunication::TrackerEvent;
+                    const ESPNowCommunication::EventStats &stats = ESPNowCommunication::getInstance().getEventStats();
+                    for (size_t type = 0; type < TrackerEvent::typeCount; type++) {
+                        Serial.printf("[CMD] %-12s raised %lu, dropped %lu\n", ESPNowCommunication::eventTypeName(static_cast<TrackerEvent::Type>(type)),
+                                      static_cast<unsigned long>(stats.published[type]), static_cast<unsigned long>(stats.dropped[type]));
+                    }
+                    Serial.printf("[CMD] Event queue high water %u of %u\n", static_cast<unsigned>(stats.highWater), static_cast<unsigned>(ESPNowCommunication::eventQueueSize));
+                } else if (serialBuffer.equalsIgnoreCase("hidformat") || serialBuffer.startsWith("hidformat ")) {
+                    // Normally the host picks it through the HID feature report
+                    String args = serialBuffer.substring(9);
+                    args.trim();
+                    PacketHandling &packetHandling = PacketHandling::getInstance();
+                    if (args.equalsIgnoreCase("legacy")) {
+                        packetHandling.setReportFormat(PacketHandling::ReportFormat::LEGACY);
+                    } else if (args.equalsIgnoreCase("compact")) {
+                        packetHandling.setReportFormat(PacketHandling::ReportFormat::COMPACT);
+                    } else if (args.length() > 0) {
+                        Serial.println("[CMD] Invalid HID report format. Use: hidformat [legacy | compact]");
+                    }
+                    const PacketHandling::Stats &stats = packetHandling.getStats();
+                    Serial.printf("[CMD] HID report format: %s, %lu of %lu transfers compact\n", PacketHandling::reportFormatName(packetHandling.getReportFormat()),
+                                  static_cast<unsigned long>(stats.compactTransfers), static_cast<unsigned long>(stats.transfers));
+                } else if (serialBuffer.equalsIgnoreCase("boottime")) {
+                    BootTimeline::getInstance().print();
                 } else if (serialBuffer.equalsIgnoreCase("getchannel")) {
-                    int ch = WiFi.channel();
+                    int ch = SlimeVR::Hal::Radio::getChannel();
                     Serial.printf("[CMD] Current WiFi channel: %d\n", ch);
+                } else if (serialBuffer.equalsIgnoreCase("capture") || serialBuffer.startsWith("capture ")) {
+                    String args = serialBuffer.substring(7);
+                    args.trim();
+                    PacketCapture &capture = PacketCapture::getInstance();
+                    if (args.startsWith("start")) {
+                        String snapStr = args.substring(5);
+                        snapStr.trim();
+                        long snapLength = snapStr.length() > 0 ? snapStr.toInt() : PacketCapture::maxSnapLength;
+                        if (snapLength < 1 || snapLength > (long)PacketCapture::maxSnapLength) {
+                            Serial.printf("[CMD] Invalid snap length. Use 1-%u.\n", (unsigned)PacketCapture::maxSnapLength);
+                        } else if (capture.start(snapLength)) {
+                            Serial.printf("[CMD] Capture started, %u bytes per packet, room for %u packets in %s.\n", (unsigned)capture.getSnapLength(), (unsigned)capture.getCapacity(), capture.isInPsram() ? "PSRAM" : "internal RAM");
+                        } else {
+                            Serial.println("[CMD] Couldn't allocate the capture buffer.");
+                        }
+                    } else if (args.equalsIgnoreCase("stop")) {
+                        capture.stop();
+                        Serial.printf("[CMD] Capture stopped, %u packets stored.\n", (unsigned)capture.getRecordCount());
+                    } else if (args.equalsIgnoreCase("clear")) {
+                        capture.clear();
+                        Serial.println("[CMD] Capture cleared.");
+                    } else if (args.equalsIgnoreCase("status")) {
+                        Serial.printf("[CMD] Capture %s, %u of %u packets stored, %u received in total.\n", capture.isActive() ? "running" : "stopped", (unsigned)capture.getRecordCount(), (unsigned)capture.getCapacity(), (unsigned)capture.getTotalCount());
+                    } else if (args.equalsIgnoreCase("dump")) {
+                        SlimeVR::Hal::ConsolePort &usb = SlimeVR::Hal::Console::usb();
+                        if (!usb.isConnected()) {
+                            Serial.println("[CMD] Capture dump needs the USB console.");
+                        } else if (!capture.dump(usb)) {
+                            Serial.println("[CMD] Capture dump aborted, host stopped reading.");
+                        }
+                    } else {
+                        Serial.println("[CMD] Invalid capture command. Use: capture start [snaplen] | stop | clear | status | dump");
+                    }
+                } else if (serialBuffer.equalsIgnoreCase("loadtest") || serialBuffer.startsWith("loadtest ")) {
+                    String args = serialBuffer.substring(8);
+                    args.trim();
+                    LoadGenerator &loadGenerator = LoadGenerator::getInstance();
+                    if (args.equalsIgnoreCase("stop")) {
+                        if (loadGenerator.isActive()) {
+                            loadGenerator.stop();
+                        } else {
+                            Serial.println("[CMD] No load test running.");
+                        }
+                    } else {
+                        // <trackers> <rate Hz> [seconds] [churn ms]
+                        long values[4] = {0, 0, 60, 0};
+                        int count = 0;
+                        while (args.length() > 0 && count < 4) {
+                            int space = args.indexOf(' ');
+                            String value = space == -1 ? args : args.substring(0, space);
+                            values[count++] = value.toInt();
+                            args = space == -1 ? String() : args.substring(space + 1);
+                            args.trim();
+                        }
+                        LoadGenerator::Config config;
+                        config.trackerCount = values[0] > 0 && values[0] <= LoadGenerator::maxTrackers ? values[0] : 0;
+                        config.rateHz = values[1] > 0 ? values[1] : 0;
+                        config.durationMs = values[2] > 0 ? values[2] * 1000 : 0;
+                        config.churnIntervalMs = values[3] > 0 ? values[3] : 0;
+                        if (count < 2 || args.length() > 0 || !loadGenerator.start(config)) {
+                            Serial.printf("[CMD] Invalid load test. Use: loadtest <trackers 1-%u> <rate 1-%lu Hz> [seconds] [churn ms] | stop\n", LoadGenerator::maxTrackers, static_cast<unsigned long>(LoadGenerator::maxRateHz));
+                        }
+                    }
                 } else {
-                    Serial.println("[CMD] Unknown command. Available: factoryreset, setsecurity <16hex>, setchannel <num>, getchannel, pair, reboot");
+                    Serial.println("[CMD] Unknown command. Available: factoryreset, setsecurity <16hex>, setchannel <num>, getchannel, pair, exportpairing, importpairing <hex>, capture, loadtest, hidformat, events, boottime, reboot");
                 }
             }
             serialBuffer = "";
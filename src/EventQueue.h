@@ -0,0 +1,60 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "MpscRing.h"
+
+// Typed events handed from the tasks that raise them to the one that handles
+// them, on an MpscRing. Event is a small copyable struct with a `type` field
+// of an enum whose values run from 0 to Event::typeCount - 1.
+//
+// Publishing never allocates or waits for a handler, and events are taken in
+// the order they were published. If the ring is full the new event is
+// dropped and counted.
+template <typename Event, size_t Capacity>
+class EventQueue {
+public:
+    struct Stats {
+        std::atomic<uint32_t> published[Event::typeCount] = {};
+        std::atomic<uint32_t> dropped[Event::typeCount] = {};  // Published while the queue was full
+        std::atomic<uint32_t> highWater{0};                   // Most events queued at once, approximate
+    };
+
+    // The task that takes the events, notified on every publish
+    void setConsumerTask(TaskHandle_t task) { consumerTask = task; }
+
+    bool publish(const Event &event) {
+        size_t type = static_cast<size_t>(event.type);
+        if (!ring.tryPush(event)) {
+            stats.dropped[type].fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        stats.published[type].fetch_add(1, std::memory_order_relaxed);
+        uint32_t queued = ring.size();
+        uint32_t highWater = stats.highWater.load(std::memory_order_relaxed);
+        while (queued > highWater && !stats.highWater.compare_exchange_weak(highWater, queued, std::memory_order_relaxed)) {
+        }
+
+        if (consumerTask != nullptr) {
+            xTaskNotifyGive(consumerTask);
+        }
+        return true;
+    }
+
+    // Takes the oldest event. Returns false if there is none. Only the
+    // consumer task may call it.
+    bool take(Event &event) { return ring.tryPop(event); }
+
+    size_t size() const { return ring.size(); }
+    static constexpr size_t capacity() { return Capacity; }
+    const Stats &getStats() const { return stats; }
+
+private:
+    MpscRing<Event, Capacity> ring;
+    Stats stats;
+    TaskHandle_t consumerTask = nullptr;
+};
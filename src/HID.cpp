@@ -4,42 +4,57 @@
 #include <cstring>
 #include <Arduino.h>
 
-#include <WiFi.h>
 #include "USB.h"
+#include "hal/Radio.h"
+#include "logging/Logger.h"
+#include "packetHandling.h"
+
+#if HID_INTERFACES > 1
+#include "class/hid/hid_device.h"
+#include "esp32-hal-tinyusb.h"
+
+// tud_hid_n_report() needs TinyUSB built with a HID instance per interface
+#if CFG_TUD_HID < HID_INTERFACES
+#error "HID_INTERFACES needs an Arduino core whose TinyUSB has CFG_TUD_HID >= HID_INTERFACES (CONFIG_TINYUSB_HID_COUNT)"
+#endif
+#endif
+
+// Defined with the USB console port in hal/esp32/Console.cpp
+extern USBCDC USBSerial;
+
+static SlimeVR::Logging::Logger logger("USB");
 
 static void usbEventCallback(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data) {
   if (event_base == ARDUINO_USB_EVENTS) {
     arduino_usb_event_data_t *data = (arduino_usb_event_data_t *)event_data;
     switch (event_id) {
-      case ARDUINO_USB_STARTED_EVENT: Serial.println("USB PLUGGED"); break;
-      case ARDUINO_USB_STOPPED_EVENT: Serial.println("USB UNPLUGGED"); break;
-      case ARDUINO_USB_SUSPEND_EVENT: Serial.printf("USB SUSPENDED: remote_wakeup_en: %u\n", data->suspend.remote_wakeup_en); break;
-      case ARDUINO_USB_RESUME_EVENT:  Serial.println("USB RESUMED"); break;
+      case ARDUINO_USB_STARTED_EVENT: SVR_LOGI(logger, "USB PLUGGED"); break;
+      case ARDUINO_USB_STOPPED_EVENT:
+        SVR_LOGI(logger, "USB UNPLUGGED");
+        // The next host has to ask for a format again
+        PacketHandling::getInstance().setReportFormat(PacketHandling::ReportFormat::LEGACY);
+        break;
+      case ARDUINO_USB_SUSPEND_EVENT: SVR_LOGI(logger, "USB SUSPENDED: remote_wakeup_en: %u", data->suspend.remote_wakeup_en); break;
+      case ARDUINO_USB_RESUME_EVENT:  SVR_LOGI(logger, "USB RESUMED"); break;
 
       default: break;
     }
   } else if (event_base == ARDUINO_USB_CDC_EVENTS) {
     arduino_usb_cdc_event_data_t *data = (arduino_usb_cdc_event_data_t *)event_data;
     switch (event_id) {
-      case ARDUINO_USB_CDC_CONNECTED_EVENT:    Serial.println("CDC CONNECTED"); break;
-      case ARDUINO_USB_CDC_DISCONNECTED_EVENT: Serial.println("CDC DISCONNECTED"); break;
-      case ARDUINO_USB_CDC_LINE_STATE_EVENT:   Serial.printf("CDC LINE STATE: dtr: %u, rts: %u\n", data->line_state.dtr, data->line_state.rts); break;
+      case ARDUINO_USB_CDC_CONNECTED_EVENT:    SVR_LOGI(logger, "CDC CONNECTED"); break;
+      case ARDUINO_USB_CDC_DISCONNECTED_EVENT: SVR_LOGI(logger, "CDC DISCONNECTED"); break;
+      case ARDUINO_USB_CDC_LINE_STATE_EVENT:   SVR_LOGD(logger, "CDC LINE STATE: dtr: %u, rts: %u", data->line_state.dtr, data->line_state.rts); break;
       case ARDUINO_USB_CDC_LINE_CODING_EVENT:
-        Serial.printf(
-          "CDC LINE CODING: bit_rate: %lu, data_bits: %u, stop_bits: %u, parity: %u\n", data->line_coding.bit_rate, data->line_coding.data_bits,
+        SVR_LOGD(logger,
+          "CDC LINE CODING: bit_rate: %lu, data_bits: %u, stop_bits: %u, parity: %u", static_cast<unsigned long>(data->line_coding.bit_rate), data->line_coding.data_bits,
           data->line_coding.stop_bits, data->line_coding.parity
         );
         break;
       case ARDUINO_USB_CDC_RX_EVENT:
-        // Serial.printf("CDC RX [%u]:", data->rx.len);
-        // {
-        // //   uint8_t buf[data->rx.len];
-        // //   size_t len = USBSerial.read(buf, data->rx.len);
-        // //   Serial.write(buf, len);
-        // }
-        // Serial.println();
+        SVR_LOGT(logger, "CDC RX [%u]", static_cast<unsigned>(data->rx.len));
         break;
-      case ARDUINO_USB_CDC_RX_OVERFLOW_EVENT: Serial.printf("CDC RX Overflow of %d bytes", data->rx_overflow.dropped_bytes); break;
+      case ARDUINO_USB_CDC_RX_OVERFLOW_EVENT: SVR_LOGW(logger, "CDC RX Overflow of %u bytes", static_cast<unsigned>(data->rx_overflow.dropped_bytes)); break;
 
       default: break;
     }
@@ -47,6 +62,29 @@ static void usbEventCallback(void *arg, esp_event_base_t event_base, int32_t eve
 }
 
 
+#if HID_INTERFACES > 1
+// The interface descriptors after USBHID's. TinyUSB numbers HID instances in
+// descriptor order, and USBHID's interface comes before custom ones, so these
+// are instances 1 and up.
+static uint16_t loadExtraInterfaceDescriptors(uint8_t *dst, uint8_t *itf) {
+    uint16_t length = 0;
+    for (uint8_t interface = 1; interface < HID_INTERFACES; interface++) {
+        char name[24];
+        snprintf(name, sizeof(name), "SlimeVR Trackers %u/%u", interface + 1, HID_INTERFACES);
+        uint8_t stringIndex = tinyusb_add_string_descriptor(name);
+        uint8_t endpointIn = tinyusb_get_free_in_endpoint();
+        TU_VERIFY(endpointIn != 0);
+        uint8_t descriptor[TUD_HID_DESC_LEN] = {
+            TUD_HID_DESCRIPTOR(*itf, stringIndex, HID_ITF_PROTOCOL_NONE, sizeof(hid_report_desc), static_cast<uint8_t>(0x80 | endpointIn), 64, 1)
+        };
+        *itf += 1;
+        memcpy(dst + length, descriptor, sizeof(descriptor));
+        length += sizeof(descriptor);
+    }
+    return length;
+}
+#endif
+
 HIDDevice::HIDDevice() {
     if (initialized) {
         return;
@@ -54,15 +92,14 @@ HIDDevice::HIDDevice() {
 
     initialized = true;
     HID.addDevice(this, sizeof(hid_report_desc));
+#if HID_INTERFACES > 1
+    tinyusb_enable_interface(USB_INTERFACE_CUSTOM, (HID_INTERFACES - 1) * TUD_HID_DESC_LEN, loadExtraInterfaceDescriptors);
+#endif
 }
 
 void HIDDevice::begin() {
     uint8_t mac[6];
-    if (WiFi.getMode() == WIFI_MODE_NULL) {
-        WiFi.mode(WIFI_STA);
-        delay(100);
-    }
-    WiFi.macAddress(mac);
+    SlimeVR::Hal::Radio::getMacAddress(mac);
 
     // Format for USB_SERIAL: SVRDG + last 6 hex digits (e.g., SVRDGA1B2C3D4E5F6)
     char usbSerial[20] = "SVRDG";
@@ -74,9 +111,8 @@ void HIDDevice::begin() {
     USB.VID(USB_VID);
     USB.PID(USB_PID);
     USB.begin();
-    Serial.begin(115200);
-    delay(10);
-    Serial.printf("USB Serial Number: %s\n", usbSerial);
+    Serial.begin();
+    SVR_LOGI(logger, "USB Serial Number: %s, %u HID interfaces", usbSerial, HID_INTERFACES);
     HID.begin();
     
     USB.onEvent(usbEventCallback);
@@ -88,7 +124,31 @@ uint16_t HIDDevice::_onGetDescriptor(uint8_t *buffer) {
     return sizeof(hid_report_desc);
 }
 
-bool HIDDevice::send(const uint8_t *value, size_t size) {
+uint16_t HIDDevice::_onGetFeature(uint8_t report_id, uint8_t *buffer, uint16_t len) {
+    if (len < 2) {
+        return 0;
+    }
+    buffer[0] = static_cast<uint8_t>(PacketHandling::getInstance().getReportFormat());
+    buffer[1] = static_cast<uint8_t>(PacketHandling::newestReportFormat);
+    return 2;
+}
+
+void HIDDevice::_onSetFeature(uint8_t report_id, const uint8_t *buffer, uint16_t len) {
+    if (len < 1 || buffer[0] < static_cast<uint8_t>(PacketHandling::ReportFormat::LEGACY) || buffer[0] > static_cast<uint8_t>(PacketHandling::newestReportFormat)) {
+        SVR_LOGW(logger, "Host asked for unknown HID report format %u", len < 1 ? 0 : buffer[0]);
+        return;
+    }
+    PacketHandling::getInstance().setReportFormat(static_cast<PacketHandling::ReportFormat>(buffer[0]));
+}
+
+bool HIDDevice::send(uint8_t interface, const uint8_t *value, size_t size) {
+#if HID_INTERFACES > 1
+    // USBHID only sends on its own interface; the others take the transfer
+    // straight away, ready() said their endpoint is free
+    if (interface != 0) {
+        return tud_hid_n_ready(interface) && tud_hid_n_report(interface, 0, value, size);
+    }
+#endif
     // Only attempt send if HID is actually ready to prevent error spam
     if (!HID.ready()) {
         return false;
@@ -97,7 +157,12 @@ bool HIDDevice::send(const uint8_t *value, size_t size) {
     return HID.SendReport(0, value, size, 10);
 }
 
-bool HIDDevice::ready() {
+bool HIDDevice::ready(uint8_t interface) {
+#if HID_INTERFACES > 1
+    if (interface != 0) {
+        return tud_hid_n_ready(interface);
+    }
+#endif
     return HID.ready();
 }
 
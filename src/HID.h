@@ -4,12 +4,17 @@
 #include <cstddef>
 #include <cstdint>
 #include "Serial.h"
+#include "hal/HidSink.h"
 
 // HID Constants
 #define HID_USAGE_GEN_DESKTOP 0x01
 #define HID_USAGE_GEN_DESKTOP_UNDEFINED 0x00
 #define HID_END_COLLECTION 0xC0
 
+// The 64-byte input report carries the tracker reports. The 2-byte feature
+// report negotiates their format: reading it gives the format in use and the
+// newest one the dongle supports, writing a format's number to its first byte
+// switches to it, see PacketHandling::ReportFormat.
 // clang-format off
 static const uint8_t hid_report_desc[] = {
 	HID_USAGE_PAGE(HID_USAGE_GEN_DESKTOP),
@@ -19,17 +24,33 @@ static const uint8_t hid_report_desc[] = {
 		HID_REPORT_SIZE(8),
 		HID_REPORT_COUNT(64),
 		HID_INPUT(0x02),
+		HID_USAGE(HID_USAGE_GEN_DESKTOP_UNDEFINED),
+		HID_REPORT_SIZE(8),
+		HID_REPORT_COUNT(2),
+		HID_FEATURE(0x02),
 	HID_END_COLLECTION,
 };
 // clang-format on
 
-class HIDDevice : public USBHIDDevice {
+// The tracker report interfaces. USBHID brings up the first one; with
+// HID_INTERFACES above 1 the others are added as a custom TinyUSB interface
+// each with its own IN endpoint and the same report descriptor, which
+// USBHID's descriptor callback hands out for every HID instance. Hosts find
+// them as further HID interfaces of the dongle, named "SlimeVR Trackers i/n".
+// The ESP32-S2/S3 have IN endpoints for two next to the CDC console.
+#if HID_INTERFACES > 2
+#error "The ESP32-S2/S3 have IN endpoints for at most 2 HID interfaces next to the CDC console"
+#endif
+
+class HIDDevice : public USBHIDDevice, public SlimeVR::Hal::HidSink {
 public:
     HIDDevice();
     void begin();
     uint16_t _onGetDescriptor(uint8_t *buffer);
-    bool send(const uint8_t *value, size_t size);
-    bool ready();
+    uint16_t _onGetFeature(uint8_t report_id, uint8_t *buffer, uint16_t len);
+    void _onSetFeature(uint8_t report_id, const uint8_t *buffer, uint16_t len);
+    bool send(uint8_t interface, const uint8_t *value, size_t size) override;
+    bool ready(uint8_t interface) override;
 
 private:
     static bool initialized;
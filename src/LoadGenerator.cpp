@@ -0,0 +1,138 @@
+#include "LoadGenerator.h"
+
+#include <cstring>
+
+#include "Serial.h"
+#include "espnow/espnow.h"
+#include "hal/Clock.h"
+#include "packetHandling.h"
+
+namespace Clock = SlimeVR::Hal::Clock;
+
+LoadGenerator &LoadGenerator::getInstance() {
+    return instance;
+}
+
+bool LoadGenerator::start(const Config &newConfig) {
+    if (newConfig.trackerCount == 0 || newConfig.trackerCount > maxTrackers || newConfig.rateHz == 0 || newConfig.rateHz > maxRateHz || newConfig.durationMs == 0) {
+        return false;
+    }
+    if (active) {
+        stop();
+    }
+
+    config = newConfig;
+    size_t realTrackers = ESPNowCommunication::getInstance().getConnectedTrackerCount();
+    if (realTrackers > 0) {
+        Serial.printf("[LOAD] %u real trackers are connected, their reports count in the results too.\n", static_cast<unsigned>(realTrackers));
+    }
+
+    for (uint8_t i = 0; i < config.trackerCount; i++) {
+        registerTracker(i);
+    }
+    PacketHandling::getInstance().resetStats();
+
+    active = true;
+    startUs = Clock::micros();
+    startMs = Clock::millis();
+    generated = 0;
+    skipped = 0;
+    nextTracker = 0;
+    nextChurnTracker = 0;
+    lastChurnMs = startMs;
+    lastProgressMs = startMs;
+    lastProgressTransfers = 0;
+    Serial.printf("[LOAD] Started: %u virtual trackers (IDs %u-%u) at %lu Hz for %lu s%s\n", config.trackerCount, firstTrackerId, firstTrackerId + config.trackerCount - 1, static_cast<unsigned long>(config.rateHz), static_cast<unsigned long>(config.durationMs / 1000), config.churnIntervalMs ? ", with registration churn" : "");
+    return true;
+}
+
+void LoadGenerator::stop() {
+    if (!active) {
+        return;
+    }
+    active = false;
+    uint32_t nowMs = Clock::millis();
+    printSummary(nowMs);
+    for (uint8_t i = 0; i < config.trackerCount; i++) {
+        PacketHandling::getInstance().sendDisconnectionStatus(firstTrackerId + i);
+    }
+}
+
+void LoadGenerator::update() {
+    if (!active) {
+        return;
+    }
+
+    // Reports due since the start, computed from elapsed time so the rate
+    // doesn't drift with the main loop period
+    uint64_t elapsedUs = Clock::micros() - startUs;
+    uint64_t due = elapsedUs * config.trackerCount * config.rateHz / 1000000;
+    if (due - generated > maxBurst) {
+        skipped += due - generated - maxBurst;
+        generated = due - maxBurst;
+    }
+    while (generated < due) {
+        insertReport(nextTracker);
+        nextTracker = (nextTracker + 1) % config.trackerCount;
+        generated++;
+    }
+
+    uint32_t nowMs = Clock::millis();
+    if (config.churnIntervalMs != 0 && nowMs - lastChurnMs >= config.churnIntervalMs) {
+        lastChurnMs = nowMs;
+        PacketHandling::getInstance().sendDisconnectionStatus(firstTrackerId + nextChurnTracker);
+        registerTracker(nextChurnTracker);
+        nextChurnTracker = (nextChurnTracker + 1) % config.trackerCount;
+    }
+
+    if (nowMs - startMs >= config.durationMs) {
+        stop();
+    } else if (nowMs - lastProgressMs >= 1000) {
+        printProgress(nowMs);
+    }
+}
+
+void LoadGenerator::insertReport(uint8_t trackerIndex) {
+    uint8_t report[reportSize] = {};
+    report[0] = 1;
+    report[1] = firstTrackerId + trackerIndex;
+    memcpy(&report[2], &sequence, sizeof(sequence));
+    sequence++;
+    PacketHandling::getInstance().insert(report, sizeof(report));
+}
+
+// Same registration report main.cpp inserts when a tracker connects, with a
+// locally administered MAC made up from the tracker ID
+void LoadGenerator::registerTracker(uint8_t trackerIndex) {
+    uint8_t report[reportSize] = {};
+    report[0] = 0xff;
+    report[1] = firstTrackerId + trackerIndex;
+    const uint8_t mac[6] = {0x02, 'L', 'O', 'A', 'D', report[1]};
+    memcpy(&report[2], mac, sizeof(mac));
+    PacketHandling::getInstance().insert(report, sizeof(report));
+}
+
+void LoadGenerator::printProgress(uint32_t nowMs) {
+    const PacketHandling::Stats &stats = PacketHandling::getInstance().getStats();
+    uint32_t intervalMs = nowMs - lastProgressMs;
+    Serial.printf("[LOAD] %lu s: %lu transfers/s, %lu overwritten, %lu dropped, %lu failed sends\n", static_cast<unsigned long>((nowMs - startMs) / 1000), static_cast<unsigned long>((stats.transfers - lastProgressTransfers) * 1000ULL / intervalMs), static_cast<unsigned long>(stats.overwrittenReports), static_cast<unsigned long>(stats.droppedReports), static_cast<unsigned long>(stats.failedTransfers));
+    lastProgressMs = nowMs;
+    lastProgressTransfers = stats.transfers;
+}
+
+void LoadGenerator::printSummary(uint32_t nowMs) {
+    const PacketHandling::Stats &stats = PacketHandling::getInstance().getStats();
+    uint32_t elapsedMs = nowMs - startMs;
+    if (elapsedMs == 0) {
+        elapsedMs = 1;
+    }
+    Serial.printf("[LOAD] Done after %lu.%03lu s\n", static_cast<unsigned long>(elapsedMs / 1000), static_cast<unsigned long>(elapsedMs % 1000));
+    Serial.printf("[LOAD] Generated %llu reports (%llu/s), skipped %llu the main loop couldn't keep up with\n", static_cast<unsigned long long>(generated), static_cast<unsigned long long>(generated * 1000 / elapsedMs), static_cast<unsigned long long>(skipped));
+    Serial.printf("[LOAD] HID transfers: %lu (%llu/s), %lu compact, %lu failed sends\n", static_cast<unsigned long>(stats.transfers), static_cast<unsigned long long>(stats.transfers * 1000ULL / elapsedMs), static_cast<unsigned long>(stats.compactTransfers), static_cast<unsigned long>(stats.failedTransfers));
+    Serial.printf("[LOAD] FIFO: %lu reports inserted, %lu overwritten by a newer one, %lu dropped full\n", static_cast<unsigned long>(stats.insertedReports), static_cast<unsigned long>(stats.overwrittenReports), static_cast<unsigned long>(stats.droppedReports));
+    if (stats.wakeups != 0) {
+        Serial.printf("[LOAD] Wake to HID send: %lu us average, %lu us max over %lu reports that found the FIFO empty\n", static_cast<unsigned long>(stats.wakeLatencyTotalUs / stats.wakeups), static_cast<unsigned long>(stats.wakeLatencyMaxUs), static_cast<unsigned long>(stats.wakeups));
+    }
+}
+
+LoadGenerator LoadGenerator::instance;
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Feeds synthetic tracker reports straight into PacketHandling::insert, so
+// the USB side of a dongle and host can be characterised without trackers or
+// radio. Virtual trackers get IDs from firstTrackerId up, well clear of the
+// IDs handed out at pairing, and are registered with the host at start like
+// real ones.
+//
+// Reports are type 1 with the tracker ID in byte 1 and a sequence number in
+// bytes 2-5, generated evenly spread across the trackers at trackerCount *
+// rateHz reports per second. With a churn interval set, one virtual tracker
+// at a time is disconnected and registered again every churnIntervalMs.
+//
+// Once a second and at the end of the run the generator prints HID transfers
+// per second, dedup overwrites, FIFO drops and failed HIDDevice::send calls
+// from PacketHandling's stats. Reports from real trackers still count there.
+class LoadGenerator {
+public:
+    struct Config {
+        uint8_t trackerCount = 16;
+        uint32_t rateHz = 100;
+        uint32_t durationMs = 60000;
+        uint32_t churnIntervalMs = 0;  // 0 disables churn
+    };
+
+    static constexpr uint8_t firstTrackerId = 192;
+    static constexpr uint8_t maxTrackers = 63;  // Up to tracker ID 254, 255 marks registrations
+    static constexpr uint32_t maxRateHz = 1000;
+
+    static LoadGenerator &getInstance();
+
+    // Returns false if the config is out of range
+    bool start(const Config &config);
+    // Stops early and prints the summary
+    void stop();
+    bool isActive() const { return active; }
+
+    // Called from the main loop
+    void update();
+
+private:
+    static LoadGenerator instance;
+    LoadGenerator() = default;
+
+    void insertReport(uint8_t trackerIndex);
+    void registerTracker(uint8_t trackerIndex);
+    void printProgress(uint32_t nowMs);
+    void printSummary(uint32_t nowMs);
+
+    // Reports generated in one update at most; if the main loop falls further
+    // behind the schedule the missed reports are skipped
+    static constexpr uint64_t maxBurst = 64;
+    static constexpr size_t reportSize = 16;
+
+    Config config;
+    bool active = false;
+    uint64_t startUs = 0;
+    uint32_t startMs = 0;
+    uint64_t generated = 0;
+    uint64_t skipped = 0;
+    uint32_t sequence = 0;
+    uint8_t nextTracker = 0;
+    uint8_t nextChurnTracker = 0;
+    uint32_t lastChurnMs = 0;
+    uint32_t lastProgressMs = 0;
+    uint32_t lastProgressTransfers = 0;
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded multi-producer / single-consumer ring.
+//
+// Producers claim a slot with a single CAS on the enqueue index and publish it
+// by bumping the slot's sequence number, so a producer never waits on another
+// producer or on the consumer. A full ring is reported back to the producer
+// instead of blocking. Only one context may call tryPop() at a time.
+template <typename T, size_t Capacity>
+class MpscRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    MpscRing() {
+        for (size_t i = 0; i < Capacity; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Claims a slot, lets fill() write the element in place and publishes it.
+    // Returns false without calling fill() when the ring is full.
+    template <typename Fill>
+    bool tryEmplace(Fill &&fill) {
+        Cell *cell;
+        uint32_t pos = enqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells[pos & mask];
+            uint32_t seq = cell->sequence.load(std::memory_order_acquire);
+            int32_t diff = static_cast<int32_t>(seq - pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        fill(cell->value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPush(const T &value) {
+        return tryEmplace([&value](T &slot) { slot = value; });
+    }
+
+    bool tryPop(T &out) {
+        uint32_t pos = dequeuePos.load(std::memory_order_relaxed);
+        Cell &cell = cells[pos & mask];
+        uint32_t seq = cell.sequence.load(std::memory_order_acquire);
+        if (static_cast<int32_t>(seq - (pos + 1)) < 0) return false;
+        out = cell.value;
+        cell.sequence.store(pos + Capacity, std::memory_order_release);
+        dequeuePos.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Approximate number of queued elements, for statistics only
+    size_t size() const {
+        uint32_t enq = enqueuePos.load(std::memory_order_relaxed);
+        uint32_t deq = dequeuePos.load(std::memory_order_relaxed);
+        return static_cast<size_t>(static_cast<int32_t>(enq - deq) > 0 ? enq - deq : 0);
+    }
+
+    bool isEmpty() const { return size() == 0; }
+
+    static constexpr size_t capacity() { return Capacity; }
+
+private:
+    static constexpr uint32_t mask = Capacity - 1;
+
+    struct Cell {
+        std::atomic<uint32_t> sequence;
+        T value;
+    };
+
+    Cell cells[Capacity];
+    std::atomic<uint32_t> enqueuePos{0};
+    std::atomic<uint32_t> dequeuePos{0};
+};
@@ -1,4 +1,148 @@
 #include "Serial.h"
+#include "hal/Clock.h"
 
-USBCDC USBSerial;
 HybridSerial Serial;
+
+static void onUsbWritable() {
+    Serial.pump();
+}
+
+void HybridSerial::begin(unsigned long baud) {
+    uart->begin(baud);
+    beginUSB();
+}
+
+void HybridSerial::beginUSB() {
+    usb->onWritable(onUsbWritable);
+    usb->begin(0);
+}
+
+void HybridSerial::setBaudRate(unsigned long baud) {
+    uart->setBaudRate(baud);
+}
+
+void HybridSerial::setSinkEnabled(Sink sink, bool enabled) {
+    sinks[static_cast<size_t>(sink)].enabled = enabled;
+}
+
+size_t HybridSerial::getPendingBytes(Sink sink) const {
+    const SinkBuffer &buffer = sinks[static_cast<size_t>(sink)];
+    return buffer.head - buffer.tail;
+}
+
+size_t HybridSerial::write(uint8_t c) {
+    SinkBuffer &uartSink = sinks[static_cast<size_t>(Sink::UART)];
+    SinkBuffer &usbSink = sinks[static_cast<size_t>(Sink::USB)];
+
+    if (uartSink.enabled) {
+        enqueue(uartSink, &c, 1);
+    }
+    // Only buffer for USB while a host has the port open
+    if (usbSink.enabled && usb->isConnected()) {
+        enqueue(usbSink, &c, 1);
+    }
+    return 1;
+}
+
+size_t HybridSerial::write(const uint8_t *buffer, size_t size) {
+    SinkBuffer &uartSink = sinks[static_cast<size_t>(Sink::UART)];
+    SinkBuffer &usbSink = sinks[static_cast<size_t>(Sink::USB)];
+
+    if (uartSink.enabled) {
+        enqueue(uartSink, buffer, size);
+    }
+    if (usbSink.enabled && usb->isConnected()) {
+        enqueue(usbSink, buffer, size);
+    }
+
+    pump();
+    return size;
+}
+
+int HybridSerial::availableForWrite() {
+    size_t available = sinkBufferSize;
+    for (const SinkBuffer &sink : sinks) {
+        if (sink.enabled) {
+            available = std::min(available, sinkBufferSize - (sink.head - sink.tail));
+        }
+    }
+    return static_cast<int>(available);
+}
+
+// Copies a whole write into the sink or drops it, so lines never get cut
+void HybridSerial::enqueue(SinkBuffer &sink, const uint8_t *buffer, size_t size) {
+    portENTER_CRITICAL(&sink.lock);
+    if (size > sinkBufferSize - (sink.head - sink.tail)) {
+        portEXIT_CRITICAL(&sink.lock);
+        sink.dropped.fetch_add(size, std::memory_order_relaxed);
+        return;
+    }
+
+    size_t offset = sink.head % sinkBufferSize;
+    size_t first = std::min(size, sinkBufferSize - offset);
+    memcpy(&sink.data[offset], buffer, first);
+    memcpy(sink.data, buffer + first, size - first);
+    sink.head += size;
+    portEXIT_CRITICAL(&sink.lock);
+}
+
+void HybridSerial::pump() {
+    pumpSink(sinks[static_cast<size_t>(Sink::UART)], *uart);
+    pumpSink(sinks[static_cast<size_t>(Sink::USB)], *usb);
+}
+
+void HybridSerial::pumpSink(SinkBuffer &sink, SlimeVR::Hal::ConsolePort &port) {
+    // Another context is already feeding this driver
+    if (sink.pumping.test_and_set(std::memory_order_acquire)) {
+        return;
+    }
+
+    for (;;) {
+        portENTER_CRITICAL(&sink.lock);
+        size_t pending = sink.head - sink.tail;
+        portEXIT_CRITICAL(&sink.lock);
+        if (pending == 0) {
+            break;
+        }
+
+        size_t room = port.availableForWrite();
+        if (room == 0) {
+            break;
+        }
+
+        size_t offset = sink.tail % sinkBufferSize;
+        size_t chunk = std::min({pending, sinkBufferSize - offset, room});
+        size_t written = port.write(&sink.data[offset], chunk);
+        if (written == 0) {
+            break;
+        }
+
+        portENTER_CRITICAL(&sink.lock);
+        sink.tail += written;
+        portEXIT_CRITICAL(&sink.lock);
+    }
+
+    sink.pumping.clear(std::memory_order_release);
+}
+
+void HybridSerial::flush() {
+    SinkBuffer &uartSink = sinks[static_cast<size_t>(Sink::UART)];
+    SinkBuffer &usbSink = sinks[static_cast<size_t>(Sink::USB)];
+
+    // Give up once the drivers stop taking data, e.g. a host that has the
+    // port open but doesn't read
+    uint32_t lastProgress = SlimeVR::Hal::Clock::millis();
+    size_t lastTail = uartSink.tail + usbSink.tail;
+    while (uartSink.head != uartSink.tail || (usbSink.head != usbSink.tail && usb->isConnected())) {
+        pump();
+        if (uartSink.tail + usbSink.tail != lastTail) {
+            lastTail = uartSink.tail + usbSink.tail;
+            lastProgress = SlimeVR::Hal::Clock::millis();
+        } else if (SlimeVR::Hal::Clock::millis() - lastProgress >= flushTimeoutMs) {
+            break;
+        }
+        SlimeVR::Hal::Clock::delay(1);
+    }
+    uart->flush();
+    usb->flush();
+}
@@ -1,80 +1,104 @@
 #include <Arduino.h>
+#include <atomic>
+
+#include "hal/Console.h"
 
 #undef Serial  // Remove the core's Serial definition
 
 
 #ifndef SERIAL_H
 #define SERIAL_H
-extern USBCDC USBSerial;
 
+#ifndef UART_BAUD_RATE
+#define UART_BAUD_RATE 115200
+#endif
+
+// Console output to the UART and USB CDC at the same time.
+//
+// Writes only copy into a ring buffer per sink and never block; the buffers
+// are moved into the drivers by pump(), which writes no more than the driver
+// can take without waiting. pump() runs after every write, on the CDC
+// TX-complete event and from the main loop. A write that doesn't fit into a
+// sink's buffer is dropped for that sink and counted.
 class HybridSerial : public Stream {
-private:
-    HardwareSerial* uart;
-    USBCDC* usb;
-    
 public:
-    HybridSerial() : uart(&Serial0), usb(&USBSerial) {}
-    
-    void begin(unsigned long baud = 115200) {
-        uart->begin(baud);
-        usb->begin();
-    }
-    
-    void beginUSB() {
-        usb->begin();
-    }
-    
-    // Write to both USB and UART
-    size_t write(uint8_t c) override {
-        size_t n = 0;
-        n += uart->write(c);
-        // Only write to USB if connected
-        if (usb && usb->availableForWrite()) {
-            n += usb->write(c);
-        }
-        return n;
-    }
+    enum class Sink : uint8_t {
+        UART = 0,
+        USB = 1,
+    };
+
+    static constexpr size_t sinkBufferSize = 2048;
+    static constexpr unsigned long flushTimeoutMs = 200;
+
+    HybridSerial() : uart(&SlimeVR::Hal::Console::uart()), usb(&SlimeVR::Hal::Console::usb()) {}
+
+    void begin(unsigned long baud = UART_BAUD_RATE);
+    void beginUSB();
+    void setBaudRate(unsigned long baud);
+
+    void setSinkEnabled(Sink sink, bool enabled);
+    bool isSinkEnabled(Sink sink) const { return sinks[static_cast<size_t>(sink)].enabled; }
+    uint32_t getDroppedBytes(Sink sink) const { return sinks[static_cast<size_t>(sink)].dropped.load(std::memory_order_relaxed); }
+    size_t getPendingBytes(Sink sink) const;
+
+    // Moves buffered output into the drivers without blocking
+    void pump();
+
+    // Single bytes are only buffered; they go out with the next pump()
+    size_t write(uint8_t c) override;
+
+    size_t write(const uint8_t *buffer, size_t size) override;
+
+    int availableForWrite() override;
 
-    size_t write(const uint8_t *buffer, size_t size) override {
-        size_t n = 0;
-        n += uart->write(buffer, size);
-        // Only write to USB if connected
-        if (usb && usb->availableForWrite()) {
-            n += usb->write(buffer, size);
-        }
-        return n;
-    }
-    
     // Read from both (USB has priority, then UART)
     int available() override {
         int n = usb->available();
         if (n > 0) return n;
         return uart->available();
     }
-    
+
     int read() override {
         if (usb->available()) {
             return usb->read();
         }
         return uart->read();
     }
-    
+
     int peek() override {
         if (usb->available()) {
             return usb->peek();
         }
         return uart->peek();
     }
-    
-    void flush() override {
-        uart->flush();
-        usb->flush();
-    }
-    
+
+    // Blocks until everything buffered has been handed to the drivers, or until
+    // they stop accepting data for flushTimeoutMs. Pending USB output is only
+    // waited for while a host has the port open.
+    void flush() override;
+
     // Expose operator bool for connection checking
     operator bool() const {
-        return *usb || *uart;
+        return usb->isConnected() || uart->isConnected();
     }
+
+private:
+    struct SinkBuffer {
+        uint8_t data[sinkBufferSize];
+        size_t head = 0;  // Total bytes queued, only advanced under lock
+        size_t tail = 0;  // Total bytes handed to the driver, only advanced by the pumping context
+        bool enabled = true;
+        std::atomic<uint32_t> dropped{0};
+        std::atomic_flag pumping = ATOMIC_FLAG_INIT;
+        portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+    };
+
+    void enqueue(SinkBuffer &sink, const uint8_t *buffer, size_t size);
+    void pumpSink(SinkBuffer &sink, SlimeVR::Hal::ConsolePort &port);
+
+    SlimeVR::Hal::ConsolePort* uart;
+    SlimeVR::Hal::ConsolePort* usb;
+    SinkBuffer sinks[2];
 };
 
 #endif
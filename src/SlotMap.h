@@ -0,0 +1,177 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Refers to an element of a SlotMap. A handle stops resolving once its
+// element is removed, even after another element took over the slot.
+class SlotHandle {
+public:
+    SlotHandle() = default;
+
+    bool valid() const { return generation != 0; }
+    // The slot, below the map's capacity. Stays the same while the element
+    // exists, so it can index per-element side tables.
+    uint8_t index() const { return slot; }
+    bool operator==(const SlotHandle &other) const { return slot == other.slot && generation == other.generation; }
+    bool operator!=(const SlotHandle &other) const { return !(*this == other); }
+
+private:
+    template <typename T, size_t Capacity>
+    friend class SlotMap;
+
+    SlotHandle(uint8_t slot, uint16_t generation) : slot(slot), generation(generation) {}
+
+    uint8_t slot = 0;
+    uint16_t generation = 0;  // 0 is never handed out, so a default handle is invalid
+};
+
+// Fixed-capacity table addressed by generation-checked handles.
+//
+// Elements stay in their slot from insert() to remove() and never move, so
+// insert and remove are O(1) and a pointer from get() or forEach() stays
+// valid until its element is removed. Removing a slot bumps its generation,
+// which invalidates the handles to the old element.
+//
+// Inserts must come from one context at a time and so must removals, but an
+// insert may run alongside a removal: it only takes a free slot, and both
+// update the occupancy mask atomically. Readers in other contexts may run
+// alongside either; an element is written before its slot is published. A
+// reader can still see an element that is being removed; get() with its
+// handle afterwards tells whether it still exists.
+template <typename T, size_t Capacity>
+class SlotMap {
+    static_assert(Capacity > 0 && Capacity <= 64, "Occupancy is kept in one 64-bit mask");
+
+public:
+    SlotMap() {
+        for (size_t i = 0; i < Capacity; i++) {
+            generations[i].store(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Returns an invalid handle if every slot is taken
+    SlotHandle insert(const T &value) {
+        uint64_t free = ~occupied.load(std::memory_order_acquire) & allSlots;
+        if (free == 0) {
+            return SlotHandle();
+        }
+        uint8_t slot = __builtin_ctzll(free);
+        slots[slot] = value;
+        occupied.fetch_or(bit(slot), std::memory_order_release);
+        return SlotHandle(slot, generations[slot].load(std::memory_order_relaxed));
+    }
+
+    // Returns false if the handle was already stale
+    bool remove(SlotHandle handle) {
+        if (get(handle) == nullptr) {
+            return false;
+        }
+        release(handle.slot);
+        return true;
+    }
+
+    void clear() {
+        uint64_t used = occupied.load(std::memory_order_relaxed);
+        while (used != 0) {
+            release(__builtin_ctzll(used));
+            used &= used - 1;
+        }
+    }
+
+    T *get(SlotHandle handle) {
+        return const_cast<T *>(static_cast<const SlotMap *>(this)->get(handle));
+    }
+
+    const T *get(SlotHandle handle) const {
+        if (!handle.valid() || handle.slot >= Capacity) {
+            return nullptr;
+        }
+        if ((occupied.load(std::memory_order_acquire) & bit(handle.slot)) == 0 || generations[handle.slot].load(std::memory_order_relaxed) != handle.generation) {
+            return nullptr;
+        }
+        return &slots[handle.slot];
+    }
+
+    // Calls fn(handle, element) for every element, in slot order. fn may
+    // remove any element, including the one it was called with; elements
+    // inserted meanwhile are not visited.
+    template <typename Fn>
+    void forEach(Fn &&fn) {
+        uint64_t pending = occupied.load(std::memory_order_acquire);
+        while (pending != 0) {
+            uint8_t slot = __builtin_ctzll(pending);
+            pending &= pending - 1;
+            if ((occupied.load(std::memory_order_acquire) & bit(slot)) == 0) {
+                continue;
+            }
+            fn(SlotHandle(slot, generations[slot].load(std::memory_order_relaxed)), slots[slot]);
+        }
+    }
+
+    template <typename Fn>
+    void forEach(Fn &&fn) const {
+        uint64_t pending = occupied.load(std::memory_order_acquire);
+        while (pending != 0) {
+            uint8_t slot = __builtin_ctzll(pending);
+            pending &= pending - 1;
+            fn(SlotHandle(slot, generations[slot].load(std::memory_order_relaxed)), slots[slot]);
+        }
+    }
+
+    // The element in slot index, or an invalid handle if the slot is free
+    SlotHandle handleAt(size_t index) const {
+        if (index >= Capacity || (occupied.load(std::memory_order_acquire) & bit(index)) == 0) {
+            return SlotHandle();
+        }
+        return SlotHandle(index, generations[index].load(std::memory_order_relaxed));
+    }
+
+    // The first element for which match(element) is true, or an invalid handle
+    template <typename Match>
+    SlotHandle find(Match &&match) const {
+        uint64_t pending = occupied.load(std::memory_order_acquire);
+        while (pending != 0) {
+            uint8_t slot = __builtin_ctzll(pending);
+            pending &= pending - 1;
+            if (match(slots[slot])) {
+                return SlotHandle(slot, generations[slot].load(std::memory_order_relaxed));
+            }
+        }
+        return SlotHandle();
+    }
+
+    // The element in the next occupied slot after previous's, wrapping
+    // around, for round robin. Starts at the first slot if previous is
+    // invalid. Returns an invalid handle if the map is empty.
+    SlotHandle next(SlotHandle previous) const {
+        uint64_t used = occupied.load(std::memory_order_acquire);
+        if (used == 0) {
+            return SlotHandle();
+        }
+        uint64_t after = previous.valid() && previous.slot + 1 < 64 ? used & ~((bit(previous.slot) << 1) - 1) : used;
+        uint8_t slot = __builtin_ctzll(after != 0 ? after : used);
+        return SlotHandle(slot, generations[slot].load(std::memory_order_relaxed));
+    }
+
+    size_t size() const { return __builtin_popcountll(occupied.load(std::memory_order_relaxed)); }
+    bool empty() const { return occupied.load(std::memory_order_relaxed) == 0; }
+    static constexpr size_t capacity() { return Capacity; }
+
+private:
+    static constexpr uint64_t bit(size_t slot) { return uint64_t(1) << slot; }
+    static constexpr uint64_t allSlots = Capacity == 64 ? ~uint64_t(0) : bit(Capacity) - 1;
+
+    // The generation is bumped before the slot is freed, so an insert that
+    // sees the slot free also sees the new generation
+    void release(uint8_t slot) {
+        uint16_t generation = generations[slot].load(std::memory_order_relaxed) + 1;
+        generations[slot].store(generation != 0 ? generation : 1, std::memory_order_relaxed);
+        occupied.fetch_and(~bit(slot), std::memory_order_release);
+    }
+
+    T slots[Capacity] = {};
+    std::atomic<uint64_t> occupied{0};
+    std::atomic<uint16_t> generations[Capacity];
+};
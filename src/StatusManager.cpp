@@ -7,7 +7,7 @@ void StatusManager::setStatus(Status status, bool value) {
 			return;
 		}
 
-		m_Logger.trace("Added status %s", statusToString(status));
+		SVR_LOGT(m_Logger, "Added status %s", statusToString(status));
 
 		m_Status |= status;
 	} else {
@@ -15,7 +15,7 @@ void StatusManager::setStatus(Status status, bool value) {
 			return;
 		}
 
-		m_Logger.trace("Removed status %s", statusToString(status));
+		SVR_LOGT(m_Logger, "Removed status %s", statusToString(status));
 
 		m_Status &= ~status;
 	}
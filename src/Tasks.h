@@ -0,0 +1,58 @@
+#pragma once
+
+#include <Arduino.h>
+
+// How the firmware's tasks are spread over the cores, picked per env with the
+// TASK_CORES build flag
+#define TASK_CORES_SINGLE 1  // One core (ESP32-S2), the tasks are ordered by priority alone
+#define TASK_CORES_DUAL 2    // Radio work on the WiFi core, HID output and control on the other
+
+#ifndef TASK_CORES
+#define TASK_CORES TASK_CORES_DUAL
+#endif
+
+// Every task the firmware starts. The WiFi stack runs its own at priority 23
+// on core 0 and hands received frames to ESPNowCommunication from there; they
+// reach the HID output task through PacketHandling's FIFO, a bounded queue.
+// A higher priority preempts a lower one on the same core.
+namespace Tasks {
+struct Config {
+    const char *name;
+    uint32_t stackSize;
+    UBaseType_t priority;
+    BaseType_t core;
+};
+
+#if TASK_CORES == TASK_CORES_DUAL
+constexpr BaseType_t radioCore = 0;
+constexpr BaseType_t appCore = 1;
+#else
+constexpr BaseType_t radioCore = tskNO_AFFINITY;
+constexpr BaseType_t appCore = tskNO_AFFINITY;
+#endif
+
+// Moves reports from the FIFO to USB. Nothing else on its core outranks it,
+// so console commands and LED patterns can't hold it up. Sleeps until a
+// report arrives or a registration is due.
+constexpr Config hidOutput = {"hidOutput", 4096, tskIDLE_PRIORITY + 5, appCore};
+// Heartbeats, the send queue and pairing broadcasts, next to the WiFi stack.
+// Sleeps until the next of them is due or a message is queued.
+constexpr Config radio = {"radio", 4096, tskIDLE_PRIORITY + 4, radioCore};
+// Button, LEDs, console commands, the load generator and console output,
+// polled every controlPollMs. Woken early to dispatch tracker events.
+constexpr Config control = {"control", 8192, tskIDLE_PRIORITY + 2, appCore};
+constexpr uint32_t controlPollMs = 10;
+constexpr Config logDrain = {"logDrain", 4096, tskIDLE_PRIORITY + 1, tskNO_AFFINITY};
+constexpr Config configFlush = {"configFlush", 4096, tskIDLE_PRIORITY + 1, tskNO_AFFINITY};
+
+// Blocks until the calling task is notified or ms have passed. Waits at least
+// a tick, so a task whose work is always due can't starve the ones below it.
+inline void waitForNotification(uint32_t ms) {
+    TickType_t ticks = pdMS_TO_TICKS(ms);
+    ulTaskNotifyTake(pdTRUE, ticks > 0 ? ticks : 1);
+}
+
+inline BaseType_t start(const Config &config, TaskFunction_t function, void *arg, TaskHandle_t *handle) {
+    return xTaskCreatePinnedToCore(function, config.name, config.stackSize, arg, config.priority, handle, config.core);
+}
+}  // namespace Tasks
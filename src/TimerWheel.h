@@ -0,0 +1,125 @@
+#pragma once
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+
+// Deadlines for up to 64 entries, identified by index, in a wheel of Buckets
+// buckets of TickMs each. A bucket is a bitmask of the entries that expire in
+// its tick, so scheduling is O(1) and advancing costs one step per elapsed
+// tick plus one per expired entry, however many entries are waiting.
+//
+// Entries expire in the first tick that starts at or after their deadline.
+// A deadline further out than the wheel spans is parked in its last bucket
+// and moved on when that bucket comes round.
+//
+// Not thread-safe, the owner serializes all calls.
+template <size_t Entries, size_t Buckets, unsigned long TickMs>
+class TimerWheel {
+    static_assert(Entries > 0 && Entries <= 64, "Each bucket is one 64-bit mask");
+
+public:
+    static constexpr unsigned long spanMs = Buckets * TickMs;
+
+    TimerWheel() {
+        for (size_t i = 0; i < Entries; i++) {
+            bucketOf[i] = none;
+        }
+    }
+
+    // Sets or replaces the entry's deadline
+    void schedule(uint8_t entry, unsigned long dueMs) {
+        cancel(entry);
+        unsigned long offset = 0;
+        if (static_cast<long>(dueMs - nextTickMs) > 0) {
+            offset = (dueMs - nextTickMs + TickMs - 1) / TickMs;
+            if (offset >= Buckets) {
+                offset = Buckets - 1;
+            }
+        }
+        size_t bucket = (cursor + offset) % Buckets;
+        buckets[bucket] |= bit(entry);
+        bucketOf[entry] = bucket;
+        this->dueMs[entry] = dueMs;
+        scheduled++;
+    }
+
+    void cancel(uint8_t entry) {
+        if (bucketOf[entry] == none) {
+            return;
+        }
+        buckets[bucketOf[entry]] &= ~bit(entry);
+        bucketOf[entry] = none;
+        scheduled--;
+    }
+
+    // Calls expired(entry) for every entry whose deadline has passed by
+    // nowMs, in deadline order to the tick. expired may schedule any entry,
+    // including the one it was called with. While the wheel is empty this
+    // only moves its start up to nowMs, so call it before scheduling.
+    template <typename Fn>
+    void advance(unsigned long nowMs, Fn &&expired) {
+        if (scheduled == 0) {
+            nextTickMs = nowMs;
+            return;
+        }
+        if (static_cast<long>(nowMs - nextTickMs) < 0) {
+            return;
+        }
+        // After a long stall the overdue buckets are all expired, visiting
+        // each once is enough
+        unsigned long behind = (nowMs - nextTickMs) / TickMs;
+        if (behind >= Buckets) {
+            nextTickMs += (behind - (Buckets - 1)) * TickMs;
+        }
+
+        while (scheduled != 0 && static_cast<long>(nowMs - nextTickMs) >= 0) {
+            uint64_t due = buckets[cursor];
+            buckets[cursor] = 0;
+            cursor = (cursor + 1) % Buckets;
+            nextTickMs += TickMs;
+
+            while (due != 0) {
+                uint8_t entry = __builtin_ctzll(due);
+                due &= due - 1;
+                bucketOf[entry] = none;
+                scheduled--;
+                if (static_cast<long>(dueMs[entry] - nowMs) > 0) {
+                    // Parked beyond the span
+                    schedule(entry, dueMs[entry]);
+                } else {
+                    expired(entry);
+                }
+            }
+        }
+    }
+
+    // Time until the next tick with an entry in it, ULONG_MAX if there is
+    // none
+    unsigned long millisUntilNext(unsigned long nowMs) const {
+        if (scheduled == 0) {
+            return ULONG_MAX;
+        }
+        for (size_t offset = 0; offset < Buckets; offset++) {
+            if (buckets[(cursor + offset) % Buckets] != 0) {
+                unsigned long tickMs = nextTickMs + offset * TickMs;
+                return static_cast<long>(tickMs - nowMs) > 0 ? tickMs - nowMs : 0;
+            }
+        }
+        return ULONG_MAX;
+    }
+
+    bool isScheduled(uint8_t entry) const { return bucketOf[entry] != none; }
+    size_t size() const { return scheduled; }
+
+private:
+    static constexpr uint64_t bit(size_t entry) { return uint64_t(1) << entry; }
+    static constexpr uint16_t none = UINT16_MAX;
+
+    uint64_t buckets[Buckets] = {};
+    uint16_t bucketOf[Entries];
+    unsigned long dueMs[Entries] = {};
+    size_t cursor = 0;             // The bucket for the tick at nextTickMs
+    unsigned long nextTickMs = 0;  // Start of the next tick to expire
+    size_t scheduled = 0;
+};
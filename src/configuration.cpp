@@ -1,324 +1,454 @@
 #include "configuration.h"
-#include <Arduino.h>
-#include <algorithm>
-#include <WiFi.h>
+#include <cstring>
 #include "espnow/espnow.h"
+#include "hal/Clock.h"
+#include "hal/Radio.h"
+#include "hal/Random.h"
+#include "Tasks.h"
+#include "logging/Logger.h"
 
 #define DEFAULT_WIFI_CHANNEL 6
 
 #define STARTING_TRACKER_ID 0
 
+static SlimeVR::Logging::Logger logger("Config");
+
+namespace {
+class IndexLock {
+public:
+    explicit IndexLock(SemaphoreHandle_t mutex) : mutex(mutex) { if (mutex) xSemaphoreTake(mutex, portMAX_DELAY); }
+    ~IndexLock() { if (mutex) xSemaphoreGive(mutex); }
+private:
+    SemaphoreHandle_t mutex;
+};
+}  // namespace
+
 Configuration &Configuration::getInstance() {
     return instance;
 }
 
+uint64_t Configuration::macKey(const uint8_t mac[6]) {
+    uint64_t key = 0;
+    for (int i = 0; i < 6; i++) {
+        key = (key << 8) | mac[i];
+    }
+    return key;
+}
+
 // Iterate all paired trackers, calling cb(mac, trackerId)
 void Configuration::forEachPairedTracker(std::function<void(const uint8_t mac[6], uint8_t trackerId)> cb) {
-    if (!LittleFS.exists(pairedTrackersPath) || !LittleFS.exists(trackerIdsPath)) return;
-    auto macFile = LittleFS.open(pairedTrackersPath, "r");
-    auto idFile = LittleFS.open(trackerIdsPath, "r");
-    while (macFile.available()) {
-        uint8_t mac[6];
-        if (macFile.read(mac, 6) == 6) {
-            // Find trackerId for this MAC
-            idFile.seek(0);
-            uint8_t idMac[6];
-            uint8_t trackerId = 255;
-            while (idFile.available()) {
-                if (idFile.read(idMac, 6) == 6 && idFile.read(&trackerId, 1) == 1) {
-                    if (memcmp(mac, idMac, 6) == 0) {
-                        break;
-                    }
-                }
-            }
-            cb(mac, trackerId);
+    // Copied first so the callback can call back into Configuration
+    std::vector<TrackerIdRecord> trackers;
+    {
+        IndexLock lock(indexMutex);
+        const auto &pairedMacs = journal.getState().pairedMacs;
+        trackers.reserve(pairedMacs.size());
+        for (const auto &mac : pairedMacs) {
+            auto id = trackerIdIndex.find(macKey(mac.data()));
+            trackers.push_back({mac, id != trackerIdIndex.end() ? id->second : static_cast<uint8_t>(255)});
         }
     }
-    macFile.close();
-    idFile.close();
+    for (const TrackerIdRecord &tracker : trackers) {
+        cb(tracker.mac.data(), tracker.trackerId);
+    }
 }
 
 void Configuration::setWifiChannel(uint8_t channel) {
-    auto result = WiFi.setChannel(channel);
-        if (result != 0) {
-        Serial.printf("[Config] Failed to set WiFi channel to %d - error %d\n", channel, result);
+    if (!SlimeVR::Hal::Radio::setChannel(channel)) {
+        SVR_LOGE(logger, "Failed to set WiFi channel to %d", channel);
         return;
     }
-    auto file = LittleFS.open(wifiChannelPath, "w", true);
-    file.write(&channel, 1);
-    file.close();
+    {
+        IndexLock lock(indexMutex);
+        ConfigJournal::Transaction transaction;
+        transaction.setWifiChannel(channel);
+        commitLocked(transaction);
+    }
     ESPNowCommunication::channel = channel;
-    Serial.printf("[Config] WiFi channel set to %d and saved to %s\n", channel, wifiChannelPath);
+    SVR_LOGI(logger, "WiFi channel set to %d and saved", channel);
     ESPNowCommunication::getInstance().disconnectAllTrackers();
 }
 
 uint8_t Configuration::getWifiChannel() {
-    if (!LittleFS.exists(wifiChannelPath)) {
-        return DEFAULT_WIFI_CHANNEL; // Default channel
-    }
-    auto file = LittleFS.open(wifiChannelPath, "r");
-    uint8_t channel = DEFAULT_WIFI_CHANNEL;
-    file.read(&channel, 1);
-    file.close();
-    return channel;
+    IndexLock lock(indexMutex);
+    const ConfigJournal::State &state = journal.getState();
+    return state.hasWifiChannel ? state.wifiChannel : DEFAULT_WIFI_CHANNEL;
 }
 
 // Get all paired tracker MACs
 std::vector<std::array<uint8_t, 6>> Configuration::getAllPairedTrackerMacs() {
-    std::vector<std::array<uint8_t, 6>> macs;
-    if (!LittleFS.exists(pairedTrackersPath)) return macs;
-    auto file = LittleFS.open(pairedTrackersPath, "r");
-    while (file.available()) {
-        std::array<uint8_t, 6> mac;
-        if (file.read(mac.data(), 6) == 6) {
-            macs.push_back(mac);
-        }
-    }
-    file.close();
-    return macs;
+    IndexLock lock(indexMutex);
+    return journal.getState().pairedMacs;
 }
 
 // Get all paired tracker IDs
 std::vector<uint8_t> Configuration::getAllPairedTrackerIds() {
+    IndexLock lock(indexMutex);
+    const auto &records = journal.getState().trackerIds;
     std::vector<uint8_t> ids;
-    if (!LittleFS.exists(trackerIdsPath)) return ids;
-    auto file = LittleFS.open(trackerIdsPath, "r");
-    uint8_t mac[6];
-    uint8_t trackerId;
-    while (file.available()) {
-        if (file.read(mac, 6) == 6 && file.read(&trackerId, 1) == 1) {
-            ids.push_back(trackerId);
-        }
+    ids.reserve(records.size());
+    for (const TrackerIdRecord &record : records) {
+        ids.push_back(record.trackerId);
     }
-    file.close();
     return ids;
 }
 
 void Configuration::setup() {
-    bool status = LittleFS.begin();
-    if (!status) {
-        Serial.println("Could not mount LittleFS, formatting");
+    if (!indexMutex) {
+        indexMutex = xSemaphoreCreateMutex();
+        flushMutex = xSemaphoreCreateMutex();
+    }
+    {
+        IndexLock lock(indexMutex);
+        // Boot time differs a lot between storage backends, so it's logged
+        uint64_t startUs = SlimeVR::Hal::Clock::micros();
+        if (!journal.load()) {
+            // The flush task keeps trying to open it, and writes the changes
+            // made until then once it can
+            SVR_LOGE(logger, "Could not load the configuration, changes are kept in RAM until the %s storage opens", journal.getStorageName());
+        }
+        rebuildIndexLocked();
+        SVR_LOGI(logger, "Loaded %u paired trackers, %u tracker IDs from %s in %lu us", static_cast<unsigned>(journal.getState().pairedMacs.size()), static_cast<unsigned>(journal.getState().trackerIds.size()), journal.getStorageName(), static_cast<unsigned long>(SlimeVR::Hal::Clock::micros() - startUs));
+    }
+
+    if (flushTaskHandle == nullptr) {
+        Tasks::start(Tasks::configFlush, flushTask, this, &flushTaskHandle);
+    }
+}
+
+void Configuration::flushTask(void *arg) {
+    Configuration *configuration = static_cast<Configuration *>(arg);
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(flushPollMs));
+        configuration->flushIfDue();
+    }
+}
 
-        status = LittleFS.format();
-        if (!status) {
-            Serial.println("Could not format LittleFS, aborting");
+void Configuration::flushIfDue() {
+    {
+        IndexLock lock(indexMutex);
+        uint32_t delayMs = journal.isOpen() ? flushDelayMs : storageRetryMs;
+        if (!journal.hasPendingWrite() || SlimeVR::Hal::Clock::millis() - pendingSinceMs < delayMs) {
             return;
         }
+    }
+    flush();
+}
 
-        status = LittleFS.begin();
-        if (!status) {
-            Serial.println("Could not mount LittleFS, aborting");
+void Configuration::flush() {
+    IndexLock flushLock(flushMutex);
+    if (!openStorage()) {
+        return;
+    }
+    ConfigJournal::PendingWrite write;
+    {
+        IndexLock lock(indexMutex);
+        if (!journal.takePendingWrite(write)) {
             return;
         }
     }
-    Serial.println("LittleFS is mounted");
+    bool written = journal.writePending(write);
+    IndexLock lock(indexMutex);
+    journal.finishWrite(write, written);
+    if (!written) {
+        // Retried by the flush task after another flushDelayMs
+        pendingSinceMs = SlimeVR::Hal::Clock::millis();
+    }
 }
 
-bool Configuration::isTrackerIdInUse(uint8_t trackerId) {
-    if (!LittleFS.exists(trackerIdsPath)) return false;
-    auto file = LittleFS.open(trackerIdsPath, "r");
-    uint8_t mac[6];
-    uint8_t id;
-    while (file.available()) {
-        if (file.read(mac, 6) == 6 && file.read(&id, 1) == 1) {
-            if (id == trackerId) {
-                file.close();
-                return true;
-            }
+bool Configuration::openStorage() {
+    {
+        IndexLock lock(indexMutex);
+        if (journal.isOpen()) {
+            return true;
         }
     }
-    file.close();
-    return false;
+    // Mounting can take a while, lookups don't wait for it
+    bool opened = journal.openStorage();
+    IndexLock lock(indexMutex);
+    if (!opened) {
+        pendingSinceMs = SlimeVR::Hal::Clock::millis();
+        return false;
+    }
+    ConfigJournal::State before = journal.getState();
+    journal.finishOpen();
+    rebuildIndexLocked();
+    const ConfigJournal::State &state = journal.getState();
+    SVR_LOGI(logger, "Opened the %s storage, %u paired trackers, %u tracker IDs", journal.getStorageName(), static_cast<unsigned>(state.pairedMacs.size()), static_cast<unsigned>(state.trackerIds.size()));
+
+    // Trackers may have connected with the code, channel or tracker IDs
+    // used until now
+    bool changed = before.securityCode != state.securityCode || before.hasWifiChannel != state.hasWifiChannel || before.wifiChannel != state.wifiChannel;
+    for (const TrackerIdRecord &record : before.trackerIds) {
+        auto id = trackerIdIndex.find(macKey(record.mac.data()));
+        changed |= id == trackerIdIndex.end() || id->second != record.trackerId;
+    }
+    if (changed) {
+        SVR_LOGI(logger, "The stored settings replace the ones used until now, reconnecting all trackers");
+        ESPNowCommunication::getInstance().reloadConfiguration();
+    }
+    return true;
+}
+
+void Configuration::commitLocked(const ConfigJournal::Transaction &transaction) {
+    if (!journal.hasPendingWrite()) {
+        pendingSinceMs = SlimeVR::Hal::Clock::millis();
+    }
+    if (!journal.isOpen()) {
+        SVR_LOGW(logger, "The %s storage isn't open, the change is only kept in RAM until it is", journal.getStorageName());
+    }
+    journal.commit(transaction);
+    rebuildIndexLocked();
+}
+
+// At most 256 records each, and only after a change
+void Configuration::rebuildIndexLocked() {
+    const ConfigJournal::State &state = journal.getState();
+    pairedIndex.clear();
+    trackerIdIndex.clear();
+    usedTrackerIds.reset();
+    for (const auto &mac : state.pairedMacs) {
+        pairedIndex.insert(macKey(mac.data()));
+    }
+    for (const TrackerIdRecord &record : state.trackerIds) {
+        trackerIdIndex.emplace(macKey(record.mac.data()), record.trackerId);
+        usedTrackerIds.set(record.trackerId);
+    }
+}
+
+bool Configuration::isTrackerIdInUse(uint8_t trackerId) {
+    IndexLock lock(indexMutex);
+    return usedTrackerIds.test(trackerId);
+}
+
+void Configuration::generateSecurityCode(uint8_t securityCode[8]) {
+    for (int i = 0; i < 8; i++) {
+        securityCode[i] = SlimeVR::Hal::random32() & 0xFF;
+    }
 }
 
 void Configuration::getSecurityCode(uint8_t securityCode[8]) {
-    if (!LittleFS.exists(securityCodePath)) {
-        Serial.println("Security code doesn't exist, generating new one");
+    IndexLock lock(indexMutex);
+    const ConfigJournal::State &state = journal.getState();
+    if (!state.hasSecurityCode) {
+        SVR_LOGI(logger, "Security code doesn't exist, generating new one");
         
-        // Generate random 8-byte security code
-        for (int i = 0; i < 8; i++) {
-            securityCode[i] = random(0, 256);
-        }
-        
-        // Save to file
-        auto file = LittleFS.open(securityCodePath, "w", true);
-        file.write(securityCode, 8);
-        file.close();
+        generateSecurityCode(securityCode);
+        ConfigJournal::Transaction transaction;
+        transaction.setSecurityCode(securityCode);
+        commitLocked(transaction);
         
-        Serial.printf("Generated security code: %02x%02x%02x%02x%02x%02x%02x%02x\n",
+        SVR_LOGI(logger, "Generated security code: %02x%02x%02x%02x%02x%02x%02x%02x",
                      securityCode[0], securityCode[1], securityCode[2], securityCode[3],
                      securityCode[4], securityCode[5], securityCode[6], securityCode[7]);
+        if (!journal.isOpen()) {
+            SVR_LOGW(logger, "The code is temporary, a code stored on %s replaces it once the storage opens", journal.getStorageName());
+        }
     } else {
-        // Load existing security code
-        auto file = LittleFS.open(securityCodePath, "r");
-        file.read(securityCode, 8);
-        file.close();
+        memcpy(securityCode, state.securityCode.data(), 8);
         
-        Serial.printf("Loaded security code: %02x:%02x:%02x:%02x:%02x:%02x:%02x:%02x\n",
+        SVR_LOGI(logger, "Loaded security code: %02x:%02x:%02x:%02x:%02x:%02x:%02x:%02x",
                      securityCode[0], securityCode[1], securityCode[2], securityCode[3],
                      securityCode[4], securityCode[5], securityCode[6], securityCode[7]);
     }
 }
 
+void Configuration::setSecurityCode(const uint8_t securityCode[8]) {
+    IndexLock lock(indexMutex);
+    ConfigJournal::Transaction transaction;
+    transaction.setSecurityCode(securityCode);
+    commitLocked(transaction);
+}
+
 void Configuration::resetSecurityCode() {
-    if (LittleFS.exists(securityCodePath)) {
-        LittleFS.remove(securityCodePath);
-        Serial.println("Security code reset");
-        uint8_t dummy[8];
-        Configuration::getInstance().getSecurityCode(ESPNowCommunication::getInstance().securityCode); // Reload into ESPNowCommunication
+    uint8_t securityCode[8];
+    generateSecurityCode(securityCode);
+    setSecurityCode(securityCode);
+    SVR_LOGI(logger, "Security code reset");
+    getSecurityCode(ESPNowCommunication::getInstance().securityCode); // Reload into ESPNowCommunication
+}
+
+void Configuration::resetPairing() {
+    uint8_t securityCode[8];
+    generateSecurityCode(securityCode);
+    {
+        IndexLock lock(indexMutex);
+        ConfigJournal::Transaction transaction;
+        transaction.clearTrackers();
+        transaction.setSecurityCode(securityCode);
+        commitLocked(transaction);
     }
+    SVR_LOGI(logger, "Cleared all paired trackers and reset the security code");
+    getSecurityCode(ESPNowCommunication::getInstance().securityCode); // Reload into ESPNowCommunication
 }
 
-bool Configuration::isPairedTracker(const uint8_t mac[6]) {
-    if (!LittleFS.exists(pairedTrackersPath)) {
+std::vector<uint8_t> Configuration::exportPairing() {
+    IndexLock lock(indexMutex);
+    return journal.exportState();
+}
+
+bool Configuration::isValidImport(const ConfigJournal::State &state) {
+    if (state.hasWifiChannel && (state.wifiChannel < 1 || state.wifiChannel > 14)) {
+        SVR_LOGE(logger, "Import has invalid WiFi channel %d", state.wifiChannel);
         return false;
     }
-    
-    auto file = LittleFS.open(pairedTrackersPath, "r");
-    uint8_t storedMac[6];
-    
-    while (file.read(storedMac, 6) == 6) {
-        if (memcmp(storedMac, mac, 6) == 0) {
-            file.close();
-            return true;
+    std::bitset<256> ids;
+    for (const TrackerIdRecord &record : state.trackerIds) {
+        if (record.trackerId == 255 || ids.test(record.trackerId)) {
+            SVR_LOGE(logger, "Import has invalid or duplicate tracker ID %d", record.trackerId);
+            return false;
+        }
+        ids.set(record.trackerId);
+    }
+    return true;
+}
+
+bool Configuration::importPairing(const std::vector<uint8_t> &data) {
+    ConfigJournal::State state;
+    if (!ConfigJournal::parseExport(data, state) || !isValidImport(state)) {
+        return false;
+    }
+    {
+        IndexLock lock(indexMutex);
+        // An export without a channel keeps the current one
+        if (!state.hasWifiChannel) {
+            state.hasWifiChannel = journal.getState().hasWifiChannel;
+            state.wifiChannel = journal.getState().wifiChannel;
         }
+        journal.reset(state);
+        rebuildIndexLocked();
+    }
+    flush();
+    SVR_LOGI(logger, "Imported %u paired trackers and %u tracker IDs", static_cast<unsigned>(state.pairedMacs.size()), static_cast<unsigned>(state.trackerIds.size()));
+
+    // Connected trackers may have other IDs now, or not be paired at all
+    auto &espnow = ESPNowCommunication::getInstance();
+    espnow.disconnectAllTrackers();
+    uint8_t channel = getWifiChannel();
+    if (channel != ESPNowCommunication::channel && SlimeVR::Hal::Radio::setChannel(channel)) {
+        ESPNowCommunication::channel = channel;
+    }
+    getSecurityCode(espnow.securityCode); // Reload into ESPNowCommunication
+    return true;
+}
+
+void Configuration::factoryReset() {
+    {
+        IndexLock lock(indexMutex);
+        ConfigJournal::State state;
+        state.hasWifiChannel = journal.getState().hasWifiChannel;
+        state.wifiChannel = journal.getState().wifiChannel;
+        journal.reset(state);
+        rebuildIndexLocked();
     }
-    
-    file.close();
-    return false;
+    flush();
+    SVR_LOGI(logger, "Factory reset: cleared paired trackers, tracker IDs and the security code");
+}
+
+bool Configuration::isPairedTracker(const uint8_t mac[6]) {
+    IndexLock lock(indexMutex);
+    return pairedIndex.count(macKey(mac)) != 0;
 }
 
 void Configuration::addPairedTracker(const uint8_t mac[6]) {
-    if (isPairedTracker(mac)) {
+    IndexLock lock(indexMutex);
+    if (pairedIndex.count(macKey(mac)) != 0) {
         return; // Already paired
     }
-    
-    auto file = LittleFS.open(pairedTrackersPath, "a");
-    file.write(mac, 6);
-    file.close();
+    ConfigJournal::Transaction transaction;
+    transaction.pair(mac);
+    commitLocked(transaction);
 }
 
-void Configuration::removePairedTracker(const uint8_t mac[6]) {
-    if (!LittleFS.exists(pairedTrackersPath)) return;
-    
-    // Read all MAC addresses except the one to remove
-    std::vector<uint8_t> remainingMacs;
-    auto file = LittleFS.open(pairedTrackersPath, "r");
-    uint8_t storedMac[6];
-    
-    while (file.read(storedMac, 6) == 6) {
-        if (memcmp(storedMac, mac, 6) != 0) {
-            for (int i = 0; i < 6; i++) {
-                remainingMacs.push_back(storedMac[i]);
-            }
-        }
+uint8_t Configuration::pairTracker(const uint8_t mac[6]) {
+    IndexLock lock(indexMutex);
+    uint64_t key = macKey(mac);
+    ConfigJournal::Transaction transaction;
+    if (pairedIndex.count(key) == 0) {
+        transaction.pair(mac);
     }
-    file.close();
-    
-    // Write back the remaining MAC addresses
-    file = LittleFS.open(pairedTrackersPath, "w");
-    file.write(remainingMacs.data(), remainingMacs.size());
-    file.close();
-
-
-    // Remove tracker ID for this MAC
-    if (LittleFS.exists(trackerIdsPath)) {
-        std::vector<uint8_t> remainingData;
-        auto idFile = LittleFS.open(trackerIdsPath, "r");
-        uint8_t idMac[6];
-        uint8_t trackerId;
-        while (idFile.read(idMac, 6) == 6 && idFile.read(&trackerId, 1) == 1) {
-            if (memcmp(idMac, mac, 6) != 0) {
-                for (int i = 0; i < 6; i++) {
-                    remainingData.push_back(idMac[i]);
-                }
-                remainingData.push_back(trackerId);
-            }
-        }
-        idFile.close();
+    auto id = trackerIdIndex.find(key);
+    uint8_t trackerId = id != trackerIdIndex.end() ? id->second : findFreeTrackerIdLocked(mac);
+    if (id == trackerIdIndex.end() && trackerId != 255) {
+        transaction.assignTrackerId(mac, trackerId);
+        SVR_LOGI(logger, "Allocated new tracker ID %d for MAC %02x:%02x:%02x:%02x:%02x:%02x",
+                     trackerId, mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    }
+    if (!transaction.empty()) {
+        commitLocked(transaction);
+    }
+    return trackerId;
+}
 
-        // Write back all except the removed one
-        idFile = LittleFS.open(trackerIdsPath, "w");
-        if (!remainingData.empty()) {
-            idFile.write(remainingData.data(), remainingData.size());
-        }
-        idFile.close();
+void Configuration::removePairedTracker(const uint8_t mac[6]) {
+    IndexLock lock(indexMutex);
+    uint64_t key = macKey(mac);
+    // The pairing and the tracker ID go in one commit, so a power loss can't
+    // leave just one of them
+    if (pairedIndex.count(key) != 0 || trackerIdIndex.count(key) != 0) {
+        ConfigJournal::Transaction transaction;
+        transaction.unpair(mac);
+        commitLocked(transaction);
     }
-    
-    Serial.printf("Removed paired tracker: %02x:%02x:%02x:%02x:%02x:%02x\n",
+
+    SVR_LOGI(logger, "Removed paired tracker: %02x:%02x:%02x:%02x:%02x:%02x",
                   mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
 }
 
 void Configuration::clearAllPairedTrackers() {
-    if (LittleFS.exists(pairedTrackersPath)) {
-        LittleFS.remove(pairedTrackersPath);
-        Serial.println("Cleared all paired trackers");
-    }
-    if (LittleFS.exists(trackerIdsPath)) {
-        LittleFS.remove(trackerIdsPath);
-        Serial.println("Cleared all tracker IDs");
-    }
+    IndexLock lock(indexMutex);
+    ConfigJournal::Transaction transaction;
+    transaction.clearTrackers();
+    commitLocked(transaction);
+    SVR_LOGI(logger, "Cleared all paired trackers and tracker IDs");
 }
 
 uint8_t Configuration::getTrackerIdForMac(const uint8_t mac[6]) {
-    if (!LittleFS.exists(trackerIdsPath)) {
-        // No tracker IDs file exists, allocate new ID
-        return allocateTrackerIdForMac(mac);
-    }
-    
-    // Search for existing tracker ID
-    auto file = LittleFS.open(trackerIdsPath, "r");
-    uint8_t storedMac[6];
-    uint8_t trackerId;
-    
-    while (file.available()) {
-        if (file.read(storedMac, 6) == 6 && file.read(&trackerId, 1) == 1) {
-            if (memcmp(storedMac, mac, 6) == 0) {
-                file.close();
-                Serial.printf("Found existing tracker ID %d for MAC %02x:%02x:%02x:%02x:%02x:%02x\n",
-                             trackerId, mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-                return trackerId;
-            }
-        }
+    IndexLock lock(indexMutex);
+    auto id = trackerIdIndex.find(macKey(mac));
+    if (id != trackerIdIndex.end()) {
+        SVR_LOGD(logger, "Found existing tracker ID %d for MAC %02x:%02x:%02x:%02x:%02x:%02x",
+                     id->second, mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+        return id->second;
     }
-    file.close();
-    
+
     // MAC not found, allocate new ID
-    return allocateTrackerIdForMac(mac);
+    return allocateTrackerIdLocked(mac);
 }
 
 uint8_t Configuration::allocateTrackerIdForMac(const uint8_t mac[6]) {
-    // Read all existing tracker IDs to find first available
-    std::vector<uint8_t> usedIds;
-    
-    if (LittleFS.exists(trackerIdsPath)) {
-        auto file = LittleFS.open(trackerIdsPath, "r");
-        uint8_t storedMac[6];
-        uint8_t trackerId;
-        
-        while (file.available()) {
-            if (file.read(storedMac, 6) == 6 && file.read(&trackerId, 1) == 1) {
-                usedIds.push_back(trackerId);
-            }
-        }
-        file.close();
-    }
-    
+    IndexLock lock(indexMutex);
+    return allocateTrackerIdLocked(mac);
+}
+
+uint8_t Configuration::findFreeTrackerIdLocked(const uint8_t mac[6]) {
     // Find first available ID (starting from STARTING_TRACKER_ID)
-    uint8_t newId = STARTING_TRACKER_ID;
-    while (std::find(usedIds.begin(), usedIds.end(), newId) != usedIds.end()) {
+    size_t newId = STARTING_TRACKER_ID;
+    while (newId < usedTrackerIds.size() && usedTrackerIds.test(newId)) {
         newId++;
     }
-    
+    if (newId == usedTrackerIds.size()) {
+        SVR_LOGE(logger, "No tracker IDs left for MAC %02x:%02x:%02x:%02x:%02x:%02x",
+                     mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+        return 255;
+    }
+    return newId;
+}
+
+uint8_t Configuration::allocateTrackerIdLocked(const uint8_t mac[6]) {
+    uint8_t newId = findFreeTrackerIdLocked(mac);
+    if (newId == 255) {
+        return 255;
+    }
+
     // Store the new MAC -> ID mapping
-    auto file = LittleFS.open(trackerIdsPath, "a");
-    file.write(mac, 6);
-    file.write(&newId, 1);
-    file.close();
-    
-    Serial.printf("Allocated new tracker ID %d for MAC %02x:%02x:%02x:%02x:%02x:%02x\n",
+    ConfigJournal::Transaction transaction;
+    transaction.assignTrackerId(mac, newId);
+    commitLocked(transaction);
+
+    SVR_LOGI(logger, "Allocated new tracker ID %d for MAC %02x:%02x:%02x:%02x:%02x:%02x",
                  newId, mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-    
+
     return newId;
 }
 
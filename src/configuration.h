@@ -1,7 +1,13 @@
 #pragma once
 
-#include <LittleFS.h>
+#include <array>
+#include <bitset>
 #include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "ConfigJournal.h"
 #include "Serial.h"
 
 class Configuration {
@@ -9,7 +15,6 @@ public:
     // WiFi channel override
     void setWifiChannel(uint8_t channel);
     uint8_t getWifiChannel();
-    static constexpr char wifiChannelPath[] = "/wifiChannel.bin";
     // Helper: iterate all paired trackers, calling a callback with mac and trackerId
     void forEachPairedTracker(std::function<void(const uint8_t mac[6], uint8_t trackerId)> cb);
 
@@ -17,14 +22,44 @@ public:
     std::vector<std::array<uint8_t, 6>> getAllPairedTrackerMacs();
     std::vector<uint8_t> getAllPairedTrackerIds();
     static Configuration &getInstance();
+    // Opens the storage backend, loads the configuration journal into RAM
+    // and starts the flush task. If the storage can't be opened the
+    // configuration starts from defaults, and the flush task keeps trying to
+    // open it.
     void setup();
+    // Writes changes still waiting for the flush task to flash. Call before
+    // restarting.
+    void flush();
+    // Flushes once changes have waited flushDelayMs. Called by the flush
+    // task; the native build has no tasks and calls it directly.
+    void flushIfDue();
     uint8_t getSavedTrackerCount();
+    // Generates and saves a code if there is none yet
     void getSecurityCode(uint8_t securityCode[8]);
+    void setSecurityCode(const uint8_t securityCode[8]);
+    // Saves a new random code and loads it into ESPNowCommunication
     void resetSecurityCode();
+    // Unpairs every tracker and resets the security code in one commit
+    void resetPairing();
+    // The whole pairing database (security code, WiFi channel, MAC -> tracker
+    // ID table) as one versioned, CRC-protected blob
+    std::vector<uint8_t> exportPairing();
+    // Replaces the pairing database with an export in a single flash write,
+    // then disconnects all trackers and switches to the imported channel and
+    // security code. Returns false and changes nothing if the blob is
+    // damaged or inconsistent.
+    bool importPairing(const std::vector<uint8_t> &data);
+    // Removes everything but the WiFi channel and flushes. A new security
+    // code is generated when it's next read.
+    void factoryReset();
     
-    // Tracker management
+    // Tracker management. Queries are served from RAM; changes update RAM
+    // and the flush task writes them to flash shortly after.
     bool isPairedTracker(const uint8_t mac[6]);
     void addPairedTracker(const uint8_t mac[6]);
+    // Pairs the tracker and allocates its tracker ID in one commit. Returns
+    // the tracker ID, existing or new.
+    uint8_t pairTracker(const uint8_t mac[6]);
     void removePairedTracker(const uint8_t mac[6]);
     void clearAllPairedTrackers();
 
@@ -39,7 +74,47 @@ private:
     Configuration() = default;
 
     static Configuration instance;
-    static constexpr char securityCodePath[] = "/securityCode.bin";
-    static constexpr char pairedTrackersPath[] = "/pairedTrackers.bin";
-    static constexpr char trackerIdsPath[] = "/trackerIds.bin";
+
+    using TrackerIdRecord = ConfigJournal::TrackerIdRecord;
+
+    // Changes are written together once the first one has waited this long,
+    // so pairing a batch of trackers costs one flash write
+    static constexpr uint32_t flushDelayMs = 250;
+    static constexpr uint32_t flushPollMs = 50;
+    // How often the flush task tries to open storage that setup() couldn't
+    static constexpr uint32_t storageRetryMs = 5000;
+
+    static void flushTask(void *arg);
+
+    // MACs as 48-bit integers, for hashing
+    static uint64_t macKey(const uint8_t mac[6]);
+
+    // Opens the storage if setup() couldn't and merges what it holds with the
+    // changes made since, see ConfigJournal::finishOpen(). If that changed
+    // the security code, channel or a tracker ID, ESPNowCommunication
+    // reloads them and reconnects the trackers. Returns false if the storage
+    // is still unavailable. Called with flushMutex held.
+    bool openStorage();
+    void commitLocked(const ConfigJournal::Transaction &transaction);
+    void rebuildIndexLocked();
+    // Lowest free tracker ID, or 255 if all are taken
+    uint8_t findFreeTrackerIdLocked(const uint8_t mac[6]);
+    uint8_t allocateTrackerIdLocked(const uint8_t mac[6]);
+    static void generateSecurityCode(uint8_t securityCode[8]);
+    static bool isValidImport(const ConfigJournal::State &state);
+
+    // The journal's state holds the records in the order they were added,
+    // the hashed indexes built from it answer lookups. Used from the WiFi
+    // task and the main loop, so every access holds indexMutex.
+    ConfigJournal journal{SlimeVR::Hal::getConfigStorage()};
+    std::unordered_set<uint64_t> pairedIndex;
+    std::unordered_map<uint64_t, uint8_t> trackerIdIndex;
+    std::bitset<256> usedTrackerIds;
+    SemaphoreHandle_t indexMutex = nullptr;
+
+    // Held for a whole flush, so batches reach flash in commit order. Flash
+    // writes happen outside indexMutex, lookups never wait for them.
+    SemaphoreHandle_t flushMutex = nullptr;
+    TaskHandle_t flushTaskHandle = nullptr;
+    uint32_t pendingSinceMs = 0;
 };
@@ -5,4 +5,5 @@ enum class ErrorCodes {
     ESP_NOW_INIT_FAILED = 0x01,
     ESP_NOW_ADDING_BROADCAST_FAILED = 0x02,
     ESP_RECV_CALLACK_REGISTERING_FAILED = 0x03,
+    TASK_START_FAILED = 0x04,
 };
@@ -0,0 +1,178 @@
+#include "PacketCapture.h"
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include "hal/Clock.h"
+
+namespace Clock = SlimeVR::Hal::Clock;
+namespace Radio = SlimeVR::Hal::Radio;
+
+PacketCapture PacketCapture::instance;
+
+PacketCapture &PacketCapture::getInstance() {
+    return instance;
+}
+
+bool PacketCapture::start(size_t newSnapLength) {
+    newSnapLength = std::min(std::max<size_t>(newSnapLength, 1), maxSnapLength);
+    if (slots == nullptr || newSnapLength != snapLength) {
+        stop();
+        if (!allocate(newSnapLength)) {
+            return false;
+        }
+        written.store(0);
+    }
+    active.store(true);
+    return true;
+}
+
+void PacketCapture::stop() {
+    active.store(false);
+    waitForWriters();
+}
+
+void PacketCapture::clear() {
+    bool wasActive = active.exchange(false);
+    waitForWriters();
+    written.store(0);
+    active.store(wasActive);
+}
+
+size_t PacketCapture::getRecordCount() const {
+    return std::min<size_t>(written.load(std::memory_order_relaxed), slotCount);
+}
+
+bool PacketCapture::allocate(size_t newSnapLength) {
+    if (slots != nullptr) {
+        heap_caps_free(slots);
+        slots = nullptr;
+        slotCount = 0;
+    }
+
+    slotSize = (sizeof(Record) + newSnapLength + 3) & ~size_t(3);
+    inPsram = psramFound();
+    size_t bytes = inPsram ? psramCaptureBytes : internalCaptureBytes;
+    slots = static_cast<uint8_t *>(heap_caps_malloc(bytes, inPsram ? MALLOC_CAP_SPIRAM : MALLOC_CAP_8BIT));
+    if (slots == nullptr) {
+        return false;
+    }
+    slotCount = bytes / slotSize;
+    snapLength = newSnapLength;
+    return true;
+}
+
+// The receive callback is the only writer. stop() and dump() clear active and
+// then wait here, so the ring is never resized or read while a frame is being
+// copied in.
+void PacketCapture::waitForWriters() {
+    while (writers.load() != 0) {
+        Clock::delay(1);
+    }
+}
+
+void PacketCapture::recordFrame(const Radio::RxInfo &info, const uint8_t *data, int dataLen) {
+    writers.fetch_add(1);
+    if (!active.load()) {
+        writers.fetch_sub(1);
+        return;
+    }
+
+    uint32_t index = written.load(std::memory_order_relaxed);
+    uint8_t *slot = &slots[(index % slotCount) * slotSize];
+    Record *record = reinterpret_cast<Record *>(slot);
+    size_t length = std::max(dataLen, 0);
+
+    record->timestampUs = Clock::micros();
+    memcpy(record->mac, info.srcMac, sizeof(record->mac));
+    record->rssi = info.rssi;
+    record->channel = info.channel;
+    record->length = static_cast<uint8_t>(std::min<size_t>(length, UINT8_MAX));
+    record->capturedLength = static_cast<uint8_t>(std::min(length, snapLength));
+    memcpy(slot + sizeof(Record), data, record->capturedLength);
+
+    written.store(index + 1, std::memory_order_release);
+    writers.fetch_sub(1);
+}
+
+bool PacketCapture::dump(SlimeVR::Hal::ConsolePort &port) {
+    bool wasActive = active.exchange(false);
+    waitForWriters();
+
+    // Keep console output off the USB port until the dump is complete
+    Serial.flush();
+    bool usbConsole = Serial.isSinkEnabled(HybridSerial::Sink::USB);
+    Serial.setSinkEnabled(HybridSerial::Sink::USB, false);
+
+    uint32_t total = written.load(std::memory_order_acquire);
+    uint32_t count = std::min<uint32_t>(total, slotCount);
+
+    HeaderFrame header;
+    header.version = formatVersion;
+    header.channel = Radio::getChannel();
+    header.snapLength = snapLength;
+    header.recordCount = count;
+    header.overwrittenCount = total - count;
+    Radio::getMacAddress(header.dongleMac);
+
+    bool ok = writeFrame(port, FrameType::HEADER, &header, sizeof(header));
+    for (uint32_t i = total - count; ok && i < total; i++) {
+        const uint8_t *slot = &slots[(i % slotCount) * slotSize];
+        const Record *record = reinterpret_cast<const Record *>(slot);
+        ok = writeFrame(port, FrameType::RECORD, record, sizeof(Record), slot + sizeof(Record), record->capturedLength);
+    }
+    if (ok) {
+        EndFrame end;
+        end.recordCount = count;
+        ok = writeFrame(port, FrameType::END, &end, sizeof(end));
+    }
+    port.flush();
+
+    Serial.setSinkEnabled(HybridSerial::Sink::USB, usbConsole);
+    active.store(wasActive);
+    return ok;
+}
+
+bool PacketCapture::writeFrame(SlimeVR::Hal::ConsolePort &port, FrameType type, const void *payload, size_t payloadLen, const void *extra, size_t extraLen) {
+    uint16_t length = payloadLen + extraLen;
+    uint8_t head[5] = {frameMagic[0], frameMagic[1], static_cast<uint8_t>(type), static_cast<uint8_t>(length & 0xFF), static_cast<uint8_t>(length >> 8)};
+
+    uint16_t crc = crc16(0xFFFF, &head[2], 3);
+    crc = crc16(crc, static_cast<const uint8_t *>(payload), payloadLen);
+    crc = crc16(crc, static_cast<const uint8_t *>(extra), extraLen);
+    uint8_t tail[2] = {static_cast<uint8_t>(crc & 0xFF), static_cast<uint8_t>(crc >> 8)};
+
+    return writeAll(port, head, sizeof(head))
+        && writeAll(port, static_cast<const uint8_t *>(payload), payloadLen)
+        && writeAll(port, static_cast<const uint8_t *>(extra), extraLen)
+        && writeAll(port, tail, sizeof(tail));
+}
+
+// Console ports never block on writes, so retry until the host has taken
+// everything or stops reading
+bool PacketCapture::writeAll(SlimeVR::Hal::ConsolePort &port, const uint8_t *data, size_t len) {
+    uint32_t lastProgress = Clock::millis();
+    while (len > 0) {
+        size_t sent = port.write(data, len);
+        if (sent > 0) {
+            data += sent;
+            len -= sent;
+            lastProgress = Clock::millis();
+        } else if (!port.isConnected() || Clock::millis() - lastProgress >= dumpStallTimeoutMs) {
+            return false;
+        } else {
+            Clock::delay(1);
+        }
+    }
+    return true;
+}
+
+// CRC-16/CCITT-FALSE, bitwise since it only runs while dumping
+uint16_t PacketCapture::crc16(uint16_t crc, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        crc ^= static_cast<uint16_t>(data[i]) << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "Serial.h"
+#include "hal/Console.h"
+#include "hal/Radio.h"
+
+// Records raw received ESP-NOW frames into a RAM ring for later inspection.
+//
+// The ring lives in PSRAM when the board has it. Recording is off by default
+// and costs a single relaxed load on the receive path while off. Once the
+// ring is full the oldest frames are overwritten.
+//
+// dump() streams the capture over USB CDC as a sequence of frames:
+//
+//   magic (2 bytes, A5 5C) | type (1) | length (2, LE) | payload | CRC-16 (2, LE)
+//
+// The CRC is CRC-16/CCITT-FALSE over type, length and payload. A dump is a
+// header frame, one record frame per captured packet (oldest first) and an
+// end frame. tools/capture2pcap.cpp turns a saved dump into a pcap file.
+class PacketCapture {
+public:
+    static constexpr uint8_t frameMagic[2] = {0xA5, 0x5C};
+    static constexpr uint8_t formatVersion = 1;
+
+    enum class FrameType : uint8_t {
+        HEADER = 1,
+        RECORD = 2,
+        END = 3,
+    };
+
+    struct __attribute__((packed)) HeaderFrame {
+        uint8_t version;
+        uint8_t channel;
+        uint16_t snapLength;
+        uint32_t recordCount;
+        uint32_t overwrittenCount;  // Records lost to wraparound before the dump
+        uint8_t dongleMac[6];
+    };
+
+    struct __attribute__((packed)) Record {
+        uint64_t timestampUs;  // Clock time at reception
+        uint8_t mac[6];
+        int8_t rssi;
+        uint8_t channel;
+        uint8_t length;          // Length of the frame on air
+        uint8_t capturedLength;  // Bytes of payload that follow, at most the snap length
+    };
+
+    struct __attribute__((packed)) EndFrame {
+        uint32_t recordCount;
+    };
+
+    static constexpr size_t maxSnapLength = SlimeVR::Hal::Radio::maxPayloadLength;
+    static constexpr size_t psramCaptureBytes = 512 * 1024;
+    static constexpr size_t internalCaptureBytes = 16 * 1024;
+
+    static PacketCapture &getInstance();
+
+    // Starts recording frames truncated to snapLength bytes. Restarting with a
+    // different snap length discards the current capture.
+    bool start(size_t snapLength = maxSnapLength);
+    void stop();
+    void clear();
+
+    bool isActive() const { return active.load(std::memory_order_relaxed); }
+    size_t getSnapLength() const { return snapLength; }
+    size_t getCapacity() const { return slotCount; }
+    size_t getRecordCount() const;
+    uint32_t getTotalCount() const { return written.load(std::memory_order_relaxed); }
+    bool isInPsram() const { return inPsram; }
+
+    // Called from the ESP-NOW receive callback
+    inline void record(const SlimeVR::Hal::Radio::RxInfo &info, const uint8_t *data, int dataLen) {
+        if (!active.load(std::memory_order_relaxed)) {
+            return;
+        }
+        recordFrame(info, data, dataLen);
+    }
+
+    // Streams the capture to the USB console port in the framed format above.
+    // Recording is paused while dumping and console output is held back from
+    // the USB port so it doesn't interleave with the frames.
+    bool dump(SlimeVR::Hal::ConsolePort &port);
+
+private:
+    static PacketCapture instance;
+    PacketCapture() = default;
+
+    void recordFrame(const SlimeVR::Hal::Radio::RxInfo &info, const uint8_t *data, int dataLen);
+    void waitForWriters();
+    bool allocate(size_t newSnapLength);
+
+    bool writeFrame(SlimeVR::Hal::ConsolePort &port, FrameType type, const void *payload, size_t payloadLen, const void *extra = nullptr, size_t extraLen = 0);
+    static bool writeAll(SlimeVR::Hal::ConsolePort &port, const uint8_t *data, size_t len);
+    static uint16_t crc16(uint16_t crc, const uint8_t *data, size_t len);
+
+    uint8_t *slots = nullptr;
+    size_t slotSize = 0;
+    size_t slotCount = 0;
+    size_t snapLength = 0;
+    bool inPsram = false;
+
+    std::atomic<bool> active{false};
+    std::atomic<uint32_t> writers{0};
+    std::atomic<uint32_t> written{0};  // Total frames recorded since the last clear
+
+    static constexpr unsigned long dumpStallTimeoutMs = 1000;
+};
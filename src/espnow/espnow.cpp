@@ -3,10 +3,14 @@
 
 #include "configuration.h"
 #include "espnow/messages.h"
+#include "espnow/PacketCapture.h"
 #include "packetHandling.h"
-#include <esp_wifi.h>
-#include <string>
+#include "hal/Clock.h"
+#include "hal/Random.h"
 #include "../GlobalVars.h"
+#include "logging/Logger.h"
+
+#include <algorithm>
 
 // Ensure StatusManager type is defined before extern declaration
 // Use the global StatusManager instance defined in main.cpp
@@ -16,6 +20,10 @@ extern SlimeVR::Status::StatusManager statusManager;
 #define MACSTR "%02x:%02x:%02x:%02x:%02x:%02x"
 #define MAC2ARGS(mac) mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]
 
+namespace Radio = SlimeVR::Hal::Radio;
+namespace Clock = SlimeVR::Hal::Clock;
+
+static SlimeVR::Logging::Logger logger("ESPNow");
 
 // Static member definition
 unsigned int ESPNowCommunication::channel = 6;
@@ -42,19 +50,42 @@ void ESPNowCommunication::onTrackerDisconnected(std::function<void(uint8_t)> cal
     trackerDisconnectedCallbacks.push_back(std::move(callback));
 }
 
-// Invokes all registered tracker paired event callbacks
-void ESPNowCommunication::invokeTrackerPairedEvent() {
-    for (auto &callback : trackerPairedCallbacks) callback();
+// Queues an event for dispatchEvents()
+void ESPNowCommunication::publishEvent(TrackerEvent::Type type, const uint8_t mac[6], uint8_t trackerId) {
+    TrackerEvent event;
+    event.type = type;
+    event.trackerId = trackerId;
+    memcpy(event.mac.data(), mac, event.mac.size());
+    if (!events.publish(event)) {
+        SVR_LOGW(logger, "Event queue full, dropped %s event for tracker " MACSTR, eventTypeName(type), MAC2ARGS(mac));
+    }
 }
 
-// Invokes all registered tracker connected event callbacks
-void ESPNowCommunication::invokeTrackerConnectedEvent(const uint8_t *trackerMacAddress) {
-    for (auto &callback : trackerConnectedCallbacks) callback(trackerMacAddress);
+// Invokes the registered callbacks for every queued event
+void ESPNowCommunication::dispatchEvents() {
+    TrackerEvent event;
+    while (events.take(event)) {
+        switch (event.type) {
+            case TrackerEvent::Type::PAIRED:
+                for (auto &callback : trackerPairedCallbacks) callback();
+                break;
+            case TrackerEvent::Type::CONNECTED:
+                for (auto &callback : trackerConnectedCallbacks) callback(event.mac.data());
+                break;
+            case TrackerEvent::Type::DISCONNECTED:
+                for (auto &callback : trackerDisconnectedCallbacks) callback(event.trackerId);
+                break;
+        }
+    }
 }
 
-// Invokes all registered tracker disconnected event callbacks
-void ESPNowCommunication::invokeTrackerDisconnectedEvent(uint8_t trackerId) {
-    for (auto &callback : trackerDisconnectedCallbacks) callback(trackerId);
+const char *ESPNowCommunication::eventTypeName(TrackerEvent::Type type) {
+    switch (type) {
+        case TrackerEvent::Type::PAIRED: return "paired";
+        case TrackerEvent::Type::CONNECTED: return "connected";
+        case TrackerEvent::Type::DISCONNECTED: return "disconnected";
+    }
+    return "unknown";
 }
 
 // Gets the number of currently connected trackers
@@ -62,48 +93,44 @@ size_t ESPNowCommunication::getConnectedTrackerCount() const {
     return connectedTrackers.size();
 }
 
-// Gets the MAC address of a connected tracker by its index
-bool ESPNowCommunication::getTrackerMacByIndex(size_t index, uint8_t mac[6]) const {
-    if (index >= connectedTrackers.size()) return false;
-    memcpy(mac, connectedTrackers[index].mac.data(), 6);
+// Gets the next connected tracker after cursor, round robin
+bool ESPNowCommunication::getNextTracker(TrackerHandle &cursor, uint8_t mac[6], uint8_t &trackerId) const {
+    cursor = connectedTrackers.next(cursor);
+    const Tracker *tracker = connectedTrackers.get(cursor);
+    if (tracker == nullptr) return false;
+    memcpy(mac, tracker->mac.data(), 6);
+    trackerId = tracker->trackerId;
     return true;
 }
 
-// Gets the MAC address of a connected tracker by its index
-uint8_t* ESPNowCommunication::getTrackerIdByIndex(size_t index) {
-    return &connectedTrackers[index].trackerId;
+// Finds the connected tracker with the given MAC address
+ESPNowCommunication::TrackerHandle ESPNowCommunication::findTracker(const uint8_t peerMac[6]) const {
+    // Fast MAC comparison using integer comparisons instead of memcmp
+    return connectedTrackers.find([peerMac](const Tracker &tracker) {
+        return *reinterpret_cast<const uint32_t *>(tracker.mac.data()) == *reinterpret_cast<const uint32_t *>(peerMac) && *reinterpret_cast<const uint16_t *>(tracker.mac.data() + 4) == *reinterpret_cast<const uint16_t *>(peerMac + 4);
+    });
 }
 
 // Gets the tracker structure for a given MAC address
 ESPNowCommunication::Tracker *ESPNowCommunication::getTracker(const uint8_t peerMac[6]) {
-    // Fast MAC comparison using integer comparisons instead of memcmp
-    for (auto &tracker : connectedTrackers) {
-        if (*reinterpret_cast<const uint32_t *>(tracker.mac.data()) == *reinterpret_cast<const uint32_t *>(peerMac) && *reinterpret_cast<const uint16_t *>(tracker.mac.data() + 4) == *reinterpret_cast<const uint16_t *>(peerMac + 4)) {
-            return &tracker;
-        }
-    }
-    return nullptr;
+    return connectedTrackers.get(findTracker(peerMac));
 }
 
 // Checks if a tracker with the given MAC address is currently connected
 bool ESPNowCommunication::isTrackerConnected(const uint8_t peerMac[6]) {
-    // Fast MAC comparison using integer comparisons instead of memcmp
-    for (const auto &tracker : connectedTrackers) {
-        if (*reinterpret_cast<const uint32_t *>(tracker.mac.data()) == *reinterpret_cast<const uint32_t *>(peerMac) && *reinterpret_cast<const uint16_t *>(tracker.mac.data() + 4) == *reinterpret_cast<const uint16_t *>(peerMac + 4) && esp_now_is_peer_exist(peerMac)) return true;
-    }
-    return false;
+    return findTracker(peerMac).valid() && Radio::hasPeer(peerMac);
 }
 
 // Checks if a tracker ID is currently connected
 bool ESPNowCommunication::isTrackerIdConnected(uint8_t trackerId) const {
-    for (const auto &tracker : connectedTrackers) if (tracker.trackerId == trackerId) return true;
-    return false;
+    return connectedTrackers.find([trackerId](const Tracker &tracker) { return tracker.trackerId == trackerId; }).valid();
 }
 
 // Enters pairing mode
 void ESPNowCommunication::enterPairingMode() {
     pairing = true;
     statusManager.setStatus(SlimeVR::Status::PAIRING_MODE, true);
+    wakeUpdate();
 }
 
 // Exits pairing mode
@@ -114,46 +141,57 @@ void ESPNowCommunication::exitPairingMode() {
 
 // Disconnect a single tracker by MAC
 bool ESPNowCommunication::disconnectSingleTracker(const uint8_t mac[6]) {
-    for (auto it = connectedTrackers.begin(); it != connectedTrackers.end(); ++it) {
-        if (memcmp(it->mac.data(), mac, 6) == 0) {
-            uint8_t trackerId = it->trackerId;
-            deletePeer(mac);
-            connectedTrackers.erase(it);
-            Serial.printf("[ESPNOW] Disconnected tracker %02x:%02x:%02x:%02x:%02x:%02x (ID: %d)\n", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5], trackerId);
-            invokeTrackerDisconnectedEvent(trackerId);
-            sendRateUpdateNextTick = true;
-            return true;
-        }
-    }
-    return false;
+    TrackerHandle handle = findTracker(mac);
+    if (!handle.valid()) return false;
+    disconnectTracker(handle);
+    return true;
+}
+
+void ESPNowCommunication::disconnectTracker(TrackerHandle handle) {
+    const Tracker *tracker = connectedTrackers.get(handle);
+    if (tracker == nullptr) return;
+    // Copied, the slot is free for the next tracker once removed
+    const std::array<uint8_t, 6> mac = tracker->mac;
+    const uint8_t trackerId = tracker->trackerId;
+    deletePeer(mac.data());
+    connectedTrackers.remove(handle);
+    SVR_LOGI(logger, "Disconnected tracker " MACSTR " (ID: %d)", MAC2ARGS(mac.data()), trackerId);
+    publishEvent(TrackerEvent::Type::DISCONNECTED, mac.data(), trackerId);
+    sendRateUpdateNextTick = true;
+    wakeUpdate();
 }
 
 // Disconnect all trackers
 void ESPNowCommunication::disconnectAllTrackers() {
-    for (const auto &tracker : connectedTrackers) {
+    connectedTrackers.forEach([this](TrackerHandle handle, const Tracker &tracker) {
         deletePeer(tracker.mac.data());
-        invokeTrackerDisconnectedEvent(tracker.trackerId);
-    }
+        publishEvent(TrackerEvent::Type::DISCONNECTED, tracker.mac.data(), tracker.trackerId);
+    });
 
     connectedTrackers.clear();
-    Serial.println("All trackers disconnected");
+    SVR_LOGI(logger, "All trackers disconnected");
 }
 
 // Queue a message for sending with rate limiting
-void ESPNowCommunication::queueMessageMutex(const uint8_t peerMac[6], const uint8_t *data, size_t dataLen, Tracker* tracker, bool ephemeral) {
+void ESPNowCommunication::queueMessageMutex(const uint8_t peerMac[6], const uint8_t *data, size_t dataLen, TrackerHandle tracker, bool ephemeral) {
     // Validate message data
-    // Serial.printf("Queueing message to " MACSTR " of size %zu\n", MAC2ARGS(peerMac), dataLen);
-    if (dataLen == 0 || dataLen > ESP_NOW_MAX_DATA_LEN) {
-        Serial.printf("Invalid message size %zu for " MACSTR ", skipping\n", dataLen, MAC2ARGS(peerMac));
+    SVR_LOGT(logger, "Queueing message to " MACSTR " of size %zu", MAC2ARGS(peerMac), dataLen);
+    if (dataLen == 0 || dataLen > Radio::maxPayloadLength) {
+        SVR_LOGE(logger, "Invalid message size %zu for " MACSTR ", skipping", dataLen, MAC2ARGS(peerMac));
         return;
     }
 
+    // The WiFi task's callback and the radio and control tasks all queue
+    // messages
+    MutexLock lock(queueMutex);
+
     // Check if queue is full
     size_t nextTail = (queueTail + 1) % maxQueueSize;
     if (nextTail == queueHead) {
         // Calculate queue depth for diagnostic output
         size_t queueDepth = (queueTail >= queueHead) ? (queueTail - queueHead) : (maxQueueSize - queueHead + queueTail);
-        Serial.printf("Send queue full! Dropping message to " MACSTR " (queue: %zu/%zu, depth: %zu)\n", MAC2ARGS(peerMac), maxQueueSize, maxQueueSize, queueDepth);
+        stats.sendQueueFull++;
+        SVR_LOGW(logger, "Send queue full! Dropping message to " MACSTR " (queue: %zu/%zu, depth: %zu)", MAC2ARGS(peerMac), maxQueueSize, maxQueueSize, queueDepth);
         return;
     }
     
@@ -166,21 +204,22 @@ void ESPNowCommunication::queueMessageMutex(const uint8_t peerMac[6], const uint
     msg.ephemeral = ephemeral;
     msg.skip = false;
     queueTail = nextTail;
+    wakeUpdate();
 }
 
 // Queue a message for sending with rate limiting
-void ESPNowCommunication::queueMessage(const uint8_t peerMac[6], const uint8_t *data, size_t dataLen, Tracker* tracker, bool ephemeral) {
+void ESPNowCommunication::queueMessage(const uint8_t peerMac[6], const uint8_t *data, size_t dataLen, TrackerHandle tracker, bool ephemeral) {
     queueMessageMutex(peerMac, data, dataLen, tracker, ephemeral);
     processSendQueue();
 }
 
-void ESPNowCommunication::queueMessage(const uint8_t peerMac[6], const uint8_t *data, size_t dataLen, Tracker* tracker) {
+void ESPNowCommunication::queueMessage(const uint8_t peerMac[6], const uint8_t *data, size_t dataLen, TrackerHandle tracker) {
     queueMessage(peerMac, data, dataLen, tracker, false);
 }
 
 // Overloaded method to queue a message without tracker pointer
 void ESPNowCommunication::queueMessage(const uint8_t peerMac[6], const uint8_t *data, size_t dataLen) {
-    queueMessage(peerMac, data, dataLen, nullptr, false);
+    queueMessage(peerMac, data, dataLen, TrackerHandle(), false);
 }
 
 // Process queued messages with rate limiting
@@ -188,9 +227,9 @@ void ESPNowCommunication::processSendQueue() {
     MutexLock lock(queueMutex);
     if (queueHead == queueTail) return;
 
-    // Serial.printf("Queue in processSendQueue: head=%zu, tail=%zu\n", queueHead, queueTail);
+    SVR_LOGT(logger, "Queue in processSendQueue: head=%zu, tail=%zu", queueHead, queueTail);
 
-    unsigned long currentTime = millis();
+    unsigned long currentTime = Clock::millis();
     if (currentTime - lastSendTime >= sendRateLimit) {
         PendingMessage &msg = sendQueue[queueHead];
 
@@ -200,50 +239,53 @@ void ESPNowCommunication::processSendQueue() {
         }
 
         // Validate message data
-        if (msg.dataLen == 0 || msg.dataLen > ESP_NOW_MAX_DATA_LEN) {
-            Serial.printf("Invalid message size %zu for " MACSTR ", dropping\n", msg.dataLen, MAC2ARGS(msg.peerMac));
+        if (msg.dataLen == 0 || msg.dataLen > Radio::maxPayloadLength) {
+            SVR_LOGE(logger, "Invalid message size %zu for " MACSTR ", dropping", msg.dataLen, MAC2ARGS(msg.peerMac));
             queueHead = (queueHead + 1) % maxQueueSize;
             lastSendTime = currentTime;
             return;
         }
 
         // Ensure peer is added before sending
-        if (!esp_now_is_peer_exist(msg.peerMac)) {
-            Serial.printf("Peer " MACSTR " not found, adding before sending queued message\n", MAC2ARGS(msg.peerMac));
+        if (!Radio::hasPeer(msg.peerMac)) {
+            SVR_LOGD(logger, "Peer " MACSTR " not found, adding before sending queued message", MAC2ARGS(msg.peerMac));
             auto addResult = addPeer(msg.peerMac);
-            if (addResult != ESP_OK) {
-                Serial.printf("Failed to add peer " MACSTR " for queued message, error: %s (%d)\n", MAC2ARGS(msg.peerMac), espNowErrorToString(addResult).c_str(), addResult);
+            if (addResult != Radio::Result::OK) {
+                SVR_LOGE(logger, "Failed to add peer " MACSTR " for queued message, error: %s", MAC2ARGS(msg.peerMac), Radio::resultToString(addResult));
+                stats.sendFailed++;
                 queueHead = (queueHead + 1) % maxQueueSize;
                 lastSendTime = currentTime;
                 return;
             }
         }
         
-        //Serial.printf("Sending message to " MACSTR ", size %zu\n", MAC2ARGS(msg.peerMac), msg.dataLen);
-        auto result = esp_now_send(msg.peerMac, msg.data, msg.dataLen);
+        SVR_LOGT(logger, "Sending message to " MACSTR ", size %zu", MAC2ARGS(msg.peerMac), msg.dataLen);
+        auto result = Radio::send(msg.peerMac, msg.data, msg.dataLen);
         
         if (msg.ephemeral) {
             // Remove peer if message was ephemeral
-            deletePeer(msg.peerMac);
+            deletePeerLocked(msg.peerMac);
         }
 
-        if (msg.tracker != nullptr) {
+        Tracker *tracker = connectedTrackers.get(msg.tracker);
+        if (tracker != nullptr) {
             // Update ping info if this message is associated with a tracker
-            msg.tracker->lastPingSent = currentTime;
-            msg.tracker->pingStartTime = currentTime;
+            tracker->lastPingSent = currentTime;
+            tracker->pingStartTime = currentTime;
         }
 
-        if (result == ESP_OK) {
+        if (result == Radio::Result::OK) {
             // Message sent successfully, remove from queue
             queueHead = (queueHead + 1) % maxQueueSize;
             lastSendTime = currentTime;
-        } else if (result == ESP_ERR_ESPNOW_NO_MEM) {
+        } else if (result == Radio::Result::NO_MEMORY) {
             // ESP-NOW internal buffer is full - retry this message later without advancing queue
             // Don't update lastSendTime to allow immediate retry on next processSendQueue call
-            Serial.printf("ESP-NOW buffer full, retrying message to " MACSTR ", error: %s (%d)\n", MAC2ARGS(msg.peerMac), espNowErrorToString(result).c_str(), result);
+            SVR_LOGW(logger, "ESP-NOW buffer full, retrying message to " MACSTR ", error: %s", MAC2ARGS(msg.peerMac), Radio::resultToString(result));
         } else {
             // Other errors - log and drop the message
-            Serial.printf("Failed to send queued message to " MACSTR ", error: %s (%d)\n", MAC2ARGS(msg.peerMac), espNowErrorToString(result).c_str(), result);
+            SVR_LOGE(logger, "Failed to send queued message to " MACSTR ", error: %s", MAC2ARGS(msg.peerMac), Radio::resultToString(result));
+            stats.sendFailed++;
             queueHead = (queueHead + 1) % maxQueueSize;
             lastSendTime = currentTime;
         }
@@ -256,8 +298,8 @@ void ESPNowCommunication::sendUnpairToTracker(const uint8_t mac[6]) {
     memcpy(unpairMsg.securityBytes, securityCode, 8);
 	queueMessage(mac, reinterpret_cast<const uint8_t *>(&unpairMsg), sizeof(ESPNowUnpairMessage));
 	queueMessage(mac, reinterpret_cast<const uint8_t *>(&unpairMsg), sizeof(ESPNowUnpairMessage));
-	queueMessage(mac, reinterpret_cast<const uint8_t *>(&unpairMsg), sizeof(ESPNowUnpairMessage), nullptr, true);
-	// Serial.printf("Queued unpair to tracker " MACSTR "\n", MAC2ARGS(mac));
+	queueMessage(mac, reinterpret_cast<const uint8_t *>(&unpairMsg), sizeof(ESPNowUnpairMessage), TrackerHandle(), true);
+	SVR_LOGD(logger, "Queued unpair to tracker " MACSTR, MAC2ARGS(mac));
 }
 
 // Sends unpair messages to all connected trackers
@@ -269,7 +311,7 @@ void ESPNowCommunication::sendUnpairToAllTrackers() {
     queueMessage(broadcastAddress, reinterpret_cast<const uint8_t *>(&unpairMsg), sizeof(ESPNowUnpairMessage));
     queueMessage(broadcastAddress, reinterpret_cast<const uint8_t *>(&unpairMsg), sizeof(ESPNowUnpairMessage));
 
-    // Serial.println("Unpair messages queued to all trackers");
+    SVR_LOGD(logger, "Unpair messages queued to all trackers");
 }
 
 // Sends rate update messages to all connected trackers
@@ -280,7 +322,7 @@ void ESPNowCommunication::sendRateUpdateToAllTrackers() {
     // Calculate polling rate per tracker in Hz: divide maxPPS by number of trackers
     uint32_t pollRateHz = maxPPS / trackerCount;
 
-    Serial.printf("Updating tracker rate: %u trackers, %u Hz per tracker\n", trackerCount, pollRateHz);
+    SVR_LOGI(logger, "Updating tracker rate: %u trackers, %u Hz per tracker", static_cast<unsigned>(trackerCount), static_cast<unsigned>(pollRateHz));
 
     // Queue rate update to all connected trackers
     ESPNowTrackerRateMessage rateMsg;
@@ -290,20 +332,36 @@ void ESPNowCommunication::sendRateUpdateToAllTrackers() {
     queueMessage(broadcastAddress, reinterpret_cast<const uint8_t *>(&rateMsg), sizeof(ESPNowTrackerRateMessage));
 }
 
+ESPNowCommunication::StateLock::StateLock(bool wait) : mutex(instance.stateMutex) {
+    isHeld = mutex == nullptr || xSemaphoreTake(mutex, wait ? portMAX_DELAY : 0) == pdTRUE;
+}
+
+ESPNowCommunication::StateLock::~StateLock() {
+    if (isHeld && mutex != nullptr) {
+        xSemaphoreGive(mutex);
+    }
+}
+
 // Initializes ESPNOW communication
 ErrorCodes ESPNowCommunication::begin() {
     // Initialize mutex for queue protection
     if (!queueMutex) {
         queueMutex = xSemaphoreCreateMutex();
         if (!queueMutex) {
-            Serial.println("[ESPNOW] Failed to create queue mutex!");
+            SVR_LOGE(logger, "Failed to create queue mutex!");
+            return ErrorCodes::ESP_NOW_INIT_FAILED;
+        }
+    }
+    if (!stateMutex) {
+        stateMutex = xSemaphoreCreateMutex();
+        if (!stateMutex) {
+            SVR_LOGE(logger, "Failed to create state mutex!");
             return ErrorCodes::ESP_NOW_INIT_FAILED;
         }
     }
     channel = Configuration::getInstance().getWifiChannel();
 
     // Pre-allocate vectors to avoid reallocations during operation
-    connectedTrackers.reserve(16); // Reserve space for up to 16 trackers
     trackerPairedCallbacks.reserve(4);
     trackerConnectedCallbacks.reserve(4);
     trackerDisconnectedCallbacks.reserve(4);
@@ -311,276 +369,409 @@ ErrorCodes ESPNowCommunication::begin() {
     // Load or generate security code
     Configuration::getInstance().getSecurityCode(securityCode);
 
-    WiFi.mode(WIFI_STA);
-    WiFi.setChannel(channel);
-    WiFi.setTxPower(WIFI_POWER_17dBm);
-    esp_wifi_set_protocol(WIFI_IF_STA, WIFI_PROTOCOL_11G);
-    esp_wifi_set_ps(WIFI_PS_NONE);
-
-    rate_config.phymode = WIFI_PHY_MODE_HT20;
-    rate_config.rate = WIFI_PHY_RATE_MCS7_SGI;
-    rate_config.ersu = false;
-
-    auto result = esp_now_init();
-    if (result != ESP_OK) {
-        Serial.printf("Couldn't initialize ESPNOW! - %s\n", espNowErrorToString(result).c_str());
+    auto result = Radio::begin(channel);
+    if (result != Radio::Result::OK) {
+        SVR_LOGE(logger, "Couldn't initialize ESPNOW! - %s", Radio::resultToString(result));
         return ErrorCodes::ESP_NOW_INIT_FAILED;
     }
 
     result = addPeer(broadcastAddress, true);
-    if (result != ESP_OK)
+    if (result != Radio::Result::OK)
     {
-        Serial.printf("Couldn't add broadcast peer! - %s\n", espNowErrorToString(result).c_str());
+        SVR_LOGE(logger, "Couldn't add broadcast peer! - %s", Radio::resultToString(result));
         return ErrorCodes::ESP_NOW_ADDING_BROADCAST_FAILED;
     }
 
-    result = esp_now_register_recv_cb(onReceive);
-    if (result != ESP_OK)
+    result = Radio::setReceiveCallback(onReceive);
+    if (result != Radio::Result::OK)
     {
-        Serial.printf("Couldn't register message callback! - %s\n", espNowErrorToString(result).c_str());
+        SVR_LOGE(logger, "Couldn't register message callback! - %s", Radio::resultToString(result));
         return ErrorCodes::ESP_RECV_CALLACK_REGISTERING_FAILED;
     }
 
     uint8_t macaddr[6];
-    WiFi.macAddress(macaddr);
+    Radio::getMacAddress(macaddr);
 
-    Serial.printf("[ESPNOW] address: %02x:%02x:%02x:%02x:%02x:%02x Channel: %d\n", macaddr[0], macaddr[1], macaddr[2], macaddr[3], macaddr[4], macaddr[5], WiFi.channel());
+    SVR_LOGI(logger, "Address: " MACSTR " Channel: %d", MAC2ARGS(macaddr), Radio::getChannel());
     return ErrorCodes::NO_ERROR;
 }
 
 // ESPNOW receive callback
-void ESPNowCommunication::onReceive(const esp_now_recv_info_t *senderInfo, const uint8_t *data, int dataLen) {
+void ESPNowCommunication::onReceive(const Radio::RxInfo &senderInfo, const uint8_t *data, int dataLen) {
+    PacketCapture::getInstance().record(senderInfo, data, dataLen);
     ESPNowCommunication::getInstance().handleMessage(senderInfo, data, dataLen);
 }
 
+constexpr ESPNowCommunication::MessageRoute ESPNowCommunication::route(ESPNowMessageTypes type, MessageHandler handler) {
+    const ESPNowMessageSize &size = espnowMessageSizes[static_cast<size_t>(type)];
+    return {type, size.min, size.max, handler};
+}
+
+constexpr ESPNowCommunication::MessageRoute ESPNowCommunication::messageRoutes[espnowMessageTypeCount] = {
+    route(ESPNowMessageTypes::PAIRING_REQUEST, &ESPNowCommunication::handlePairingRequest),
+    route(ESPNowMessageTypes::PAIRING_RESPONSE, nullptr),
+    route(ESPNowMessageTypes::HANDSHAKE_REQUEST, &ESPNowCommunication::handleHandshakeRequest),
+    route(ESPNowMessageTypes::HANDSHAKE_RESPONSE, nullptr),
+    route(ESPNowMessageTypes::HEARTBEAT_ECHO, &ESPNowCommunication::handleHeartbeatEcho),
+    route(ESPNowMessageTypes::HEARTBEAT_RESPONSE, &ESPNowCommunication::handleHeartbeatResponse),
+    route(ESPNowMessageTypes::TRACKER_DATA, &ESPNowCommunication::handleTrackerData),
+    route(ESPNowMessageTypes::PAIRING_ANNOUNCEMENT, nullptr),
+    route(ESPNowMessageTypes::UNPAIR, nullptr),
+    route(ESPNowMessageTypes::TRACKER_RATE, nullptr),
+    route(ESPNowMessageTypes::ENTER_OTA_MODE, nullptr),
+    route(ESPNowMessageTypes::ENTER_OTA_ACK, &ESPNowCommunication::handleOtaAck),
+};
+
 // Handles incoming ESPNOW messages
-void ESPNowCommunication::handleMessage(const esp_now_recv_info_t *senderInfo, const uint8_t *data, int dataLen) {
-    // Fast path: cast message once and read header
-    //Serial.printf("[ESPNOW] Received message of length %d from " MACSTR "\n", dataLen, MAC2ARGS(senderInfo->src_addr));
-    const ESPNowMessage *message = reinterpret_cast<const ESPNowMessage *>(data);
-    const ESPNowMessageTypes header = message->base.header;
-
-    // Optimize the most common case - TRACKER_DATA (hot path)
-    if (header == ESPNowMessageTypes::TRACKER_DATA) {
-        // Fast validation: check if tracker is connected (most packets come from connected trackers)
-        const uint8_t *mac = senderInfo->src_addr;
-        Tracker* tracker = getTracker(mac);
-        if (tracker == nullptr) return; // Tracker not connected - ignore packet
-
-        // Tracker found and connected - process packet
-        recievedPacketCount++;
-        recievedByteCount += message->packet.len;
-
-        // Update RSSI for this tracker
-        tracker->rssi = senderInfo->rx_ctrl->rssi;
-
-        // Forward packet to PacketHandling with RSSI
-        PacketHandling::getInstance().insert(message->packet.data, message->packet.len, senderInfo->rx_ctrl->rssi);
+void ESPNowCommunication::handleMessage(const Radio::RxInfo &senderInfo, const uint8_t *data, int dataLen) {
+    static_assert([] {
+        for (size_t i = 0; i < espnowMessageTypeCount; i++) {
+            if (static_cast<size_t>(messageRoutes[i].type) != i) return false;
+        }
+        return true;
+    }(), "messageRoutes must be indexed by ESPNowMessageTypes");
+
+    SVR_LOGT(logger, "Received message of length %d from " MACSTR, dataLen, MAC2ARGS(senderInfo.srcMac));
+    // One table lookup checks the frame length against its type, so the
+    // handlers never read past dataLen
+    const size_t type = dataLen > 0 ? data[0] : espnowMessageTypeCount;
+    if (type >= espnowMessageTypeCount) {
+        stats.malformedFrames++;
+        return;
+    }
+    const MessageRoute &route = messageRoutes[type];
+    if (static_cast<size_t>(dataLen) < route.minLen || static_cast<size_t>(dataLen) > route.maxLen) {
+        stats.malformedFrames++;
+        SVR_LOGD(logger, "Dropping message type %u of length %d from " MACSTR, static_cast<unsigned>(type), dataLen, MAC2ARGS(senderInfo.srcMac));
+        return;
+    }
+    if (route.handler == nullptr) {
         return;
     }
+    (this->*route.handler)(senderInfo, *reinterpret_cast<const ESPNowMessage *>(data), dataLen);
+}
 
-    // Handle less frequent message types
-    switch (header) {
-    case ESPNowMessageTypes::PAIRING_REQUEST: {
-        const ESPNowPairingMessage &request = message->pairing;
-        if (memcmp(request.securityBytes, securityCode, 8) != 0) return; // Invalid security code
+// Hot path, most frames are reports from connected trackers
+void ESPNowCommunication::handleTrackerData(const Radio::RxInfo &senderInfo, const ESPNowMessage &message, size_t len) {
+    // The length byte must not claim more reports than the frame carries
+    if (message.packet.len > len - offsetof(ESPNowPacketMessage, data)) {
+        stats.malformedFrames++;
+        return;
+    }
 
-        // Step 1: Check if tracker is already paired
-        if (!Configuration::getInstance().isPairedTracker(senderInfo->src_addr)) {
-            if (!pairing) return; // Ignore pairing requests if not in pairing mode
-            Configuration::getInstance().addPairedTracker(senderInfo->src_addr);
-            // Allocate persistent tracker ID for this MAC address
-            uint8_t trackerId = Configuration::getInstance().getTrackerIdForMac(senderInfo->src_addr);
-            Serial.printf("Paired a new tracker at mac address " MACSTR " with ID %d!\n", MAC2ARGS(senderInfo->src_addr), trackerId);
-        } else {
-            Serial.printf("Tracker at mac address " MACSTR " is already paired!\n", MAC2ARGS(senderInfo->src_addr));
-        }
+    // Fast validation: check if tracker is connected (most packets come from connected trackers)
+    Tracker* tracker = getTracker(senderInfo.srcMac);
+    if (tracker == nullptr) return; // Tracker not connected - ignore packet
 
-        // Step 2: Send acknowledgment
-        ESPNowPairingAckMessage ackMessage;
-        // Serial.printf("Sending pairing acknowledgment to " MACSTR "\n", MAC2ARGS(senderInfo->src_addr));
-        queueMessage(senderInfo->src_addr, reinterpret_cast<uint8_t *>(&ackMessage), sizeof(ackMessage), nullptr, true);
+    // Tracker found and connected - process packet
+    recievedPacketCount++;
+    recievedByteCount += message.packet.len;
 
-        // Step 3: Invoke paired event
-        invokeTrackerPairedEvent();
-        break;
-    }
-    case ESPNowMessageTypes::PAIRING_RESPONSE:
-        return;
-    case ESPNowMessageTypes::HANDSHAKE_REQUEST: {
-        const ESPNowConnectionMessage &handshake = message->connection;
-        // Validate security code
-        if (memcmp(handshake.securityBytes, securityCode, 8) != 0) {
-            Serial.printf("Received handshake from " MACSTR " with invalid security code! Sent: ", MAC2ARGS(senderInfo->src_addr));
-            for (int i = 0; i < 8; ++i) Serial.printf("%02x", handshake.securityBytes[i]);
-            Serial.println();
-            return;
-        }
+    // Update RSSI for this tracker
+    tracker->rssi = senderInfo.rssi;
 
-        // Check that the tracker MAC is in persistent memory
-        if (!Configuration::getInstance().isPairedTracker(senderInfo->src_addr)) {
-            Serial.printf("Received handshake from unpaired tracker " MACSTR " - ignoring!\n", MAC2ARGS(senderInfo->src_addr));
-            return;
-        }
+    // Forward packet to PacketHandling with RSSI
+    PacketHandling::getInstance().insert(message.packet.data, message.packet.len, senderInfo.rssi);
+}
 
-        Tracker* tracker = getTracker(senderInfo->src_addr);
-        // Check to make sure the tracker isn't already connected
-        if (tracker != nullptr) {
-            Serial.printf("Tracker at mac address " MACSTR " is already connected!\n", MAC2ARGS(senderInfo->src_addr));
+void ESPNowCommunication::handlePairingRequest(const Radio::RxInfo &senderInfo, const ESPNowMessage &message, size_t len) {
+    const ESPNowPairingMessage &request = message.pairing;
+    if (memcmp(request.securityBytes, securityCode, 8) != 0) return; // Invalid security code
 
-            ESPNowConnectionAckMessage handshakeResponse;
-            handshakeResponse.trackerId = tracker->trackerId;
-            handshakeResponse.channel = channel;
-            // Serial.printf("Re-sending handshake ack to " MACSTR " for tracker ID %d\n", MAC2ARGS(senderInfo->src_addr), tracker->trackerId);
-            queueMessage(senderInfo->src_addr, reinterpret_cast<const uint8_t *>(&handshakeResponse), sizeof(ESPNowConnectionAckMessage));
-            return;
-        }
+    // Step 1: Check if tracker is already paired
+    if (!Configuration::getInstance().isPairedTracker(senderInfo.srcMac)) {
+        if (!pairing) return; // Ignore pairing requests if not in pairing mode
+        // Pair and allocate a persistent tracker ID for this MAC address
+        uint8_t trackerId = Configuration::getInstance().pairTracker(senderInfo.srcMac);
+        SVR_LOGI(logger, "Paired a new tracker at mac address " MACSTR " with ID %d!", MAC2ARGS(senderInfo.srcMac), trackerId);
+    } else {
+        SVR_LOGD(logger, "Tracker at mac address " MACSTR " is already paired!", MAC2ARGS(senderInfo.srcMac));
+    }
 
-        // Step 1: Get persistent tracker ID for this MAC address
-        uint8_t trackerId = Configuration::getInstance().getTrackerIdForMac(senderInfo->src_addr);
+    // Step 2: Send acknowledgment
+    ESPNowPairingAckMessage ackMessage;
+    SVR_LOGD(logger, "Sending pairing acknowledgment to " MACSTR, MAC2ARGS(senderInfo.srcMac));
+    queueMessage(senderInfo.srcMac, reinterpret_cast<uint8_t *>(&ackMessage), sizeof(ackMessage), TrackerHandle(), true);
 
-        // Step 2: Send handshake response with tracker ID and channel
-        ESPNowConnectionAckMessage handshakeResponse;
-        handshakeResponse.trackerId = trackerId;
-        handshakeResponse.channel = channel;
-        // Serial.printf("Sending handshake ack to " MACSTR " with tracker ID %d\n", MAC2ARGS(senderInfo->src_addr), trackerId);
-        queueMessage(senderInfo->src_addr, reinterpret_cast<const uint8_t *>(&handshakeResponse), sizeof(ESPNowConnectionAckMessage));
+    // Step 3: Raise paired event
+    publishEvent(TrackerEvent::Type::PAIRED, senderInfo.srcMac, Configuration::getInstance().getTrackerIdForMac(senderInfo.srcMac));
+}
 
-        // Step 3: Add tracker to connected list with heartbeat tracking
-        Tracker newTracker;
-        memcpy(newTracker.mac.data(), senderInfo->src_addr, 6);
-        newTracker.trackerId = trackerId;
-        newTracker.lastPingSent = 0;
-        newTracker.waitingForResponse = false;
-        newTracker.missedPings = 0;
-        connectedTrackers.push_back(newTracker);
+void ESPNowCommunication::handleHandshakeRequest(const Radio::RxInfo &senderInfo, const ESPNowMessage &message, size_t len) {
+    const ESPNowConnectionMessage &handshake = message.connection;
+    // Validate security code
+    if (memcmp(handshake.securityBytes, securityCode, 8) != 0) {
+        const uint8_t *sent = handshake.securityBytes;
+        SVR_LOGW(logger, "Received handshake from " MACSTR " with invalid security code! Sent: %02x%02x%02x%02x%02x%02x%02x%02x", MAC2ARGS(senderInfo.srcMac), sent[0], sent[1], sent[2], sent[3], sent[4], sent[5], sent[6], sent[7]);
+        return;
+    }
 
-        Serial.printf("Device with mac address " MACSTR " connected with tracker id %d!\n", MAC2ARGS(senderInfo->src_addr), trackerId);
+    // Check that the tracker MAC is in persistent memory
+    if (!Configuration::getInstance().isPairedTracker(senderInfo.srcMac)) {
+        SVR_LOGW(logger, "Received handshake from unpaired tracker " MACSTR " - ignoring!", MAC2ARGS(senderInfo.srcMac));
+        return;
+    }
 
-        // Step 4: Send rate update to newly connected trackers
-        sendRateUpdateNextTick = true;
+    Tracker* tracker = getTracker(senderInfo.srcMac);
+    // Check to make sure the tracker isn't already connected
+    if (tracker != nullptr) {
+        SVR_LOGD(logger, "Tracker at mac address " MACSTR " is already connected!", MAC2ARGS(senderInfo.srcMac));
 
-        // Step 5: Invoke connected event (also sends rate updates to all other trackers)
-        invokeTrackerConnectedEvent(senderInfo->src_addr);
+        ESPNowConnectionAckMessage handshakeResponse;
+        handshakeResponse.trackerId = tracker->trackerId;
+        handshakeResponse.channel = channel;
+        SVR_LOGD(logger, "Re-sending handshake ack to " MACSTR " for tracker ID %d", MAC2ARGS(senderInfo.srcMac), tracker->trackerId);
+        queueMessage(senderInfo.srcMac, reinterpret_cast<const uint8_t *>(&handshakeResponse), sizeof(ESPNowConnectionAckMessage));
         return;
     }
-    case ESPNowMessageTypes::HEARTBEAT_ECHO: {
-        // Fast MAC lookup for connected tracker
-        const uint8_t *mac = senderInfo->src_addr;
-        Tracker *tracker = getTracker(mac);
-        if (tracker == nullptr) return;
-        tracker->missedPings = 0;
-
-        // Send heartbeat response with the same sequence number
-        ESPNowHeartbeatResponseMessage response;
-        response.sequenceNumber = message->heartbeatEcho.sequenceNumber;
-        // Serial.printf("Sending heartbeat response to tracker " MACSTR " with sequence number %u\n", MAC2ARGS(mac), response.sequenceNumber);
-        queueMessage(mac, reinterpret_cast<const uint8_t *>(&response), sizeof(ESPNowHeartbeatResponseMessage));
+
+    if (connectedTrackers.size() >= maxConnectedTrackers) {
+        SVR_LOGW(logger, "Can't connect tracker " MACSTR ", %u trackers are already connected!", MAC2ARGS(senderInfo.srcMac), static_cast<unsigned>(maxConnectedTrackers));
         return;
     }
-    case ESPNowMessageTypes::HEARTBEAT_RESPONSE: {
-        // Find the tracker and update heartbeat info
-        const uint8_t *mac = senderInfo->src_addr;
-        Tracker *tracker = getTracker(mac);
-        if (tracker == nullptr) return;
-        if (tracker->waitingForResponse) {
-            // Validate sequence number matches expected
-            if (message->heartbeatResponse.sequenceNumber == tracker->expectedSequenceNumber) {
-                unsigned long latency = millis() - tracker->pingStartTime;
-                tracker->latency = static_cast<uint8_t>(latency);
-                tracker->waitingForResponse = false;
-                tracker->missedPings = 0;
-                senderInfo->rx_ctrl->rssi;
-            }
-            // If sequence number doesn't match, ignore the response (likely stale)
+
+    // Step 1: Get persistent tracker ID for this MAC address
+    uint8_t trackerId = Configuration::getInstance().getTrackerIdForMac(senderInfo.srcMac);
+
+    // Step 2: Send handshake response with tracker ID and channel
+    ESPNowConnectionAckMessage handshakeResponse;
+    handshakeResponse.trackerId = trackerId;
+    handshakeResponse.channel = channel;
+    SVR_LOGD(logger, "Sending handshake ack to " MACSTR " with tracker ID %d", MAC2ARGS(senderInfo.srcMac), trackerId);
+    queueMessage(senderInfo.srcMac, reinterpret_cast<const uint8_t *>(&handshakeResponse), sizeof(ESPNowConnectionAckMessage));
+
+    // Step 3: Add tracker to connected list with heartbeat tracking
+    Tracker newTracker;
+    memcpy(newTracker.mac.data(), senderInfo.srcMac, 6);
+    newTracker.trackerId = trackerId;
+    newTracker.lastPingSent = 0;
+    newTracker.waitingForResponse = false;
+    newTracker.missedPings = 0;
+    TrackerHandle handle = connectedTrackers.insert(newTracker);
+    newHeartbeatTrackers.fetch_or(uint64_t(1) << handle.index());
+
+    SVR_LOGI(logger, "Device with mac address " MACSTR " connected with tracker id %d!", MAC2ARGS(senderInfo.srcMac), trackerId);
+
+    // Step 4: Send rate update to newly connected trackers
+    sendRateUpdateNextTick = true;
+    wakeUpdate();
+
+    // Step 5: Invoke connected event (also sends rate updates to all other trackers)
+    publishEvent(TrackerEvent::Type::CONNECTED, senderInfo.srcMac, trackerId);
+}
+
+void ESPNowCommunication::handleHeartbeatEcho(const Radio::RxInfo &senderInfo, const ESPNowMessage &message, size_t len) {
+    // Fast MAC lookup for connected tracker
+    const uint8_t *mac = senderInfo.srcMac;
+    Tracker *tracker = getTracker(mac);
+    if (tracker == nullptr) return;
+    tracker->missedPings = 0;
+
+    // Send heartbeat response with the same sequence number
+    ESPNowHeartbeatResponseMessage response;
+    response.sequenceNumber = message.heartbeatEcho.sequenceNumber;
+    SVR_LOGT(logger, "Sending heartbeat response to tracker " MACSTR " with sequence number %u", MAC2ARGS(mac), response.sequenceNumber);
+    queueMessage(mac, reinterpret_cast<const uint8_t *>(&response), sizeof(ESPNowHeartbeatResponseMessage));
+}
+
+void ESPNowCommunication::handleHeartbeatResponse(const Radio::RxInfo &senderInfo, const ESPNowMessage &message, size_t len) {
+    // Find the tracker and update heartbeat info
+    const uint8_t *mac = senderInfo.srcMac;
+    Tracker *tracker = getTracker(mac);
+    if (tracker == nullptr) return;
+    if (tracker->waitingForResponse) {
+        // Validate sequence number matches expected
+        if (message.heartbeatResponse.sequenceNumber == tracker->expectedSequenceNumber) {
+            unsigned long latency = Clock::millis() - tracker->pingStartTime;
+            tracker->latency = static_cast<uint8_t>(latency);
+            tracker->waitingForResponse = false;
+            tracker->missedPings = 0;
         }
-        return;
+        // If sequence number doesn't match, ignore the response (likely stale)
     }
-    case ESPNowMessageTypes::ENTER_OTA_ACK:{
-        // Find the tracker and mark it as in OTA
-        const uint8_t *mac = senderInfo->src_addr;
-        Tracker *tracker = getTracker(mac);
-        if (tracker == nullptr) return;
+}
+
+void ESPNowCommunication::handleOtaAck(const Radio::RxInfo &senderInfo, const ESPNowMessage &message, size_t len) {
+    // The tracker left for its OTA update. Only update() removes trackers,
+    // so it disconnects the tracker there.
+    TrackerHandle handle = findTracker(senderInfo.srcMac);
+    if (!handle.valid()) return;
 
-        disconnectSingleTracker(mac);
+    if (!otaAckedTrackers.tryPush(handle)) {
+        // Only if a tracker acknowledged again before update() ran, the
+        // broadcast that asks for it repeats
+        SVR_LOGD(logger, "Dropping OTA acknowledgment from " MACSTR, MAC2ARGS(senderInfo.srcMac));
         return;
     }
-    default:
-        break;
+    wakeUpdate();
+}
+
+void ESPNowCommunication::reloadConfiguration() {
+    configurationReloadPending.store(true);
+    wakeUpdate();
+}
+
+void ESPNowCommunication::setUpdateTask(TaskHandle_t task) {
+    updateTask = task;
+}
+
+void ESPNowCommunication::wakeUpdate() {
+    if (updateTask != nullptr && updateTask != xTaskGetCurrentTaskHandle()) {
+        xTaskNotifyGive(updateTask);
+    }
+}
+
+unsigned long ESPNowCommunication::getMillisUntilUpdate() const {
+    const unsigned long currentTime = Clock::millis();
+    auto until = [currentTime](unsigned long last, unsigned long interval) {
+        unsigned long elapsed = currentTime - last;
+        return elapsed >= interval ? 0 : interval - elapsed;
+    };
+
+    unsigned long wait = until(lastStatsReport, statsReportInterval);
+    if (queueHead != queueTail) {
+        wait = std::min(wait, until(lastSendTime, sendRateLimit));
+    }
+    if (newHeartbeatTrackers.load() != 0) {
+        return 0;
+    }
+    wait = std::min(wait, heartbeats.millisUntilNext(currentTime));
+    if (ota_in_progress) {
+        return std::min({wait, until(ota_start_time, ota_timeout), until(ota_last_send_time, ota_send_interval)});
+    }
+    if (pairing) {
+        wait = std::min(wait, until(lastPairingBroadcast, pairingBroadcastInterval));
+    }
+    if (sendRateUpdateNextTick) {
+        wait = std::min(wait, until(lastRateUpdateTime, rateUpdateInterval));
     }
+    return wait;
+}
+
+// Where in the heartbeat interval a tracker in this slot is pinged. Slots
+// 0, 1, 2, 3... get 0, 1/2, 1/4, 3/4... of it, so the pings of any number of
+// trackers are spread evenly, even if they all connected at once.
+unsigned long ESPNowCommunication::heartbeatPhase(uint8_t slot) {
+    static_assert(maxConnectedTrackers == 64, "The phase reverses 6 slot bits");
+    uint8_t reversed = 0;
+    for (int bit = 0; bit < 6; bit++) {
+        if (slot & (1 << bit)) reversed |= 1 << (5 - bit);
+    }
+    return reversed * heartbeatInterval / maxConnectedTrackers;
+}
+
+void ESPNowCommunication::heartbeat(TrackerHandle handle, unsigned long currentTime) {
+    Tracker *trackerPtr = connectedTrackers.get(handle);
+    if (trackerPtr == nullptr) return;
+    Tracker &tracker = *trackerPtr;
+
+    // Check if waiting for response and timeout has occurred
+    if (tracker.waitingForResponse && (currentTime - tracker.pingStartTime >= heartbeatTimeout)) {
+        tracker.missedPings++;
+        tracker.waitingForResponse = false;
+        SVR_LOGW(logger, "Missed heartbeat from tracker " MACSTR " (ID: %d), missed count: %d", MAC2ARGS(tracker.mac.data()), tracker.trackerId, tracker.missedPings);
+
+        // Send timed out status on second missed heartbeat
+        if (tracker.missedPings == 3) {
+            // Send packet type 3 with SVR_STATUS_TIMED_OUT (2)
+            uint8_t statusPacket[16] = {0};
+            statusPacket[0] = 3; // packet type 3 (status)
+            statusPacket[1] = tracker.trackerId;
+            statusPacket[2] = 5;             // SVR_STATUS_TIMED_OUT
+            statusPacket[3] = 0;             // tracker_status (not relevant for timeout)
+            statusPacket[15] = tracker.rssi; // Use last known RSSI before timeout
+            PacketHandling::getInstance().insert(statusPacket, 16, 0);
+        }
+
+        // Remove tracker if exceeded max missed pings
+        if (tracker.missedPings >= maxMissedPings)
+        {
+            SVR_LOGW(logger, "Removing tracker " MACSTR " (ID: %d) due to missed heartbeats", MAC2ARGS(tracker.mac.data()), tracker.trackerId);
+            disconnectTracker(handle);
+            return;
+        }
+    }
+
+    // Send heartbeat ping if its time has come and not waiting for response
+    if (!tracker.waitingForResponse && static_cast<long>(currentTime - tracker.nextPingDue) >= 0) {
+        // Generate random 16-bit sequence number using hardware RNG
+        tracker.expectedSequenceNumber = static_cast<uint16_t>(SlimeVR::Hal::random32() & 0xFFFF);
+
+        // Create and send heartbeat echo message with sequence number
+        ESPNowHeartbeatEchoMessage heartbeatMsg;
+        heartbeatMsg.sequenceNumber = tracker.expectedSequenceNumber;
+
+        // Queue heartbeat through the rate-limited queue to prevent ESP_ERR_ESPNOW_NO_MEM
+        tracker.lastPingSent = currentTime;
+        tracker.pingStartTime = currentTime;
+        
+        SVR_LOGT(logger, "Sending heartbeat echo to tracker " MACSTR " with sequence number %u", MAC2ARGS(tracker.mac.data()), heartbeatMsg.sequenceNumber);
+        queueMessage(tracker.mac.data(), reinterpret_cast<uint8_t *>(&heartbeatMsg), sizeof(ESPNowHeartbeatEchoMessage), handle);
+        tracker.waitingForResponse = true;
+
+        // Stay in phase, skipping the pings a stall made us miss
+        tracker.nextPingDue += heartbeatInterval;
+        if (static_cast<long>(currentTime - tracker.nextPingDue) >= 0) {
+            tracker.nextPingDue += (currentTime - tracker.nextPingDue) / heartbeatInterval * heartbeatInterval + heartbeatInterval;
+        }
+    }
+
+    // pingStartTime moves to when the ping actually left the send queue, the
+    // timeout is checked again then if it was late
+    heartbeats.schedule(handle.index(), tracker.waitingForResponse ? tracker.pingStartTime + heartbeatTimeout : tracker.nextPingDue);
 }
 
 // Main update loop to be called regularly
 void ESPNowCommunication::update() {
-    const unsigned long currentTime = millis();
+    const unsigned long currentTime = Clock::millis();
 
     // PRIORITY 1: Handle heartbeat system FIRST - critical for connection stability
-    // Process heartbeats before stats/pairing to maintain accurate timing
-    if (!connectedTrackers.empty() && (currentTime - lastHeartbeatCheck >= heartbeatInterval+100)) {
-        lastHeartbeatCheck = currentTime;
-
-        //For each connected tracker
-        for (auto it = connectedTrackers.begin(); it != connectedTrackers.end();) {
-            auto &tracker = *it;
-
-            // Check if waiting for response and timeout has occurred
-            if (tracker.waitingForResponse && (currentTime - tracker.pingStartTime >= heartbeatTimeout)) {
-                tracker.missedPings++;
-                tracker.waitingForResponse = false;
-                Serial.printf("Missed heartbeat from tracker " MACSTR " (ID: %d), missed count: %d\n", MAC2ARGS(tracker.mac.data()), tracker.trackerId, tracker.missedPings);
-
-                // Send timed out status on second missed heartbeat
-                if (tracker.missedPings == 3) {
-                    // Send packet type 3 with SVR_STATUS_TIMED_OUT (2)
-                    uint8_t statusPacket[16] = {0};
-                    statusPacket[0] = 3; // packet type 3 (status)
-                    statusPacket[1] = tracker.trackerId;
-                    statusPacket[2] = 5;             // SVR_STATUS_TIMED_OUT
-                    statusPacket[3] = 0;             // tracker_status (not relevant for timeout)
-                    statusPacket[15] = tracker.rssi; // Use last known RSSI before timeout
-                    PacketHandling::getInstance().insert(statusPacket, 16, 0);
-                }
-
-                // Remove tracker if exceeded max missed pings
-                if (tracker.missedPings >= maxMissedPings)
-                {
-                    Serial.printf("Removing tracker " MACSTR " (ID: %d) due to missed heartbeats\n", MAC2ARGS(tracker.mac.data()), tracker.trackerId);
-                    disconnectSingleTracker(tracker.mac.data());
-                    continue; // Skip increment since we erased
-                }
-            }
+    // Only the trackers whose deadline expired are visited
+    uint64_t newTrackers = newHeartbeatTrackers.exchange(0);
+    heartbeats.advance(currentTime, [&](uint8_t slot) {
+        // A deadline left by a tracker that disconnected from this slot
+        if (newTrackers & (uint64_t(1) << slot)) return;
+        heartbeat(connectedTrackers.handleAt(slot), currentTime);
+    });
+    while (newTrackers != 0) {
+        uint8_t slot = __builtin_ctzll(newTrackers);
+        newTrackers &= newTrackers - 1;
+        Tracker *tracker = connectedTrackers.get(connectedTrackers.handleAt(slot));
+        if (tracker == nullptr) continue;
+        // First ping at the next point of the tracker's phase
+        unsigned long phase = heartbeatPhase(slot);
+        tracker->nextPingDue = currentTime + (phase + heartbeatInterval - currentTime % heartbeatInterval) % heartbeatInterval;
+        heartbeats.schedule(slot, tracker->nextPingDue);
+    }
 
-            // Send heartbeat ping if interval has elapsed and not waiting for response
-            if (!tracker.waitingForResponse && (currentTime - tracker.lastPingSent >= heartbeatInterval)) {
-                // Generate random 16-bit sequence number using hardware RNG
-                tracker.expectedSequenceNumber = static_cast<uint16_t>(esp_random() & 0xFFFF);
-
-                // Create and send heartbeat echo message with sequence number
-                ESPNowHeartbeatEchoMessage heartbeatMsg;
-                heartbeatMsg.sequenceNumber = tracker.expectedSequenceNumber;
-
-                // Queue heartbeat through the rate-limited queue to prevent ESP_ERR_ESPNOW_NO_MEM
-                tracker.lastPingSent = currentTime;
-                tracker.pingStartTime = currentTime;
-                
-                // Serial.printf("Sending heartbeat echo to tracker " MACSTR " with sequence number %u\n", MAC2ARGS(tracker.mac.data()), heartbeatMsg.sequenceNumber);
-                queueMessage(tracker.mac.data(), reinterpret_cast<uint8_t *>(&heartbeatMsg), sizeof(ESPNowHeartbeatEchoMessage), &tracker);
-                tracker.waitingForResponse = true;
-            }
+    // Trackers that acknowledged the OTA command in the receive callback.
+    // Handles of trackers that disconnected meanwhile are stale and ignored.
+    TrackerHandle otaAcked;
+    while (otaAckedTrackers.tryPop(otaAcked)) {
+        disconnectTracker(otaAcked);
+    }
 
-            ++it;
+    // Settings Configuration replaced, such as the ones it read once its
+    // storage opened late. Trackers connected with the old ones reconnect.
+    if (configurationReloadPending.exchange(false)) {
+        Configuration &configuration = Configuration::getInstance();
+        configuration.getSecurityCode(securityCode);
+        uint8_t storedChannel = configuration.getWifiChannel();
+        if (storedChannel != channel && Radio::setChannel(storedChannel)) {
+            channel = storedChannel;
         }
+        disconnectAllTrackers();
     }
 
     // Skip lower priority tasks if an OTA update is in progress
     if (ota_in_progress) {
         if (getConnectedTrackerCount() == 0) {
             ota_in_progress = false;
-            Serial.println("All trackers entered OTA, resuming normal operation");
+            SVR_LOGI(logger, "All trackers entered OTA, resuming normal operation");
             return;
         } else if (currentTime - ota_start_time > ota_timeout) {
             ota_in_progress = false;
-            Serial.println("OTA timeout expired, resuming normal operation");
+            SVR_LOGI(logger, "OTA timeout expired, resuming normal operation");
             return;
         } else if (currentTime - ota_last_send_time >= ota_send_interval) {
             ota_last_send_time = currentTime;
@@ -598,7 +789,7 @@ void ESPNowCommunication::update() {
         }
 
         // Still report stats during OTA to monitor progress
-        if (currentTime - lastStatsReport >= 1000) {
+        if (currentTime - lastStatsReport >= statsReportInterval) {
             const int deltaTime = currentTime - lastStatsReport;
             lastStatsReport = currentTime;
 
@@ -608,8 +799,11 @@ void ESPNowCommunication::update() {
             const int bytesPerSecond = (recievedByteCount * 1000) / deltaTime;
             recievedByteCount = 0;
 
-            Serial.printf("OTA in progress - T:%d|PPS:%d|BPS:%d|Q:%d\n", getConnectedTrackerCount(), pps, bytesPerSecond, queueSize());
+            SVR_LOGI(logger, "OTA in progress - T:%d|PPS:%d|BPS:%d|Q:%d", static_cast<int>(getConnectedTrackerCount()), pps, bytesPerSecond, queueSize());
         }
+
+        // The OTA command may be queued behind heartbeats
+        processSendQueue();
         return;
     }
 
@@ -621,12 +815,12 @@ void ESPNowCommunication::update() {
         announcement.channel = channel;
         memcpy(announcement.securityBytes, securityCode, 8);
 
-        // Serial.println("Broadcasting pairing announcement");
+        SVR_LOGT(logger, "Broadcasting pairing announcement");
         queueMessage(broadcastAddress, reinterpret_cast<uint8_t *>(&announcement), sizeof(announcement));
     }
 
     // PRIORITY 3: Print tracker statistics (lowest priority - can be skipped if timing is tight)
-    if (currentTime - lastStatsReport >= 1000) {
+    if (currentTime - lastStatsReport >= statsReportInterval) {
         const int deltaTime = currentTime - lastStatsReport;
         lastStatsReport = currentTime;
 
@@ -643,7 +837,7 @@ void ESPNowCommunication::update() {
         long totalRssi = 0;
         const size_t trackerCount = connectedTrackers.size();
 
-        for (const auto &tracker : connectedTrackers) {
+        connectedTrackers.forEach([&](TrackerHandle, const Tracker &tracker) {
             const uint8_t lat = tracker.latency;
             totalLatency += lat;
             if (lat > highestLatency) highestLatency = lat;
@@ -651,95 +845,68 @@ void ESPNowCommunication::update() {
             const int8_t rssi = tracker.rssi;
             totalRssi += rssi;
             if (rssi > maxRssi) maxRssi = rssi;
-        }
+        });
 
         const uint8_t avgLatency = trackerCount > 0 ? totalLatency / trackerCount : 0;
-        const int8_t avgRssi = trackerCount > 0 ? totalRssi / trackerCount : 0;
+        const int8_t avgRssi = trackerCount > 0 ? totalRssi / static_cast<long>(trackerCount) : 0;
 
         // Use shorter format to reduce blocking time
-        Serial.printf("T:%d|L:%d/%dms|RSSI:%d/%ddBm|PPS:%d|BPS:%d|Q:%d\n", trackerCount, avgLatency, highestLatency, avgRssi, maxRssi, pps, bytesPerSecond, queueSize());
+        SVR_LOGI(logger, "T:%d|L:%d/%dms|RSSI:%d/%ddBm|PPS:%d|BPS:%d|Q:%d", static_cast<int>(trackerCount), avgLatency, highestLatency, avgRssi, maxRssi, pps, bytesPerSecond, queueSize());
     }
 
     // PRIORITY 4: Process send queue - rate limiting to prevent ESP_ERR_ESPNOW_NO_MEM
     processSendQueue();
 
     // PRIORITY 5: Send rate update if flagged
-    if (sendRateUpdateNextTick && (currentTime - lastRateUpdateTime >= 1000)) {
+    if (sendRateUpdateNextTick && (currentTime - lastRateUpdateTime >= rateUpdateInterval)) {
         sendRateUpdateToAllTrackers();
         sendRateUpdateNextTick = false;
         lastRateUpdateTime = currentTime;
     }
 }
 
-// Converts ESPNOW error codes to human-readable strings
-std::string ESPNowCommunication::espNowErrorToString(esp_err_t error) {
-    switch (error) {
-    case ESP_OK:
-        return "ESP_OK";
-    case ESP_ERR_ESPNOW_NOT_INIT:
-        return "ESP_ERR_ESPNOW_NOT_INIT";
-    case ESP_ERR_ESPNOW_ARG:
-        return "ESP_ERR_ESPNOW_ARG";
-    case ESP_ERR_ESPNOW_NO_MEM:
-        return "ESP_ERR_ESPNOW_NO_MEM";
-    case ESP_ERR_ESPNOW_FULL:
-        return "ESP_ERR_ESPNOW_FULL";
-    case ESP_ERR_ESPNOW_NOT_FOUND:
-        return "ESP_ERR_ESPNOW_NOT_FOUND";
-    case ESP_ERR_ESPNOW_INTERNAL:
-        return "ESP_ERR_ESPNOW_INTERNAL";
-    case ESP_ERR_ESPNOW_EXIST:
-        return "ESP_ERR_ESPNOW_EXIST";
-    default:
-        return "UNKNOWN_ERROR - " + std::to_string(error);
-    }
-}
-
 // Adds a ESP-Now peer with the given MAC address
-uint8_t ESPNowCommunication::addPeer(const uint8_t peerMac[6], bool defaultConfig) {
-    Serial.printf("Adding peer " MACSTR "\n", MAC2ARGS(peerMac));
+Radio::Result ESPNowCommunication::addPeer(const uint8_t peerMac[6], bool defaultConfig) {
+    SVR_LOGD(logger, "Adding peer " MACSTR, MAC2ARGS(peerMac));
     // Check if peer already exists
-    if (esp_now_is_peer_exist(peerMac)) {
-        Serial.printf("Peer " MACSTR " already exists.\n", MAC2ARGS(peerMac));
-        return ESP_OK; // Peer already exists, return success
+    if (Radio::hasPeer(peerMac)) {
+        SVR_LOGD(logger, "Peer " MACSTR " already exists.", MAC2ARGS(peerMac));
+        return Radio::Result::OK; // Peer already exists, return success
     }
 
-    esp_now_peer_info_t peer;
-    memset(&peer, 0, sizeof(esp_now_peer_info_t));
-    memcpy(peer.peer_addr, peerMac, sizeof(uint8_t[6]));
-    peer.channel = 0;
-    peer.encrypt = false;
-    peer.ifidx = WIFI_IF_STA;
-
-    esp_err_t result = esp_now_add_peer(&peer);
-    if (result != ESP_OK) {
-        Serial.printf("Failed to add peer, error: %s\n", espNowErrorToString(result).c_str());
-    } else if (!defaultConfig){
-        esp_now_set_peer_rate_config(peer.peer_addr, &rate_config);
+    auto result = Radio::addPeer(peerMac, !defaultConfig);
+    if (result != Radio::Result::OK) {
+        SVR_LOGE(logger, "Failed to add peer " MACSTR ", error: %s", MAC2ARGS(peerMac), Radio::resultToString(result));
     }
     return result;
 }
 
 // Adds a ESP-Now peer with the given MAC address (defaultConfig = false)
-uint8_t ESPNowCommunication::addPeer(const uint8_t peerMac[6]) {
+Radio::Result ESPNowCommunication::addPeer(const uint8_t peerMac[6]) {
     return addPeer(peerMac, false);
 }
 
 // Deletes a ESP-Now peer with the given MAC address
 bool ESPNowCommunication::deletePeer(const uint8_t peerMac[6]) {
-    if (!esp_now_is_peer_exist(peerMac)) {
-        Serial.printf("Peer " MACSTR " does not exist.\n", MAC2ARGS(peerMac));
+    MutexLock lock(queueMutex);
+    return deletePeerLocked(peerMac);
+}
+
+// deletePeer() for callers that already hold queueMutex
+bool ESPNowCommunication::deletePeerLocked(const uint8_t peerMac[6]) {
+    if (!Radio::hasPeer(peerMac)) {
+        SVR_LOGD(logger, "Peer " MACSTR " does not exist.", MAC2ARGS(peerMac));
         return true; // Peer does not exist, return success
     }
 
-    Serial.printf("Deleting peer " MACSTR "\n", MAC2ARGS(peerMac));
-    auto result = esp_now_del_peer(peerMac);
-    if (result != ESP_OK || esp_now_is_peer_exist(peerMac)) Serial.printf("Failed to delete peer " MACSTR ", error: %s\n", MAC2ARGS(peerMac), espNowErrorToString(result).c_str());
+    SVR_LOGD(logger, "Deleting peer " MACSTR, MAC2ARGS(peerMac));
+    auto result = Radio::deletePeer(peerMac);
+    if (result != Radio::Result::OK || Radio::hasPeer(peerMac)) SVR_LOGE(logger, "Failed to delete peer " MACSTR ", error: %s", MAC2ARGS(peerMac), Radio::resultToString(result));
 
 	//Remove all pending messages to this peer from the send queue by setting the ignore flag
 	for (size_t i = 0; i < maxQueueSize; ++i) if (memcmp(sendQueue[i].peerMac, peerMac, 6) == 0) sendQueue[i].skip = true; // Mark message to be skipped
 
-    return result == ESP_OK;
+    return result == Radio::Result::OK;
 }
 
 void ESPNowCommunication::startOtaUpdate(const uint8_t auth[16], long port, const uint8_t ip[4], const char ssid[33], const char password[65]) {
@@ -750,5 +917,6 @@ void ESPNowCommunication::startOtaUpdate(const uint8_t auth[16], long port, cons
     memcpy(ota_password, password, sizeof(ota_password));
     
     ota_in_progress = true;
-    ota_start_time = millis();
+    ota_start_time = Clock::millis();
+    wakeUpdate();
 }
\ No newline at end of file
@@ -1,11 +1,16 @@
 #pragma once
 
+#include "EventQueue.h"
+#include "MpscRing.h"
+#include "SlotMap.h"
+#include "TimerWheel.h"
 #include "error_codes.h"
 #include "espnow/messages.h"
+#include "hal/Radio.h"
 
-#include <WiFi.h>
+#include <array>
+#include <atomic>
 #include <cstdint>
-#include <esp_now.h>
 #include <functional>
 #include <vector>
 #include "Serial.h"
@@ -13,6 +18,35 @@
 class ESPNowCommunication {
     public:
         static constexpr size_t packetSizeBytes = 240;
+        // Handshakes beyond this are ignored until a tracker disconnects
+        static constexpr size_t maxConnectedTrackers = 64;
+
+        using TrackerHandle = SlotHandle;
+
+        struct Stats {
+            uint32_t sendQueueFull = 0;  // Messages dropped because the send queue was full
+            uint32_t sendFailed = 0;     // Messages dropped after the radio rejected them
+            uint32_t malformedFrames = 0;  // Received frames with an unknown type or a bad length
+        };
+
+        // Pairings, connections and disconnections, raised in the WiFi task
+        // and the radio and control tasks and handed to the subscribers later
+        // by dispatchEvents()
+        struct TrackerEvent {
+            enum class Type : uint8_t {
+                PAIRED,
+                CONNECTED,
+                DISCONNECTED,
+            };
+            static constexpr size_t typeCount = 3;
+
+            Type type;
+            uint8_t trackerId;
+            std::array<uint8_t, 6> mac;
+        };
+        // Room for every tracker to disconnect and reconnect before a dispatch
+        static constexpr size_t eventQueueSize = 2 * maxConnectedTrackers;
+        using EventStats = EventQueue<TrackerEvent, eventQueueSize>::Stats;
 
         static unsigned int channel;
 
@@ -31,41 +65,100 @@ class ESPNowCommunication {
         void sendUnpairToAllTrackers();
         void sendUnpairToTracker(const uint8_t mac[6]);
         bool isTrackerIdConnected(uint8_t trackerId) const;
+        // Takes the security code and WiFi channel from Configuration again
+        // and disconnects all trackers, in the next update(). Safe to call
+        // from any task.
+        void reloadConfiguration();
 
         void update();
+        // The task that calls update(). It gets a notification whenever
+        // something changes that update() has to act on sooner than
+        // getMillisUntilUpdate() said.
+        void setUpdateTask(TaskHandle_t task);
+        // Time until the next heartbeat sweep, pairing broadcast, queued send
+        // or other work update() does on a timer
+        unsigned long getMillisUntilUpdate() const;
 
+        // Subscribers are called from dispatchEvents(), never from the task
+        // that raised the event. Subscribe before begin().
         void onTrackerPaired(std::function<void()> callback);
         void onTrackerConnected(std::function<void(const uint8_t *)> callback);
         void onTrackerDisconnected(std::function<void(uint8_t)> callback);  // Passes tracker ID
+        // Calls the subscribers for every event raised since the last call, in
+        // the order they were raised
+        void dispatchEvents();
+        // The task that calls dispatchEvents(), notified when an event is raised
+        void setEventTask(TaskHandle_t task) { events.setConsumerTask(task); }
+        const EventStats &getEventStats() const { return events.getStats(); }
+        static const char *eventTypeName(TrackerEvent::Type type);
         
         size_t getConnectedTrackerCount() const;
-        bool getTrackerMacByIndex(size_t index, uint8_t mac[6]) const;
-        uint8_t* getTrackerIdByIndex(size_t index);
+        // Moves cursor on to the next connected tracker, round robin, and
+        // copies its MAC address and tracker ID. Returns false if no tracker
+        // is connected.
+        bool getNextTracker(TrackerHandle &cursor, uint8_t mac[6], uint8_t &trackerId) const;
         uint8_t securityCode[8];
 
         bool isTrackerConnected(const uint8_t peerMac[6]);
 
         void startOtaUpdate(const uint8_t auth[16], long port, const uint8_t ip[4], const char ssid[33], const char password[65]);
 
+        const Stats &getStats() const { return stats; }
+        void resetStats() { stats = Stats(); }
+
+        // Serializes the tasks that read or change the connected trackers and
+        // the pairing state: the radio task around update(), the control task
+        // around console commands and button callbacks, and the HID task while
+        // it builds registration reports. Received frames are handled without
+        // it, in the WiFi task's callback.
+        class StateLock {
+        public:
+            // With wait false the lock is only taken if it is free, see held()
+            explicit StateLock(bool wait = true);
+            ~StateLock();
+            bool held() const { return isHeld; }
+        private:
+            SemaphoreHandle_t mutex;
+            bool isHeld;
+        };
+
     private:
         static ESPNowCommunication instance;
         ESPNowCommunication() = default;
 
-        esp_now_rate_config_t rate_config;
-
-        void invokeTrackerPairedEvent();
-        void invokeTrackerConnectedEvent(const uint8_t *trackerMacAddress);
-        void invokeTrackerDisconnectedEvent(uint8_t trackerId);
+        void wakeUpdate();
+        void publishEvent(TrackerEvent::Type type, const uint8_t mac[6], uint8_t trackerId);
         void sendRateUpdateToAllTrackers();
 
-        static void onReceive(const esp_now_recv_info_t *senderInfo, const uint8_t *data, int dataLen);
-        void __attribute__((hot)) __attribute__((flatten)) handleMessage(const esp_now_recv_info_t *senderInfo, const uint8_t *data, int dataLen);
+        static void onReceive(const SlimeVR::Hal::Radio::RxInfo &senderInfo, const uint8_t *data, int dataLen);
+        void __attribute__((hot)) __attribute__((flatten)) handleMessage(const SlimeVR::Hal::Radio::RxInfo &senderInfo, const uint8_t *data, int dataLen);
+
+        // Per-type handlers, only called with frames whose length handleMessage
+        // has checked against the route
+        void handleTrackerData(const SlimeVR::Hal::Radio::RxInfo &senderInfo, const ESPNowMessage &message, size_t len);
+        void handlePairingRequest(const SlimeVR::Hal::Radio::RxInfo &senderInfo, const ESPNowMessage &message, size_t len);
+        void handleHandshakeRequest(const SlimeVR::Hal::Radio::RxInfo &senderInfo, const ESPNowMessage &message, size_t len);
+        void handleHeartbeatEcho(const SlimeVR::Hal::Radio::RxInfo &senderInfo, const ESPNowMessage &message, size_t len);
+        void handleHeartbeatResponse(const SlimeVR::Hal::Radio::RxInfo &senderInfo, const ESPNowMessage &message, size_t len);
+        void handleOtaAck(const SlimeVR::Hal::Radio::RxInfo &senderInfo, const ESPNowMessage &message, size_t len);
+
+        using MessageHandler = void (ESPNowCommunication::*)(const SlimeVR::Hal::Radio::RxInfo &senderInfo, const ESPNowMessage &message, size_t len);
+        struct MessageRoute {
+            ESPNowMessageTypes type;
+            uint8_t minLen;
+            uint8_t maxLen;
+            MessageHandler handler;  // nullptr for messages only the dongle sends
+        };
+        static constexpr MessageRoute route(ESPNowMessageTypes type, MessageHandler handler);
+        // Indexed by ESPNowMessageTypes
+        static const MessageRoute messageRoutes[espnowMessageTypeCount];
 
         // Heartbeat tracking structure
         struct Tracker {
             std::array<uint8_t, 6> mac;
             uint8_t trackerId;
             unsigned long lastPingSent = 0;
+            unsigned long nextPingDue = 0;  // Keeps the tracker's phase, see heartbeatPhase()
             unsigned long pingStartTime = 0;
             bool waitingForResponse = false;
             uint8_t missedPings = 0;
@@ -74,12 +167,21 @@ class ESPNowCommunication {
             int8_t rssi = 0;  // Signal strength in dBm
         };
 
-        uint8_t addPeer(const uint8_t peerMac[6]);
-        uint8_t addPeer(const uint8_t peerMac[6], bool defaultConfig);
+        SlimeVR::Hal::Radio::Result addPeer(const uint8_t peerMac[6]);
+        SlimeVR::Hal::Radio::Result addPeer(const uint8_t peerMac[6], bool defaultConfig);
+        // Also skips the messages still queued for the peer
         bool deletePeer(const uint8_t peerMac[6]);
+        bool deletePeerLocked(const uint8_t peerMac[6]);
         Tracker* getTracker(const uint8_t peerMac[6]);
+        TrackerHandle findTracker(const uint8_t peerMac[6]) const;
+        void disconnectTracker(TrackerHandle handle);
+        // Runs when the tracker's heartbeat deadline expires: counts a missed
+        // response, sends the next ping and sets the next deadline
+        void heartbeat(TrackerHandle handle, unsigned long currentTime);
+        static unsigned long heartbeatPhase(uint8_t slot);
 
         bool pairing = false;
+        Stats stats;
 
         bool sendRateUpdateNextTick = false;
         unsigned long lastRateUpdateTime = 0;
@@ -88,31 +190,51 @@ class ESPNowCommunication {
         unsigned int recievedByteCount = 0;
         unsigned long lastStatsReport = 0;
         
-        // Store connected tracker MAC addresses with heartbeat tracking
-        std::vector<Tracker> connectedTrackers;
+        // Store connected tracker MAC addresses with heartbeat tracking.
+        // Trackers never move while connected, so the receive callback can
+        // look them up while update() disconnects others. The receive callback
+        // only inserts; removals happen under StateLock.
+        SlotMap<Tracker, maxConnectedTrackers> connectedTrackers;
         
         static constexpr unsigned long heartbeatInterval = 1000; // 1 second
         static constexpr unsigned long heartbeatTimeout = 1000; // 1 second timeout
         static constexpr uint8_t maxMissedPings = 5;
+        static constexpr unsigned long heartbeatTickMs = 10;
+
+        // Each connected tracker's next heartbeat deadline, by slot. Only
+        // update() touches it; the receive callback marks newly connected
+        // trackers in newHeartbeatTrackers for update() to schedule.
+        TimerWheel<maxConnectedTrackers, 128, heartbeatTickMs> heartbeats;
+        static_assert(decltype(heartbeats)::spanMs > heartbeatInterval && decltype(heartbeats)::spanMs > heartbeatTimeout, "Every heartbeat deadline fits in the wheel");
+        std::atomic<uint64_t> newHeartbeatTrackers{0};
+        // Trackers the receive callback saw acknowledge the OTA command, for
+        // update() to disconnect
+        MpscRing<TrackerHandle, maxConnectedTrackers> otaAckedTrackers;
+        // Set by reloadConfiguration() for update()
+        std::atomic<bool> configurationReloadPending{false};
 
         std::vector<std::function<void()>> trackerPairedCallbacks;
         std::vector<std::function<void(const uint8_t *)>> trackerConnectedCallbacks;
         std::vector<std::function<void(uint8_t)>> trackerDisconnectedCallbacks;
+        EventQueue<TrackerEvent, eventQueueSize> events;
 
         static constexpr uint8_t broadcastAddress[6]{0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
         static constexpr uint8_t espnowWifiChannel = 6;
 
         unsigned long lastPairingBroadcast = 0;
-        unsigned long lastHeartbeatCheck = 0;
         static constexpr unsigned long pairingBroadcastInterval = 100;
+        static constexpr unsigned long statsReportInterval = 1000;
+        static constexpr unsigned long rateUpdateInterval = 1000;
 
         // Send queue for rate limiting
         struct PendingMessage {
             uint8_t peerMac[6];
-            uint8_t data[ESP_NOW_MAX_DATA_LEN];
+            uint8_t data[SlimeVR::Hal::Radio::maxPayloadLength];
             size_t dataLen;
             bool ephemeral;
-            Tracker* tracker;  // Pointer to associated tracker for updating ping info
+            // Tracker whose ping info is updated when sent, if it is still
+            // connected by then
+            TrackerHandle tracker;
             bool skip = false;
         };
         static constexpr size_t maxQueueSize = 64;
@@ -124,14 +246,18 @@ class ESPNowCommunication {
         }
         unsigned long lastSendTime = 0;
         static constexpr unsigned long sendRateLimit = 5;
-        void queueMessageMutex(const uint8_t peerMac[6], const uint8_t *data, size_t dataLen, Tracker* tracker, bool ephemeral);
-        void queueMessage(const uint8_t peerMac[6], const uint8_t *data, size_t dataLen, Tracker* tracker, bool ephemeral);
-        void queueMessage(const uint8_t peerMac[6], const uint8_t *data, size_t dataLen, Tracker* tracker);
+        void queueMessageMutex(const uint8_t peerMac[6], const uint8_t *data, size_t dataLen, TrackerHandle tracker, bool ephemeral);
+        void queueMessage(const uint8_t peerMac[6], const uint8_t *data, size_t dataLen, TrackerHandle tracker, bool ephemeral);
+        void queueMessage(const uint8_t peerMac[6], const uint8_t *data, size_t dataLen, TrackerHandle tracker);
         void queueMessage(const uint8_t peerMac[6], const uint8_t *data, size_t dataLen);
         void processSendQueue();
 
-        // Mutex for protecting send queue (thread safety)
+        // Mutex for protecting send queue (thread safety). Held while
+        // queueing, sending and marking messages to skip.
         SemaphoreHandle_t queueMutex = nullptr;
+        // Held through StateLock
+        SemaphoreHandle_t stateMutex = nullptr;
+        TaskHandle_t updateTask = nullptr;
         // RAII helper for mutex locking
         class MutexLock {
         public:
@@ -141,8 +267,6 @@ class ESPNowCommunication {
             SemaphoreHandle_t m;
         };
 
-        std::string espNowErrorToString(esp_err_t error);
-
         uint8_t ota_auth[16];
         long ota_portNum;
         uint8_t ota_ip[4];
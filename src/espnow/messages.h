@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 enum class ESPNowMessageTypes : uint8_t 
@@ -18,6 +19,8 @@ enum class ESPNowMessageTypes : uint8_t
         ENTER_OTA_ACK = 11     // Acknowledgment from tracker to gateway to enter OTA update mode
 };
 
+constexpr size_t espnowMessageTypeCount = static_cast<size_t>(ESPNowMessageTypes::ENTER_OTA_ACK) + 1;
+
 struct __attribute__((packed)) ESPNowPairingAnnouncementMessage {
     ESPNowMessageTypes header = ESPNowMessageTypes::PAIRING_ANNOUNCEMENT;
     uint8_t channel;
@@ -101,4 +104,46 @@ union ESPNowMessage {
     ESPNowTrackerRateMessage trackerRate;
     ESPNowEnterOtaModeMessage enterOtaMode;
     ESPNowEnterOtaAckMessage enterOtaAck;
-};
\ No newline at end of file
+};
+
+// Valid frame lengths for each message type, taken from the structs above.
+// Only TRACKER_DATA varies: the header and length byte, then up to 240 bytes
+// of reports.
+struct ESPNowMessageSize {
+    ESPNowMessageTypes type;
+    uint8_t min;
+    uint8_t max;
+};
+
+template <typename Message>
+constexpr ESPNowMessageSize espnowFixedSize() {
+    return {Message().header, sizeof(Message), sizeof(Message)};
+}
+
+// Indexed by ESPNowMessageTypes
+constexpr ESPNowMessageSize espnowMessageSizes[] = {
+    espnowFixedSize<ESPNowPairingMessage>(),
+    espnowFixedSize<ESPNowPairingAckMessage>(),
+    espnowFixedSize<ESPNowConnectionMessage>(),
+    espnowFixedSize<ESPNowConnectionAckMessage>(),
+    espnowFixedSize<ESPNowHeartbeatEchoMessage>(),
+    espnowFixedSize<ESPNowHeartbeatResponseMessage>(),
+    {ESPNowMessageTypes::TRACKER_DATA, offsetof(ESPNowPacketMessage, data), sizeof(ESPNowPacketMessage)},
+    espnowFixedSize<ESPNowPairingAnnouncementMessage>(),
+    espnowFixedSize<ESPNowUnpairMessage>(),
+    espnowFixedSize<ESPNowTrackerRateMessage>(),
+    espnowFixedSize<ESPNowEnterOtaModeMessage>(),
+    espnowFixedSize<ESPNowEnterOtaAckMessage>(),
+};
+
+constexpr bool espnowMessageSizesInOrder() {
+    for (size_t i = 0; i < espnowMessageTypeCount; i++) {
+        if (static_cast<size_t>(espnowMessageSizes[i].type) != i) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(sizeof(espnowMessageSizes) / sizeof(espnowMessageSizes[0]) == espnowMessageTypeCount, "Every message type needs its sizes");
+static_assert(espnowMessageSizesInOrder(), "espnowMessageSizes must be indexed by ESPNowMessageTypes");
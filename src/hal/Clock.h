@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+
+// Time source for the dongle core. On the ESP32 this is the system timer, in
+// the native build a clock that only moves when the simulation advances it.
+namespace SlimeVR::Hal::Clock {
+// Milliseconds since boot, wraps around like Arduino's millis()
+uint32_t millis();
+
+// Microseconds since boot
+uint64_t micros();
+
+// Waits for the given time; the native clock just jumps ahead
+void delay(uint32_t ms);
+}  // namespace SlimeVR::Hal::Clock
@@ -0,0 +1,67 @@
+#include "hal/ConfigStorage.h"
+
+#include "hal/FileSystem.h"
+
+namespace SlimeVR::Hal {
+bool FileConfigStorage::begin() {
+    if (!FileSystem::mount() && !(FileSystem::format() && FileSystem::mount())) {
+        return false;
+    }
+    // Left over from a replace that didn't finish, the journal is intact
+    if (FileSystem::exists(tempPath)) {
+        FileSystem::remove(tempPath);
+    }
+    return true;
+}
+
+bool FileConfigStorage::read(std::vector<uint8_t> &data) {
+    return FileSystem::read(path, data);
+}
+
+bool FileConfigStorage::append(const uint8_t *data, size_t len) {
+    return FileSystem::append(path, data, len);
+}
+
+// The rename replaces the journal in one step
+bool FileConfigStorage::replace(const uint8_t *data, size_t len) {
+    return FileSystem::write(tempPath, data, len) && FileSystem::rename(tempPath, path);
+}
+
+bool FileConfigStorage::readLegacyFile(const char *path, std::vector<uint8_t> &data) {
+    return FileSystem::read(path, data);
+}
+
+void FileConfigStorage::removeLegacyFile(const char *path) {
+    FileSystem::remove(path);
+}
+
+bool MemoryConfigStorage::read(std::vector<uint8_t> &data) {
+    data = journal;
+    return stored;
+}
+
+bool MemoryConfigStorage::append(const uint8_t *data, size_t len) {
+    journal.insert(journal.end(), data, data + len);
+    stored = true;
+    return true;
+}
+
+bool MemoryConfigStorage::replace(const uint8_t *data, size_t len) {
+    journal.assign(data, data + len);
+    stored = true;
+    return true;
+}
+
+ConfigStorage &getConfigStorage() {
+#if CONFIG_STORAGE == CONFIG_STORAGE_NVS
+    static NvsConfigStorage storage;
+#elif CONFIG_STORAGE == CONFIG_STORAGE_MEMORY
+    static MemoryConfigStorage storage;
+#elif CONFIG_STORAGE == CONFIG_STORAGE_LITTLEFS
+    static FileConfigStorage storage;
+#else
+#error "Unknown CONFIG_STORAGE"
+#endif
+    return storage;
+}
+}  // namespace SlimeVR::Hal
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Backends for the configuration journal, picked per env with the
+// CONFIG_STORAGE build flag
+#define CONFIG_STORAGE_LITTLEFS 0  // A file on LittleFS, the default
+#define CONFIG_STORAGE_NVS 1       // A blob in NVS, nothing to mount or scan (ESP32 only)
+#define CONFIG_STORAGE_MEMORY 2    // RAM only, lost on reset; for native tests and benchmarks
+
+#ifndef CONFIG_STORAGE
+#define CONFIG_STORAGE CONFIG_STORAGE_LITTLEFS
+#endif
+
+namespace SlimeVR::Hal {
+// Where ConfigJournal keeps its bytes. The journal only ever reads itself
+// whole, appends, or replaces itself whole.
+class ConfigStorage {
+public:
+    virtual ~ConfigStorage() = default;
+
+    virtual const char *getName() const = 0;
+    // Mounts or opens the backing store, formatting it if it can't be mounted
+    virtual bool begin() = 0;
+    // Replaces data with the stored journal. Returns false if there is none.
+    virtual bool read(std::vector<uint8_t> &data) = 0;
+    virtual bool append(const uint8_t *data, size_t len) = 0;
+    // Replaces the stored journal. After a power loss either the old or the
+    // new one is read back.
+    virtual bool replace(const uint8_t *data, size_t len) = 0;
+
+    // The per-field files older firmware kept on LittleFS, read once to
+    // migrate them into the journal
+    virtual bool readLegacyFile(const char *path, std::vector<uint8_t> &data) {
+        data.clear();
+        return false;
+    }
+    virtual void removeLegacyFile(const char *path) {}
+};
+
+// The journal in /config.journal on Hal::FileSystem, LittleFS on the ESP32
+class FileConfigStorage : public ConfigStorage {
+public:
+    const char *getName() const override { return "LittleFS"; }
+    bool begin() override;
+    bool read(std::vector<uint8_t> &data) override;
+    bool append(const uint8_t *data, size_t len) override;
+    bool replace(const uint8_t *data, size_t len) override;
+    bool readLegacyFile(const char *path, std::vector<uint8_t> &data) override;
+    void removeLegacyFile(const char *path) override;
+
+    static constexpr char path[] = "/config.journal";
+
+private:
+    static constexpr char tempPath[] = "/config.journal.tmp";
+};
+
+// The journal as one NVS blob. NVS has no append, so the blob is kept in RAM
+// and every change writes it out whole; NVS writes the new copy before it
+// drops the old one.
+class NvsConfigStorage : public ConfigStorage {
+public:
+    const char *getName() const override { return "NVS"; }
+    bool begin() override;
+    bool read(std::vector<uint8_t> &data) override;
+    bool append(const uint8_t *data, size_t len) override;
+    bool replace(const uint8_t *data, size_t len) override;
+    // Mounts LittleFS only when there are files to migrate
+    bool readLegacyFile(const char *path, std::vector<uint8_t> &data) override;
+    void removeLegacyFile(const char *path) override;
+
+private:
+    static constexpr char nvsNamespace[] = "slimevr";
+    static constexpr char key[] = "config";
+
+    bool write();
+
+    std::vector<uint8_t> blob;
+    bool legacyMounted = false;
+};
+
+class MemoryConfigStorage : public ConfigStorage {
+public:
+    const char *getName() const override { return "memory"; }
+    bool begin() override { return true; }
+    bool read(std::vector<uint8_t> &data) override;
+    bool append(const uint8_t *data, size_t len) override;
+    bool replace(const uint8_t *data, size_t len) override;
+
+private:
+    std::vector<uint8_t> journal;
+    bool stored = false;
+};
+
+// The backend CONFIG_STORAGE picked
+ConfigStorage &getConfigStorage();
+}  // namespace SlimeVR::Hal
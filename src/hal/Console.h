@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace SlimeVR::Hal {
+// A serial connection to a host. Writes never wait: they take what fits into
+// the driver and return how much that was.
+class ConsolePort {
+public:
+    virtual ~ConsolePort() = default;
+
+    virtual void begin(unsigned long baud) = 0;
+    virtual void setBaudRate(unsigned long baud) = 0;
+
+    // Called from the driver's context whenever output has drained and more
+    // can be written
+    virtual void onWritable(void (*callback)()) = 0;
+
+    // False while nobody is listening, e.g. the USB port isn't opened by a host
+    virtual bool isConnected() = 0;
+
+    virtual size_t availableForWrite() = 0;
+    virtual size_t write(const uint8_t *data, size_t len) = 0;
+    virtual void flush() = 0;
+
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+namespace Console {
+ConsolePort &uart();
+ConsolePort &usb();
+}  // namespace Console
+}  // namespace SlimeVR::Hal
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Persistent storage, LittleFS on the ESP32 and in memory in the native
+// build. The dongle only keeps a handful of small files, so they are always
+// read and written as a whole.
+namespace SlimeVR::Hal::FileSystem {
+bool mount();
+bool format();
+
+bool exists(const char *path);
+bool remove(const char *path);
+// Replaces to if it exists. Atomic on LittleFS: after a power loss either
+// file is whole.
+bool rename(const char *from, const char *to);
+
+// Replaces data with the file's contents. Returns false if the file doesn't
+// exist.
+bool read(const char *path, std::vector<uint8_t> &data);
+bool write(const char *path, const uint8_t *data, size_t len);
+bool append(const char *path, const uint8_t *data, size_t len);
+}  // namespace SlimeVR::Hal::FileSystem
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// How many HID interfaces carry tracker reports, picked per env with the
+// HID_INTERFACES build flag. Each has its own interrupt IN endpoint and takes
+// one 64-byte transfer per 1 ms poll, so every interface adds 4000 reports/s.
+// Trackers are sharded over them by tracker ID, see hidInterfaceFor().
+#ifndef HID_INTERFACES
+#define HID_INTERFACES 1
+#endif
+
+#if HID_INTERFACES < 1 || HID_INTERFACES > 4
+#error "HID_INTERFACES must be 1 to 4"
+#endif
+
+namespace SlimeVR::Hal {
+constexpr uint8_t hidInterfaceCount = HID_INTERFACES;
+
+// The interface a tracker's reports and registrations go out on
+constexpr uint8_t hidInterfaceFor(uint8_t trackerId) {
+    return trackerId % hidInterfaceCount;
+}
+
+// Where HID transfers to the host go. HIDDevice implements it on the ESP32,
+// the native build has a simulated endpoint.
+class HidSink {
+public:
+    virtual ~HidSink() = default;
+
+    // True when a transfer can be sent on the interface without waiting
+    virtual bool ready(uint8_t interface) = 0;
+    virtual bool send(uint8_t interface, const uint8_t *data, size_t size) = 0;
+};
+}  // namespace SlimeVR::Hal
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// ESP-NOW radio. Frames are addressed by MAC and have to be sent to a known
+// peer; the broadcast address is a peer like any other.
+namespace SlimeVR::Hal::Radio {
+constexpr size_t maxPayloadLength = 250;
+
+struct RxInfo {
+    const uint8_t *srcMac;
+    int8_t rssi;
+    uint8_t channel;
+};
+
+// Runs in the radio driver's context, not the main loop
+typedef void (*ReceiveCallback)(const RxInfo &info, const uint8_t *data, int dataLen);
+
+enum class Result : uint8_t {
+    OK,
+    NOT_INITIALIZED,
+    INVALID_ARGUMENT,
+    NO_MEMORY,  // Driver buffers are full, retry later
+    PEER_LIST_FULL,
+    PEER_NOT_FOUND,
+    PEER_EXISTS,
+    INTERNAL_ERROR,
+    FAILED,
+};
+
+const char *resultToString(Result result);
+
+// Brings up the radio in station mode on the given channel
+Result begin(uint8_t channel);
+Result setReceiveCallback(ReceiveCallback callback);
+
+bool setChannel(uint8_t channel);
+uint8_t getChannel();
+void getMacAddress(uint8_t mac[6]);
+
+// Peers added with fastRate send at the highest PHY rate instead of the
+// driver default
+Result addPeer(const uint8_t mac[6], bool fastRate);
+Result deletePeer(const uint8_t mac[6]);
+bool hasPeer(const uint8_t mac[6]);
+
+// Queues a frame with the driver, doesn't wait for it to go out
+Result send(const uint8_t mac[6], const uint8_t *data, size_t len);
+}  // namespace SlimeVR::Hal::Radio
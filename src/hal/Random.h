@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdint>
+
+namespace SlimeVR::Hal {
+// Hardware RNG on the ESP32, a seeded generator in the native build so runs
+// are reproducible
+uint32_t random32();
+}  // namespace SlimeVR::Hal
@@ -0,0 +1,18 @@
+#include "hal/Clock.h"
+
+#include <Arduino.h>
+#include <esp_timer.h>
+
+namespace SlimeVR::Hal::Clock {
+uint32_t millis() {
+    return ::millis();
+}
+
+uint64_t micros() {
+    return esp_timer_get_time();
+}
+
+void delay(uint32_t ms) {
+    ::delay(ms);
+}
+}  // namespace SlimeVR::Hal::Clock
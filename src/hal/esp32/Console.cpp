@@ -0,0 +1,74 @@
+#include "hal/Console.h"
+
+#include <Arduino.h>
+#include <USB.h>
+
+USBCDC USBSerial;
+
+namespace SlimeVR::Hal {
+namespace {
+class UartPort : public ConsolePort {
+public:
+    void begin(unsigned long baud) override { Serial0.begin(baud); }
+    void setBaudRate(unsigned long baud) override { Serial0.updateBaudRate(baud); }
+
+    // The UART driver has no TX-complete event to hook; its output is pumped
+    // from the main loop
+    void onWritable(void (*callback)()) override {}
+
+    bool isConnected() override { return true; }
+    size_t availableForWrite() override { return std::max(Serial0.availableForWrite(), 0); }
+    size_t write(const uint8_t *data, size_t len) override { return Serial0.write(data, len); }
+    void flush() override { Serial0.flush(); }
+
+    int available() override { return Serial0.available(); }
+    int read() override { return Serial0.read(); }
+    int peek() override { return Serial0.peek(); }
+};
+
+class UsbCdcPort : public ConsolePort {
+public:
+    void begin(unsigned long baud) override {
+        // Never let a write wait for the host
+        USBSerial.setTxTimeoutMs(0);
+        USBSerial.onEvent(ARDUINO_USB_CDC_TX_EVENT, onTxEvent);
+        USBSerial.begin();
+    }
+    void setBaudRate(unsigned long baud) override {}
+
+    void onWritable(void (*callback)()) override { writableCallback = callback; }
+
+    bool isConnected() override { return static_cast<bool>(USBSerial); }
+    size_t availableForWrite() override { return std::max(USBSerial.availableForWrite(), 0); }
+    size_t write(const uint8_t *data, size_t len) override { return USBSerial.write(data, len); }
+    void flush() override { USBSerial.flush(); }
+
+    int available() override { return USBSerial.available(); }
+    int read() override { return USBSerial.read(); }
+    int peek() override { return USBSerial.peek(); }
+
+private:
+    static void onTxEvent(void *arg, esp_event_base_t eventBase, int32_t eventId, void *eventData) {
+        if (writableCallback != nullptr) {
+            writableCallback();
+        }
+    }
+
+    static void (*writableCallback)();
+};
+
+void (*UsbCdcPort::writableCallback)() = nullptr;
+}  // namespace
+
+namespace Console {
+ConsolePort &uart() {
+    static UartPort port;
+    return port;
+}
+
+ConsolePort &usb() {
+    static UsbCdcPort port;
+    return port;
+}
+}  // namespace Console
+}  // namespace SlimeVR::Hal
@@ -0,0 +1,60 @@
+#include "hal/FileSystem.h"
+
+#include <LittleFS.h>
+
+namespace SlimeVR::Hal::FileSystem {
+namespace {
+bool writeMode(const char *path, const char *mode, const uint8_t *data, size_t len) {
+    auto file = LittleFS.open(path, mode, true);
+    if (!file) {
+        return false;
+    }
+    size_t written = len > 0 ? file.write(data, len) : 0;
+    file.close();
+    return written == len;
+}
+}  // namespace
+
+bool mount() {
+    return LittleFS.begin();
+}
+
+bool format() {
+    return LittleFS.format();
+}
+
+bool exists(const char *path) {
+    return LittleFS.exists(path);
+}
+
+bool remove(const char *path) {
+    return LittleFS.remove(path);
+}
+
+bool rename(const char *from, const char *to) {
+    return LittleFS.rename(from, to);
+}
+
+bool read(const char *path, std::vector<uint8_t> &data) {
+    data.clear();
+    if (!LittleFS.exists(path)) {
+        return false;
+    }
+    auto file = LittleFS.open(path, "r");
+    if (!file) {
+        return false;
+    }
+    data.resize(file.size());
+    data.resize(file.read(data.data(), data.size()));
+    file.close();
+    return true;
+}
+
+bool write(const char *path, const uint8_t *data, size_t len) {
+    return writeMode(path, "w", data, len);
+}
+
+bool append(const char *path, const uint8_t *data, size_t len) {
+    return writeMode(path, "a", data, len);
+}
+}  // namespace SlimeVR::Hal::FileSystem
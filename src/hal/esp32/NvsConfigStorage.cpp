@@ -0,0 +1,57 @@
+#include "hal/ConfigStorage.h"
+
+#include <Preferences.h>
+
+#include "hal/FileSystem.h"
+
+namespace SlimeVR::Hal {
+namespace {
+Preferences preferences;
+}  // namespace
+
+bool NvsConfigStorage::begin() {
+    return preferences.begin(nvsNamespace, false);
+}
+
+bool NvsConfigStorage::read(std::vector<uint8_t> &data) {
+    blob.clear();
+    if (preferences.isKey(key)) {
+        blob.resize(preferences.getBytesLength(key));
+        blob.resize(preferences.getBytes(key, blob.data(), blob.size()));
+    }
+    data = blob;
+    return !blob.empty();
+}
+
+bool NvsConfigStorage::append(const uint8_t *data, size_t len) {
+    blob.insert(blob.end(), data, data + len);
+    return write();
+}
+
+bool NvsConfigStorage::replace(const uint8_t *data, size_t len) {
+    blob.assign(data, data + len);
+    return write();
+}
+
+bool NvsConfigStorage::write() {
+    return preferences.putBytes(key, blob.data(), blob.size()) == blob.size();
+}
+
+bool NvsConfigStorage::readLegacyFile(const char *path, std::vector<uint8_t> &data) {
+    if (!legacyMounted) {
+        // No formatting here, a partition that doesn't mount has no files
+        legacyMounted = FileSystem::mount();
+    }
+    if (!legacyMounted) {
+        data.clear();
+        return false;
+    }
+    return FileSystem::read(path, data);
+}
+
+void NvsConfigStorage::removeLegacyFile(const char *path) {
+    if (legacyMounted) {
+        FileSystem::remove(path);
+    }
+}
+}  // namespace SlimeVR::Hal
@@ -0,0 +1,129 @@
+#include "hal/Radio.h"
+
+#include <WiFi.h>
+#include <esp_mac.h>
+#include <esp_now.h>
+#include <esp_wifi.h>
+
+static_assert(SlimeVR::Hal::Radio::maxPayloadLength == ESP_NOW_MAX_DATA_LEN);
+
+namespace SlimeVR::Hal::Radio {
+namespace {
+ReceiveCallback receiveCallback = nullptr;
+esp_now_rate_config_t fastRateConfig = {};
+
+Result toResult(esp_err_t error) {
+    switch (error) {
+    case ESP_OK:
+        return Result::OK;
+    case ESP_ERR_ESPNOW_NOT_INIT:
+        return Result::NOT_INITIALIZED;
+    case ESP_ERR_ESPNOW_ARG:
+        return Result::INVALID_ARGUMENT;
+    case ESP_ERR_ESPNOW_NO_MEM:
+        return Result::NO_MEMORY;
+    case ESP_ERR_ESPNOW_FULL:
+        return Result::PEER_LIST_FULL;
+    case ESP_ERR_ESPNOW_NOT_FOUND:
+        return Result::PEER_NOT_FOUND;
+    case ESP_ERR_ESPNOW_EXIST:
+        return Result::PEER_EXISTS;
+    case ESP_ERR_ESPNOW_INTERNAL:
+        return Result::INTERNAL_ERROR;
+    default:
+        return Result::FAILED;
+    }
+}
+
+void onReceive(const esp_now_recv_info_t *info, const uint8_t *data, int dataLen) {
+    RxInfo rxInfo;
+    rxInfo.srcMac = info->src_addr;
+    rxInfo.rssi = info->rx_ctrl->rssi;
+    rxInfo.channel = info->rx_ctrl->channel;
+    receiveCallback(rxInfo, data, dataLen);
+}
+}  // namespace
+
+const char *resultToString(Result result) {
+    switch (result) {
+    case Result::OK:
+        return "ESP_OK";
+    case Result::NOT_INITIALIZED:
+        return "ESP_ERR_ESPNOW_NOT_INIT";
+    case Result::INVALID_ARGUMENT:
+        return "ESP_ERR_ESPNOW_ARG";
+    case Result::NO_MEMORY:
+        return "ESP_ERR_ESPNOW_NO_MEM";
+    case Result::PEER_LIST_FULL:
+        return "ESP_ERR_ESPNOW_FULL";
+    case Result::PEER_NOT_FOUND:
+        return "ESP_ERR_ESPNOW_NOT_FOUND";
+    case Result::PEER_EXISTS:
+        return "ESP_ERR_ESPNOW_EXIST";
+    case Result::INTERNAL_ERROR:
+        return "ESP_ERR_ESPNOW_INTERNAL";
+    default:
+        return "UNKNOWN_ERROR";
+    }
+}
+
+Result begin(uint8_t channel) {
+    WiFi.mode(WIFI_STA);
+    WiFi.setChannel(channel);
+    WiFi.setTxPower(WIFI_POWER_17dBm);
+    esp_wifi_set_protocol(WIFI_IF_STA, WIFI_PROTOCOL_11G);
+    esp_wifi_set_ps(WIFI_PS_NONE);
+
+    fastRateConfig.phymode = WIFI_PHY_MODE_HT20;
+    fastRateConfig.rate = WIFI_PHY_RATE_MCS7_SGI;
+    fastRateConfig.ersu = false;
+
+    return toResult(esp_now_init());
+}
+
+Result setReceiveCallback(ReceiveCallback callback) {
+    receiveCallback = callback;
+    return toResult(esp_now_register_recv_cb(onReceive));
+}
+
+bool setChannel(uint8_t channel) {
+    return WiFi.setChannel(channel) == ESP_OK;
+}
+
+uint8_t getChannel() {
+    return WiFi.channel();
+}
+
+void getMacAddress(uint8_t mac[6]) {
+    // Read from eFuse, so HIDDevice::begin() doesn't have to start WiFi and
+    // wait for it just for the USB serial number
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+}
+
+Result addPeer(const uint8_t mac[6], bool fastRate) {
+    esp_now_peer_info_t peer;
+    memset(&peer, 0, sizeof(esp_now_peer_info_t));
+    memcpy(peer.peer_addr, mac, sizeof(uint8_t[6]));
+    peer.channel = 0;
+    peer.encrypt = false;
+    peer.ifidx = WIFI_IF_STA;
+
+    esp_err_t result = esp_now_add_peer(&peer);
+    if (result == ESP_OK && fastRate) {
+        esp_now_set_peer_rate_config(peer.peer_addr, &fastRateConfig);
+    }
+    return toResult(result);
+}
+
+Result deletePeer(const uint8_t mac[6]) {
+    return toResult(esp_now_del_peer(mac));
+}
+
+bool hasPeer(const uint8_t mac[6]) {
+    return esp_now_is_peer_exist(mac);
+}
+
+Result send(const uint8_t mac[6], const uint8_t *data, size_t len) {
+    return toResult(esp_now_send(mac, data, len));
+}
+}  // namespace SlimeVR::Hal::Radio
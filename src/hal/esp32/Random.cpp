@@ -0,0 +1,9 @@
+#include "hal/Random.h"
+
+#include <Arduino.h>
+
+namespace SlimeVR::Hal {
+uint32_t random32() {
+    return esp_random();
+}
+}  // namespace SlimeVR::Hal
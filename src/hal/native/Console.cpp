@@ -0,0 +1,61 @@
+#include "hal/Console.h"
+
+#include "Simulation.h"
+
+namespace SlimeVR::Hal {
+namespace {
+// Takes everything and passes it to the simulation's onConsoleOutput hook
+class SimulatedUart : public ConsolePort {
+public:
+    void begin(unsigned long baud) override {}
+    void setBaudRate(unsigned long baud) override {}
+    void onWritable(void (*callback)()) override {}
+
+    bool isConnected() override { return true; }
+    size_t availableForWrite() override { return 4096; }
+
+    size_t write(const uint8_t *data, size_t len) override {
+        Simulation::Hooks &hooks = Simulation::hooks();
+        if (hooks.onConsoleOutput) {
+            hooks.onConsoleOutput(data, len);
+        }
+        return len;
+    }
+
+    void flush() override {}
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+};
+
+// No host ever opens the USB port
+class DisconnectedPort : public ConsolePort {
+public:
+    void begin(unsigned long baud) override {}
+    void setBaudRate(unsigned long baud) override {}
+    void onWritable(void (*callback)()) override {}
+
+    bool isConnected() override { return false; }
+    size_t availableForWrite() override { return 0; }
+    size_t write(const uint8_t *data, size_t len) override { return 0; }
+    void flush() override {}
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+};
+}  // namespace
+
+namespace Console {
+ConsolePort &uart() {
+    static SimulatedUart port;
+    return port;
+}
+
+ConsolePort &usb() {
+    static DisconnectedPort port;
+    return port;
+}
+}  // namespace Console
+}  // namespace SlimeVR::Hal
@@ -0,0 +1,60 @@
+#include "hal/FileSystem.h"
+
+#include <map>
+#include <string>
+
+// Files only live as long as the process
+namespace {
+std::map<std::string, std::vector<uint8_t>> files;
+}  // namespace
+
+namespace SlimeVR::Hal::FileSystem {
+bool mount() {
+    return true;
+}
+
+bool format() {
+    files.clear();
+    return true;
+}
+
+bool exists(const char *path) {
+    return files.count(path) != 0;
+}
+
+bool remove(const char *path) {
+    return files.erase(path) != 0;
+}
+
+bool rename(const char *from, const char *to) {
+    auto it = files.find(from);
+    if (it == files.end()) {
+        return false;
+    }
+    std::vector<uint8_t> data = std::move(it->second);
+    files.erase(it);
+    files[to] = std::move(data);
+    return true;
+}
+
+bool read(const char *path, std::vector<uint8_t> &data) {
+    auto it = files.find(path);
+    if (it == files.end()) {
+        data.clear();
+        return false;
+    }
+    data = it->second;
+    return true;
+}
+
+bool write(const char *path, const uint8_t *data, size_t len) {
+    files[path].assign(data, data + len);
+    return true;
+}
+
+bool append(const char *path, const uint8_t *data, size_t len) {
+    std::vector<uint8_t> &file = files[path];
+    file.insert(file.end(), data, data + len);
+    return true;
+}
+}  // namespace SlimeVR::Hal::FileSystem
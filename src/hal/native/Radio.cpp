@@ -0,0 +1,134 @@
+#include "hal/Radio.h"
+
+#include <array>
+#include <cstring>
+#include <map>
+
+#include "Simulation.h"
+
+// Frames sent go to the simulation's onRadioSend hook, frames are received
+// through Simulation::deliverFrame()
+namespace {
+bool initialized = false;
+uint8_t channel = 1;
+uint8_t dongleMac[6] = {0x02, 0x53, 0x56, 0x52, 0x00, 0x01};
+SlimeVR::Hal::Radio::ReceiveCallback receiveCallback = nullptr;
+std::map<std::array<uint8_t, 6>, bool> peers;  // MAC to fastRate
+
+std::array<uint8_t, 6> toKey(const uint8_t *mac) {
+    std::array<uint8_t, 6> key;
+    memcpy(key.data(), mac, key.size());
+    return key;
+}
+}  // namespace
+
+namespace Simulation {
+void setDongleMac(const uint8_t mac[6]) {
+    memcpy(dongleMac, mac, sizeof(dongleMac));
+}
+
+void deliverFrame(const uint8_t mac[6], int8_t rssi, const uint8_t *data, size_t len) {
+    if (receiveCallback == nullptr) {
+        return;
+    }
+
+    SlimeVR::Hal::Radio::RxInfo info;
+    info.srcMac = mac;
+    info.rssi = rssi;
+    info.channel = channel;
+    receiveCallback(info, data, static_cast<int>(len));
+}
+}  // namespace Simulation
+
+namespace SlimeVR::Hal::Radio {
+const char *resultToString(Result result) {
+    switch (result) {
+    case Result::OK:
+        return "OK";
+    case Result::NOT_INITIALIZED:
+        return "NOT_INITIALIZED";
+    case Result::INVALID_ARGUMENT:
+        return "INVALID_ARGUMENT";
+    case Result::NO_MEMORY:
+        return "NO_MEMORY";
+    case Result::PEER_LIST_FULL:
+        return "PEER_LIST_FULL";
+    case Result::PEER_NOT_FOUND:
+        return "PEER_NOT_FOUND";
+    case Result::PEER_EXISTS:
+        return "PEER_EXISTS";
+    case Result::INTERNAL_ERROR:
+        return "INTERNAL_ERROR";
+    default:
+        return "FAILED";
+    }
+}
+
+Result begin(uint8_t newChannel) {
+    if (!setChannel(newChannel)) {
+        return Result::INVALID_ARGUMENT;
+    }
+    initialized = true;
+    return Result::OK;
+}
+
+Result setReceiveCallback(ReceiveCallback callback) {
+    if (!initialized) {
+        return Result::NOT_INITIALIZED;
+    }
+    receiveCallback = callback;
+    return Result::OK;
+}
+
+bool setChannel(uint8_t newChannel) {
+    if (newChannel < 1 || newChannel > 14) {
+        return false;
+    }
+    channel = newChannel;
+    return true;
+}
+
+uint8_t getChannel() {
+    return channel;
+}
+
+void getMacAddress(uint8_t mac[6]) {
+    memcpy(mac, dongleMac, sizeof(dongleMac));
+}
+
+Result addPeer(const uint8_t mac[6], bool fastRate) {
+    if (!initialized) {
+        return Result::NOT_INITIALIZED;
+    }
+    return peers.emplace(toKey(mac), fastRate).second ? Result::OK : Result::PEER_EXISTS;
+}
+
+Result deletePeer(const uint8_t mac[6]) {
+    return peers.erase(toKey(mac)) != 0 ? Result::OK : Result::PEER_NOT_FOUND;
+}
+
+bool hasPeer(const uint8_t mac[6]) {
+    return peers.count(toKey(mac)) != 0;
+}
+
+Result send(const uint8_t mac[6], const uint8_t *data, size_t len) {
+    if (len == 0 || len > maxPayloadLength) {
+        return Result::INVALID_ARGUMENT;
+    }
+    auto peer = peers.find(toKey(mac));
+    if (peer == peers.end()) {
+        return Result::PEER_NOT_FOUND;
+    }
+
+    Simulation::Hooks &hooks = Simulation::hooks();
+    if (hooks.onRadioSend) {
+        Simulation::SentFrame frame;
+        frame.timeUs = Simulation::getTimeUs();
+        memcpy(frame.mac, mac, sizeof(frame.mac));
+        frame.fastRate = peer->second;
+        frame.data.assign(data, data + len);
+        hooks.onRadioSend(frame);
+    }
+    return Result::OK;
+}
+}  // namespace SlimeVR::Hal::Radio
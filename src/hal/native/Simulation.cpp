@@ -0,0 +1,72 @@
+#include "Simulation.h"
+
+#include "hal/Clock.h"
+#include "hal/Random.h"
+
+namespace {
+uint64_t timeUs = 0;
+uint64_t rngState = 1;
+Simulation::Hooks simulationHooks;
+}  // namespace
+
+namespace Simulation {
+void setSeed(uint64_t seed) {
+    rngState = seed != 0 ? seed : 1;
+}
+
+Hooks &hooks() {
+    return simulationHooks;
+}
+
+uint64_t getTimeUs() {
+    return timeUs;
+}
+
+void setTimeUs(uint64_t newTimeUs) {
+    timeUs = newTimeUs;
+}
+
+void advanceUs(uint64_t deltaUs) {
+    timeUs += deltaUs;
+}
+
+bool HidEndpoint::ready(uint8_t interface) {
+    return timeUs >= nextSlotUs[interface];
+}
+
+bool HidEndpoint::send(uint8_t interface, const uint8_t *data, size_t size) {
+    if (!ready(interface)) {
+        return false;
+    }
+    nextSlotUs[interface] = timeUs + intervalUs;
+    if (simulationHooks.onHidReport) {
+        simulationHooks.onHidReport(timeUs, interface, data, size);
+    }
+    return true;
+}
+}  // namespace Simulation
+
+namespace SlimeVR::Hal {
+namespace Clock {
+uint32_t millis() {
+    return timeUs / 1000;
+}
+
+uint64_t micros() {
+    return timeUs;
+}
+
+// Waiting is modelled as time passing, nothing else runs meanwhile
+void delay(uint32_t ms) {
+    timeUs += static_cast<uint64_t>(ms) * 1000;
+}
+}  // namespace Clock
+
+// xorshift64*, seeded by Simulation::setSeed()
+uint32_t random32() {
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return (rngState * 0x2545F4914F6CDD1DULL) >> 32;
+}
+}  // namespace SlimeVR::Hal
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "hal/HidSink.h"
+
+// Drives the native HAL fakes. Time only moves when the caller advances it,
+// randomness comes from a seeded generator and every radio frame, HID report
+// and console byte the firmware produces is handed to the hooks below, so a
+// run is fully reproducible.
+namespace Simulation {
+struct SentFrame {
+    uint64_t timeUs;
+    uint8_t mac[6];
+    bool fastRate;  // The peer was added with fastRate, see Radio::addPeer()
+    std::vector<uint8_t> data;
+};
+
+struct Hooks {
+    std::function<void(const SentFrame &)> onRadioSend;
+    std::function<void(uint64_t timeUs, uint8_t interface, const uint8_t *data, size_t len)> onHidReport;
+    std::function<void(const uint8_t *data, size_t len)> onConsoleOutput;
+};
+
+void setSeed(uint64_t seed);
+Hooks &hooks();
+
+uint64_t getTimeUs();
+void setTimeUs(uint64_t timeUs);
+void advanceUs(uint64_t deltaUs);
+
+void setDongleMac(const uint8_t mac[6]);
+
+// Passes a frame to the radio's receive callback, as if it had just been
+// received
+void deliverFrame(const uint8_t mac[6], int8_t rssi, const uint8_t *data, size_t len);
+
+// HID interfaces that each take one transfer per interval, like full-speed
+// interrupt endpoints with bInterval 1
+class HidEndpoint : public SlimeVR::Hal::HidSink {
+public:
+    explicit HidEndpoint(uint64_t intervalUs = 1000) : intervalUs(intervalUs) {}
+
+    bool ready(uint8_t interface) override;
+    bool send(uint8_t interface, const uint8_t *data, size_t size) override;
+
+private:
+    uint64_t intervalUs;
+    uint64_t nextSlotUs[SlimeVR::Hal::hidInterfaceCount] = {};
+};
+}  // namespace Simulation
@@ -0,0 +1,444 @@
+#include "LogBackend.h"
+#include "Logger.h"
+#include "Tasks.h"
+
+namespace SlimeVR
+{
+  namespace Logging
+  {
+    namespace
+    {
+      class ArgDecoder
+      {
+      public:
+        explicit ArgDecoder(const LogRecord &record) : m_Record(record) {}
+
+        bool next(ArgType &type, const uint8_t *&data, size_t &size)
+        {
+          if (m_Offset >= m_Record.payloadLen)
+          {
+            return false;
+          }
+
+          type = static_cast<ArgType>(m_Record.payload[m_Offset++]);
+          switch (type)
+          {
+          case ArgType::STR:
+            size = m_Record.payload[m_Offset++];
+            break;
+          case ArgType::I32:
+          case ArgType::U32:
+            size = 4;
+            break;
+          case ArgType::PTR:
+            size = sizeof(uintptr_t);
+            break;
+          default:
+            size = 8;
+            break;
+          }
+          data = &m_Record.payload[m_Offset];
+          m_Offset += size;
+          return true;
+        }
+
+      private:
+        const LogRecord &m_Record;
+        size_t m_Offset = 0;
+      };
+
+      template <typename T>
+      T readArg(const uint8_t *data)
+      {
+        T value;
+        memcpy(&value, data, sizeof(T));
+        return value;
+      }
+
+      // Formats one conversion of the record's format string with the recorded
+      // argument. The length modifier written at the call site is replaced by
+      // the one matching the type the argument was recorded with.
+      int formatArg(char *out, size_t outSize, const char *spec, size_t specLen, char conversion, ArgType type, const uint8_t *data, size_t size)
+      {
+        char fmt[24];
+        if (specLen > sizeof(fmt) - 4)
+        {
+          specLen = sizeof(fmt) - 4;
+        }
+        memcpy(fmt, spec, specLen);
+
+        bool isString = conversion == 's';
+        bool isFloat = strchr("fFeEgGaA", conversion) != nullptr;
+        bool isPointer = conversion == 'p';
+
+        if (isString && type == ArgType::STR)
+        {
+          char str[LogRecord::payloadSize];
+          memcpy(str, data, size);
+          str[size] = '\0';
+          fmt[specLen] = 's';
+          fmt[specLen + 1] = '\0';
+          return snprintf(out, outSize, fmt, str);
+        }
+
+        if (isString || type == ArgType::STR)
+        {
+          return snprintf(out, outSize, "<?>");
+        }
+
+        if (isPointer || type == ArgType::PTR)
+        {
+          fmt[specLen] = 'p';
+          fmt[specLen + 1] = '\0';
+          uintptr_t ptr = type == ArgType::PTR ? readArg<uintptr_t>(data) : 0;
+          return snprintf(out, outSize, fmt, reinterpret_cast<void *>(ptr));
+        }
+
+        if (isFloat)
+        {
+          double value;
+          switch (type)
+          {
+          case ArgType::F64: value = readArg<double>(data); break;
+          case ArgType::I32: value = readArg<int32_t>(data); break;
+          case ArgType::U32: value = readArg<uint32_t>(data); break;
+          case ArgType::I64: value = readArg<int64_t>(data); break;
+          default: value = readArg<uint64_t>(data); break;
+          }
+          fmt[specLen] = conversion;
+          fmt[specLen + 1] = '\0';
+          return snprintf(out, outSize, fmt, value);
+        }
+
+        // Integer conversions (d, i, u, x, X, o, c)
+        long long value;
+        switch (type)
+        {
+        case ArgType::I32: value = readArg<int32_t>(data); break;
+        case ArgType::U32: value = readArg<uint32_t>(data); break;
+        case ArgType::I64: value = readArg<int64_t>(data); break;
+        case ArgType::U64: value = static_cast<long long>(readArg<uint64_t>(data)); break;
+        default: value = static_cast<long long>(readArg<double>(data)); break;
+        }
+
+        if (conversion == 'c')
+        {
+          fmt[specLen] = 'c';
+          fmt[specLen + 1] = '\0';
+          return snprintf(out, outSize, fmt, static_cast<int>(value));
+        }
+
+        fmt[specLen] = 'l';
+        fmt[specLen + 1] = 'l';
+        fmt[specLen + 2] = conversion;
+        fmt[specLen + 3] = '\0';
+        if (strchr("di", conversion) != nullptr)
+        {
+          return snprintf(out, outSize, fmt, value);
+        }
+        // Keep the bit pattern of negative values printed with %u/%x the way
+        // printf would have for a 32 bit argument
+        unsigned long long uvalue = static_cast<unsigned long long>(value);
+        if (type == ArgType::I32)
+        {
+          uvalue = static_cast<uint32_t>(value);
+        }
+        return snprintf(out, outSize, fmt, uvalue);
+      }
+
+      size_t renderMessage(char *out, size_t outSize, const char *format, const LogRecord &record)
+      {
+        ArgDecoder decoder(record);
+        size_t len = 0;
+        auto append = [&](int written) {
+          if (written > 0)
+          {
+            len += static_cast<size_t>(written);
+            if (len >= outSize)
+            {
+              len = outSize - 1;
+            }
+          }
+        };
+
+        for (const char *p = format; *p != '\0' && len < outSize - 1; p++)
+        {
+          if (*p != '%')
+          {
+            out[len++] = *p;
+            continue;
+          }
+
+          if (p[1] == '%')
+          {
+            out[len++] = '%';
+            p++;
+            continue;
+          }
+
+          // Collect flags, width and precision; drop length modifiers
+          const char *specStart = p;
+          p++;
+          while (*p != '\0' && strchr("-+ #0123456789.", *p) != nullptr)
+          {
+            p++;
+          }
+          size_t specLen = p - specStart;
+          while (*p != '\0' && strchr("hlLqjzt", *p) != nullptr)
+          {
+            p++;
+          }
+          if (*p == '\0')
+          {
+            break;
+          }
+
+          ArgType type;
+          const uint8_t *data;
+          size_t size;
+          if (!decoder.next(type, data, size))
+          {
+            append(snprintf(&out[len], outSize - len, record.truncated ? "..." : "<?>"));
+            continue;
+          }
+          append(formatArg(&out[len], outSize - len, specStart, specLen, *p, type, data, size));
+        }
+
+        out[len] = '\0';
+        return len;
+      }
+
+      size_t renderPrefix(char *out, size_t outSize, Level level, const Logger *owner)
+      {
+        const char *tag = owner != nullptr ? owner->getTag() : nullptr;
+        int written = snprintf(out, outSize, "[%-5s] [%s%s%s] ", levelToString(level), owner != nullptr ? owner->getPrefix() : "?", tag != nullptr ? ":" : "", tag != nullptr ? tag : "");
+        if (written < 0)
+        {
+          return 0;
+        }
+        return static_cast<size_t>(written) < outSize ? written : outSize - 1;
+      }
+    }
+
+    void ArgEncoder::addString(const char *str)
+    {
+      if (str == nullptr)
+      {
+        str = "(null)";
+      }
+
+      size_t available = LogRecord::payloadSize - m_Record.payloadLen;
+      if (available < 3)
+      {
+        m_Record.truncated = true;
+        return;
+      }
+
+      size_t len = strnlen(str, available - 2);
+      m_Record.payload[m_Record.payloadLen++] = static_cast<uint8_t>(ArgType::STR);
+      m_Record.payload[m_Record.payloadLen++] = static_cast<uint8_t>(len);
+      memcpy(&m_Record.payload[m_Record.payloadLen], str, len);
+      m_Record.payloadLen += len;
+    }
+
+    void ArgEncoder::addRaw(ArgType type, const void *data, size_t size)
+    {
+      if (m_Record.truncated || m_Record.payloadLen + 1 + size > LogRecord::payloadSize)
+      {
+        m_Record.truncated = true;
+        return;
+      }
+
+      m_Record.payload[m_Record.payloadLen++] = static_cast<uint8_t>(type);
+      memcpy(&m_Record.payload[m_Record.payloadLen], data, size);
+      m_Record.payloadLen += size;
+    }
+
+    LogBackend &LogBackend::getInstance()
+    {
+      return instance;
+    }
+
+    void LogBackend::begin()
+    {
+      if (m_DrainTask != nullptr)
+      {
+        return;
+      }
+
+      Tasks::start(Tasks::logDrain, drainTask, this, &m_DrainTask);
+    }
+
+    void LogBackend::drainTask(void *arg)
+    {
+      LogBackend *backend = static_cast<LogBackend *>(arg);
+      for (;;)
+      {
+        if (backend->drain(drainBatch) == 0)
+        {
+          vTaskDelay(pdMS_TO_TICKS(drainIdleDelayMs));
+        }
+      }
+    }
+
+    LogSite *LogBackend::getSite(const Logger *owner, const void *key, const char *format, Level level)
+    {
+      uintptr_t hash = reinterpret_cast<uintptr_t>(key) ^ (reinterpret_cast<uintptr_t>(owner) * 31);
+      hash ^= hash >> 7;
+      size_t start = hash % maxSites;
+
+      for (size_t probe = 0; probe < maxSites; probe++)
+      {
+        LogSite &site = m_Sites[(start + probe) % maxSites];
+        uint8_t state = site.state.load(std::memory_order_acquire);
+
+        if (state == 0)
+        {
+          if (site.state.compare_exchange_strong(state, 1, std::memory_order_acquire))
+          {
+            site.key = key;
+            site.format = format;
+            site.owner = owner;
+            site.level = level;
+            site.state.store(2, std::memory_order_release);
+            m_SiteCount.fetch_add(1, std::memory_order_relaxed);
+            return &site;
+          }
+        }
+
+        // Another task is registering this slot right now. Waiting for it
+        // could spin forever on a single core if that task was preempted by
+        // this one, so the slot counts as a miss. If it was this very site,
+        // it ends up registered twice, which only splits its rate limit.
+        if (state == 1)
+        {
+          continue;
+        }
+
+        if (site.key == key && site.owner == owner && site.format == format)
+        {
+          return &site;
+        }
+      }
+
+      return nullptr;
+    }
+
+    bool LogBackend::admit(LogSite &site, uint32_t now, uint32_t &suppressedBefore)
+    {
+      uint32_t start = site.windowStart.load(std::memory_order_relaxed);
+      if (now - start >= rateLimitWindowMs && site.windowStart.compare_exchange_strong(start, now, std::memory_order_relaxed))
+      {
+        site.windowCount.store(0, std::memory_order_relaxed);
+        suppressedBefore = site.suppressed.exchange(0, std::memory_order_relaxed);
+      }
+
+      if (site.windowCount.fetch_add(1, std::memory_order_relaxed) < rateLimitBurst)
+      {
+        return true;
+      }
+
+      site.suppressed.fetch_add(1, std::memory_order_relaxed);
+      m_SuppressedTotal.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    size_t LogBackend::drain(size_t maxRecords)
+    {
+      if (m_Draining.test_and_set(std::memory_order_acquire))
+      {
+        return 0;
+      }
+
+      size_t written = 0;
+      LogRecord record;
+      while (written < maxRecords && m_Ring.tryPop(record))
+      {
+        write(record);
+        written++;
+      }
+
+      uint32_t dropped = m_DroppedRecords.load(std::memory_order_relaxed);
+      if (dropped != m_ReportedDrops)
+      {
+        Serial.printf("[WARN ] [Logging] %u log records dropped, ring full\n", static_cast<unsigned>(dropped - m_ReportedDrops));
+        m_ReportedDrops = dropped;
+      }
+
+      uint32_t now = Hal::Clock::millis();
+      if (now - m_LastSuppressedSweep >= rateLimitWindowMs)
+      {
+        m_LastSuppressedSweep = now;
+        reportSuppressed(now);
+      }
+
+      m_Draining.clear(std::memory_order_release);
+      return written;
+    }
+
+    void LogBackend::flush()
+    {
+      while (!m_Ring.isEmpty())
+      {
+        if (drain(ringCapacity) == 0)
+        {
+          vTaskDelay(1);
+        }
+      }
+      Serial.flush();
+    }
+
+    void LogBackend::write(const LogRecord &record)
+    {
+      if (record.site >= maxSites)
+      {
+        return;
+      }
+
+      const LogSite &site = m_Sites[record.site];
+      char line[320];
+
+      size_t len = renderPrefix(line, sizeof(line), site.level, site.owner);
+      if (record.suppressedBefore > 0)
+      {
+        snprintf(&line[len], sizeof(line) - len, "%u similar messages suppressed\n", record.suppressedBefore);
+        Serial.print(line);
+      }
+
+      len += renderMessage(&line[len], sizeof(line) - len - 1, site.format, record);
+      line[len++] = '\n';
+      Serial.write(reinterpret_cast<const uint8_t *>(line), len);
+    }
+
+    // Reports suppressed messages of sites that went quiet, as no further
+    // record will carry their count
+    void LogBackend::reportSuppressed(uint32_t now)
+    {
+      for (size_t i = 0; i < maxSites; i++)
+      {
+        LogSite &site = m_Sites[i];
+        if (site.state.load(std::memory_order_acquire) != 2)
+        {
+          continue;
+        }
+        if (site.suppressed.load(std::memory_order_relaxed) == 0 || now - site.windowStart.load(std::memory_order_relaxed) < rateLimitWindowMs)
+        {
+          continue;
+        }
+
+        uint32_t count = site.suppressed.exchange(0, std::memory_order_relaxed);
+        if (count == 0)
+        {
+          continue;
+        }
+
+        char line[160];
+        size_t len = renderPrefix(line, sizeof(line), site.level, site.owner);
+        snprintf(&line[len], sizeof(line) - len, "%u similar messages suppressed\n", static_cast<unsigned>(count));
+        Serial.print(line);
+      }
+    }
+
+    LogBackend LogBackend::instance;
+  }
+}
@@ -0,0 +1,225 @@
+#ifndef LOGGING_LOGBACKEND_H
+#define LOGGING_LOGBACKEND_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "Level.h"
+#include "MpscRing.h"
+#include "hal/Clock.h"
+
+namespace SlimeVR
+{
+  namespace Logging
+  {
+    class Logger;
+
+    // A single log statement. Sites are registered once and referenced by index
+    // from every record they produce, so the record only carries arguments.
+    struct LogSite
+    {
+      std::atomic<uint8_t> state{0};  // 0 = free, 1 = being registered, 2 = ready
+      const void *key = nullptr;
+      const char *format = nullptr;
+      const Logger *owner = nullptr;
+      Level level = INFO;
+
+      // Per-site rate limiting state
+      std::atomic<uint32_t> windowStart{0};
+      std::atomic<uint32_t> windowCount{0};
+      std::atomic<uint32_t> suppressed{0};
+    };
+
+    enum class ArgType : uint8_t
+    {
+      I32,
+      U32,
+      I64,
+      U64,
+      F64,
+      STR,
+      PTR,
+    };
+
+    struct LogRecord
+    {
+      static constexpr size_t payloadSize = 88;
+
+      uint32_t timestamp;
+      uint16_t site;
+      uint16_t suppressedBefore;  // Messages dropped by the rate limiter since the last record of this site
+      uint8_t payloadLen;
+      bool truncated;  // Not all arguments fit into the payload
+      uint8_t payload[payloadSize];
+    };
+
+    // Serializes printf-style arguments into a record payload. Strings are
+    // copied so the caller's buffers don't have to outlive the call.
+    class ArgEncoder
+    {
+    public:
+      explicit ArgEncoder(LogRecord &record) : m_Record(record)
+      {
+        m_Record.payloadLen = 0;
+        m_Record.truncated = false;
+      }
+
+      template <typename T>
+      void add(const T &value)
+      {
+        using U = std::decay_t<T>;
+        if constexpr (std::is_same_v<U, const char *> || std::is_same_v<U, char *>)
+        {
+          addString(value);
+        }
+        else if constexpr (std::is_pointer_v<U>)
+        {
+          uintptr_t ptr = reinterpret_cast<uintptr_t>(value);
+          addRaw(ArgType::PTR, &ptr, sizeof(ptr));
+        }
+        else if constexpr (std::is_enum_v<U>)
+        {
+          add(static_cast<std::underlying_type_t<U>>(value));
+        }
+        else if constexpr (std::is_floating_point_v<U>)
+        {
+          double v = value;
+          addRaw(ArgType::F64, &v, sizeof(v));
+        }
+        else if constexpr (std::is_integral_v<U> && sizeof(U) <= 4 && std::is_signed_v<U>)
+        {
+          int32_t v = value;
+          addRaw(ArgType::I32, &v, sizeof(v));
+        }
+        else if constexpr (std::is_integral_v<U> && sizeof(U) <= 4)
+        {
+          uint32_t v = value;
+          addRaw(ArgType::U32, &v, sizeof(v));
+        }
+        else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>)
+        {
+          int64_t v = value;
+          addRaw(ArgType::I64, &v, sizeof(v));
+        }
+        else if constexpr (std::is_integral_v<U>)
+        {
+          uint64_t v = value;
+          addRaw(ArgType::U64, &v, sizeof(v));
+        }
+        else
+        {
+          static_assert(std::is_integral_v<U>, "Unsupported log argument type");
+        }
+      }
+
+      void addString(const char *str);
+
+    private:
+      void addRaw(ArgType type, const void *data, size_t size);
+
+      LogRecord &m_Record;
+    };
+
+    // Deferred logging backend.
+    //
+    // Call sites push compact records into a lock-free ring and return
+    // immediately; a low priority task formats them and writes them to Serial.
+    // Each site is rate limited on its own and reports how many of its messages
+    // were suppressed, and records that don't fit into the ring are counted.
+    class LogBackend
+    {
+    public:
+      static constexpr size_t maxSites = 128;
+      static constexpr size_t ringCapacity = 64;
+      static constexpr uint32_t rateLimitWindowMs = 1000;
+      static constexpr uint32_t rateLimitBurst = 10;
+
+      static LogBackend &getInstance();
+
+      // Starts the drain task. Records pushed before this are kept in the ring.
+      void begin();
+
+      // Returns the site for this (owner, key, format), registering it on first
+      // use. Returns nullptr if the site table is full. The format is kept
+      // and read by the drain task, so it must be a string literal.
+      LogSite *getSite(const Logger *owner, const void *key, const char *format, Level level);
+
+      template <typename... Args>
+      void push(LogSite *site, const Args &...args)
+      {
+        if (site == nullptr)
+        {
+          m_DroppedRecords.fetch_add(1, std::memory_order_relaxed);
+          return;
+        }
+
+        uint32_t now = Hal::Clock::millis();
+        uint32_t suppressedBefore = 0;
+        if (!admit(*site, now, suppressedBefore))
+        {
+          return;
+        }
+
+        uint16_t siteIndex = static_cast<uint16_t>(site - m_Sites);
+        bool queued = m_Ring.tryEmplace([&](LogRecord &record) {
+          record.timestamp = now;
+          record.site = siteIndex;
+          record.suppressedBefore = suppressedBefore > UINT16_MAX ? UINT16_MAX : suppressedBefore;
+          ArgEncoder encoder(record);
+          (encoder.add(args), ...);
+        });
+
+        if (!queued)
+        {
+          m_DroppedRecords.fetch_add(1, std::memory_order_relaxed);
+          if (suppressedBefore > 0)
+          {
+            site->suppressed.fetch_add(suppressedBefore, std::memory_order_relaxed);
+          }
+        }
+      }
+
+      // Formats and writes up to maxRecords queued records. Returns the number
+      // of records written. Safe to call from any task; only one drains at a time.
+      size_t drain(size_t maxRecords);
+
+      // Drains everything that is queued and waits for Serial to send it, e.g.
+      // before a restart or abort.
+      void flush();
+
+      uint32_t getDroppedRecordCount() const { return m_DroppedRecords.load(std::memory_order_relaxed); }
+      uint32_t getSuppressedCount() const { return m_SuppressedTotal.load(std::memory_order_relaxed); }
+
+    private:
+      LogBackend() = default;
+
+      static LogBackend instance;
+
+      static constexpr size_t drainBatch = 16;
+      static constexpr uint32_t drainIdleDelayMs = 10;
+
+      static void drainTask(void *arg);
+
+      bool admit(LogSite &site, uint32_t now, uint32_t &suppressedBefore);
+      void write(const LogRecord &record);
+      void reportSuppressed(uint32_t now);
+
+      LogSite m_Sites[maxSites];
+      std::atomic<uint32_t> m_SiteCount{0};
+
+      MpscRing<LogRecord, ringCapacity> m_Ring;
+      std::atomic<uint32_t> m_DroppedRecords{0};
+      std::atomic<uint32_t> m_SuppressedTotal{0};
+      uint32_t m_ReportedDrops = 0;
+      uint32_t m_LastSuppressedSweep = 0;
+
+      std::atomic_flag m_Draining = ATOMIC_FLAG_INIT;
+      TaskHandle_t m_DrainTask = nullptr;
+    };
+  }
+}
+
+#endif
@@ -2,14 +2,56 @@
 #define LOGGING_LOGGER_H
 
 #include "Level.h"
+#include "LogBackend.h"
 #include "Serial.h"
 
+// Messages below this level are compiled out of the SVR_LOG* macros and
+// dropped by the Logger methods. Override with -DLOG_LEVEL=LOG_LEVEL_DEBUG.
+#ifndef LOG_LEVEL
 #define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// Level-tagged logging macros. Statements below LOG_LEVEL are discarded at
+// compile time, including the evaluation of their arguments. Each statement
+// registers its site once and afterwards only pushes its arguments to the
+// backend. The format string is checked against the arguments like printf.
+#define SVR_LOG(logger, level, format, ...)                                                              \
+  do                                                                                                     \
+  {                                                                                                      \
+    if constexpr ((level) >= LOG_LEVEL)                                                                  \
+    {                                                                                                    \
+      if (false)                                                                                         \
+      {                                                                                                  \
+        SlimeVR::Logging::checkFormat(format, ##__VA_ARGS__);                                            \
+      }                                                                                                  \
+      static SlimeVR::Logging::LogSite *const svrLogSite = (logger).registerSite((level), (format));    \
+      SlimeVR::Logging::LogBackend::getInstance().push(svrLogSite, ##__VA_ARGS__);                      \
+    }                                                                                                    \
+  } while (0)
+
+#define SVR_LOGT(logger, format, ...) SVR_LOG(logger, SlimeVR::Logging::TRACE, format, ##__VA_ARGS__)
+#define SVR_LOGD(logger, format, ...) SVR_LOG(logger, SlimeVR::Logging::DEBUG, format, ##__VA_ARGS__)
+#define SVR_LOGI(logger, format, ...) SVR_LOG(logger, SlimeVR::Logging::INFO, format, ##__VA_ARGS__)
+#define SVR_LOGW(logger, format, ...) SVR_LOG(logger, SlimeVR::Logging::WARN, format, ##__VA_ARGS__)
+#define SVR_LOGE(logger, format, ...) SVR_LOG(logger, SlimeVR::Logging::ERROR, format, ##__VA_ARGS__)
+#define SVR_LOGF(logger, format, ...)                                       \
+  do                                                                        \
+  {                                                                         \
+    SVR_LOG(logger, SlimeVR::Logging::FATAL, format, ##__VA_ARGS__);        \
+    SlimeVR::Logging::LogBackend::getInstance().flush();                    \
+  } while (0)
 
 namespace SlimeVR
 {
   namespace Logging
   {
+    // Never called, only lets the compiler check SVR_LOG* format strings
+    inline void checkFormat(const char *format, ...) __attribute__((format(printf, 1, 2)));
+    inline void checkFormat(const char *format, ...) {}
+
+    // Front end to the deferred LogBackend. Arguments are captured when the
+    // message is logged and formatted later by the backend's drain task, so
+    // logging never blocks on the serial port.
     class Logger
     {
     public:
@@ -29,12 +71,58 @@ namespace SlimeVR
 
       void setTag(const char *tag);
 
-      void trace(const char *str, ...);
-      void debug(const char *str, ...);
-      void info(const char *str, ...);
-      void warn(const char *str, ...);
-      void error(const char *str, ...);
-      void fatal(const char *str, ...);
+      const char *getPrefix() const { return m_Prefix; }
+      const char *getTag() const { return m_Tag; }
+
+      // Registers a log statement of this logger with the backend. Used by the
+      // SVR_LOG* macros, which keep the returned site in a static.
+      LogSite *registerSite(Level level, const char *format) const
+      {
+        return LogBackend::getInstance().getSite(this, format, format, level);
+      }
+
+      // str is the format and, by its address, the key of the message's site.
+      // The backend formats the message after the call returns, so str must
+      // be a string literal. The *Array methods below print str followed by
+      // the array's elements, from sites of their own.
+      template <typename... Args>
+      void trace(const char *str, const Args &...args)
+      {
+        log<TRACE>(str, args...);
+      }
+
+      template <typename... Args>
+      void debug(const char *str, const Args &...args)
+      {
+        log<DEBUG>(str, args...);
+      }
+
+      template <typename... Args>
+      void info(const char *str, const Args &...args)
+      {
+        log<INFO>(str, args...);
+      }
+
+      template <typename... Args>
+      void warn(const char *str, const Args &...args)
+      {
+        log<WARN>(str, args...);
+      }
+
+      template <typename... Args>
+      void error(const char *str, const Args &...args)
+      {
+        log<ERROR>(str, args...);
+      }
+
+      // Fatal messages are written out before returning, as the caller is
+      // usually about to abort
+      template <typename... Args>
+      void fatal(const char *str, const Args &...args)
+      {
+        log<FATAL>(str, args...);
+        LogBackend::getInstance().flush();
+      }
 
       template <typename T>
       inline void traceArray(const char *str, const T *array, size_t size)
@@ -73,8 +161,18 @@ namespace SlimeVR
       }
 
     private:
-      void log(Level level, const char *str, va_list args);
+      template <Level level, typename... Args>
+      void log(const char *str, const Args &...args)
+      {
+        if constexpr (level >= LOG_LEVEL)
+        {
+          LogBackend &backend = LogBackend::getInstance();
+          backend.push(backend.getSite(this, str, str, level), args...);
+        }
+      }
 
+      // Array contents are rendered right away, the backend only receives the
+      // resulting text
       template <typename T>
       void logArray(Level level, const char *str, const T *array, size_t size)
       {
@@ -83,24 +181,45 @@ namespace SlimeVR
           return;
         }
 
-        char buf[strlen(m_Prefix) + (m_Tag == nullptr ? 0 : strlen(m_Tag)) + 2];
-        strcpy(buf, m_Prefix);
-        if (m_Tag != nullptr)
-        {
-          strcat(buf, ":");
-          strcat(buf, m_Tag);
-        }
-
-        Serial.printf("[%-5s] [%s] %s", levelToString(level), buf, str);
+        char buf[LogRecord::payloadSize];
+        size_t len = 0;
+        buf[0] = '\0';
 
-        for (size_t i = 0; i < size; i++)
+        for (size_t i = 0; i < size && len < sizeof(buf) - 1; i++)
         {
-          Serial.print(array[i]);
+          int written;
+          if constexpr (std::is_floating_point_v<T>)
+          {
+            written = snprintf(&buf[len], sizeof(buf) - len, "%.2f", static_cast<double>(array[i]));
+          }
+          else if constexpr (std::is_same_v<T, char>)
+          {
+            written = snprintf(&buf[len], sizeof(buf) - len, "%c", array[i]);
+          }
+          else if constexpr (std::is_signed_v<T>)
+          {
+            written = snprintf(&buf[len], sizeof(buf) - len, "%lld", static_cast<long long>(array[i]));
+          }
+          else
+          {
+            written = snprintf(&buf[len], sizeof(buf) - len, "%llu", static_cast<unsigned long long>(array[i]));
+          }
+
+          if (written < 0)
+          {
+            break;
+          }
+          len = std::min(len + static_cast<size_t>(written), sizeof(buf) - 1);
         }
 
-        Serial.println();
+        LogBackend &backend = LogBackend::getInstance();
+        backend.push(backend.getSite(this, str, arrayFormat, level), str, static_cast<const char *>(buf));
       }
 
+      // The format of logArray() sites, which tells them apart from log()
+      // sites keyed by the same literal
+      static constexpr char arrayFormat[] = "%s%s";
+
       const char *const m_Prefix;
       char *m_Tag;
     };
@@ -1,5 +1,7 @@
+#include "BootTimeline.h"
 #include "ConsoleCommandHandler.h"
 #include "HID.h"
+#include "LoadGenerator.h"
 #include "button.h"
 #include "configuration.h"
 #include "error_codes.h"
@@ -8,6 +10,7 @@
 #include "logging/Logger.h"
 #include "GlobalVars.h"
 #include "Serial.h"
+#include "Tasks.h"
 
 #include "USB.h"
 
@@ -20,17 +23,119 @@ SlimeVR::Logging::Logger logger("Main");
 ConsoleCommandHandler consoleCommandHandler;
 
 void fail(ErrorCodes errorCode) {
-    Serial.printf("Fatal error occurred: %d\n", static_cast<uint8_t>(errorCode));
+    logger.fatal("Fatal error occurred: %d", static_cast<uint8_t>(errorCode));
     abort();
 }
 
+// The tasks setup() starts in place of loop(), see Tasks.h for their
+// priorities and cores
+
+static void hidOutputTask(void *arg) {
+    PacketHandling &packetHandling = PacketHandling::getInstance();
+    packetHandling.setOutputTask(xTaskGetCurrentTaskHandle());
+    for (;;) {
+        // A send waits for the host to take the previous transfer, so the
+        // next one can go straight away
+        if (!packetHandling.tick(hidDevice)) {
+            Tasks::waitForNotification(packetHandling.getIdleWaitMs());
+        }
+    }
+}
+
+static void radioTask(void *arg) {
+    espnow.setUpdateTask(xTaskGetCurrentTaskHandle());
+    for (;;) {
+        unsigned long waitMs;
+        {
+            ESPNowCommunication::StateLock lock;
+            espnow.update();
+            waitMs = espnow.getMillisUntilUpdate();
+        }
+        Tasks::waitForNotification(waitMs);
+    }
+}
+
+static void controlTask(void *arg) {
+    espnow.setEventTask(xTaskGetCurrentTaskHandle());
+    for (;;) {
+        // Connection events from the radio and WiFi tasks, whose subscribers
+        // print and queue HID reports
+        espnow.dispatchEvents();
+
+        {
+            // Button callbacks and console commands pair, unpair and
+            // disconnect trackers
+            ESPNowCommunication::StateLock lock;
+            button.update();
+
+            // Non-blocking serial command handler
+            consoleCommandHandler.update();
+        }
+        ledManager.update();
+
+        // Synthetic reports for USB throughput tests, if one is running
+        LoadGenerator &loadGenerator = LoadGenerator::getInstance();
+        loadGenerator.update();
+
+        // Hand buffered console output to the UART and USB drivers
+        Serial.pump();
+
+        // A load test needs every tick to keep up its report rate
+        Tasks::waitForNotification(loadGenerator.isActive() ? 0 : Tasks::controlPollMs);
+    }
+}
+
+static void startTask(const Tasks::Config &config, TaskFunction_t function) {
+    if (Tasks::start(config, function, nullptr, nullptr) != pdPASS) {
+        fail(ErrorCodes::TASK_START_FAILED);
+    }
+}
+
 void setup() { 
+    BootTimeline &bootTimeline = BootTimeline::getInstance();
+    bootTimeline.mark("reset");
+
+    // The host enumerates USB in the background from here on, while the
+    // rest of the dongle comes up
     hidDevice.begin();
+    SlimeVR::Logging::LogBackend::getInstance().begin();
     Serial.println("Starting up " USB_PRODUCT "...");
+    bootTimeline.mark("usb");
 
     statusManager.setStatus(SlimeVR::Status::LOADING, true);
     ledManager.setup();
     Configuration::getInstance().setup();
+    PacketHandling::getInstance().begin();
+    bootTimeline.mark("config");
+
+    espnow.onTrackerPaired([&]() { 
+        //espnow.exitPairingMode();
+    });
+
+    espnow.onTrackerConnected(
+        [&](const uint8_t *trackerMacAddress) {
+            Serial.println("New tracker connected");
+            uint8_t packet[16];
+            packet[0] = 0xff;
+            packet[1] = Configuration::getInstance().getTrackerIdForMac(trackerMacAddress);
+            memcpy(&packet[2], trackerMacAddress, sizeof(uint8_t) * 6);
+            memset(&packet[8], 0, sizeof(uint8_t) * 8);
+            PacketHandling::getInstance().insert(packet, 16);
+    });
+
+    espnow.onTrackerDisconnected(
+        [&](uint8_t trackerId) {
+            Serial.printf("Tracker %d disconnected, sending status packet\n", trackerId);
+            PacketHandling::getInstance().sendDisconnectionStatus(trackerId);
+    });
+
+    // Trackers can reconnect as soon as the radio is up, everything after
+    // this can wait
+    ErrorCodes result = espnow.begin();
+    if (result != ErrorCodes::NO_ERROR) {
+        fail(result);
+    }
+    bootTimeline.mark("radio");
 
     // Print all paired trackers and their tracker IDs
     Serial.println("Paired trackers:");
@@ -49,10 +154,9 @@ void setup() {
     button.onLongPress([]() {
         Serial.println("Trackers reset");
         statusManager.setStatus(SlimeVR::Status::RESETTING, true);
-        Configuration::getInstance().clearAllPairedTrackers();
         espnow.sendUnpairToAllTrackers();
         espnow.disconnectAllTrackers();
-        Configuration::getInstance().resetSecurityCode();
+        Configuration::getInstance().resetPairing();
 
         // Blink LED twice to indicate reset action
         ledManager.pattern(500, 300, 2);
@@ -74,43 +178,18 @@ void setup() {
         }
     });
 
-    ErrorCodes result = espnow.begin();
-    if (result != ErrorCodes::NO_ERROR) {
-        fail(result);
-    }
-
-    espnow.onTrackerPaired([&]() { 
-        //espnow.exitPairingMode();
-    });
-
-    espnow.onTrackerConnected(
-        [&](const uint8_t *trackerMacAddress) {
-            Serial.println("New tracker connected");
-            uint8_t packet[16];
-            packet[0] = 0xff;
-            memcpy(&packet[2], trackerMacAddress, sizeof(uint8_t) * 6);
-            memset(&packet[8], 0, sizeof(uint8_t) * 8);
-            PacketHandling::getInstance().insert(packet, 16);
-    });
-
-    espnow.onTrackerDisconnected(
-        [&](uint8_t trackerId) {
-            Serial.printf("Tracker %d disconnected, sending status packet\n", trackerId);
-            PacketHandling::getInstance().sendDisconnectionStatus(trackerId);
-    });
+    startTask(Tasks::hidOutput, hidOutputTask);
+    startTask(Tasks::radio, radioTask);
+    startTask(Tasks::control, controlTask);
 
     Serial.println("Boot complete");
     statusManager.setStatus(SlimeVR::Status::LOADING, false);
     statusManager.setStatus(SlimeVR::Status::READY, true);
+    bootTimeline.mark("ready");
+    bootTimeline.print();
 }
 
+// Arduino's loop task isn't needed once setup() has started the others
 void loop() {
-    button.update();
-    ledManager.update();
-    espnow.update();
-
-    // Non-blocking serial command handler
-    consoleCommandHandler.update();
-
-    PacketHandling::getInstance().tick(hidDevice);
+    vTaskDelete(nullptr);
 }
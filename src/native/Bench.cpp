@@ -0,0 +1,672 @@
+// Pushes synthetic tracker traffic through ESPNowCommunication and
+// PacketHandling on the simulated clock and measures what comes out of the
+// HID endpoint, plus microbenchmarks of the hot paths. Results are written as
+// one JSON object per line so runs can be diffed and plotted.
+//
+// Build: pio run -e native_bench   (the binary is .pio/build/native_bench/program)
+//
+// Usage: program [options]
+//
+//   --trackers LIST     tracker counts to run, default 4,16,64
+//   --rates LIST        per-tracker report rates in Hz, default 100,200,400
+//   --poll-us N         HID polling interval, default 1000
+//   --duration-s N      simulated time per cell, default 2
+//   --step-us N         main loop period, default 100
+//   --hid-wake MODE     when HID output runs: loop, once per main loop period
+//                       (default); poll, every --hid-period-us, like a task
+//                       sleeping between polls; notify, also as soon as a
+//                       frame is delivered, like the firmware's HID task
+//   --hid-period-us N   HID polling period for --hid-wake poll, default 1000
+//   --hid-format F      HID report format, legacy (default) or compact
+//   --iterations N      iterations per microbenchmark, default 100000
+//   --no-micro          only run the pipeline matrix
+//   --micro-only        only run the microbenchmarks
+//   --output FILE       write the results to FILE instead of stdout
+//
+// Every tracker sends a type 1 report with its tracker ID in byte 1 and a
+// sequence number in its quaternion, see writeSequence(), with the trackers'
+// send times spread evenly over the report period. Report age is the simulated time from the radio
+// frame to the HID transfer that carried it. CPU time is host wall-clock time
+// spent in each stage of the main loop, so compare runs from the same machine
+// only; it tracks the firmware's relative costs, not its absolute ones. Wake
+// latency is the simulated time from a report arriving at an empty FIFO to
+// the transfer that carries it, see PacketHandling::Stats.
+//
+// The microbenchmarks include the compact format's encoder and decoder, and a
+// compact_precision line with how far random rotations and accelerations are
+// off after a round trip through it. test/test_compact_report fails if that
+// exceeds the bounds CompactReport.h documents.
+
+#include "CompactReport.h"
+#include "configuration.h"
+#include "espnow/espnow.h"
+#include "espnow/messages.h"
+#include "logging/Logger.h"
+#include "packetHandling.h"
+#include "StatusManager.h"
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include "DongleHarness.h"
+#include "hal/native/Simulation.h"
+
+SlimeVR::Status::StatusManager statusManager;
+
+namespace {
+constexpr uint64_t startTimeUs = 1000000;
+constexpr uint64_t warmupUs = 500000;   // Lets the handshake acks drain through the rate limited send queue
+constexpr uint64_t settleUs = 50000;    // Run after every cell so the next one starts with an empty FIFO
+constexpr size_t maxTrackers = ESPNowCommunication::maxConnectedTrackers;
+constexpr size_t histogramBuckets = 20; // 1 ms buckets, the last one also holds everything older
+
+using BenchClock = std::chrono::steady_clock;
+
+enum class HidWake {
+    LOOP,
+    POLL,
+    NOTIFY,
+};
+
+const char *hidWakeName(HidWake wake) {
+    switch (wake) {
+        case HidWake::POLL: return "poll";
+        case HidWake::NOTIFY: return "notify";
+        default: return "loop";
+    }
+}
+
+struct Options {
+    std::vector<size_t> trackerCounts = {4, 16, 64};
+    std::vector<uint32_t> ratesHz = {100, 200, 400};
+    uint64_t pollUs = 1000;
+    uint64_t durationUs = 2000000;
+    uint64_t stepUs = 100;
+    HidWake hidWake = HidWake::LOOP;
+    uint64_t hidPeriodUs = 1000;
+    PacketHandling::ReportFormat hidFormat = PacketHandling::ReportFormat::LEGACY;
+    size_t iterations = 100000;
+    bool pipeline = true;
+    bool micro = true;
+    std::string outputPath;
+};
+
+// Accepts every transfer, for timing PacketHandling without the endpoint's pacing
+class AlwaysReadySink : public SlimeVR::Hal::HidSink {
+public:
+    bool ready(uint8_t interface) override { return true; }
+    bool send(uint8_t interface, const uint8_t *data, size_t size) override { return true; }
+};
+
+bool parseList(const char *text, std::vector<uint32_t> &values) {
+    values.clear();
+    std::istringstream input(text);
+    std::string item;
+    while (std::getline(input, item, ',')) {
+        uint32_t value = strtoul(item.c_str(), nullptr, 10);
+        if (value == 0) {
+            return false;
+        }
+        values.push_back(value);
+    }
+    return !values.empty();
+}
+
+bool parseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--trackers" && hasValue) {
+            std::vector<uint32_t> counts;
+            if (!parseList(argv[++i], counts)) {
+                return false;
+            }
+            options.trackerCounts.assign(counts.begin(), counts.end());
+            for (size_t count : options.trackerCounts) {
+                if (count > maxTrackers) {
+                    return false;
+                }
+            }
+        } else if (arg == "--rates" && hasValue) {
+            if (!parseList(argv[++i], options.ratesHz)) {
+                return false;
+            }
+        } else if (arg == "--poll-us" && hasValue) {
+            options.pollUs = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--duration-s" && hasValue) {
+            options.durationUs = std::max(1ULL, strtoull(argv[++i], nullptr, 10)) * 1000000;
+        } else if (arg == "--step-us" && hasValue) {
+            options.stepUs = std::max(1ULL, strtoull(argv[++i], nullptr, 10));
+        } else if (arg == "--hid-wake" && hasValue) {
+            std::string mode = argv[++i];
+            if (mode == "loop") {
+                options.hidWake = HidWake::LOOP;
+            } else if (mode == "poll") {
+                options.hidWake = HidWake::POLL;
+            } else if (mode == "notify") {
+                options.hidWake = HidWake::NOTIFY;
+            } else {
+                return false;
+            }
+        } else if (arg == "--hid-period-us" && hasValue) {
+            options.hidPeriodUs = std::max(1ULL, strtoull(argv[++i], nullptr, 10));
+        } else if (arg == "--hid-format" && hasValue) {
+            std::string format = argv[++i];
+            if (format == "legacy") {
+                options.hidFormat = PacketHandling::ReportFormat::LEGACY;
+            } else if (format == "compact") {
+                options.hidFormat = PacketHandling::ReportFormat::COMPACT;
+            } else {
+                return false;
+            }
+        } else if (arg == "--iterations" && hasValue) {
+            options.iterations = std::max(1ULL, strtoull(argv[++i], nullptr, 10));
+        } else if (arg == "--no-micro") {
+            options.micro = false;
+        } else if (arg == "--micro-only") {
+            options.pipeline = false;
+        } else if (arg == "--output" && hasValue) {
+            options.outputPath = argv[++i];
+        } else {
+            return false;
+        }
+    }
+    return options.pipeline || options.micro;
+}
+
+void trackerMac(size_t index, uint8_t mac[6]) {
+    mac[0] = 0x02;
+    mac[1] = 0xbe;
+    mac[2] = 0x4c;
+    mac[3] = 0x00;
+    mac[4] = index >> 8;
+    mac[5] = index & 0xff;
+}
+
+// Puts a 30-bit sequence number into a type 1 report's quaternion, 10 bits in
+// each of the first three components, on the compact format's quantization
+// grid so it comes through both formats unchanged. The fourth component
+// makes it a unit quaternion and stays the largest.
+void writeSequence(uint32_t sequence, uint8_t *report) {
+    float sumSquares = 0;
+    for (size_t i = 0; i < 3; i++) {
+        float component = CompactReport::dequantizeComponent(static_cast<int32_t>((sequence >> (10 * i)) & 0x3ff) - 512);
+        sumSquares += component * component;
+        CompactReport::writeInt16(&report[2 + 2 * i], CompactReport::toLegacyComponent(component));
+    }
+    CompactReport::writeInt16(&report[8], CompactReport::toLegacyComponent(std::sqrt(1.0f - sumSquares)));
+}
+
+uint32_t readSequence(const uint8_t *report) {
+    uint32_t sequence = 0;
+    for (size_t i = 0; i < 3; i++) {
+        int32_t value = CompactReport::quantizeComponent(CompactReport::readInt16(&report[2 + 2 * i]) / CompactReport::quaternionScale);
+        sequence |= static_cast<uint32_t>(value + 512) << (10 * i);
+    }
+    return sequence;
+}
+
+// A TRACKER_DATA frame carrying one type 1 report
+size_t buildDataFrame(uint8_t trackerId, uint32_t sequence, uint8_t frame[sizeof(ESPNowPacketMessage)]) {
+    constexpr size_t reportLen = 16;
+    memset(frame, 0, sizeof(ESPNowPacketMessage));
+    frame[0] = static_cast<uint8_t>(ESPNowMessageTypes::TRACKER_DATA);
+    frame[1] = reportLen;
+    frame[2] = 1;
+    frame[3] = trackerId;
+    writeSequence(sequence, &frame[2]);
+    return 2 + reportLen;
+}
+
+// A type 1 report with a uniformly random rotation and an acceleration
+// whose components are up to range
+void randomReport(std::mt19937 &random, int32_t range, uint8_t *report) {
+    std::normal_distribution<float> normal;
+    float q[4];
+    float lengthSquared = 0;
+    for (float &component : q) {
+        component = normal(random);
+        lengthSquared += component * component;
+    }
+    memset(report, 0, 16);
+    report[0] = 1;
+    report[1] = random() & 0xff;
+    for (size_t i = 0; i < 4; i++) {
+        CompactReport::writeInt16(&report[2 + 2 * i], CompactReport::toLegacyComponent(q[i] / std::sqrt(lengthSquared)));
+    }
+    std::uniform_int_distribution<int32_t> accel(-range, range);
+    for (size_t i = 0; i < 3; i++) {
+        CompactReport::writeInt16(&report[10 + 2 * i], accel(random));
+    }
+}
+
+int64_t elapsedNs(BenchClock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(BenchClock::now() - start).count();
+}
+
+uint64_t percentile(const std::vector<uint64_t> &sorted, double fraction) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+// Main loop stages, as in main.cpp's loop()
+struct StageTimes {
+    int64_t receiveNs = 0;
+    int64_t updateNs = 0;
+    int64_t tickNs = 0;
+    int64_t logNs = 0;
+};
+
+class Bench {
+public:
+    Bench(const Options &options, std::ostream &out) : options(options), out(out), hidEndpoint(options.pollUs) {}
+
+    bool begin() {
+        Simulation::setTimeUs(startTimeUs);
+        if (!harness.begin()) {
+            return false;
+        }
+        PacketHandling::getInstance().setReportFormat(options.hidFormat);
+
+        // Pairing up front keeps the tracker IDs the same in every cell
+        size_t trackerCount = 0;
+        for (size_t count : options.trackerCounts) {
+            trackerCount = std::max(trackerCount, count);
+        }
+        trackerCount = std::max<size_t>(trackerCount, 64);  // The microbenchmarks use up to 64
+        for (size_t i = 0; i < trackerCount; i++) {
+            uint8_t mac[6];
+            trackerMac(i, mac);
+            harness.pairTracker(mac);
+            trackerIds.push_back(Configuration::getInstance().getTrackerIdForMac(mac));
+        }
+        return true;
+    }
+
+    void runPipeline(size_t trackerCount, uint32_t rateHz) {
+        auto &espnow = ESPNowCommunication::getInstance();
+        auto &packetHandling = PacketHandling::getInstance();
+
+        connect(trackerCount);
+        runFor(warmupUs, nullptr);
+
+        // Tracker index by tracker ID, for matching the HID reports to their sender
+        std::vector<int> trackerIndexById(256, -1);
+        for (size_t i = 0; i < trackerCount; i++) {
+            trackerIndexById[trackerIds[i]] = static_cast<int>(i);
+        }
+
+        uint64_t periodUs = 1000000 / rateHz;
+        uint64_t beginUs = Simulation::getTimeUs();
+        uint64_t endUs = beginUs + options.durationUs;
+        auto sendTimeUs = [&](size_t tracker, uint32_t sequence) { return beginUs + tracker * periodUs / trackerCount + sequence * periodUs; };
+
+        std::vector<uint32_t> nextSequence(trackerCount, 0);
+        std::vector<uint64_t> ages;
+        ages.reserve(trackerCount * rateHz * (options.durationUs / 1000000));
+        uint64_t framesSent = 0;
+        uint64_t hidTransfers = 0;
+
+        auto countReport = [&](uint64_t timeUs, const uint8_t *report) {
+            int tracker = trackerIndexById[report[1]];
+            if (report[0] == 1 && tracker >= 0) {
+                ages.push_back(timeUs - sendTimeUs(tracker, readSequence(report)));
+            }
+        };
+        Simulation::hooks().onHidReport = [&](uint64_t timeUs, uint8_t interface, const uint8_t *data, size_t len) {
+            hidTransfers++;
+            if (CompactReport::isCompactTransfer(data)) {
+                uint8_t report[16];
+                for (size_t i = 0; i < CompactReport::entryCount(data); i++) {
+                    CompactReport::decode(CompactReport::entryAt(data, i), report);
+                    countReport(timeUs, report);
+                }
+                return;
+            }
+            for (size_t offset = 0; offset + 16 <= len; offset += 16) {
+                countReport(timeUs, &data[offset]);
+            }
+        };
+
+        espnow.resetStats();
+        packetHandling.resetStats();
+
+        StageTimes times;
+        uint8_t frame[sizeof(ESPNowPacketMessage)];
+        while (Simulation::getTimeUs() < endUs) {
+            uint64_t now = Simulation::getTimeUs();
+
+            auto start = BenchClock::now();
+            for (size_t i = 0; i < trackerCount; i++) {
+                while (sendTimeUs(i, nextSequence[i]) <= now) {
+                    uint8_t mac[6];
+                    trackerMac(i, mac);
+                    size_t len = buildDataFrame(trackerIds[i], nextSequence[i]++, frame);
+                    Simulation::deliverFrame(mac, -50, frame, len);
+                    framesSent++;
+                }
+            }
+            harness.deliverDueReplies();
+            times.receiveNs += elapsedNs(start);
+
+            if (options.hidWake == HidWake::NOTIFY) {
+                start = BenchClock::now();
+                while (packetHandling.tick(hidEndpoint)) {
+                }
+                times.tickNs += elapsedNs(start);
+            }
+
+            runLoopOnce(&times);
+
+            if (Simulation::getTimeUs() == now) {
+                Simulation::advanceUs(options.stepUs);
+            }
+        }
+        Simulation::hooks().onHidReport = nullptr;
+
+        const PacketHandling::Stats &pipelineStats = packetHandling.getStats();
+        const ESPNowCommunication::Stats &radioStats = espnow.getStats();
+        std::sort(ages.begin(), ages.end());
+        double seconds = options.durationUs / 1e6;
+
+        uint64_t histogram[histogramBuckets] = {};
+        for (uint64_t age : ages) {
+            histogram[std::min<uint64_t>(age / 1000, histogramBuckets - 1)]++;
+        }
+        uint64_t iterations = options.durationUs / options.stepUs;
+
+        out << "{\"bench\":\"pipeline\",\"trackers\":" << trackerCount << ",\"rateHz\":" << rateHz
+            << ",\"pollUs\":" << options.pollUs << ",\"stepUs\":" << options.stepUs
+            << ",\"hidWake\":\"" << hidWakeName(options.hidWake) << "\",\"hidFormat\":\"" << PacketHandling::reportFormatName(packetHandling.getReportFormat())
+            << "\",\"durationS\":" << seconds
+            << ",\"framesSent\":" << framesSent << ",\"reportsDelivered\":" << ages.size()
+            << ",\"offeredPerSecond\":" << framesSent / seconds << ",\"deliveredPerSecond\":" << ages.size() / seconds
+            << ",\"hidTransfers\":" << hidTransfers << ",\"compactTransfers\":" << pipelineStats.compactTransfers
+            << ",\"dedupOverwrites\":" << pipelineStats.overwrittenReports << ",\"fifoDrops\":" << pipelineStats.droppedReports
+            << ",\"sendQueueFull\":" << radioStats.sendQueueFull << ",\"sendFailed\":" << radioStats.sendFailed
+            << ",\"ageUs\":{\"p50\":" << percentile(ages, 0.5) << ",\"p90\":" << percentile(ages, 0.9)
+            << ",\"p99\":" << percentile(ages, 0.99) << ",\"max\":" << (ages.empty() ? 0 : ages.back()) << "}"
+            << ",\"wakeUs\":{\"count\":" << pipelineStats.wakeups
+            << ",\"avg\":" << (pipelineStats.wakeups != 0 ? pipelineStats.wakeLatencyTotalUs / pipelineStats.wakeups : 0)
+            << ",\"max\":" << pipelineStats.wakeLatencyMaxUs << "}"
+            << ",\"ageHistogramMs\":[";
+        for (size_t i = 0; i < histogramBuckets; i++) {
+            out << (i != 0 ? "," : "") << histogram[i];
+        }
+        out << "],\"cpuNsPerLoop\":{\"receive\":" << times.receiveNs / iterations << ",\"update\":" << times.updateNs / iterations
+            << ",\"tick\":" << times.tickNs / iterations << ",\"log\":" << times.logNs / iterations << "}"
+            << ",\"cpuNsPerFrame\":" << (framesSent != 0 ? times.receiveNs / static_cast<int64_t>(framesSent) : 0) << "}\n";
+
+        disconnectAll();
+    }
+
+    void runMicro() {
+        auto &packetHandling = PacketHandling::getInstance();
+        uint8_t frame[sizeof(ESPNowPacketMessage)];
+        uint8_t mac[6];
+        AlwaysReadySink sink;
+
+        // TRACKER_DATA from a MAC that isn't connected, the cost of a lookup miss
+        connect(16);
+        trackerMac(maxTrackers, mac);
+        size_t len = buildDataFrame(0, 0, frame);
+        auto start = BenchClock::now();
+        for (size_t i = 0; i < options.iterations; i++) {
+            Simulation::deliverFrame(mac, -50, frame, len);
+        }
+        report("mac_lookup_miss", "16 trackers connected", start, options.iterations);
+        disconnectAll();
+
+        // A report from the last of 64 trackers while all of them have one
+        // queued, so the dedup scan walks the whole FIFO before overwriting
+        connect(64);
+        runFor(warmupUs, nullptr);
+        for (size_t i = 0; i < 64; i++) {
+            trackerMac(i, mac);
+            len = buildDataFrame(trackerIds[i], 0, frame);
+            Simulation::deliverFrame(mac, -50, frame, len);
+        }
+        trackerMac(63, mac);
+        len = buildDataFrame(trackerIds[63], 1, frame);
+        start = BenchClock::now();
+        for (size_t i = 0; i < options.iterations; i++) {
+            Simulation::deliverFrame(mac, -50, frame, len);
+        }
+        report("receive_dedup", "64 reports queued", start, options.iterations);
+        drain(sink);
+
+        // New entries into an empty FIFO until it is full; the scan grows with it
+        uint8_t packet[16] = {1};
+        size_t rounds = std::max<size_t>(1, options.iterations / 256);
+        int64_t insertNs = 0;
+        int64_t tickNs = 0;
+        for (size_t round = 0; round < rounds; round++) {
+            start = BenchClock::now();
+            for (size_t id = 0; id < 256; id++) {
+                packet[1] = id;
+                packetHandling.insert(packet, sizeof(packet), -50);
+            }
+            insertNs += elapsedNs(start);
+
+            // Assembling transfers from a full FIFO
+            start = BenchClock::now();
+            while (packetHandling.getQueuedReportCount() != 0) {
+                packetHandling.tick(sink);
+            }
+            tickNs += elapsedNs(start);
+        }
+        report("insert_new", "empty to full FIFO", insertNs, rounds * 256);
+        report("hid_assembly", "4 queued reports per transfer", tickNs, rounds * 64);
+
+        // Queueing a message and sending it once the rate limit allows,
+        // here a re-sent handshake ack to a connected tracker
+        ESPNowConnectionMessage handshake;
+        memcpy(handshake.securityBytes, ESPNowCommunication::getInstance().securityCode, sizeof(handshake.securityBytes));
+        trackerMac(0, mac);
+        size_t sends = std::max<size_t>(1, options.iterations / 10);
+        harness.answerHeartbeats = false;
+        int64_t sendNs = 0;
+        for (size_t i = 0; i < sends; i++) {
+            start = BenchClock::now();
+            Simulation::deliverFrame(mac, -50, reinterpret_cast<const uint8_t *>(&handshake), sizeof(handshake));
+            ESPNowCommunication::getInstance().update();
+            sendNs += elapsedNs(start);
+            Simulation::advanceUs(5000);
+            drain(sink);
+        }
+        harness.answerHeartbeats = true;
+        report("send_queue", "queue and send one message", sendNs, sends);
+        disconnectAll();
+
+        // A handshake from a paired tracker that isn't connected yet: the
+        // pairing and tracker ID lookups, then adding it to the connected list
+        size_t handshakes = std::max<size_t>(1, options.iterations / 10);
+        int64_t handshakeNs = 0;
+        for (size_t i = 0; i < handshakes; i++) {
+            trackerMac(i % 64, mac);
+            start = BenchClock::now();
+            Simulation::deliverFrame(mac, -50, reinterpret_cast<const uint8_t *>(&handshake), sizeof(handshake));
+            handshakeNs += elapsedNs(start);
+            ESPNowCommunication::getInstance().disconnectSingleTracker(mac);
+            Simulation::advanceUs(5000);
+            ESPNowCommunication::getInstance().update();
+            drain(sink);
+        }
+        report("handshake", "64 paired trackers", handshakeNs, handshakes);
+
+        runCompactCodec();
+    }
+
+    // Encoding and decoding compact entries, and how far a round trip moves
+    // random reports
+    void runCompactCodec() {
+        constexpr int32_t accelRange = 16320;  // Where the compact format saturates
+        std::mt19937 random(1);
+        std::vector<uint8_t> legacy(options.iterations * 16);
+        std::vector<uint8_t> entries(options.iterations * CompactReport::entrySize);
+        std::vector<uint8_t> decoded(options.iterations * 16);
+        for (size_t i = 0; i < options.iterations; i++) {
+            // Spread over every acceleration exponent
+            randomReport(random, accelRange >> (random() % 8), &legacy[i * 16]);
+        }
+
+        auto start = BenchClock::now();
+        for (size_t i = 0; i < options.iterations; i++) {
+            CompactReport::encode(&legacy[i * 16], &entries[i * CompactReport::entrySize]);
+        }
+        report("compact_encode", "random type 1 reports", start, options.iterations);
+        start = BenchClock::now();
+        for (size_t i = 0; i < options.iterations; i++) {
+            CompactReport::decode(&entries[i * CompactReport::entrySize], &decoded[i * 16]);
+        }
+        report("compact_decode", "random type 1 reports", start, options.iterations);
+
+        std::vector<uint64_t> angleErrorsUdeg;
+        angleErrorsUdeg.reserve(options.iterations);
+        int32_t accelErrorMax = 0;
+        for (size_t i = 0; i < options.iterations; i++) {
+            const uint8_t *before = &legacy[i * 16];
+            const uint8_t *after = &decoded[i * 16];
+            double dot = 0, lengthBefore = 0, lengthAfter = 0;
+            for (size_t c = 0; c < 4; c++) {
+                double a = CompactReport::readInt16(&before[2 + 2 * c]);
+                double b = CompactReport::readInt16(&after[2 + 2 * c]);
+                dot += a * b;
+                lengthBefore += a * a;
+                lengthAfter += b * b;
+            }
+            double cosHalfAngle = std::min(1.0, std::fabs(dot) / std::sqrt(lengthBefore * lengthAfter));
+            angleErrorsUdeg.push_back(static_cast<uint64_t>(2 * std::acos(cosHalfAngle) * 180 / M_PI * 1e6));
+
+            for (size_t c = 0; c < 3; c++) {
+                int32_t error = CompactReport::readInt16(&before[10 + 2 * c]) - CompactReport::readInt16(&after[10 + 2 * c]);
+                accelErrorMax = std::max(accelErrorMax, std::abs(error));
+            }
+        }
+        std::sort(angleErrorsUdeg.begin(), angleErrorsUdeg.end());
+        out << "{\"bench\":\"compact_precision\",\"samples\":" << options.iterations
+            << ",\"angleErrorDeg\":{\"p50\":" << percentile(angleErrorsUdeg, 0.5) / 1e6 << ",\"p99\":" << percentile(angleErrorsUdeg, 0.99) / 1e6
+            << ",\"max\":" << angleErrorsUdeg.back() / 1e6 << "},\"accelErrorMax\":" << accelErrorMax << "}\n";
+    }
+
+private:
+    void connect(size_t trackerCount) {
+        for (size_t i = 0; i < trackerCount; i++) {
+            uint8_t mac[6];
+            trackerMac(i, mac);
+            harness.connectTracker(mac, -50);
+        }
+    }
+
+    void disconnectAll() {
+        ESPNowCommunication::getInstance().disconnectAllTrackers();
+        harness.clearPendingReplies();
+        runFor(settleUs, nullptr);
+        Simulation::advanceUs(5000);
+    }
+
+    void drain(SlimeVR::Hal::HidSink &sink) {
+        ESPNowCommunication::getInstance().dispatchEvents();
+        while (PacketHandling::getInstance().getQueuedReportCount() != 0) {
+            PacketHandling::getInstance().tick(sink);
+        }
+        SlimeVR::Logging::LogBackend::getInstance().drain(SIZE_MAX);
+    }
+
+    void runLoopOnce(StageTimes *times) {
+        auto start = BenchClock::now();
+        ESPNowCommunication::getInstance().update();
+        ESPNowCommunication::getInstance().dispatchEvents();
+        auto afterUpdate = BenchClock::now();
+        uint64_t now = Simulation::getTimeUs();
+        if (options.hidWake != HidWake::POLL || now >= nextHidPollUs) {
+            nextHidPollUs = now + options.hidPeriodUs;
+            PacketHandling::getInstance().tick(hidEndpoint);
+        }
+        auto afterTick = BenchClock::now();
+        Serial.pump();
+        SlimeVR::Logging::LogBackend::getInstance().drain(SIZE_MAX);
+        auto end = BenchClock::now();
+
+        if (times != nullptr) {
+            times->updateNs += std::chrono::duration_cast<std::chrono::nanoseconds>(afterUpdate - start).count();
+            times->tickNs += std::chrono::duration_cast<std::chrono::nanoseconds>(afterTick - afterUpdate).count();
+            times->logNs += std::chrono::duration_cast<std::chrono::nanoseconds>(end - afterTick).count();
+        }
+    }
+
+    void runFor(uint64_t durationUs, StageTimes *times) {
+        uint64_t endUs = Simulation::getTimeUs() + durationUs;
+        while (Simulation::getTimeUs() < endUs) {
+            uint64_t now = Simulation::getTimeUs();
+            harness.deliverDueReplies();
+            runLoopOnce(times);
+            if (Simulation::getTimeUs() == now) {
+                Simulation::advanceUs(options.stepUs);
+            }
+        }
+    }
+
+    void report(const char *name, const char *setup, BenchClock::time_point start, size_t iterations) {
+        report(name, setup, elapsedNs(start), iterations);
+    }
+
+    void report(const char *name, const char *setup, int64_t totalNs, size_t iterations) {
+        out << "{\"bench\":\"" << name << "\",\"setup\":\"" << setup << "\",\"iterations\":" << iterations
+            << ",\"nsPerIteration\":" << static_cast<double>(totalNs) / iterations << "}\n";
+    }
+
+    const Options &options;
+    std::ostream &out;
+    DongleHarness harness;
+    Simulation::HidEndpoint hidEndpoint;
+    std::vector<uint8_t> trackerIds;
+    uint64_t nextHidPollUs = 0;
+};
+}  // namespace
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        fprintf(stderr, "Usage: %s [--trackers LIST] [--rates LIST] [--poll-us N] [--duration-s N] [--step-us N] [--hid-wake loop|poll|notify] [--hid-period-us N] [--hid-format legacy|compact] [--iterations N] [--no-micro | --micro-only] [--output FILE]\n", argv[0]);
+        return 2;
+    }
+
+    std::ofstream file;
+    if (!options.outputPath.empty()) {
+        file.open(options.outputPath);
+        if (!file) {
+            fprintf(stderr, "Couldn't open %s\n", options.outputPath.c_str());
+            return 1;
+        }
+    }
+    std::ostream &out = options.outputPath.empty() ? std::cout : file;
+
+    Simulation::setSeed(1);
+    Bench bench(options, out);
+    if (!bench.begin()) {
+        fprintf(stderr, "ESPNowCommunication::begin() failed\n");
+        return 1;
+    }
+
+    if (options.pipeline) {
+        for (size_t trackerCount : options.trackerCounts) {
+            for (uint32_t rateHz : options.ratesHz) {
+                bench.runPipeline(trackerCount, rateHz);
+                out.flush();
+            }
+        }
+    }
+    if (options.micro) {
+        bench.runMicro();
+    }
+    return 0;
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+// Host-side reader for the framed dumps produced by the "capture dump"
+// console command. The format is described in espnow/PacketCapture.h.
+// Bytes outside valid frames (console text, corrupted frames) are skipped
+// and counted.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace CaptureDump {
+constexpr uint8_t frameMagic[2] = {0xA5, 0x5C};
+constexpr size_t frameHeaderSize = 5;
+constexpr size_t frameCrcSize = 2;
+constexpr size_t maxFramePayload = 1024;
+
+constexpr uint8_t frameTypeHeader = 1;
+constexpr uint8_t frameTypeRecord = 2;
+constexpr uint8_t frameTypeEnd = 3;
+
+constexpr size_t headerFrameSize = 18;
+constexpr size_t recordHeaderSize = 18;
+
+struct Header {
+    uint8_t version = 0;
+    uint8_t channel = 0;
+    uint16_t snapLength = 0;
+    uint32_t recordCount = 0;
+    uint32_t overwrittenCount = 0;
+    uint8_t dongleMac[6] = {};
+};
+
+struct Packet {
+    uint64_t timestampUs;
+    uint8_t mac[6];
+    int8_t rssi;
+    uint8_t channel;
+    uint8_t length;
+    std::vector<uint8_t> payload;
+};
+
+struct Capture {
+    bool hasHeader = false;
+    bool hasEnd = false;
+    Header header;
+    std::vector<Packet> packets;
+    size_t skippedBytes = 0;
+    size_t badFrames = 0;
+};
+
+inline uint16_t crc16(const uint8_t *data, size_t len) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= static_cast<uint16_t>(data[i]) << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+inline uint16_t readLe16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+inline uint32_t readLe32(const uint8_t *p) {
+    return readLe16(p) | (static_cast<uint32_t>(readLe16(p + 2)) << 16);
+}
+
+inline uint64_t readLe64(const uint8_t *p) {
+    return readLe32(p) | (static_cast<uint64_t>(readLe32(p + 4)) << 32);
+}
+
+inline void parseFrame(Capture &capture, uint8_t type, const uint8_t *payload, size_t len) {
+    switch (type) {
+    case frameTypeHeader:
+        if (len < headerFrameSize) {
+            capture.badFrames++;
+            return;
+        }
+        capture.hasHeader = true;
+        capture.header.version = payload[0];
+        capture.header.channel = payload[1];
+        capture.header.snapLength = readLe16(&payload[2]);
+        capture.header.recordCount = readLe32(&payload[4]);
+        capture.header.overwrittenCount = readLe32(&payload[8]);
+        memcpy(capture.header.dongleMac, &payload[12], 6);
+        return;
+    case frameTypeRecord: {
+        if (len < recordHeaderSize || len != recordHeaderSize + payload[17]) {
+            capture.badFrames++;
+            return;
+        }
+        Packet packet;
+        packet.timestampUs = readLe64(&payload[0]);
+        memcpy(packet.mac, &payload[8], 6);
+        packet.rssi = static_cast<int8_t>(payload[14]);
+        packet.channel = payload[15];
+        packet.length = payload[16];
+        packet.payload.assign(payload + recordHeaderSize, payload + len);
+        capture.packets.push_back(std::move(packet));
+        return;
+    }
+    case frameTypeEnd:
+        capture.hasEnd = true;
+        return;
+    default:
+        capture.badFrames++;
+        return;
+    }
+}
+
+inline Capture parse(const std::vector<uint8_t> &data) {
+    Capture capture;
+    size_t pos = 0;
+    while (pos + frameHeaderSize + frameCrcSize <= data.size()) {
+        if (data[pos] != frameMagic[0] || data[pos + 1] != frameMagic[1]) {
+            pos++;
+            capture.skippedBytes++;
+            continue;
+        }
+
+        size_t len = readLe16(&data[pos + 3]);
+        size_t frameSize = frameHeaderSize + len + frameCrcSize;
+        if (len > maxFramePayload || pos + frameSize > data.size()
+            || crc16(&data[pos + 2], 3 + len) != readLe16(&data[pos + frameHeaderSize + len])) {
+            // Not a frame after all, or a damaged one; resync on the next byte
+            pos++;
+            capture.skippedBytes++;
+            continue;
+        }
+
+        parseFrame(capture, data[pos + 2], &data[pos + frameHeaderSize], len);
+        pos += frameSize;
+    }
+    capture.skippedBytes += data.size() - pos;
+    return capture;
+}
+
+// Text traces are plain ASCII, so any frame magic means a dump
+inline bool looksLikeDump(const std::vector<uint8_t> &data) {
+    for (size_t i = 0; i + 1 < data.size(); i++) {
+        if (data[i] == frameMagic[0] && data[i + 1] == frameMagic[1]) {
+            return true;
+        }
+    }
+    return false;
+}
+}  // namespace CaptureDump
@@ -0,0 +1,202 @@
+// Runs the dongle core and a set of simulated trackers on a shared radio
+// channel (see RadioChannel.h) and reports, per tracker, how many reports
+// got through, how late and how many were lost, so rate and heartbeat policy
+// changes can be compared before they reach a venue.
+//
+// Build: pio run -e native_channel   (the binary is .pio/build/native_channel/program)
+//
+// Usage: program [options]
+//
+//   --trackers N            number of trackers, default 16
+//   --rssi NEAR:FAR         link RSSI range, spread evenly over the trackers, default -40:-75
+//   --fading-db N           standard deviation of per-frame fading, default 3
+//   --retry-limit N         MAC retransmissions per unicast frame, default 7
+//   --initial-rate-hz N     report rate until a TRACKER_RATE arrives, default 100
+//   --ignore-rate-updates   keep the initial rate, for comparing against the dongle's policy
+//   --warmup-s N            simulated time before measuring, default 2
+//   --duration-s N          simulated time measured, default 10
+//   --step-us N             main loop period, default 100
+//   --poll-us N             HID polling interval, default 1000
+//   --seed N                random seed, default 1
+//   --output FILE           write the results to FILE instead of stdout
+//
+// Output is one JSON object per tracker followed by a summary of the channel
+// and the dongle. The trackers are TrackerEmulators, paired up front and
+// powered on at random times during the first half second.
+
+#include "espnow/espnow.h"
+#include "packetHandling.h"
+#include "StatusManager.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "Testbed.h"
+
+SlimeVR::Status::StatusManager statusManager;
+
+namespace {
+constexpr uint64_t powerOnSpreadUs = 500000;
+
+struct Options {
+    size_t trackerCount = 16;
+    int nearRssi = -40;
+    int farRssi = -75;
+    double fadingDb = 3.0;
+    uint8_t retryLimit = 7;
+    uint32_t initialRateHz = 100;
+    bool followRateUpdates = true;
+    uint64_t warmupUs = 2000000;
+    uint64_t durationUs = 10000000;
+    uint64_t stepUs = 100;
+    uint64_t pollUs = 1000;
+    uint64_t seed = 1;
+    std::string outputPath;
+};
+
+bool parseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--trackers" && hasValue) {
+            options.trackerCount = strtoul(argv[++i], nullptr, 10);
+            if (options.trackerCount == 0 || options.trackerCount > 200) {
+                return false;
+            }
+        } else if (arg == "--rssi" && hasValue) {
+            if (sscanf(argv[++i], "%d:%d", &options.nearRssi, &options.farRssi) != 2) {
+                return false;
+            }
+        } else if (arg == "--fading-db" && hasValue) {
+            options.fadingDb = atof(argv[++i]);
+        } else if (arg == "--retry-limit" && hasValue) {
+            options.retryLimit = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--initial-rate-hz" && hasValue) {
+            options.initialRateHz = std::max(1UL, strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--ignore-rate-updates") {
+            options.followRateUpdates = false;
+        } else if (arg == "--warmup-s" && hasValue) {
+            options.warmupUs = strtoull(argv[++i], nullptr, 10) * 1000000;
+        } else if (arg == "--duration-s" && hasValue) {
+            options.durationUs = std::max(1ULL, strtoull(argv[++i], nullptr, 10)) * 1000000;
+        } else if (arg == "--step-us" && hasValue) {
+            options.stepUs = std::max(1ULL, strtoull(argv[++i], nullptr, 10));
+        } else if (arg == "--poll-us" && hasValue) {
+            options.pollUs = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--seed" && hasValue) {
+            options.seed = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--output" && hasValue) {
+            options.outputPath = argv[++i];
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t percentile(std::vector<uint32_t> values, double fraction) {
+    if (values.empty()) {
+        return 0;
+    }
+    size_t index = static_cast<size_t>(fraction * (values.size() - 1) + 0.5);
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+std::string formatMac(const uint8_t mac[6]) {
+    char buf[18];
+    snprintf(buf, sizeof(buf), "%02x:%02x:%02x:%02x:%02x:%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    return buf;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        fprintf(stderr, "Usage: %s [--trackers N] [--rssi NEAR:FAR] [--fading-db N] [--retry-limit N] [--initial-rate-hz N] [--ignore-rate-updates] [--warmup-s N] [--duration-s N] [--step-us N] [--poll-us N] [--seed N] [--output FILE]\n", argv[0]);
+        return 2;
+    }
+
+    std::ofstream file;
+    if (!options.outputPath.empty()) {
+        file.open(options.outputPath);
+        if (!file) {
+            fprintf(stderr, "Couldn't open %s\n", options.outputPath.c_str());
+            return 1;
+        }
+    }
+    std::ostream &out = options.outputPath.empty() ? std::cout : file;
+
+    Testbed::Config config;
+    config.channel.fadingDb = options.fadingDb;
+    config.channel.retryLimit = options.retryLimit;
+    config.channel.seed = options.seed;
+    config.tracker.initialRateHz = options.initialRateHz;
+    config.tracker.followRateUpdates = options.followRateUpdates;
+    config.stepUs = options.stepUs;
+    config.pollUs = options.pollUs;
+    config.seed = options.seed;
+
+    Testbed testbed(config);
+    if (!testbed.begin()) {
+        fprintf(stderr, "ESPNowCommunication::begin() failed\n");
+        return 1;
+    }
+
+    RadioChannel &channel = testbed.getChannel();
+    size_t dongleStation = testbed.getDongleStation();
+    testbed.addTrackers(options.trackerCount, true);
+    for (size_t i = 0; i < options.trackerCount; i++) {
+        int rssi = options.trackerCount > 1 ? options.nearRssi + static_cast<int>((options.farRssi - options.nearRssi) * static_cast<int64_t>(i) / static_cast<int64_t>(options.trackerCount - 1)) : options.nearRssi;
+        channel.setLinkRssi(dongleStation, testbed.getTracker(i).getStation(), rssi);
+    }
+    testbed.powerOnAll(powerOnSpreadUs);
+
+    testbed.runFor(options.warmupUs);
+    testbed.resetStats();
+    uint64_t dongleFramesAtStart = testbed.getDongleFramesSent();
+    uint64_t dongleDisconnectsAtStart = testbed.getDongleDisconnects();
+    testbed.runFor(options.durationUs);
+
+    auto &espnow = ESPNowCommunication::getInstance();
+    auto &packetHandling = PacketHandling::getInstance();
+    double seconds = options.durationUs / 1e6;
+    uint64_t totalSent = 0;
+    uint64_t totalReceived = 0;
+    uint64_t totalHid = 0;
+    for (size_t i = 0; i < testbed.getTrackerCount(); i++) {
+        const TrackerEmulator &tracker = testbed.getTracker(i);
+        const TrackerEmulator::Stats &stats = tracker.getStats();
+        const RadioChannel::StationStats &radio = channel.getStats(tracker.getStation());
+        totalSent += stats.reportsSent;
+        totalReceived += stats.reportsReceived;
+        totalHid += stats.hidReports;
+
+        out << "{\"tracker\":" << i << ",\"mac\":\"" << formatMac(tracker.getMac()) << "\",\"trackerId\":" << static_cast<int>(tracker.getTrackerId())
+            << ",\"rssi\":" << static_cast<int>(channel.getLinkRssi(dongleStation, tracker.getStation())) << ",\"rateHz\":" << tracker.getRateHz()
+            << ",\"reportsSent\":" << stats.reportsSent << ",\"receivedPps\":" << stats.reportsReceived / seconds << ",\"hidPps\":" << stats.hidReports / seconds
+            << ",\"radioLoss\":" << (stats.reportsSent != 0 ? 1.0 - static_cast<double>(stats.reportsReceived) / stats.reportsSent : 0.0)
+            << ",\"radioLatencyUs\":{\"p50\":" << percentile(stats.radioLatencyUs, 0.5) << ",\"p99\":" << percentile(stats.radioLatencyUs, 0.99) << "}"
+            << ",\"hidAgeUs\":{\"p50\":" << percentile(stats.hidAgeUs, 0.5) << ",\"p99\":" << percentile(stats.hidAgeUs, 0.99) << "}"
+            << ",\"attempts\":" << radio.attempts << ",\"collisions\":" << radio.collisions << ",\"faded\":" << radio.faded
+            << ",\"retryDrops\":" << radio.retryDrops << ",\"queueDrops\":" << radio.queueDrops
+            << ",\"rateUpdates\":" << stats.rateUpdates << ",\"disconnects\":" << stats.disconnects << "}\n";
+    }
+
+    const RadioChannel::ChannelStats &channelStats = channel.getChannelStats();
+    const RadioChannel::StationStats &dongleRadio = channel.getStats(dongleStation);
+    const PacketHandling::Stats &pipelineStats = packetHandling.getStats();
+    out << "{\"summary\":true,\"trackers\":" << testbed.getTrackerCount() << ",\"durationS\":" << seconds
+        << ",\"channelUtilization\":" << channelStats.busyUs / static_cast<double>(options.durationUs)
+        << ",\"transmissions\":" << channelStats.transmissions << ",\"collisions\":" << channelStats.collisions
+        << ",\"reportsSentPps\":" << totalSent / seconds << ",\"receivedPps\":" << totalReceived / seconds << ",\"hidPps\":" << totalHid / seconds
+        << ",\"radioLoss\":" << (totalSent != 0 ? 1.0 - static_cast<double>(totalReceived) / totalSent : 0.0)
+        << ",\"dongleFramesSent\":" << testbed.getDongleFramesSent() - dongleFramesAtStart << ",\"dongleRetryDrops\":" << dongleRadio.retryDrops
+        << ",\"dongleQueueDrops\":" << dongleRadio.queueDrops << ",\"dongleDisconnects\":" << testbed.getDongleDisconnects() - dongleDisconnectsAtStart
+        << ",\"sendQueueFull\":" << espnow.getStats().sendQueueFull << ",\"fifoDrops\":" << pipelineStats.droppedReports
+        << ",\"dedupOverwrites\":" << pipelineStats.overwrittenReports << "}\n";
+    return 0;
+}
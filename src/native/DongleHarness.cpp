@@ -0,0 +1,82 @@
+#include "DongleHarness.h"
+
+#include "configuration.h"
+#include "espnow/espnow.h"
+#include "espnow/messages.h"
+#include "packetHandling.h"
+
+DongleHarness::DongleHarness() {
+    Simulation::hooks().onRadioSend = [this](const Simulation::SentFrame &frame) { handleSentFrame(frame); };
+}
+
+DongleHarness::~DongleHarness() {
+    Simulation::hooks().onRadioSend = nullptr;
+}
+
+bool DongleHarness::begin() {
+    auto &espnow = ESPNowCommunication::getInstance();
+
+    Configuration::getInstance().setup();
+    PacketHandling::getInstance().begin();
+    if (espnow.begin() != ErrorCodes::NO_ERROR) {
+        return false;
+    }
+
+    // The parts of main.cpp's setup() that feed the HID pipeline
+    espnow.onTrackerConnected([](const uint8_t *trackerMacAddress) {
+        uint8_t packet[16];
+        packet[0] = 0xff;
+        packet[1] = Configuration::getInstance().getTrackerIdForMac(trackerMacAddress);
+        memcpy(&packet[2], trackerMacAddress, 6);
+        memset(&packet[8], 0, 8);
+        PacketHandling::getInstance().insert(packet, 16);
+    });
+
+    espnow.onTrackerDisconnected([](uint8_t trackerId) {
+        PacketHandling::getInstance().sendDisconnectionStatus(trackerId);
+    });
+    return true;
+}
+
+void DongleHarness::pairTracker(const uint8_t mac[6]) {
+    Configuration::getInstance().addPairedTracker(mac);
+}
+
+void DongleHarness::connectTracker(const uint8_t mac[6], int8_t rssi) {
+    if (!Configuration::getInstance().isPairedTracker(mac)) {
+        pairTracker(mac);
+    }
+
+    ESPNowConnectionMessage handshake;
+    memcpy(handshake.securityBytes, ESPNowCommunication::getInstance().securityCode, sizeof(handshake.securityBytes));
+    Simulation::deliverFrame(mac, rssi, reinterpret_cast<const uint8_t *>(&handshake), sizeof(handshake));
+}
+
+void DongleHarness::deliverDueReplies() {
+    uint64_t now = Simulation::getTimeUs();
+    while (!pendingReplies.empty() && pendingReplies.begin()->first <= now) {
+        Reply reply = std::move(pendingReplies.begin()->second);
+        pendingReplies.erase(pendingReplies.begin());
+        Simulation::deliverFrame(reply.mac, 0, reply.data.data(), reply.data.size());
+    }
+}
+
+void DongleHarness::handleSentFrame(const Simulation::SentFrame &frame) {
+    if (onRadioSend) {
+        onRadioSend(frame);
+    }
+
+    if (!answerHeartbeats || frame.data.size() < sizeof(ESPNowHeartbeatEchoMessage) || frame.data[0] != static_cast<uint8_t>(ESPNowMessageTypes::HEARTBEAT_ECHO)) {
+        return;
+    }
+
+    ESPNowHeartbeatEchoMessage echo;
+    memcpy(&echo, frame.data.data(), sizeof(echo));
+    ESPNowHeartbeatResponseMessage response;
+    response.sequenceNumber = echo.sequenceNumber;
+
+    Reply reply;
+    memcpy(reply.mac, frame.mac, sizeof(reply.mac));
+    reply.data.assign(reinterpret_cast<const uint8_t *>(&response), reinterpret_cast<const uint8_t *>(&response) + sizeof(response));
+    pendingReplies.emplace(frame.timeUs + heartbeatReplyUs, std::move(reply));
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+// Brings the dongle core up on the native HAL the way main.cpp's setup() does
+// and plays the part of well-behaved trackers: it pairs and connects them and
+// answers heartbeats. The host programs in src/native drive the main loop
+// themselves and call into the harness where they need a tracker's side.
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <vector>
+
+#include "hal/native/Simulation.h"
+
+class DongleHarness {
+public:
+    // Simulated heartbeat round trip
+    static constexpr uint64_t defaultHeartbeatReplyUs = 2000;
+
+    // Takes over Simulation::hooks().onRadioSend, frames the dongle sends are
+    // passed on to onRadioSend below
+    DongleHarness();
+    ~DongleHarness();
+
+    // Sets up the configuration and ESP-NOW and wires the same callbacks as
+    // main.cpp, returns false if ESPNowCommunication::begin() failed
+    bool begin();
+
+    void pairTracker(const uint8_t mac[6]);
+
+    // Pairs the tracker if needed and delivers a valid handshake from it
+    void connectTracker(const uint8_t mac[6], int8_t rssi = 0);
+
+    // Delivers the heartbeat responses that are due by now
+    void deliverDueReplies();
+
+    // Clears pending heartbeat responses, e.g. after disconnecting trackers
+    void clearPendingReplies() { pendingReplies.clear(); }
+
+    bool answerHeartbeats = true;
+    uint64_t heartbeatReplyUs = defaultHeartbeatReplyUs;
+    std::function<void(const Simulation::SentFrame &)> onRadioSend;
+
+private:
+    struct Reply {
+        uint8_t mac[6];
+        std::vector<uint8_t> data;
+    };
+
+    void handleSentFrame(const Simulation::SentFrame &frame);
+
+    // Heartbeat responses by delivery time, in the order the echoes were sent
+    std::multimap<uint64_t, Reply> pendingReplies;
+};
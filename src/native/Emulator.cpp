@@ -0,0 +1,236 @@
+// Load scenarios for the dongle core, played by emulated trackers (see
+// TrackerEmulator.h) on the simulated channel. Each scenario sets up a
+// situation, checks how the dongle comes out of it and prints PASS or FAIL
+// with what it measured.
+//
+// Build: pio run -e native_emulator   (the binary is .pio/build/native_emulator/program)
+//
+// Usage: program [options] <scenario|all> [trackers]
+//
+//   --rssi N      link RSSI of every tracker, default -50
+//   --seed N      random seed, default 1
+//   --list        list the scenarios
+//
+// Exits with 1 if any scenario failed. "program reconnect 40" runs 40
+// trackers through a dongle reboot.
+
+#include "espnow/espnow.h"
+#include "StatusManager.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "Testbed.h"
+
+SlimeVR::Status::StatusManager statusManager;
+
+namespace {
+constexpr uint64_t secondUs = 1000000;
+
+using State = TrackerEmulator::State;
+
+struct Options {
+    std::string scenario;
+    size_t trackerCount = 16;
+    int8_t rssi = -50;
+    uint64_t seed = 1;
+};
+
+struct Result {
+    bool passed;
+    std::string detail;
+};
+
+std::string format(const char *format, ...) __attribute__((format(printf, 1, 2)));
+std::string format(const char *format, ...) {
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    return buffer;
+}
+
+double secondsSince(uint64_t startUs) {
+    return (Simulation::getTimeUs() - startUs) / 1e6;
+}
+
+// Paired trackers, powered on within half a second, all connected
+bool connectAll(Testbed &testbed, size_t count) {
+    testbed.addTrackers(count, true);
+    testbed.powerOnAll(secondUs / 2);
+    return testbed.runUntil([&] { return testbed.countTrackers(State::CONNECTED) == count && testbed.getDongleConnectedCount() == count; }, 10 * secondUs);
+}
+
+Result connectFailure(Testbed &testbed, size_t count) {
+    return {false, format("only %zu of %zu trackers connected (dongle sees %zu)", testbed.countTrackers(State::CONNECTED), count, testbed.getDongleConnectedCount())};
+}
+
+Result pairScenario(Testbed &testbed, size_t count) {
+    auto &espnow = ESPNowCommunication::getInstance();
+    testbed.addTrackers(count, false);
+    testbed.powerOnAll(secondUs / 2);
+    espnow.enterPairingMode();
+    uint64_t startUs = Simulation::getTimeUs();
+    bool connected = testbed.runUntil([&] { return testbed.countTrackers(State::CONNECTED) == count; }, 20 * secondUs);
+    espnow.exitPairingMode();
+    if (!connected) {
+        return {false, format("%zu of %zu trackers paired, %zu connected", count - testbed.countTrackers(State::UNPAIRED), count, testbed.countTrackers(State::CONNECTED))};
+    }
+    return {true, format("all paired and connected in %.2f s", secondsSince(startUs))};
+}
+
+Result streamScenario(Testbed &testbed, size_t count) {
+    if (!connectAll(testbed, count)) {
+        return connectFailure(testbed, count);
+    }
+    // Rate updates go out at most once a second
+    testbed.runFor(2 * secondUs);
+    testbed.resetStats();
+    testbed.runFor(5 * secondUs);
+
+    uint32_t expectedRateHz = ESPNowCommunication::maxPPS / count;
+    size_t wrongRate = 0;
+    size_t silent = 0;
+    uint64_t hidReports = 0;
+    for (size_t i = 0; i < count; i++) {
+        const TrackerEmulator &tracker = testbed.getTracker(i);
+        wrongRate += tracker.getRateHz() != expectedRateHz;
+        silent += tracker.getStats().hidReports == 0;
+        hidReports += tracker.getStats().hidReports;
+    }
+    std::string detail = format("%.0f reports/s reach the host, %zu trackers not at %u Hz, %zu silent", hidReports / 5.0, wrongRate, expectedRateHz, silent);
+    return {wrongRate == 0 && silent == 0, detail};
+}
+
+Result reconnectScenario(Testbed &testbed, size_t count) {
+    if (!connectAll(testbed, count)) {
+        return connectFailure(testbed, count);
+    }
+    testbed.rebootDongle(secondUs / 2);
+    uint64_t startUs = Simulation::getTimeUs();
+    bool reconnected = testbed.runUntil([&] {
+        return testbed.getDongleConnectedCount() == count && testbed.countTrackers(State::CONNECTED) == count;
+    }, 30 * secondUs);
+    if (!reconnected) {
+        return {false, format("%zu of %zu trackers back after %.2f s", testbed.getDongleConnectedCount(), count, secondsSince(startUs))};
+    }
+    return {true, format("all reconnected %.2f s after the reboot", secondsSince(startUs))};
+}
+
+Result unpairScenario(Testbed &testbed, size_t count) {
+    if (!connectAll(testbed, count)) {
+        return connectFailure(testbed, count);
+    }
+    ESPNowCommunication::getInstance().sendUnpairToAllTrackers();
+    uint64_t startUs = Simulation::getTimeUs();
+    bool unpaired = testbed.runUntil([&] { return testbed.countTrackers(State::UNPAIRED) == count; }, 5 * secondUs);
+    if (!unpaired) {
+        return {false, format("%zu of %zu trackers unpaired", testbed.countTrackers(State::UNPAIRED), count)};
+    }
+    return {true, format("all unpaired in %.2f s", secondsSince(startUs))};
+}
+
+Result otaScenario(Testbed &testbed, size_t count) {
+    if (!connectAll(testbed, count)) {
+        return connectFailure(testbed, count);
+    }
+    const uint8_t auth[16] = {};
+    const uint8_t ip[4] = {192, 168, 1, 10};
+    ESPNowCommunication::getInstance().startOtaUpdate(auth, 3232, ip, "venue", "password");
+    uint64_t startUs = Simulation::getTimeUs();
+    bool entered = testbed.runUntil([&] { return testbed.countTrackers(State::OTA) == count && testbed.getDongleConnectedCount() == 0; }, 30 * secondUs);
+    if (!entered) {
+        return {false, format("%zu of %zu trackers in OTA mode, dongle still sees %zu", testbed.countTrackers(State::OTA), count, testbed.getDongleConnectedCount())};
+    }
+    return {true, format("all in OTA mode in %.2f s", secondsSince(startUs))};
+}
+
+struct Scenario {
+    const char *name;
+    const char *description;
+    Result (*run)(Testbed &testbed, size_t count);
+};
+
+const Scenario scenarios[] = {
+    {"pair", "unpaired trackers pair while the dongle is in pairing mode", pairScenario},
+    {"stream", "connected trackers settle on the dongle's rate and reach the host", streamScenario},
+    {"reconnect", "connected trackers all reconnect after a dongle reboot", reconnectScenario},
+    {"unpair", "the dongle unpairs every connected tracker", unpairScenario},
+    {"ota", "the dongle sends every connected tracker into OTA mode", otaScenario},
+};
+
+bool parseOptions(int argc, char **argv, Options &options) {
+    bool countGiven = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--rssi" && hasValue) {
+            options.rssi = atoi(argv[++i]);
+        } else if (arg == "--seed" && hasValue) {
+            options.seed = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--list") {
+            for (const Scenario &scenario : scenarios) {
+                printf("%-10s %s\n", scenario.name, scenario.description);
+            }
+            exit(0);
+        } else if (arg[0] != '-' && options.scenario.empty()) {
+            options.scenario = arg;
+        } else if (arg[0] != '-' && !countGiven) {
+            options.trackerCount = strtoul(arg.c_str(), nullptr, 10);
+            countGiven = true;
+            if (options.trackerCount == 0 || options.trackerCount > 200) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    return !options.scenario.empty();
+}
+
+bool runScenario(const Scenario &scenario, const Options &options) {
+    Testbed::Config config;
+    config.channel.defaultRssi = options.rssi;
+    config.channel.seed = options.seed;
+    config.seed = options.seed;
+
+    Testbed testbed(config);
+    if (!testbed.begin()) {
+        printf("FAIL %s: ESPNowCommunication::begin() failed\n", scenario.name);
+        return false;
+    }
+    Result result = scenario.run(testbed, options.trackerCount);
+    printf("%s %s, %zu trackers: %s\n", result.passed ? "PASS" : "FAIL", scenario.name, options.trackerCount, result.detail.c_str());
+    return result.passed;
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        fprintf(stderr, "Usage: %s [--rssi N] [--seed N] [--list] <scenario|all> [trackers]\n", argv[0]);
+        return 2;
+    }
+
+    // The dongle core is made of singletons that can't be reset, so every
+    // scenario gets a process of its own
+    if (options.scenario == "all") {
+        bool passed = true;
+        for (const Scenario &scenario : scenarios) {
+            std::string command = std::string(argv[0]) + " --rssi " + std::to_string(options.rssi) + " --seed " + std::to_string(options.seed) + " " + scenario.name + " " + std::to_string(options.trackerCount);
+            passed &= system(command.c_str()) == 0;
+        }
+        return passed ? 0 : 1;
+    }
+
+    for (const Scenario &scenario : scenarios) {
+        if (options.scenario == scenario.name) {
+            return runScenario(scenario, options) ? 0 : 1;
+        }
+    }
+    fprintf(stderr, "Unknown scenario %s, see --list\n", options.scenario.c_str());
+    return 2;
+}
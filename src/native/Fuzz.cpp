@@ -0,0 +1,337 @@
+// Fuzz target for the dongle's receive path: every input is one ESP-NOW
+// frame handed to ESPNowCommunication as if the radio had received it. Built
+// with -fsanitize=address,undefined, so any read past the frame or into freed
+// trackers aborts with a report.
+//
+// Input layout: byte 0 picks the sender and the dongle's state, the rest is
+// the frame.
+//
+//   bits 0-1   0: a connected tracker, 1: a paired tracker that isn't
+//              connected, 2 and 3: an unknown MAC
+//   bit 2      the dongle is in pairing mode
+//   bit 3      the host picked the compact HID report format, taken from the
+//              frame before each HID tick. The frame's first report also
+//              goes through the compact encoder and decoder on its own.
+//
+// Compact entries must decode to unit quaternions, and compact transfers
+// must be zero after their last entry; anything else aborts.
+//
+// LLVMFuzzerTestOneInput works with libFuzzer (build with clang,
+// -fsanitize=fuzzer and -DSLIMEVR_LIBFUZZER). Without it the built-in driver
+// mutates valid frames of every message type and reports how many it
+// accepted and what each one cost.
+//
+// Build: pio run -e native_fuzz   (the binary is .pio/build/native_fuzz/program)
+//
+// Usage: program [options] [input files]
+//
+//   --iterations N   frames to generate, default 1000000
+//   --seed N         random seed, default 1
+//
+// Input files, e.g. crashes saved by libFuzzer, are run once each instead.
+// A run with the same seed and iteration count generates the same frames.
+
+#include "CompactReport.h"
+#include "espnow/espnow.h"
+#include "espnow/messages.h"
+#include "logging/Logger.h"
+#include "packetHandling.h"
+#include "StatusManager.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "DongleHarness.h"
+#include "hal/native/Simulation.h"
+
+SlimeVR::Status::StatusManager statusManager;
+
+namespace {
+constexpr uint64_t startTimeUs = 1000000;
+constexpr size_t framesPerLoop = 256;  // Frames delivered between main loop iterations
+constexpr uint64_t loopUs = 1000;
+
+constexpr uint8_t connectedMac[6] = {0x02, 0x46, 0x55, 0x5a, 0x00, 0x01};
+constexpr uint8_t pairedMac[6] = {0x02, 0x46, 0x55, 0x5a, 0x00, 0x02};
+constexpr uint8_t unknownMac[6] = {0x02, 0x46, 0x55, 0x5a, 0x00, 0x03};
+
+class FuzzTarget {
+public:
+    FuzzTarget() : hidEndpoint(loopUs) {
+        Simulation::setTimeUs(startTimeUs);
+        harness.begin();
+        harness.pairTracker(pairedMac);
+        harness.connectTracker(connectedMac);
+        Simulation::hooks().onHidReport = [](uint64_t timeUs, uint8_t interface, const uint8_t *data, size_t len) { checkTransfer(data, len); };
+    }
+
+    void run(const uint8_t *data, size_t size) {
+        if (size == 0) {
+            return;
+        }
+        auto &espnow = ESPNowCommunication::getInstance();
+        if (!espnow.isTrackerConnected(connectedMac)) {
+            harness.connectTracker(connectedMac);
+        }
+        bool pairing = data[0] & 0x04;
+        if (pairing != espnow.isInPairingMode()) {
+            pairing ? espnow.enterPairingMode() : espnow.exitPairingMode();
+        }
+
+        const uint8_t *mac = (data[0] & 0x03) == 0 ? connectedMac : (data[0] & 0x03) == 1 ? pairedMac : unknownMac;
+        Simulation::deliverFrame(mac, -50, &data[1], size - 1);
+
+        // The TRACKER_DATA header is 2 bytes
+        if ((data[0] & 0x08) && size >= 3 + CompactReport::legacyReportSize && CompactReport::canEncode(&data[3])) {
+            uint8_t entry[CompactReport::entrySize];
+            CompactReport::encode(&data[3], entry);
+            checkEntry(entry, &data[3], CompactReport::legacyReportSize);
+        }
+
+        if (++frames % framesPerLoop == 0) {
+            Simulation::advanceUs(loopUs);
+            harness.deliverDueReplies();
+            espnow.update();
+            espnow.dispatchEvents();
+            PacketHandling::getInstance().setReportFormat(data[0] & 0x08 ? PacketHandling::ReportFormat::COMPACT : PacketHandling::ReportFormat::LEGACY);
+            PacketHandling::getInstance().tick(hidEndpoint);
+            Serial.pump();
+            SlimeVR::Logging::LogBackend::getInstance().drain(SIZE_MAX);
+        }
+    }
+
+private:
+    static void checkTransfer(const uint8_t *data, size_t len) {
+        if (!CompactReport::isCompactTransfer(data)) {
+            return;
+        }
+        size_t count = CompactReport::entryCount(data);
+        if (len != CompactReport::transferSize || count > CompactReport::entriesPerTransfer) {
+            fail("Malformed compact transfer", data, len);
+        }
+        for (size_t i = 0; i < count; i++) {
+            checkEntry(CompactReport::entryAt(data, i), data, len);
+        }
+        for (size_t i = 1 + count * CompactReport::entrySize; i < len; i++) {
+            if (data[i] != 0) {
+                fail("Compact transfer not zero after its last entry", data, len);
+            }
+        }
+    }
+
+    // Aborts with context if the entry's quaternion doesn't decode to unit
+    // length
+    static void checkEntry(const uint8_t *entry, const uint8_t *context, size_t contextLen) {
+        uint8_t report[CompactReport::legacyReportSize];
+        CompactReport::decode(entry, report);
+        float lengthSquared = 0;
+        for (size_t c = 0; c < 4; c++) {
+            float component = CompactReport::readInt16(&report[2 + 2 * c]) / CompactReport::quaternionScale;
+            lengthSquared += component * component;
+        }
+        if (std::fabs(lengthSquared - 1.0f) >= 0.001f) {
+            fail("Compact entry isn't a unit quaternion", context, contextLen);
+        }
+    }
+
+    static void fail(const char *what, const uint8_t *data, size_t len) {
+        fprintf(stderr, "%s:", what);
+        for (size_t i = 0; i < len; i++) {
+            fprintf(stderr, " %02x", data[i]);
+        }
+        fprintf(stderr, "\n");
+        abort();
+    }
+
+    DongleHarness harness;
+    Simulation::HidEndpoint hidEndpoint;
+    uint64_t frames = 0;
+};
+
+FuzzTarget &target() {
+    static FuzzTarget instance;
+    return instance;
+}
+}  // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    target().run(data, size);
+    return 0;
+}
+
+#ifndef SLIMEVR_LIBFUZZER
+namespace {
+using Input = std::vector<uint8_t>;
+
+template <typename Message>
+Input seedInput(const Message &message) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&message);
+    Input input = {0};
+    input.insert(input.end(), bytes, bytes + sizeof(message));
+    return input;
+}
+
+// One valid frame of every type, as the trackers or the dongle would send it,
+// and rotation reports from several trackers
+std::vector<Input> seedCorpus() {
+    const uint8_t *securityCode = ESPNowCommunication::getInstance().securityCode;
+    std::vector<Input> corpus;
+
+    ESPNowPairingMessage pairing;
+    memcpy(pairing.securityBytes, securityCode, sizeof(pairing.securityBytes));
+    corpus.push_back(seedInput(pairing));
+    corpus.push_back(seedInput(ESPNowPairingAckMessage()));
+    ESPNowConnectionMessage connection;
+    memcpy(connection.securityBytes, securityCode, sizeof(connection.securityBytes));
+    corpus.push_back(seedInput(connection));
+    corpus.push_back(seedInput(ESPNowConnectionAckMessage()));
+    corpus.push_back(seedInput(ESPNowHeartbeatEchoMessage()));
+    corpus.push_back(seedInput(ESPNowHeartbeatResponseMessage()));
+
+    // The selector byte, the TRACKER_DATA header and one report
+    Input data = {0, static_cast<uint8_t>(ESPNowMessageTypes::TRACKER_DATA), 16, 1, 0};
+    data.resize(3 + 16);
+    corpus.push_back(data);
+    // Rotations the compact format encodes, from as many trackers as a
+    // compact transfer holds and more. Dedup keeps one report per tracker,
+    // so compact transfers only form from several trackers' reports.
+    for (uint8_t trackerId = 0; trackerId < 2 * CompactReport::entriesPerTransfer; trackerId++) {
+        float angle = 0.4f * trackerId;
+        int16_t rotation[4] = {static_cast<int16_t>(std::lround(std::sin(angle / 2) * 32767)), 0, 0, static_cast<int16_t>(std::lround(std::cos(angle / 2) * 32767))};
+        int16_t accel[3] = {static_cast<int16_t>(100 * trackerId), -200, 4096};
+        data[0] = 0x08;
+        data[4] = trackerId;
+        for (size_t i = 0; i < 4; i++) {
+            CompactReport::writeInt16(&data[5 + 2 * i], rotation[i]);
+        }
+        for (size_t i = 0; i < 3; i++) {
+            CompactReport::writeInt16(&data[13 + 2 * i], accel[i]);
+        }
+        corpus.push_back(data);
+    }
+    data = {0, static_cast<uint8_t>(ESPNowMessageTypes::TRACKER_DATA), ESPNowCommunication::packetSizeBytes};
+    data.resize(1 + sizeof(ESPNowPacketMessage));
+    corpus.push_back(data);
+
+    corpus.push_back(seedInput(ESPNowPairingAnnouncementMessage()));
+    corpus.push_back(seedInput(ESPNowUnpairMessage()));
+    corpus.push_back(seedInput(ESPNowTrackerRateMessage()));
+    corpus.push_back(seedInput(ESPNowEnterOtaModeMessage()));
+    corpus.push_back(seedInput(ESPNowEnterOtaAckMessage()));
+    return corpus;
+}
+
+// A few random edits of a seed: flipped bits, random bytes, a different
+// length, header, TRACKER_DATA length byte or tracker ID of its first report
+Input mutate(const Input &seed, std::mt19937_64 &random) {
+    Input input = seed;
+    input[0] = random();
+    size_t edits = 1 + random() % 4;
+    for (size_t i = 0; i < edits; i++) {
+        switch (random() % 7) {
+        case 0:
+            if (input.size() > 1) {
+                input[1 + random() % (input.size() - 1)] ^= 1 << (random() % 8);
+            }
+            break;
+        case 1:
+            if (input.size() > 1) {
+                input[1 + random() % (input.size() - 1)] = random();
+            }
+            break;
+        case 2:
+            input.resize(1 + random() % (SlimeVR::Hal::Radio::maxPayloadLength + 1));
+            break;
+        case 3:
+            input.resize(input.size() + random() % 8, random());
+            break;
+        case 4:
+            if (input.size() > 1) {
+                input[1] = random() % (espnowMessageTypeCount + 2);
+            }
+            break;
+        case 5:
+            if (input.size() > 2) {
+                input[2] = random();
+            }
+            break;
+        default:
+            if (input.size() > 4) {
+                input[4] = random();
+            }
+            break;
+        }
+    }
+    return input;
+}
+
+bool readFile(const char *path, Input &input) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    input.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+    uint64_t iterations = 1000000;
+    uint64_t seed = 1;
+    std::vector<const char *> files;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--iterations" && hasValue) {
+            iterations = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--seed" && hasValue) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else if (arg[0] != '-') {
+            files.push_back(argv[i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--iterations N] [--seed N] [input files]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Simulation::setSeed(seed);
+    target();
+
+    if (!files.empty()) {
+        for (const char *path : files) {
+            Input input;
+            if (!readFile(path, input)) {
+                fprintf(stderr, "Can't read %s\n", path);
+                return 1;
+            }
+            LLVMFuzzerTestOneInput(input.data(), input.size());
+            printf("%s: OK\n", path);
+        }
+        return 0;
+    }
+
+    std::vector<Input> corpus = seedCorpus();
+    std::mt19937_64 random(seed);
+    auto &espnow = ESPNowCommunication::getInstance();
+    espnow.resetStats();
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < iterations; i++) {
+        Input input = mutate(corpus[random() % corpus.size()], random);
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+    double elapsedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    uint32_t malformed = espnow.getStats().malformedFrames;
+    printf("%llu frames, %u rejected as malformed, %lu compact HID transfers, %.0f ns per frame\n", static_cast<unsigned long long>(iterations), malformed,
+           static_cast<unsigned long>(PacketHandling::getInstance().getStats().compactTransfers), iterations ? elapsedNs / iterations : 0.0);
+    return 0;
+}
+#endif
@@ -0,0 +1,268 @@
+#include "RadioChannel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+constexpr RadioChannel::PhyRate RadioChannel::dsss1Mbps;
+constexpr RadioChannel::PhyRate RadioChannel::ofdm24Mbps;
+constexpr RadioChannel::PhyRate RadioChannel::ht20Mcs7Sgi;
+
+RadioChannel::RadioChannel(const Config &config) : config(config), rngState(config.seed != 0 ? config.seed : 1) {}
+
+size_t RadioChannel::addStation(const uint8_t mac[6], const PhyRate &rate, ReceiveHandler handler) {
+    Station station;
+    memcpy(station.mac.data(), mac, 6);
+    station.rate = &rate;
+    station.handler = std::move(handler);
+    station.cw = config.cwMin;
+    stations.push_back(std::move(station));
+    return stations.size() - 1;
+}
+
+void RadioChannel::setLinkRssi(size_t a, size_t b, int8_t rssi) {
+    linkRssi[std::minmax(a, b)] = rssi;
+}
+
+int8_t RadioChannel::getLinkRssi(size_t a, size_t b) const {
+    auto it = linkRssi.find(std::minmax(a, b));
+    return it != linkRssi.end() ? it->second : config.defaultRssi;
+}
+
+bool RadioChannel::send(size_t station, const uint8_t dstMac[6], const uint8_t *data, size_t len, uint64_t timeUs) {
+    return send(station, dstMac, data, len, timeUs, *stations[station].rate);
+}
+
+bool RadioChannel::send(size_t station, const uint8_t dstMac[6], const uint8_t *data, size_t len, uint64_t timeUs, const PhyRate &rate) {
+    Station &sender = stations[station];
+    if (sender.queue.size() >= config.queueLimit) {
+        sender.stats.queueDrops++;
+        return false;
+    }
+
+    Frame frame;
+    memcpy(frame.dstMac.data(), dstMac, 6);
+    frame.data.assign(data, data + len);
+    frame.rate = &rate;
+    frame.arrivalUs = timeUs;
+    sender.queue.push_back(std::move(frame));
+    sender.stats.queued++;
+
+    if (sender.queue.size() == 1) {
+        sender.cw = config.cwMin;
+        startBackoff(sender, timeUs);
+    }
+    return true;
+}
+
+void RadioChannel::runUntil(uint64_t timeUs) {
+    std::vector<size_t> transmitters;
+    for (;;) {
+        // Receptions always end before the medium is free again, so anything a
+        // receiver sends in response is queued before the next contention
+        while (!deliveries.empty() && deliveries.begin()->first <= timeUs) {
+            uint64_t deliveryUs = deliveries.begin()->first;
+            Delivery delivery = std::move(deliveries.begin()->second);
+            deliveries.erase(deliveries.begin());
+            Station &receiver = stations[delivery.station];
+            if (receiver.handler) {
+                receiver.handler(delivery.srcMac.data(), delivery.rssi, delivery.data.data(), delivery.data.size(), deliveryUs);
+            }
+        }
+
+        // The station whose backoff ends first takes the medium, every station
+        // ending in the same slot transmits too and collides with it
+        uint64_t startUs = UINT64_MAX;
+        transmitters.clear();
+        for (size_t i = 0; i < stations.size(); i++) {
+            const Station &station = stations[i];
+            if (station.queue.empty()) {
+                continue;
+            }
+            uint64_t endUs = std::max(station.readyUs, idleFromUs) + difsUs() + static_cast<uint64_t>(station.backoffSlots) * config.slotUs;
+            if (endUs < startUs) {
+                startUs = endUs;
+                transmitters.clear();
+            }
+            if (endUs == startUs) {
+                transmitters.push_back(i);
+            }
+        }
+        if (transmitters.empty() || startUs > timeUs) {
+            break;
+        }
+
+        // Everyone else froze their backoff with the slots that went by
+        for (Station &station : stations) {
+            if (station.queue.empty()) {
+                continue;
+            }
+            uint64_t countdownUs = std::max(station.readyUs, idleFromUs) + difsUs();
+            if (countdownUs < startUs) {
+                uint32_t elapsedSlots = (startUs - countdownUs) / config.slotUs;
+                station.backoffSlots -= std::min(station.backoffSlots, elapsedSlots);
+            }
+        }
+
+        resolve(transmitters, startUs);
+    }
+}
+
+void RadioChannel::resetStats() {
+    for (Station &station : stations) {
+        station.stats = StationStats();
+    }
+    channelStats = ChannelStats();
+}
+
+uint32_t RadioChannel::frameAirtimeUs(size_t payloadLen, const PhyRate &rate) {
+    return psduAirtimeUs(payloadLen + espnowOverheadBytes, rate);
+}
+
+uint32_t RadioChannel::psduAirtimeUs(size_t psduBytes, const PhyRate &rate) {
+    constexpr uint32_t serviceAndTailBits = 16 + 6;
+    constexpr uint32_t signalExtensionUs = 6;  // 2.4 GHz OFDM frames are padded for SIFS
+    uint32_t bits = serviceAndTailBits + 8 * psduBytes;
+
+    switch (rate.modulation) {
+    case PhyRate::Modulation::DSSS:
+        return 192 + (8 * psduBytes * 1000 + rate.rateKbps - 1) / rate.rateKbps;
+    case PhyRate::Modulation::OFDM:
+        return 20 + 4 * ((bits + rate.dataBitsPerSymbol - 1) / rate.dataBitsPerSymbol) + signalExtensionUs;
+    case PhyRate::Modulation::HT:
+    default: {
+        // Legacy preamble and L-SIG, HT-SIG, HT-STF and one HT-LTF
+        constexpr uint32_t preambleUs = 20 + 8 + 4 + 4;
+        uint32_t symbols = (bits + rate.dataBitsPerSymbol - 1) / rate.dataBitsPerSymbol;
+        uint32_t symbolsUs = rate.shortGuardInterval ? (symbols * 36 + 9) / 10 : symbols * 4;
+        return preambleUs + symbolsUs + signalExtensionUs;
+    }
+    }
+}
+
+bool RadioChannel::isBroadcast(const std::array<uint8_t, 6> &mac) const {
+    return std::all_of(mac.begin(), mac.end(), [](uint8_t byte) { return byte == 0xff; });
+}
+
+int RadioChannel::findStation(const std::array<uint8_t, 6> &mac) const {
+    for (size_t i = 0; i < stations.size(); i++) {
+        if (stations[i].mac == mac) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+void RadioChannel::startBackoff(Station &station, uint64_t readyUs) {
+    station.readyUs = readyUs;
+    station.backoffSlots = nextRandom() % (static_cast<uint32_t>(station.cw) + 1);
+}
+
+// Drops the head frame and lets the next one contend from timeUs
+void RadioChannel::finishHead(Station &station, uint64_t timeUs) {
+    station.queue.pop_front();
+    station.cw = config.cwMin;
+    if (!station.queue.empty()) {
+        startBackoff(station, std::max(timeUs, station.queue.front().arrivalUs));
+    }
+}
+
+bool RadioChannel::survives(size_t from, size_t to, const PhyRate &rate, int8_t &rssi) {
+    double received = getLinkRssi(from, to) + config.fadingDb * gaussian();
+    rssi = static_cast<int8_t>(std::max(-127.0, std::min(0.0, std::round(received))));
+    double loss = 1.0 / (1.0 + std::exp((received - rate.sensitivityDbm) / config.lossSlopeDb));
+    return uniform() >= loss;
+}
+
+void RadioChannel::resolve(const std::vector<size_t> &transmitters, uint64_t startUs) {
+    bool collision = transmitters.size() > 1;
+    uint64_t busyUntilUs = startUs;
+
+    channelStats.transmissions += transmitters.size();
+    if (collision) {
+        channelStats.collisions++;
+    }
+
+    for (size_t index : transmitters) {
+        Station &sender = stations[index];
+        Frame &frame = sender.queue.front();
+        uint32_t airtimeUs = frameAirtimeUs(frame.data.size(), *frame.rate);
+        uint64_t endUs = startUs + airtimeUs;
+        bool broadcast = isBroadcast(frame.dstMac);
+
+        sender.stats.attempts++;
+        sender.stats.airtimeUs += airtimeUs;
+        // Unicast senders hold the medium until the ACK or its timeout
+        busyUntilUs = std::max(busyUntilUs, endUs + (broadcast ? 0 : config.sifsUs + ackAirtimeUs(*frame.rate)));
+
+        if (collision) {
+            sender.stats.collisions++;
+        }
+
+        if (broadcast) {
+            if (!collision) {
+                for (size_t receiver = 0; receiver < stations.size(); receiver++) {
+                    int8_t rssi;
+                    if (receiver != index && survives(index, receiver, *frame.rate, rssi)) {
+                        deliveries.emplace(endUs, Delivery{receiver, sender.mac, rssi, frame.data});
+                    }
+                }
+                sender.stats.delivered++;
+                sender.stats.latencyUs.push_back(endUs - frame.arrivalUs);
+            }
+            finishHead(sender, endUs);
+            continue;
+        }
+
+        int receiver = findStation(frame.dstMac);
+        int8_t rssi = 0;
+        bool acknowledged = false;
+        if (!collision && receiver >= 0) {
+            acknowledged = survives(index, receiver, *frame.rate, rssi);
+            if (!acknowledged) {
+                sender.stats.faded++;
+            }
+        }
+
+        if (acknowledged) {
+            deliveries.emplace(endUs, Delivery{static_cast<size_t>(receiver), sender.mac, rssi, frame.data});
+            sender.stats.delivered++;
+            sender.stats.latencyUs.push_back(endUs - frame.arrivalUs);
+            finishHead(sender, endUs);
+        } else if (frame.retries >= config.retryLimit) {
+            sender.stats.retryDrops++;
+            finishHead(sender, endUs);
+        } else {
+            frame.retries++;
+            sender.cw = std::min<uint16_t>(sender.cw * 2 + 1, config.cwMax);
+            startBackoff(sender, endUs);
+        }
+    }
+
+    channelStats.busyUs += busyUntilUs - startUs;
+    idleFromUs = busyUntilUs;
+}
+
+uint32_t RadioChannel::ackAirtimeUs(const PhyRate &rate) {
+    return psduAirtimeUs(ackBytes, rate.modulation == PhyRate::Modulation::DSSS ? dsss1Mbps : ofdm24Mbps);
+}
+
+// Box-Muller, one value per call
+double RadioChannel::gaussian() {
+    double u1 = std::max(uniform(), 1e-12);
+    double u2 = uniform();
+    return std::sqrt(-2.0 * std::log(u1)) * std::cos(2.0 * M_PI * u2);
+}
+
+double RadioChannel::uniform() {
+    return nextRandom() / 4294967296.0;
+}
+
+// xorshift64*, separate from the firmware's generator so the channel doesn't
+// change what the firmware draws
+uint32_t RadioChannel::nextRandom() {
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return (rngState * 0x2545F4914F6CDD1DULL) >> 32;
+}
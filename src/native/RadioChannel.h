@@ -0,0 +1,166 @@
+#pragma once
+
+// Discrete-event model of one shared 2.4 GHz channel carrying ESP-NOW frames.
+//
+// Every station has a transmit queue and contends for the medium with
+// 802.11 DCF: the medium must be idle for DIFS, then a random backoff in
+// [0, CW] slots counts down while it stays idle. Stations whose backoff ends
+// in the same slot collide. Unicast frames are acknowledged and retried with
+// a doubled CW up to the retry limit; broadcasts are sent once and each
+// receiver gets them or not on its own. Whether a frame survives depends on
+// the link's RSSI with Gaussian fading against the rate's sensitivity.
+//
+// Simplifications: every station hears every other (no hidden nodes, no
+// capture effect), a new frame always draws a backoff, and the ACK is never
+// lost on its own.
+//
+// The model is evaluated lazily: send() queues a frame with its arrival time
+// and runUntil() resolves everything that happens up to the given time, so
+// frames must not be sent with a time before the last runUntil().
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <vector>
+
+class RadioChannel {
+public:
+    struct PhyRate {
+        enum class Modulation : uint8_t {
+            DSSS,  // 802.11b, long preamble
+            OFDM,  // 802.11g
+            HT,    // 802.11n HT20 mixed format, one spatial stream
+        };
+
+        const char *name;
+        Modulation modulation;
+        uint32_t rateKbps;
+        uint16_t dataBitsPerSymbol;  // OFDM and HT only
+        bool shortGuardInterval;     // HT only
+        int8_t sensitivityDbm;       // RSSI with 50 % frame loss
+    };
+
+    // The rates the dongle uses: peers added with fastRate are set to HT20
+    // MCS7 with the short guard interval, everything else (the broadcast peer)
+    // goes out at the driver's default of 1 Mbps. ACKs to HT frames use 24 Mbps.
+    static constexpr PhyRate dsss1Mbps = {"1M", PhyRate::Modulation::DSSS, 1000, 0, false, -97};
+    static constexpr PhyRate ofdm24Mbps = {"24M", PhyRate::Modulation::OFDM, 24000, 96, false, -84};
+    static constexpr PhyRate ht20Mcs7Sgi = {"MCS7_SGI", PhyRate::Modulation::HT, 72200, 260, true, -72};
+
+    // Bytes ESP-NOW adds around its payload: 802.11 header, vendor specific
+    // action frame and element headers, FCS
+    static constexpr size_t espnowOverheadBytes = 24 + 8 + 7 + 4;
+    static constexpr size_t ackBytes = 14;
+
+    struct Config {
+        uint32_t slotUs = 9;
+        uint32_t sifsUs = 10;
+        uint16_t cwMin = 15;
+        uint16_t cwMax = 1023;
+        uint8_t retryLimit = 7;        // Retransmissions after the first attempt
+        size_t queueLimit = 32;        // Frames waiting per station
+        double fadingDb = 3.0;         // Standard deviation of per-frame RSSI fading
+        double lossSlopeDb = 1.5;      // Logistic slope of frame loss around the sensitivity
+        int8_t defaultRssi = -50;
+        uint64_t seed = 1;
+    };
+
+    // Called with the sender's MAC, the RSSI the frame arrived with and the
+    // end of its reception
+    using ReceiveHandler = std::function<void(const uint8_t srcMac[6], int8_t rssi, const uint8_t *data, size_t len, uint64_t timeUs)>;
+
+    struct StationStats {
+        uint64_t queued = 0;
+        uint64_t queueDrops = 0;         // Transmit queue was full
+        uint64_t attempts = 0;
+        uint64_t collisions = 0;         // Attempts that overlapped with another station's
+        uint64_t faded = 0;              // Attempts lost to a weak signal
+        uint64_t delivered = 0;          // Unicast frames acknowledged, broadcasts sent
+        uint64_t retryDrops = 0;         // Unicast frames given up after the retry limit
+        uint64_t airtimeUs = 0;
+        std::vector<uint32_t> latencyUs; // Queueing to the end of the successful attempt, per delivered frame
+    };
+
+    struct ChannelStats {
+        uint64_t busyUs = 0;
+        uint64_t transmissions = 0;
+        uint64_t collisions = 0;         // Slots in which more than one station started
+    };
+
+    explicit RadioChannel(const Config &config);
+
+    // Returns the station's index
+    size_t addStation(const uint8_t mac[6], const PhyRate &rate, ReceiveHandler handler);
+
+    // Link RSSI, the same in both directions; unset links use Config::defaultRssi
+    void setLinkRssi(size_t a, size_t b, int8_t rssi);
+    int8_t getLinkRssi(size_t a, size_t b) const;
+
+    // Queues a frame; dstMac ff:ff:ff:ff:ff:ff is a broadcast. A unicast to a
+    // MAC without a station is never acknowledged. Returns false if the queue
+    // was full.
+    bool send(size_t station, const uint8_t dstMac[6], const uint8_t *data, size_t len, uint64_t timeUs);
+    bool send(size_t station, const uint8_t dstMac[6], const uint8_t *data, size_t len, uint64_t timeUs, const PhyRate &rate);
+
+    void runUntil(uint64_t timeUs);
+
+    size_t getStationCount() const { return stations.size(); }
+    const uint8_t *getMac(size_t station) const { return stations[station].mac.data(); }
+    const StationStats &getStats(size_t station) const { return stations[station].stats; }
+    const ChannelStats &getChannelStats() const { return channelStats; }
+    void resetStats();
+
+    // Time the frame occupies the medium, without ACK
+    static uint32_t frameAirtimeUs(size_t payloadLen, const PhyRate &rate);
+    static uint32_t psduAirtimeUs(size_t psduBytes, const PhyRate &rate);
+
+private:
+    struct Frame {
+        std::array<uint8_t, 6> dstMac;
+        std::vector<uint8_t> data;
+        const PhyRate *rate;
+        uint64_t arrivalUs;
+        uint8_t retries = 0;
+    };
+
+    struct Station {
+        std::array<uint8_t, 6> mac;
+        const PhyRate *rate;
+        ReceiveHandler handler;
+        std::deque<Frame> queue;
+        uint16_t cw = 0;
+        uint32_t backoffSlots = 0;
+        uint64_t readyUs = 0;  // The head frame may be sent from here, once the medium has been idle for DIFS
+        StationStats stats;
+    };
+
+    struct Delivery {
+        size_t station;
+        std::array<uint8_t, 6> srcMac;
+        int8_t rssi;
+        std::vector<uint8_t> data;
+    };
+
+    bool isBroadcast(const std::array<uint8_t, 6> &mac) const;
+    int findStation(const std::array<uint8_t, 6> &mac) const;
+    void startBackoff(Station &station, uint64_t readyUs);
+    void finishHead(Station &station, uint64_t timeUs);
+    uint32_t difsUs() const { return config.sifsUs + 2 * config.slotUs; }
+    bool survives(size_t from, size_t to, const PhyRate &rate, int8_t &rssi);
+    void resolve(const std::vector<size_t> &transmitters, uint64_t startUs);
+    static uint32_t ackAirtimeUs(const PhyRate &rate);
+    double gaussian();
+    double uniform();
+    uint32_t nextRandom();
+
+    Config config;
+    std::vector<Station> stations;
+    std::map<std::pair<size_t, size_t>, int8_t> linkRssi;
+    uint64_t idleFromUs = 0;  // End of the last transmission
+    std::multimap<uint64_t, Delivery> deliveries;
+    ChannelStats channelStats;
+    uint64_t rngState;
+};
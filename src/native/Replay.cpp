@@ -0,0 +1,132 @@
+// Replays a recorded frame trace through ESPNowCommunication and
+// PacketHandling against the simulated clock and prints every HID transfer
+// and radio frame the dongle produced, with its time. The replay itself is in
+// TraceReplay.cpp, which test/test_replay runs against a recorded golden
+// output.
+//
+// Build: pio run -e native   (the binary is .pio/build/native/program)
+//
+// Usage: program [options] <trace>
+//
+//   --golden FILE       compare the output with FILE, exit with 1 on mismatch
+//   --output FILE       write the output to FILE instead of stdout
+//   --logs              include the firmware's console output
+//   --no-connect        don't pair and connect the trace's trackers up front
+//   --step-us N         main loop period, default 100
+//   --hid-interval-us N minimum time between HID transfers, default 1000
+//   --hid-format F      HID report format, legacy (default) or compact, as if
+//                       the host had picked it
+//   --tail-ms N         keep running after the last frame, default 100
+//   --seed N            random seed, default 1
+//
+// The trace is either a dump from the "capture dump" console command or a
+// text file with one frame per line:
+//
+//   <time us> <source mac> <rssi> <payload hex>
+//
+// Blank lines and lines starting with # are ignored. Unless --no-connect is
+// given, every source MAC is paired and sends a valid handshake before the
+// first frame, and heartbeats are answered, so a trace cut from the middle of
+// a session still produces reports.
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "TraceReplay.h"
+
+namespace {
+struct Options {
+    std::string tracePath;
+    std::string goldenPath;
+    std::string outputPath;
+    TraceReplay::Options replay;
+};
+
+bool parseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--golden" && hasValue) {
+            options.goldenPath = argv[++i];
+        } else if (arg == "--output" && hasValue) {
+            options.outputPath = argv[++i];
+        } else if (arg == "--logs") {
+            options.replay.logs = true;
+        } else if (arg == "--no-connect") {
+            options.replay.connect = false;
+        } else if (arg == "--step-us" && hasValue) {
+            options.replay.stepUs = std::max(1ULL, strtoull(argv[++i], nullptr, 10));
+        } else if (arg == "--hid-interval-us" && hasValue) {
+            options.replay.hidIntervalUs = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--hid-format" && hasValue) {
+            std::string format = argv[++i];
+            if (format == "legacy") {
+                options.replay.hidFormat = PacketHandling::ReportFormat::LEGACY;
+            } else if (format == "compact") {
+                options.replay.hidFormat = PacketHandling::ReportFormat::COMPACT;
+            } else {
+                return false;
+            }
+        } else if (arg == "--tail-ms" && hasValue) {
+            options.replay.tailUs = strtoull(argv[++i], nullptr, 10) * 1000;
+        } else if (arg == "--seed" && hasValue) {
+            options.replay.seed = strtoull(argv[++i], nullptr, 10);
+        } else if (arg[0] != '-' && options.tracePath.empty()) {
+            options.tracePath = arg;
+        } else {
+            return false;
+        }
+    }
+    return !options.tracePath.empty();
+}
+
+int compareGolden(const std::string &output, const std::string &goldenPath) {
+    std::ifstream file(goldenPath);
+    if (!file) {
+        fprintf(stderr, "Couldn't open %s\n", goldenPath.c_str());
+        return 1;
+    }
+    std::string golden((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    std::string difference = TraceReplay::firstDifference(output, golden);
+    if (!difference.empty()) {
+        fprintf(stderr, "Output differs from %s at %s\n", goldenPath.c_str(), difference.c_str());
+        return 1;
+    }
+    fprintf(stderr, "Output matches %s\n", goldenPath.c_str());
+    return 0;
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        fprintf(stderr, "Usage: %s [--golden FILE] [--output FILE] [--logs] [--no-connect] [--step-us N] [--hid-interval-us N] [--hid-format legacy|compact] [--tail-ms N] [--seed N] <trace>\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<TraceReplay::Frame> frames;
+    if (!TraceReplay::loadTrace(options.tracePath, frames)) {
+        return 1;
+    }
+
+    // Only the file name goes into the output, so it doesn't depend on where
+    // the trace was replayed from
+    std::string traceName = options.tracePath.substr(options.tracePath.find_last_of('/') + 1);
+    std::string result;
+    if (!TraceReplay::run(traceName, std::move(frames), options.replay, result)) {
+        fprintf(stderr, "ESPNowCommunication::begin() failed\n");
+        return 1;
+    }
+
+    if (!options.outputPath.empty()) {
+        std::ofstream file(options.outputPath);
+        file << result;
+    } else if (options.goldenPath.empty()) {
+        fputs(result.c_str(), stdout);
+    }
+
+    return options.goldenPath.empty() ? 0 : compareGolden(result, options.goldenPath);
+}
@@ -0,0 +1,162 @@
+#include "Testbed.h"
+
+#include "configuration.h"
+#include "espnow/espnow.h"
+#include "espnow/messages.h"
+#include "logging/Logger.h"
+#include "packetHandling.h"
+#include "hal/Radio.h"
+#include "hal/Random.h"
+
+Testbed::Testbed(const Config &config) : config(config), channel(config.channel), hidEndpoint(config.pollUs) {
+    trackerIndexById.fill(-1);
+}
+
+Testbed::~Testbed() {
+    Simulation::hooks().onHidReport = nullptr;
+}
+
+bool Testbed::begin() {
+    Simulation::setSeed(config.seed);
+    Simulation::setTimeUs(startTimeUs);
+
+    harness.answerHeartbeats = false;
+    if (!harness.begin()) {
+        return false;
+    }
+
+    SlimeVR::Hal::Radio::getMacAddress(dongleMac);
+    dongleStation = channel.addStation(dongleMac, RadioChannel::ht20Mcs7Sgi, [this](const uint8_t *srcMac, int8_t rssi, const uint8_t *data, size_t len, uint64_t timeUs) {
+        receiveAtDongle(srcMac, rssi, data, len, timeUs);
+    });
+
+    harness.onRadioSend = [this](const Simulation::SentFrame &frame) {
+        dongleFramesSent++;
+        channel.send(dongleStation, frame.mac, frame.data.data(), frame.data.size(), frame.timeUs, frame.fastRate ? RadioChannel::ht20Mcs7Sgi : RadioChannel::dsss1Mbps);
+    };
+    Simulation::hooks().onHidReport = [this](uint64_t timeUs, uint8_t interface, const uint8_t *data, size_t len) { handleHidReport(data, len, timeUs); };
+    ESPNowCommunication::getInstance().onTrackerDisconnected([this](uint8_t trackerId) { dongleDisconnects++; });
+    return true;
+}
+
+void Testbed::addTrackers(size_t count, bool paired) {
+    for (size_t i = 0; i < count; i++) {
+        size_t index = trackers.size();
+        uint8_t mac[6] = {0x02, 0x54, 0x52, 0x4b, static_cast<uint8_t>(index >> 8), static_cast<uint8_t>(index & 0xff)};
+        trackers.push_back(std::make_unique<TrackerEmulator>(channel, mac, config.tracker));
+
+        std::array<uint8_t, 6> key;
+        memcpy(key.data(), mac, key.size());
+        trackerIndexByMac[key] = index;
+
+        if (paired) {
+            harness.pairTracker(mac);
+            trackers.back()->setPairing(dongleMac, ESPNowCommunication::getInstance().securityCode);
+        }
+    }
+}
+
+void Testbed::powerOnAll(uint64_t spreadUs) {
+    uint64_t now = Simulation::getTimeUs();
+    for (auto &tracker : trackers) {
+        tracker->powerOn(now + (spreadUs != 0 ? SlimeVR::Hal::random32() % spreadUs : 0));
+    }
+}
+
+void Testbed::rebootDongle(uint64_t offlineUs) {
+    ESPNowCommunication::getInstance().disconnectAllTrackers();
+    dongleOfflineUntilUs = Simulation::getTimeUs() + offlineUs;
+}
+
+void Testbed::step() {
+    uint64_t now = Simulation::getTimeUs();
+
+    for (auto &tracker : trackers) {
+        tracker->tick(now);
+    }
+    channel.runUntil(now);
+
+    if (now >= dongleOfflineUntilUs) {
+        ESPNowCommunication::getInstance().update();
+        ESPNowCommunication::getInstance().dispatchEvents();
+        PacketHandling::getInstance().tick(hidEndpoint);
+    }
+    Serial.pump();
+    SlimeVR::Logging::LogBackend::getInstance().drain(SIZE_MAX);
+    Configuration::getInstance().flushIfDue();
+
+    // Firmware code may have advanced the clock itself through delay()
+    if (Simulation::getTimeUs() == now) {
+        Simulation::advanceUs(config.stepUs);
+    }
+}
+
+void Testbed::runFor(uint64_t durationUs) {
+    uint64_t endUs = Simulation::getTimeUs() + durationUs;
+    while (Simulation::getTimeUs() < endUs) {
+        step();
+    }
+}
+
+bool Testbed::runUntil(const std::function<bool()> &condition, uint64_t timeoutUs) {
+    uint64_t endUs = Simulation::getTimeUs() + timeoutUs;
+    while (!condition()) {
+        if (Simulation::getTimeUs() >= endUs) {
+            return false;
+        }
+        step();
+    }
+    return true;
+}
+
+size_t Testbed::countTrackers(TrackerEmulator::State state) const {
+    size_t count = 0;
+    for (const auto &tracker : trackers) {
+        if (tracker->getState() == state) {
+            count++;
+        }
+    }
+    return count;
+}
+
+size_t Testbed::getDongleConnectedCount() const {
+    return ESPNowCommunication::getInstance().getConnectedTrackerCount();
+}
+
+void Testbed::resetStats() {
+    channel.resetStats();
+    for (auto &tracker : trackers) {
+        tracker->resetStats();
+    }
+    ESPNowCommunication::getInstance().resetStats();
+    PacketHandling::getInstance().resetStats();
+}
+
+void Testbed::receiveAtDongle(const uint8_t *srcMac, int8_t rssi, const uint8_t *data, size_t len, uint64_t timeUs) {
+    if (Simulation::getTimeUs() < dongleOfflineUntilUs) {
+        return;
+    }
+
+    std::array<uint8_t, 6> key;
+    memcpy(key.data(), srcMac, key.size());
+    auto tracker = trackerIndexByMac.find(key);
+    if (tracker != trackerIndexByMac.end() && len >= 2 + TrackerEmulator::reportSize && data[0] == static_cast<uint8_t>(ESPNowMessageTypes::TRACKER_DATA) && data[2] == 1) {
+        trackerIndexById[data[3]] = static_cast<int>(tracker->second);
+        uint32_t sequence;
+        memcpy(&sequence, &data[4], sizeof(sequence));
+        trackers[tracker->second]->onReportReceived(sequence, timeUs);
+    }
+    Simulation::deliverFrame(srcMac, rssi, data, len);
+}
+
+void Testbed::handleHidReport(const uint8_t *data, size_t len, uint64_t timeUs) {
+    for (size_t offset = 0; offset + TrackerEmulator::reportSize <= len; offset += TrackerEmulator::reportSize) {
+        const uint8_t *report = &data[offset];
+        int tracker = trackerIndexById[report[1]];
+        if (report[0] == 1 && tracker >= 0) {
+            uint32_t sequence;
+            memcpy(&sequence, &report[2], sizeof(sequence));
+            trackers[tracker]->onHidReport(sequence, timeUs);
+        }
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+// The dongle core and any number of emulated trackers on one simulated
+// channel, stepped together on the simulated clock. The dongle's frames go
+// through the channel at the rate its peers were added with, and every
+// report the trackers generate is followed to the dongle and out of the HID
+// endpoint.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "DongleHarness.h"
+#include "RadioChannel.h"
+#include "TrackerEmulator.h"
+#include "hal/native/Simulation.h"
+
+class Testbed {
+public:
+    struct Config {
+        RadioChannel::Config channel;
+        TrackerEmulator::Config tracker;
+        uint64_t stepUs = 100;
+        uint64_t pollUs = 1000;
+        uint64_t seed = 1;
+    };
+
+    static constexpr uint64_t startTimeUs = 1000000;
+
+    explicit Testbed(const Config &config);
+    ~Testbed();
+
+    // Brings the dongle up, returns false if ESPNowCommunication::begin() failed
+    bool begin();
+
+    // Adds powered off trackers; paired ones are also stored in the dongle's
+    // configuration, as if they had been paired before
+    void addTrackers(size_t count, bool paired);
+
+    // Powers the trackers on at random times within spreadUs from now
+    void powerOnAll(uint64_t spreadUs);
+
+    // The dongle stops for offlineUs and comes back without any connected
+    // trackers. Its send queue and HID FIFO survive, unlike on a real reboot.
+    void rebootDongle(uint64_t offlineUs);
+
+    // One main loop iteration for the trackers, the channel and the dongle
+    void step();
+    void runFor(uint64_t durationUs);
+
+    // Steps until the condition holds, returns false on timeout
+    bool runUntil(const std::function<bool()> &condition, uint64_t timeoutUs);
+
+    size_t countTrackers(TrackerEmulator::State state) const;
+    size_t getDongleConnectedCount() const;
+
+    void resetStats();
+
+    size_t getTrackerCount() const { return trackers.size(); }
+    TrackerEmulator &getTracker(size_t index) { return *trackers[index]; }
+    const TrackerEmulator &getTracker(size_t index) const { return *trackers[index]; }
+    RadioChannel &getChannel() { return channel; }
+    size_t getDongleStation() const { return dongleStation; }
+    const uint8_t *getDongleMac() const { return dongleMac; }
+    uint64_t getDongleFramesSent() const { return dongleFramesSent; }
+    uint64_t getDongleDisconnects() const { return dongleDisconnects; }
+
+private:
+    void receiveAtDongle(const uint8_t *srcMac, int8_t rssi, const uint8_t *data, size_t len, uint64_t timeUs);
+    void handleHidReport(const uint8_t *data, size_t len, uint64_t timeUs);
+
+    Config config;
+    RadioChannel channel;
+    DongleHarness harness;
+    Simulation::HidEndpoint hidEndpoint;
+    size_t dongleStation = 0;
+    uint8_t dongleMac[6];
+    uint64_t dongleOfflineUntilUs = 0;
+    uint64_t dongleFramesSent = 0;
+    uint64_t dongleDisconnects = 0;
+
+    std::vector<std::unique_ptr<TrackerEmulator>> trackers;
+    std::map<std::array<uint8_t, 6>, size_t> trackerIndexByMac;
+    // Learned from the reports the dongle receives, -1 if not seen yet
+    std::array<int, 256> trackerIndexById;
+};
@@ -0,0 +1,238 @@
+#include "TraceReplay.h"
+
+#include "espnow/espnow.h"
+#include "logging/Logger.h"
+#include "StatusManager.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#include "CaptureDump.h"
+#include "DongleHarness.h"
+#include "hal/native/Simulation.h"
+
+SlimeVR::Status::StatusManager statusManager;
+
+namespace TraceReplay {
+namespace {
+constexpr uint64_t startTimeUs = 1000000;      // Replay starts one second after "boot"
+constexpr uint64_t connectLeadUs = 10000;      // Handshakes go out this long before the first frame
+
+std::string formatMac(const uint8_t mac[6]) {
+    char buf[18];
+    snprintf(buf, sizeof(buf), "%02x:%02x:%02x:%02x:%02x:%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    return buf;
+}
+
+std::string formatHex(const uint8_t *data, size_t len, size_t groupSize = 0) {
+    std::string out;
+    char buf[3];
+    for (size_t i = 0; i < len; i++) {
+        if (groupSize != 0 && i != 0 && i % groupSize == 0) {
+            out += ' ';
+        }
+        snprintf(buf, sizeof(buf), "%02x", data[i]);
+        out += buf;
+    }
+    return out;
+}
+
+bool parseMac(const std::string &text, uint8_t mac[6]) {
+    unsigned parts[6];
+    if (sscanf(text.c_str(), "%x:%x:%x:%x:%x:%x", &parts[0], &parts[1], &parts[2], &parts[3], &parts[4], &parts[5]) != 6) {
+        return false;
+    }
+    for (int i = 0; i < 6; i++) {
+        mac[i] = parts[i];
+    }
+    return true;
+}
+
+bool parseHex(const std::string &text, std::vector<uint8_t> &out) {
+    if (text.size() % 2 != 0) {
+        return false;
+    }
+    for (size_t i = 0; i < text.size(); i += 2) {
+        char *end;
+        std::string byte = text.substr(i, 2);
+        out.push_back(strtoul(byte.c_str(), &end, 16));
+        if (*end != '\0') {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool loadTextTrace(const std::string &text, std::vector<Frame> &frames) {
+    std::istringstream input(text);
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(input, line)) {
+        lineNumber++;
+        std::istringstream fields(line);
+        std::string time, mac, rssi, payload;
+        if (!(fields >> time) || time[0] == '#') {
+            continue;
+        }
+
+        Frame frame;
+        fields >> mac >> rssi >> payload;
+        frame.timeUs = strtoull(time.c_str(), nullptr, 10);
+        frame.rssi = atoi(rssi.c_str());
+        if (!parseMac(mac, frame.mac) || !parseHex(payload, frame.data) || frame.data.empty()) {
+            fprintf(stderr, "Invalid frame on line %d\n", lineNumber);
+            return false;
+        }
+        frames.push_back(std::move(frame));
+    }
+    return true;
+}
+
+}  // namespace
+
+bool loadTrace(const std::string &path, std::vector<Frame> &frames) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        fprintf(stderr, "Couldn't open %s\n", path.c_str());
+        return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    if (!CaptureDump::looksLikeDump(data)) {
+        return loadTextTrace(std::string(data.begin(), data.end()), frames);
+    }
+
+    CaptureDump::Capture capture = CaptureDump::parse(data);
+    for (const CaptureDump::Packet &packet : capture.packets) {
+        if (packet.payload.size() < packet.length) {
+            fprintf(stderr, "Warning: frame at %llu us was truncated by the capture\n", static_cast<unsigned long long>(packet.timestampUs));
+        }
+        Frame frame;
+        frame.timeUs = packet.timestampUs;
+        memcpy(frame.mac, packet.mac, sizeof(frame.mac));
+        frame.rssi = packet.rssi;
+        frame.data = packet.payload;
+        frames.push_back(std::move(frame));
+    }
+    return true;
+}
+
+
+bool run(const std::string &traceName, std::vector<Frame> frames, const Options &options, std::string &result) {
+    std::stable_sort(frames.begin(), frames.end(), [](const Frame &a, const Frame &b) { return a.timeUs < b.timeUs; });
+
+    std::ostringstream output;
+    output << "# trace " << traceName << ", " << frames.size() << " frames\n";
+    size_t hidTransfers = 0;
+    size_t radioFrames = 0;
+    std::string consoleLine;
+
+    Simulation::setSeed(options.seed);
+    DongleHarness harness;
+    harness.answerHeartbeats = options.connect;
+    Simulation::hooks().onHidReport = [&](uint64_t timeUs, uint8_t interface, const uint8_t *data, size_t len) {
+        // HID1, HID2... for the other interfaces of a multi-interface build
+        output << timeUs << " HID";
+        if (interface != 0) {
+            output << static_cast<int>(interface);
+        }
+        output << " " << formatHex(data, len, 16) << "\n";
+        hidTransfers++;
+    };
+    harness.onRadioSend = [&](const Simulation::SentFrame &frame) {
+        output << frame.timeUs << " TX " << formatMac(frame.mac) << " " << formatHex(frame.data.data(), frame.data.size()) << "\n";
+        radioFrames++;
+    };
+    Simulation::hooks().onConsoleOutput = [&](const uint8_t *data, size_t len) {
+        if (!options.logs) {
+            return;
+        }
+        for (size_t i = 0; i < len; i++) {
+            if (data[i] == '\n') {
+                output << Simulation::getTimeUs() << " LOG " << consoleLine << "\n";
+                consoleLine.clear();
+            } else if (data[i] != '\r') {
+                consoleLine += static_cast<char>(data[i]);
+            }
+        }
+    };
+
+    Simulation::setTimeUs(startTimeUs - connectLeadUs);
+
+    Simulation::HidEndpoint hidEndpoint(options.hidIntervalUs);
+
+    auto &backend = SlimeVR::Logging::LogBackend::getInstance();
+    auto &espnow = ESPNowCommunication::getInstance();
+    auto &packetHandling = PacketHandling::getInstance();
+
+    if (!harness.begin()) {
+        return false;
+    }
+    packetHandling.setReportFormat(options.hidFormat);
+
+    if (options.connect) {
+        std::vector<std::array<uint8_t, 6>> connected;
+        for (const Frame &frame : frames) {
+            std::array<uint8_t, 6> mac;
+            memcpy(mac.data(), frame.mac, mac.size());
+            if (std::find(connected.begin(), connected.end(), mac) != connected.end()) {
+                continue;
+            }
+            connected.push_back(mac);
+            harness.connectTracker(frame.mac, frame.rssi);
+        }
+    }
+
+    uint64_t firstFrameUs = frames.empty() ? 0 : frames.front().timeUs;
+    uint64_t endUs = startTimeUs + (frames.empty() ? 0 : frames.back().timeUs - firstFrameUs) + options.tailUs;
+    size_t nextFrame = 0;
+
+    while (Simulation::getTimeUs() <= endUs) {
+        uint64_t now = Simulation::getTimeUs();
+
+        while (nextFrame < frames.size() && startTimeUs + frames[nextFrame].timeUs - firstFrameUs <= now) {
+            const Frame &frame = frames[nextFrame++];
+            Simulation::deliverFrame(frame.mac, frame.rssi, frame.data.data(), frame.data.size());
+        }
+        harness.deliverDueReplies();
+
+        espnow.update();
+        espnow.dispatchEvents();
+        packetHandling.tick(hidEndpoint);
+        Serial.pump();
+        backend.drain(SIZE_MAX);
+
+        // Firmware code may have advanced the clock itself through delay()
+        if (Simulation::getTimeUs() == now) {
+            Simulation::advanceUs(options.stepUs);
+        }
+    }
+
+    output << "# " << nextFrame << " frames replayed, " << hidTransfers << " HID transfers, " << radioFrames << " frames sent\n";
+
+    // The hooks refer to this call's locals
+    Simulation::hooks().onHidReport = nullptr;
+    Simulation::hooks().onConsoleOutput = nullptr;
+    result = output.str();
+    return true;
+}
+
+std::string firstDifference(const std::string &output, const std::string &expected) {
+    std::istringstream outputLines(output), expectedLines(expected);
+    std::string actualLine, expectedLine;
+    for (int line = 1;; line++) {
+        bool hasActual = static_cast<bool>(std::getline(outputLines, actualLine));
+        bool hasExpected = static_cast<bool>(std::getline(expectedLines, expectedLine));
+        if (!hasActual && !hasExpected) {
+            return "";
+        }
+        if (!hasActual || !hasExpected || actualLine != expectedLine) {
+            return "line " + std::to_string(line) + "\n  expected: " + (hasExpected ? expectedLine : "<end of file>") +
+                   "\n  actual:   " + (hasActual ? actualLine : "<end of output>");
+        }
+    }
+}
+}  // namespace TraceReplay
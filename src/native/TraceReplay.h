@@ -0,0 +1,56 @@
+#pragma once
+
+// Feeds a recorded frame trace through ESPNowCommunication and PacketHandling
+// against the simulated clock and records every HID transfer and radio frame
+// the dongle produced, with its time. Used by the replay program in Replay.cpp
+// and by the golden output test in test/test_replay.
+//
+// A trace is either a dump from the "capture dump" console command or a text
+// file with one frame per line:
+//
+//   <time us> <source mac> <rssi> <payload hex>
+//
+// Blank lines and lines starting with # are ignored.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "packetHandling.h"
+
+namespace TraceReplay {
+struct Frame {
+    uint64_t timeUs;
+    uint8_t mac[6];
+    int8_t rssi;
+    std::vector<uint8_t> data;
+};
+
+struct Options {
+    bool logs = false;        // Include the firmware's console output
+    bool connect = true;      // Pair and connect the trace's trackers up front
+    uint64_t stepUs = 100;    // Main loop period
+    uint64_t hidIntervalUs = 1000;  // Minimum time between HID transfers
+    PacketHandling::ReportFormat hidFormat = PacketHandling::ReportFormat::LEGACY;
+    uint64_t tailUs = 100000;  // Keep running this long after the last frame
+    uint64_t seed = 1;
+};
+
+// Reads a capture dump or a text trace, returns false and prints why if it
+// can't
+bool loadTrace(const std::string &path, std::vector<Frame> &frames);
+
+// Replays the frames and writes what the dongle produced to output, one line
+// per HID transfer, radio frame and (with Options::logs) console line. The
+// output only depends on the frames and the options; traceName goes into its
+// first line. Unless Options::connect is false, every source MAC is paired and
+// sends a valid handshake before the first frame, and heartbeats are
+// answered, so a trace cut from the middle of a session still produces
+// reports. The dongle core is a set of singletons, so this runs once per
+// process. Returns false if ESPNowCommunication::begin() failed.
+bool run(const std::string &traceName, std::vector<Frame> frames, const Options &options, std::string &output);
+
+// The first line where output and expected differ, or an empty string if
+// they are the same
+std::string firstDifference(const std::string &output, const std::string &expected);
+}  // namespace TraceReplay
@@ -0,0 +1,216 @@
+#include "TrackerEmulator.h"
+
+#include <cstring>
+
+#include "espnow/messages.h"
+
+TrackerEmulator::TrackerEmulator(RadioChannel &channel, const uint8_t mac[6], const Config &config)
+    : channel(channel), config(config), rateHz(config.initialRateHz) {
+    memcpy(this->mac, mac, sizeof(this->mac));
+    station = channel.addStation(mac, RadioChannel::ht20Mcs7Sgi, [this](const uint8_t *srcMac, int8_t rssi, const uint8_t *data, size_t len, uint64_t timeUs) {
+        receive(srcMac, data, len, timeUs);
+    });
+}
+
+void TrackerEmulator::setPairing(const uint8_t dongleMac[6], const uint8_t securityCode[8]) {
+    memcpy(this->dongleMac, dongleMac, sizeof(this->dongleMac));
+    memcpy(this->securityCode, securityCode, sizeof(this->securityCode));
+    paired = true;
+}
+
+void TrackerEmulator::clearPairing() {
+    paired = false;
+    if (state != State::OFF) {
+        state = State::UNPAIRED;
+    }
+}
+
+void TrackerEmulator::powerOn(uint64_t timeUs) {
+    state = paired ? State::PAIRED : State::UNPAIRED;
+    rateHz = config.initialRateHz;
+    nextHandshakeUs = timeUs;
+}
+
+void TrackerEmulator::powerOff() {
+    state = State::OFF;
+}
+
+void TrackerEmulator::tick(uint64_t now) {
+    if (state == State::PAIRED) {
+        if (nextHandshakeUs <= now) {
+            ESPNowConnectionMessage handshake;
+            memcpy(handshake.securityBytes, securityCode, sizeof(handshake.securityBytes));
+            send(&handshake, sizeof(handshake), nextHandshakeUs);
+            nextHandshakeUs += config.handshakeIntervalUs;
+        }
+        return;
+    }
+    if (state != State::CONNECTED) {
+        return;
+    }
+
+    while (nextReportUs <= now) {
+        uint8_t frame[2 + reportSize] = {};
+        frame[0] = static_cast<uint8_t>(ESPNowMessageTypes::TRACKER_DATA);
+        frame[1] = reportSize;
+        frame[2] = 1;
+        frame[3] = trackerId;
+        uint32_t sequence = reportTimesUs.size();
+        memcpy(&frame[4], &sequence, sizeof(sequence));
+        reportTimesUs.push_back(nextReportUs);
+        send(frame, sizeof(frame), nextReportUs);
+        stats.reportsSent++;
+        nextReportUs += 1000000 / rateHz;
+    }
+
+    if (nextHeartbeatUs <= now) {
+        if (waitingForHeartbeat && ++missedHeartbeats >= config.maxMissedHeartbeats) {
+            state = State::PAIRED;
+            stats.disconnects++;
+            nextHandshakeUs = nextHeartbeatUs;
+            return;
+        }
+        ESPNowHeartbeatEchoMessage echo;
+        echo.sequenceNumber = ++heartbeatSequence;
+        send(&echo, sizeof(echo), nextHeartbeatUs);
+        waitingForHeartbeat = true;
+        nextHeartbeatUs += config.heartbeatIntervalUs;
+    }
+}
+
+void TrackerEmulator::onReportReceived(uint32_t sequence, uint64_t timeUs) {
+    if (sequence < reportTimesUs.size()) {
+        stats.reportsReceived++;
+        stats.radioLatencyUs.push_back(timeUs - reportTimesUs[sequence]);
+    }
+}
+
+void TrackerEmulator::onHidReport(uint32_t sequence, uint64_t timeUs) {
+    if (sequence < reportTimesUs.size()) {
+        stats.hidReports++;
+        stats.hidAgeUs.push_back(timeUs - reportTimesUs[sequence]);
+    }
+}
+
+void TrackerEmulator::send(const void *data, size_t len, uint64_t timeUs) {
+    channel.send(station, dongleMac, static_cast<const uint8_t *>(data), len, timeUs);
+}
+
+bool TrackerEmulator::fromDongle(const uint8_t *srcMac) const {
+    return paired && memcmp(srcMac, dongleMac, sizeof(dongleMac)) == 0;
+}
+
+void TrackerEmulator::receive(const uint8_t *srcMac, const uint8_t *data, size_t len, uint64_t timeUs) {
+    if (len == 0 || state == State::OFF || state == State::OTA) {
+        return;
+    }
+
+    switch (static_cast<ESPNowMessageTypes>(data[0])) {
+    case ESPNowMessageTypes::PAIRING_ANNOUNCEMENT: {
+        if (state != State::UNPAIRED || len < sizeof(ESPNowPairingAnnouncementMessage)) {
+            return;
+        }
+        ESPNowPairingAnnouncementMessage announcement;
+        memcpy(&announcement, data, sizeof(announcement));
+        memcpy(dongleMac, srcMac, sizeof(dongleMac));
+        memcpy(securityCode, announcement.securityBytes, sizeof(securityCode));
+
+        ESPNowPairingMessage request;
+        memcpy(request.securityBytes, securityCode, sizeof(request.securityBytes));
+        send(&request, sizeof(request), timeUs);
+        return;
+    }
+    case ESPNowMessageTypes::PAIRING_RESPONSE: {
+        // The MAC and security code were taken from the announcement
+        if (state != State::UNPAIRED || memcmp(srcMac, dongleMac, sizeof(dongleMac)) != 0) {
+            return;
+        }
+        paired = true;
+        state = State::PAIRED;
+        nextHandshakeUs = timeUs;
+        return;
+    }
+    case ESPNowMessageTypes::HANDSHAKE_RESPONSE: {
+        if (state != State::PAIRED || !fromDongle(srcMac) || len < sizeof(ESPNowConnectionAckMessage)) {
+            return;
+        }
+        ESPNowConnectionAckMessage ack;
+        memcpy(&ack, data, sizeof(ack));
+        state = State::CONNECTED;
+        trackerId = ack.trackerId;
+        nextReportUs = timeUs;
+        nextHeartbeatUs = timeUs + config.heartbeatIntervalUs;
+        waitingForHeartbeat = false;
+        missedHeartbeats = 0;
+        stats.connects++;
+        return;
+    }
+    case ESPNowMessageTypes::HEARTBEAT_ECHO: {
+        if (state != State::CONNECTED || !fromDongle(srcMac) || len < sizeof(ESPNowHeartbeatEchoMessage)) {
+            return;
+        }
+        ESPNowHeartbeatEchoMessage echo;
+        memcpy(&echo, data, sizeof(echo));
+        ESPNowHeartbeatResponseMessage response;
+        response.sequenceNumber = echo.sequenceNumber;
+        send(&response, sizeof(response), timeUs);
+        return;
+    }
+    case ESPNowMessageTypes::HEARTBEAT_RESPONSE: {
+        if (state != State::CONNECTED || !fromDongle(srcMac) || len < sizeof(ESPNowHeartbeatResponseMessage)) {
+            return;
+        }
+        ESPNowHeartbeatResponseMessage response;
+        memcpy(&response, data, sizeof(response));
+        if (response.sequenceNumber == heartbeatSequence) {
+            waitingForHeartbeat = false;
+            missedHeartbeats = 0;
+        }
+        return;
+    }
+    case ESPNowMessageTypes::TRACKER_RATE: {
+        if (state != State::CONNECTED || !fromDongle(srcMac) || len < sizeof(ESPNowTrackerRateMessage)) {
+            return;
+        }
+        ESPNowTrackerRateMessage message;
+        memcpy(&message, data, sizeof(message));
+        stats.rateUpdates++;
+        if (config.followRateUpdates && message.pollRateHz != 0) {
+            rateHz = message.pollRateHz;
+        }
+        return;
+    }
+    case ESPNowMessageTypes::UNPAIR: {
+        if (!fromDongle(srcMac) || len < sizeof(ESPNowUnpairMessage)) {
+            return;
+        }
+        ESPNowUnpairMessage message;
+        memcpy(&message, data, sizeof(message));
+        if (memcmp(message.securityBytes, securityCode, sizeof(securityCode)) == 0) {
+            clearPairing();
+        }
+        return;
+    }
+    case ESPNowMessageTypes::ENTER_OTA_MODE: {
+        if (!fromDongle(srcMac) || len < sizeof(ESPNowEnterOtaModeMessage)) {
+            return;
+        }
+        ESPNowEnterOtaModeMessage message;
+        memcpy(&message, data, sizeof(message));
+        if (memcmp(message.securityBytes, securityCode, sizeof(securityCode)) != 0) {
+            return;
+        }
+        otaRequest.port = message.ota_portNum;
+        memcpy(otaRequest.ip, message.ota_ip, sizeof(otaRequest.ip));
+        memcpy(otaRequest.ssid, message.ssid, sizeof(otaRequest.ssid));
+        otaRequest.ssid[sizeof(otaRequest.ssid) - 1] = '\0';
+
+        ESPNowEnterOtaAckMessage ack;
+        send(&ack, sizeof(ack), timeUs);
+        state = State::OTA;
+        return;
+    }
+    default:
+        return;
+    }
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+// The tracker side of espnow/messages.h, running on a RadioChannel station.
+//
+// Unpaired, a tracker waits for a PAIRING_ANNOUNCEMENT, answers it with a
+// PAIRING_REQUEST carrying the announced security code and repeats that on
+// every announcement until it gets a PAIRING_RESPONSE. Paired, it sends a
+// handshake every handshakeIntervalUs until it is answered. Connected, it
+// streams type 1 reports at its current rate, follows TRACKER_RATE, answers
+// the dongle's heartbeats and sends its own, and goes back to handshaking
+// after maxMissedHeartbeats of them go unanswered. UNPAIR with the right
+// security code makes it forget the dongle; ENTER_OTA_MODE is acknowledged
+// and the tracker then stays silent in OTA mode.
+//
+// Reports carry the tracker ID in byte 1 and a sequence number in bytes 2-5,
+// so whoever sees them later can tell when they were generated.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "RadioChannel.h"
+
+class TrackerEmulator {
+public:
+    enum class State : uint8_t {
+        OFF,
+        UNPAIRED,
+        PAIRED,     // Handshaking
+        CONNECTED,
+        OTA,
+    };
+
+    struct Config {
+        uint32_t initialRateHz = 100;
+        bool followRateUpdates = true;
+        uint64_t handshakeIntervalUs = 200000;
+        uint64_t heartbeatIntervalUs = 1000000;
+        uint8_t maxMissedHeartbeats = 5;
+    };
+
+    struct Stats {
+        uint64_t reportsSent = 0;
+        uint64_t reportsReceived = 0;  // By the dongle
+        uint64_t hidReports = 0;
+        uint64_t rateUpdates = 0;
+        uint64_t connects = 0;
+        uint64_t disconnects = 0;      // Gave up on the dongle's heartbeat responses
+        std::vector<uint32_t> radioLatencyUs;  // Report generated to received by the dongle
+        std::vector<uint32_t> hidAgeUs;        // Report generated to HID transfer
+    };
+
+    struct OtaRequest {
+        long port = 0;
+        uint8_t ip[4] = {};
+        char ssid[33] = {};
+    };
+
+    static constexpr size_t reportSize = 16;
+
+    TrackerEmulator(RadioChannel &channel, const uint8_t mac[6], const Config &config);
+    TrackerEmulator(const TrackerEmulator &) = delete;
+    TrackerEmulator &operator=(const TrackerEmulator &) = delete;
+
+    // As if it had been paired with this dongle before
+    void setPairing(const uint8_t dongleMac[6], const uint8_t securityCode[8]);
+    void clearPairing();
+
+    // Starts from UNPAIRED or PAIRED depending on the stored pairing
+    void powerOn(uint64_t timeUs);
+    void powerOff();
+
+    // Sends everything that is due by now
+    void tick(uint64_t now);
+
+    // A report with this sequence number reached the dongle or the host
+    void onReportReceived(uint32_t sequence, uint64_t timeUs);
+    void onHidReport(uint32_t sequence, uint64_t timeUs);
+    void resetStats() { stats = Stats(); }
+
+    State getState() const { return state; }
+    bool isPaired() const { return paired; }
+    const uint8_t *getMac() const { return mac; }
+    size_t getStation() const { return station; }
+    uint8_t getTrackerId() const { return trackerId; }
+    uint32_t getRateHz() const { return rateHz; }
+    const OtaRequest &getOtaRequest() const { return otaRequest; }
+    const Stats &getStats() const { return stats; }
+
+private:
+    void send(const void *data, size_t len, uint64_t timeUs);
+    void receive(const uint8_t *srcMac, const uint8_t *data, size_t len, uint64_t timeUs);
+    bool fromDongle(const uint8_t *srcMac) const;
+
+    RadioChannel &channel;
+    Config config;
+    size_t station;
+    uint8_t mac[6];
+
+    bool paired = false;
+    uint8_t dongleMac[6] = {};
+    uint8_t securityCode[8] = {};
+
+    State state = State::OFF;
+    uint8_t trackerId = 0;
+    uint32_t rateHz;
+    uint64_t nextHandshakeUs = 0;
+    uint64_t nextReportUs = 0;
+    uint64_t nextHeartbeatUs = 0;
+    uint16_t heartbeatSequence = 0;
+    bool waitingForHeartbeat = false;
+    uint8_t missedHeartbeats = 0;
+    OtaRequest otaRequest;
+
+    // Generation time of every report, by sequence number
+    std::vector<uint64_t> reportTimesUs;
+    Stats stats;
+};
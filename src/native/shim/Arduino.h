@@ -0,0 +1,120 @@
+#pragma once
+
+// Host stand-in for the parts of the Arduino-ESP32 core that the dongle core
+// still uses directly: Print/Stream, the FreeRTOS primitives and a few
+// helpers. Hardware access goes through the HAL (src/hal), whose native
+// implementations live in src/hal/native. Everything runs on a single thread,
+// so the FreeRTOS primitives below don't lock and tasks never start.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "hal/Clock.h"
+#include "pins_arduino.h"
+
+#define LOW 0x0
+#define HIGH 0x1
+
+inline unsigned long millis() { return SlimeVR::Hal::Clock::millis(); }
+inline unsigned long micros() { return SlimeVR::Hal::Clock::micros(); }
+inline void delay(unsigned long ms) { SlimeVR::Hal::Clock::delay(ms); }
+inline bool psramFound() { return true; }
+
+// FreeRTOS
+
+typedef void *SemaphoreHandle_t;
+typedef void *TaskHandle_t;
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define portMAX_DELAY 0xFFFFFFFFu
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define tskIDLE_PRIORITY 0
+#define tskNO_AFFINITY 0x7FFFFFFF
+#define pdMS_TO_TICKS(ms) (ms)
+
+struct portMUX_TYPE {
+    int unused;
+};
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(mux) (void)(mux)
+#define portEXIT_CRITICAL(mux) (void)(mux)
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+    static int mutex;
+    return &mutex;
+}
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) { return pdTRUE; }
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) { return pdTRUE; }
+
+// Tasks are never started; the simulation calls their work directly
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char *name, uint32_t stackDepth, void *arg, UBaseType_t priority, TaskHandle_t *handle, BaseType_t core) {
+    if (handle != nullptr) {
+        *handle = nullptr;
+    }
+    return pdPASS;
+}
+inline void vTaskDelay(TickType_t ticks) { delay(ticks); }
+inline TaskHandle_t xTaskGetCurrentTaskHandle() { return nullptr; }
+// No task ever waits, so notifications are dropped
+inline BaseType_t xTaskNotifyGive(TaskHandle_t task) { return pdPASS; }
+inline uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) { return 0; }
+
+// Print and Stream
+
+class Print {
+public:
+    virtual ~Print() = default;
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size) {
+        size_t written = 0;
+        while (written < size && write(buffer[written])) {
+            written++;
+        }
+        return written;
+    }
+    size_t write(const char *str) { return write(reinterpret_cast<const uint8_t *>(str), strlen(str)); }
+    virtual int availableForWrite() { return 0; }
+    virtual void flush() {}
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+        char buffer[256];
+        va_list args;
+        va_start(args, format);
+        int len = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        if (len < 0) {
+            return 0;
+        }
+        return write(reinterpret_cast<const uint8_t *>(buffer), std::min<size_t>(len, sizeof(buffer) - 1));
+    }
+    size_t print(const char *str) { return write(str); }
+    size_t print(char c) { return write(static_cast<uint8_t>(c)); }
+    size_t print(int value) { return printf("%d", value); }
+    size_t print(unsigned value) { return printf("%u", value); }
+    size_t print(long value) { return printf("%ld", value); }
+    size_t print(unsigned long value) { return printf("%lu", value); }
+    size_t println() { return write("\r\n"); }
+    size_t println(const char *str) { return print(str) + println(); }
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+
+// Board definitions of a simulated dongle without LED or button
+
+#define USB_VID 0x1209
+#define USB_PID 0x7690
+#define USB_MANUFACTURER "SlimeVR"
+#define USB_PRODUCT "SlimeVR ESPNow Dongle"
+
+static const uint8_t LED_BUILTIN = 255;
+#define LED_ACTIVE_LEVEL 1
+
+static const uint8_t USER_BUTTON = 255;
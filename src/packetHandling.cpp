@@ -1,19 +1,83 @@
 #include "packetHandling.h"
+#include "CompactReport.h"
 #include "espnow/espnow.h"
-#include "Configuration.h"
+#include "configuration.h"
+#include "hal/Clock.h"
+#include "logging/Logger.h"
+
+static SlimeVR::Logging::Logger logger("PacketHandling");
+
+using SlimeVR::Hal::hidInterfaceCount;
+using SlimeVR::Hal::hidInterfaceFor;
+
+namespace {
+class FifoLock {
+public:
+    explicit FifoLock(SemaphoreHandle_t mutex) : mutex(mutex) { if (mutex) xSemaphoreTake(mutex, portMAX_DELAY); }
+    ~FifoLock() { if (mutex) xSemaphoreGive(mutex); }
+private:
+    SemaphoreHandle_t mutex;
+};
+}  // namespace
 
 PacketHandling &PacketHandling::getInstance() {
     return instance;
 }
 
+void PacketHandling::begin() {
+    if (!fifoMutex) {
+        fifoMutex = xSemaphoreCreateMutex();
+    }
+}
+
+void PacketHandling::setOutputTask(TaskHandle_t task) {
+    outputTask = task;
+}
+
+void PacketHandling::setReportFormat(ReportFormat format) {
+    if (reportFormat.exchange(format, std::memory_order_relaxed) != format) {
+        SVR_LOGI(logger, "HID report format: %s", reportFormatName(format));
+    }
+}
+
+const char *PacketHandling::reportFormatName(ReportFormat format) {
+    switch (format) {
+        case ReportFormat::LEGACY: return "legacy";
+        case ReportFormat::COMPACT: return "compact";
+    }
+    return "unknown";
+}
+
+size_t PacketHandling::getQueuedReportCount() const {
+    size_t count = 0;
+    for (const Output &output : outputs) {
+        count += output.buffer.size();
+    }
+    return count;
+}
+
 void PacketHandling::insert(const uint8_t *data, uint8_t len, int8_t rssi) {
     if (len < 2) {
         return; // Need at least packet type and tracker ID
     }
+    if (CompactReport::isCompactTransfer(data)) {
+        return; // These packet types would read as a compact transfer's header
+    }
+
+    // Reports that replaced a queued one are already waited for
+    if (queue(data, len, rssi) && outputTask != nullptr) {
+        xTaskNotifyGive(outputTask);
+    }
+}
 
+bool PacketHandling::queue(const uint8_t *data, uint8_t len, int8_t rssi) {
     // Read packet type and tracker ID early for deduplication
     uint8_t packetType = data[0];
     uint8_t trackerId = data[1];
+    Output &output = outputs[hidInterfaceFor(trackerId)];
+    auto &buffer = output.buffer;
+    FifoLock lock(fifoMutex);
+    stats.insertedReports++;
 
     // FIFO deduplication: Check if this tracker already has data queued
     // Scan existing entries in buffer for same tracker
@@ -30,16 +94,17 @@ void PacketHandling::insert(const uint8_t *data, uint8_t len, int8_t rssi) {
             
             // Write modified packet back to buffer
             buffer[i] = existing;
-            return;
+            stats.overwrittenReports++;
+            return false;
         }
     }
 
     // No duplicate found - check if buffer has space
     if (buffer.isFull()) {
-        droppedReports++;
-        Serial.printf("FIFO full! Dropped packet type %d for tracker %d (total dropped: %lu)\n", 
-                     packetType, trackerId, droppedReports);
-        return;
+        stats.droppedReports++;
+        SVR_LOGW(logger, "FIFO full! Dropped packet type %d for tracker %d (total dropped: %u)",
+                 packetType, trackerId, static_cast<unsigned>(stats.droppedReports));
+        return false;
     }
 
     // Add new entry
@@ -52,7 +117,12 @@ void PacketHandling::insert(const uint8_t *data, uint8_t len, int8_t rssi) {
         packet.data[15] = static_cast<uint8_t>(-rssi);
     }
 
+    if (buffer.isEmpty()) {
+        output.wakeStartUs = SlimeVR::Hal::Clock::micros();
+        output.wakePending = true;
+    }
     buffer.push(packet);
+    return true;
 }
 
 void PacketHandling::sendDisconnectionStatus(uint8_t trackerId) { 
@@ -64,36 +134,93 @@ void PacketHandling::sendDisconnectionStatus(uint8_t trackerId) {
     packet[3] = 0;  // tracker_status (not relevant for disconnection)
     packet[15] = 0; // RSSI (will be 0 for disconnected tracker)
 
-    Serial.printf("Sending disconnection status for tracker ID %d\n", trackerId);
+    SVR_LOGI(logger, "Sending disconnection status for tracker ID %d", trackerId);
     
     insert(packet, 16, 0);
 }
 
-void PacketHandling::createRegistrationReport(uint8_t *report, size_t trackerIndex) {
+bool PacketHandling::createRegistrationReport(uint8_t interface, uint8_t *report) {
     // Format: [255][tracker_id][6-byte MAC address][8 bytes reserved]
     memset(report, 0, reportSize);
     report[0] = 0xff;
-    report[1] = *ESPNowCommunication::getInstance().getTrackerIdByIndex(trackerIndex);
-    
-    // Get MAC address from connected trackers via ESPNow
-    ESPNowCommunication::getInstance().getTrackerMacByIndex(trackerIndex, &report[2]);
+
+    // Next connected tracker on this interface after the last one
+    // registered, wrapping around
+    auto &espnow = ESPNowCommunication::getInstance();
+    ESPNowCommunication::TrackerHandle &cursor = outputs[interface].registrationCursor;
+    size_t candidates = espnow.getConnectedTrackerCount();
+    bool found = false;
+    for (size_t i = 0; i < candidates && !found; i++) {
+        if (!espnow.getNextTracker(cursor, &report[2], report[1])) {
+            return false;
+        }
+        found = hidInterfaceFor(report[1]) == interface;
+    }
+    if (!found) {
+        return false;
+    }
     
     // Bytes 8-15 are reserved (already zeroed by memset)
     
-    // Debug output
-    // Serial.printf("Registration report for tracker #%d\n", trackerIndex);
-    // Serial.printf("  Marker: 0x%02x, Tracker ID: %d\n", report[0], report[1]);
-    // Serial.printf("  MAC Address: %02x:%02x:%02x:%02x:%02x:%02x\n", report[2], report[3], report[4], report[5], report[6], report[7]);
+    SVR_LOGT(logger, "Registration report: marker 0x%02x, tracker ID %d, MAC %02x:%02x:%02x:%02x:%02x:%02x",
+             report[0], report[1], report[2], report[3], report[4], report[5], report[6], report[7]);
+    return true;
 }
 
-void PacketHandling::tick(HIDDevice &hidDevice) {
-    // PPS print every second (packet types 0-4)
-    if (!hidDevice.ready()) return;
-    unsigned long now = millis();
+size_t PacketHandling::takeReports(uint8_t interface, uint8_t *transfer) {
+    static_assert(CompactReport::transferSize == hidTransferSize && CompactReport::legacyReportSize == reportSize, "Same transfers as the legacy format");
+    Output &output = outputs[interface];
+    uint8_t reports[CompactReport::entriesPerTransfer][reportSize];
+    size_t reportsToSend = 0;
+    bool compact = getReportFormat() == ReportFormat::COMPACT;
+    {
+        FifoLock lock(fifoMutex);
+        size_t queued = output.buffer.size();
+        size_t limit = std::min(queued, reportsPerTransfer);
+        if (compact) {
+            // Only worth it for more reports than a legacy transfer holds
+            size_t run = 0;
+            while (run < CompactReport::entriesPerTransfer && run < queued && CompactReport::canEncode(output.buffer[run].data)) {
+                run++;
+            }
+            compact = run > reportsPerTransfer;
+            if (compact) {
+                limit = run;
+            }
+        }
+        for (; reportsToSend < limit; reportsToSend++) {
+            Packet packet = output.buffer.shift();
+            memcpy(reports[reportsToSend], packet.data, reportSize);
+        }
+        if (output.wakePending && reportsToSend != 0) {
+            output.wakePending = false;
+            uint32_t latencyUs = static_cast<uint32_t>(SlimeVR::Hal::Clock::micros() - output.wakeStartUs);
+            stats.wakeups++;
+            stats.wakeLatencyTotalUs += latencyUs;
+            stats.wakeLatencyMaxUs = std::max(stats.wakeLatencyMaxUs, latencyUs);
+        }
+    }
+
+    if (compact) {
+        for (size_t i = 0; i < reportsToSend; i++) {
+            CompactReport::encode(reports[i], CompactReport::entryAt(transfer, i));
+        }
+        CompactReport::finishTransfer(transfer, reportsToSend);
+        stats.compactTransfers++;
+        return reportsPerTransfer;
+    }
+    for (size_t i = 0; i < reportsToSend; i++) {
+        memcpy(&transfer[i * reportSize], reports[i], reportSize);
+    }
+    return reportsToSend;
+}
+
+bool PacketHandling::tick(SlimeVR::Hal::HidSink &hidDevice) {
+    unsigned long now = SlimeVR::Hal::Clock::millis();
 
     //NOTE: This can be expensive if theres a lot of trackers paired, thats why its commented out for now
     // if (now - lastDiscoSweep > 5000) {
-    //     Serial.println("[DISCO] Sending disconnection statuses for unused trackers");
+    //     SVR_LOGI(logger, "[DISCO] Sending disconnection statuses for unused trackers");
     //     lastDiscoSweep = now;
     //     auto &espnow = ESPNowCommunication::getInstance();
     //     auto pairedIds = Configuration::getInstance().getAllPairedTrackerIds();
@@ -104,61 +231,102 @@ void PacketHandling::tick(HIDDevice &hidDevice) {
     //     }
     // }
 
-    static unsigned long lastDebugPrint = 0;
     unsigned long interval = now - lastSendAttempt;
 
     // Throttle to prevent overwhelming USB endpoint
-    if (interval < minSendIntervalMs) return;
+    if (interval < minSendIntervalMs) {
+        idleWaitMs = minSendIntervalMs - interval;
+        return false;
+    }
 
-    // Get reference to ESPNow instance once
-    auto &espnow = ESPNowCommunication::getInstance();
-    size_t trackerCount = espnow.getConnectedTrackerCount();
-    size_t availableReports = buffer.size();
-    
-    // Early exit if nothing to send
-    if (availableReports == 0) {
-        if (trackerCount == 0 || (now - lastRegistrationSent) < registrationIntervalMs) return;
-        lastRegistrationSent = now;
+    // Each interface has its own endpoint and poll slots
+    bool sent = false;
+    uint32_t waitMs = maxIdleWaitMs;
+    for (uint8_t interface = 0; interface < hidInterfaceCount; interface++) {
+        uint32_t interfaceWaitMs = maxIdleWaitMs;
+        if (sendTransfer(hidDevice, interface, now, interfaceWaitMs)) {
+            sent = true;
+        } else {
+            waitMs = std::min(waitMs, interfaceWaitMs);
+        }
+    }
+
+    if (sent) {
+        lastSendAttempt = now;
+    } else {
+        idleWaitMs = waitMs;
+    }
+    return sent;
+}
+
+bool PacketHandling::sendTransfer(SlimeVR::Hal::HidSink &hidDevice, uint8_t interface, unsigned long now, uint32_t &waitMs) {
+    if (!hidDevice.ready(interface)) {
+        waitMs = hidBusyRetryMs;
+        return false;
     }
+    Output &output = outputs[interface];
 
     // Prepare 64-byte transfer buffer (4 reports of 16 bytes each)
     uint8_t transferBuffer[hidTransferSize];
-    size_t reportsWritten = 0;
 
     // Priority 1: Fill slots with tracker data from FIFO (up to 4 reports)
-    size_t reportsToSend = std::min(availableReports, reportsPerTransfer);
-    for (size_t i = 0; i < reportsToSend; i++) {
-        Packet packet = buffer.shift();
-        memcpy(&transferBuffer[reportsWritten * reportSize], packet.data, reportSize);
-        reportsWritten++;
-    }
+    size_t reportsWritten = takeReports(interface, transferBuffer);
 
     // Priority 2: Pad remaining slots with registration packets
-    if (trackerCount > 0 && reportsWritten < reportsPerTransfer) {
-        size_t registrationsToSend = reportsPerTransfer - reportsWritten;
-        
-        for (size_t i = 0; i < registrationsToSend; i++) {
-            if (nextTrackerIndex >= trackerCount) {
-                nextTrackerIndex = 0;
+    if (reportsWritten < reportsPerTransfer) {
+        // Rather than wait for a console command or heartbeat sweep that holds
+        // the tracker list, this transfer goes without registrations
+        ESPNowCommunication::StateLock trackersLock(false);
+        auto &espnow = ESPNowCommunication::getInstance();
+        size_t trackerCount = trackersLock.held() ? espnow.getConnectedTrackerCount() : 0;
+
+        // Early exit if nothing to send
+        if (reportsWritten == 0) {
+            if (!trackersLock.held()) {
+                waitMs = hidBusyRetryMs;
+                return false;
+            }
+            if (trackerCount == 0) {
+                // A tracker connecting queues its registration, which wakes us
+                waitMs = maxIdleWaitMs;
+                return false;
             }
-            createRegistrationReport(&transferBuffer[reportsWritten * reportSize], nextTrackerIndex);
-            nextTrackerIndex++;
-            reportsWritten++;
+            if ((now - output.lastRegistrationSent) < registrationIntervalMs) {
+                waitMs = registrationIntervalMs - (now - output.lastRegistrationSent);
+                return false;
+            }
+            output.lastRegistrationSent = now;
         }
-    }
 
-    // Only send if we have reports to send
-    if (reportsWritten > 0) {
-        // Zero-fill any remaining bytes if not a full 64-byte transfer
-        if (reportsWritten < reportsPerTransfer) {
-            memset(&transferBuffer[reportsWritten * reportSize], 0, (reportsPerTransfer - reportsWritten) * reportSize);
+        if (trackerCount > 0) {
+            size_t registrationsToSend = reportsPerTransfer - reportsWritten;
+
+            for (size_t i = 0; i < registrationsToSend; i++) {
+                if (!createRegistrationReport(interface, &transferBuffer[reportsWritten * reportSize])) {
+                    break;
+                }
+                reportsWritten++;
+            }
         }
-        
-        lastSendAttempt = now;
-        if (!hidDevice.send(transferBuffer, hidTransferSize)) {
-            Serial.printf("[USB] Send failed at %lums\n", now);
+
+        // None of the connected trackers is on this interface
+        if (reportsWritten == 0) {
+            waitMs = registrationIntervalMs;
+            return false;
         }
     }
+
+    // Zero-fill any remaining bytes if not a full 64-byte transfer
+    if (reportsWritten < reportsPerTransfer) {
+        memset(&transferBuffer[reportsWritten * reportSize], 0, (reportsPerTransfer - reportsWritten) * reportSize);
+    }
+
+    stats.transfers++;
+    if (!hidDevice.send(interface, transferBuffer, hidTransferSize)) {
+        stats.failedTransfers++;
+        SVR_LOGW(logger, "USB send failed on interface %u at %lums", interface, now);
+    }
+    return true;
 }
 
 PacketHandling PacketHandling::instance;
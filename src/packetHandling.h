@@ -1,10 +1,10 @@
 #pragma once
 
-#include "HID.h"
 #include "espnow/espnow.h"
+#include "hal/HidSink.h"
 
-#include <Arduino.h>
 #include <CircularBuffer.hpp>
+#include <atomic>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
@@ -13,11 +13,55 @@
 
 class PacketHandling {
 public:
+    struct Stats {
+        uint32_t insertedReports = 0;
+        uint32_t overwrittenReports = 0;  // Replaced by a newer report of the same type and tracker before being sent
+        uint32_t droppedReports = 0;      // FIFO was full
+        uint32_t transfers = 0;
+        uint32_t compactTransfers = 0;  // Of transfers, the ones in the compact format
+        uint32_t failedTransfers = 0;
+        // Wake-to-send latency: from a report arriving at an empty FIFO to the
+        // transfer that carries it being assembled
+        uint32_t wakeups = 0;
+        uint64_t wakeLatencyTotalUs = 0;
+        uint32_t wakeLatencyMaxUs = 0;
+    };
+
+    // The layout of the HID transfers. The host picks it for the whole
+    // dongle, legacy until it asks for another one.
+    enum class ReportFormat : uint8_t {
+        LEGACY = 1,   // 4 sub-reports of 16 bytes
+        COMPACT = 2,  // Runs of type 1 reports quantized 7 to a transfer, see CompactReport.h
+    };
+    static constexpr ReportFormat newestReportFormat = ReportFormat::COMPACT;
+
     static PacketHandling &getInstance();
 
+    // Creates the FIFO lock. The FIFO is the bounded queue between the tasks
+    // that insert reports and the HID output task.
+    void begin();
+
+    // The task that runs tick(). It gets a notification whenever a report
+    // arrives at a FIFO.
+    void setOutputTask(TaskHandle_t task);
+
     void insert(const uint8_t *data, uint8_t len, int8_t rssi = 0);
     void sendDisconnectionStatus(uint8_t trackerId);
-    void tick(HIDDevice &hidDevice);
+    // Sends at most one transfer per HID interface. Returns true if it sent
+    // any, otherwise see getIdleWaitMs().
+    bool tick(SlimeVR::Hal::HidSink &hidDevice);
+    // How long the output task can wait for a notification after tick()
+    // returned false before it has to call it again
+    uint32_t getIdleWaitMs() const { return idleWaitMs; }
+
+    // Takes effect from the next transfer. Safe to call from any task.
+    void setReportFormat(ReportFormat format);
+    ReportFormat getReportFormat() const { return reportFormat.load(std::memory_order_relaxed); }
+    static const char *reportFormatName(ReportFormat format);
+
+    size_t getQueuedReportCount() const;
+    const Stats &getStats() const { return stats; }
+    void resetStats() { stats = Stats(); }
 
 private:
     struct Packet {
@@ -32,10 +76,31 @@ private:
     static constexpr size_t reportSize = 16;  // Each report is 16 bytes
     static constexpr size_t reportsPerTransfer = 4;  // Send 4 reports per USB transfer (64 bytes total)
     static constexpr size_t hidTransferSize = reportSize * reportsPerTransfer;  // 64 bytes total
-    static constexpr size_t bufferSize = 256;
+    static constexpr size_t bufferSize = 256;  // Shared out evenly between the HID interfaces
     static constexpr unsigned long registrationIntervalMs = 200;  // Only send registrations every 200ms when no data
     static constexpr unsigned long minSendIntervalMs = 0;   // Minimum 1ms between USB transfers
-    CircularBuffer<Packet, bufferSize> buffer;
+    static constexpr uint32_t hidBusyRetryMs = 1;  // The endpoint has no event for becoming ready
+    static constexpr uint32_t maxIdleWaitMs = 1000;
+
+    // The reports of the trackers one HID interface carries, see
+    // Hal::hidInterfaceFor()
+    struct Output {
+        CircularBuffer<Packet, bufferSize / SlimeVR::Hal::hidInterfaceCount> buffer;
+        // Set when a report arrives at an empty FIFO, for Stats::wakeLatencyTotalUs
+        uint64_t wakeStartUs = 0;
+        bool wakePending = false;
+        unsigned long lastRegistrationSent = 0;
+        // The tracker the last registration report was for
+        ESPNowCommunication::TrackerHandle registrationCursor;
+    };
+
+    Output outputs[SlimeVR::Hal::hidInterfaceCount];
+    // Guards the outputs' buffers and wake timestamps, held only while
+    // copying reports in or out
+    SemaphoreHandle_t fifoMutex = nullptr;
+    TaskHandle_t outputTask = nullptr;
+    uint32_t idleWaitMs = 0;
+    std::atomic<ReportFormat> reportFormat{ReportFormat::LEGACY};
 
     unsigned long lastDiscoSweep = 0;
     
@@ -44,13 +109,21 @@ private:
     size_t currentChunkIndex = 0;
     bool hasPartialPacket = false;
     
-    // Registration system
-    unsigned long lastRegistrationSent = 0;
     unsigned long lastSendAttempt = 0;
-    size_t nextTrackerIndex = 0;
     
-    // Statistics
-    unsigned long droppedReports = 0;
+    Stats stats;
     
-    void createRegistrationReport(uint8_t *report, size_t trackerIndex);
+    // Returns false if no tracker on the interface is connected
+    bool createRegistrationReport(uint8_t interface, uint8_t *report);
+    // Adds or replaces the report. Returns true if it took a new FIFO entry.
+    bool queue(const uint8_t *data, uint8_t len, int8_t rssi);
+    // Moves up to reportsPerTransfer reports from the interface's FIFO into
+    // transfer and returns how many it took. In the compact format, when the
+    // oldest reports are more type 1 reports than that, it builds a compact
+    // transfer of up to 7 of them instead and returns reportsPerTransfer, as
+    // the transfer is full.
+    size_t takeReports(uint8_t interface, uint8_t *transfer);
+    // Sends the interface's next transfer. Returns false and sets waitMs if
+    // there was nothing to send yet.
+    bool sendTransfer(SlimeVR::Hal::HidSink &hidDevice, uint8_t interface, unsigned long now, uint32_t &waitMs);
 };
@@ -0,0 +1,132 @@
+// Round trips through the compact HID format must stay within the bounds
+// CompactReport.h documents: 0.15 degrees of rotation, and half a step of
+// acceleration. Run with: pio test -e native_test
+
+#include <unity.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+#include "CompactReport.h"
+
+namespace {
+constexpr double maxAngleErrorDeg = 0.15;
+constexpr int32_t accelRange = 16320;  // Where the compact format saturates
+
+void makeReport(const float q[4], const int32_t accel[3], uint8_t *report) {
+    memset(report, 0, CompactReport::legacyReportSize);
+    report[0] = CompactReport::rotationAccelType;
+    report[1] = 42;
+    for (size_t i = 0; i < 4; i++) {
+        CompactReport::writeInt16(&report[2 + 2 * i], CompactReport::toLegacyComponent(q[i]));
+    }
+    for (size_t i = 0; i < 3; i++) {
+        CompactReport::writeInt16(&report[10 + 2 * i], accel[i]);
+    }
+}
+
+// Encodes and decodes report and checks the result against it
+void checkRoundTrip(const uint8_t *report) {
+    uint8_t entry[CompactReport::entrySize];
+    uint8_t decoded[CompactReport::legacyReportSize];
+    TEST_ASSERT_TRUE(CompactReport::canEncode(report));
+    CompactReport::encode(report, entry);
+    CompactReport::decode(entry, decoded);
+
+    TEST_ASSERT_EQUAL_UINT8(CompactReport::rotationAccelType, decoded[0]);
+    TEST_ASSERT_EQUAL_UINT8(report[1], decoded[1]);
+
+    // q and -q are the same rotation
+    double dot = 0, lengthBefore = 0, lengthAfter = 0;
+    for (size_t i = 0; i < 4; i++) {
+        double before = CompactReport::readInt16(&report[2 + 2 * i]);
+        double after = CompactReport::readInt16(&decoded[2 + 2 * i]);
+        dot += before * after;
+        lengthBefore += before * before;
+        lengthAfter += after * after;
+    }
+    double cosHalfAngle = std::min(1.0, std::fabs(dot) / std::sqrt(lengthBefore * lengthAfter));
+    double angleErrorDeg = 2 * std::acos(cosHalfAngle) * 180 / M_PI;
+    TEST_ASSERT_TRUE_MESSAGE(angleErrorDeg <= maxAngleErrorDeg, "Rotation moved more than the documented bound");
+    TEST_ASSERT_DOUBLE_WITHIN(0.001, 1.0, lengthAfter / (CompactReport::quaternionScale * CompactReport::quaternionScale));
+
+    int32_t accelLargest = 0;
+    for (size_t i = 0; i < 3; i++) {
+        accelLargest = std::max(accelLargest, std::abs(static_cast<int32_t>(CompactReport::readInt16(&report[10 + 2 * i]))));
+    }
+    // Half a step: 4 legacy units while the smallest step fits, or less than
+    // 1/255 of the largest component
+    int32_t accelBound = accelLargest <= 8 * CompactReport::accelMax ? 4 : (accelLargest + CompactReport::accelMax - 1) / CompactReport::accelMax;
+    for (size_t i = 0; i < 3; i++) {
+        int32_t error = CompactReport::readInt16(&report[10 + 2 * i]) - CompactReport::readInt16(&decoded[10 + 2 * i]);
+        TEST_ASSERT_TRUE_MESSAGE(std::abs(error) <= accelBound, "Acceleration moved more than half a step");
+    }
+}
+
+void test_random_reports() {
+    std::mt19937 random(1);
+    std::normal_distribution<float> normal;
+    for (int i = 0; i < 200000; i++) {
+        float q[4];
+        float lengthSquared = 0;
+        for (float &component : q) {
+            component = normal(random);
+            lengthSquared += component * component;
+        }
+        // Encoding doesn't need unit length
+        float scale = (i % 4 == 0 ? 0.5f : 1.0f) / std::sqrt(lengthSquared);
+        for (float &component : q) {
+            component *= scale;
+        }
+        // Spread over every acceleration exponent
+        int32_t range = accelRange >> (random() % 8);
+        std::uniform_int_distribution<int32_t> accelDistribution(-range, range);
+        int32_t accel[3] = {accelDistribution(random), accelDistribution(random), accelDistribution(random)};
+
+        uint8_t report[CompactReport::legacyReportSize];
+        makeReport(q, accel, report);
+        checkRoundTrip(report);
+    }
+}
+
+// Largest component negative or tied, two components at 1/sqrt(2) where the
+// smallest three saturate, full scale acceleration
+void test_edge_cases() {
+    const float half = 0.5f;
+    const float diagonal = 0.70710678f;
+    const float rotations[][4] = {
+        {0, 0, 0, 1},
+        {0, 0, 0, -1},
+        {half, half, half, half},
+        {-half, half, -half, half},
+        {diagonal, 0, 0, diagonal},
+        {0, -diagonal, diagonal, 0},
+    };
+    const int32_t accels[][3] = {
+        {0, 0, 0},
+        {accelRange, -accelRange, accelRange},
+        {-2040, 2040, 2041},
+        {1, -1, 4},
+    };
+    for (const auto &q : rotations) {
+        for (const auto &accel : accels) {
+            uint8_t report[CompactReport::legacyReportSize];
+            makeReport(q, accel, report);
+            checkRoundTrip(report);
+        }
+    }
+}
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_random_reports);
+    RUN_TEST(test_edge_cases);
+    return UNITY_END();
+}
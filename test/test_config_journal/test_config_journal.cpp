@@ -0,0 +1,143 @@
+// ConfigJournal on a storage that only opens on the second try, the way a
+// LittleFS mount can fail at boot and succeed when the flush task retries.
+// Changes made in between must not overwrite what the storage holds. Run
+// with: pio test -e native_test
+
+#include <unity.h>
+
+#include <array>
+#include <cstring>
+#include <vector>
+
+#include "ConfigJournal.h"
+
+namespace {
+class FlakyStorage : public SlimeVR::Hal::ConfigStorage {
+public:
+    const char *getName() const override { return "flaky"; }
+    bool begin() override { return failedOpens-- <= 0; }
+    bool read(std::vector<uint8_t> &data) override {
+        data = journal;
+        return !journal.empty();
+    }
+    bool append(const uint8_t *data, size_t len) override {
+        journal.insert(journal.end(), data, data + len);
+        return true;
+    }
+    bool replace(const uint8_t *data, size_t len) override {
+        journal.assign(data, data + len);
+        return true;
+    }
+
+    int failedOpens = 0;
+    std::vector<uint8_t> journal;
+};
+
+constexpr uint8_t storedCode[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+constexpr uint8_t generatedCode[8] = {9, 9, 9, 9, 9, 9, 9, 9};
+constexpr uint8_t macA[6] = {0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa};
+constexpr uint8_t macB[6] = {0xbb, 0xbb, 0xbb, 0xbb, 0xbb, 0xbb};
+
+int trackerIdOf(const ConfigJournal::State &state, const uint8_t mac[6]) {
+    for (const ConfigJournal::TrackerIdRecord &record : state.trackerIds) {
+        if (memcmp(record.mac.data(), mac, 6) == 0) {
+            return record.trackerId;
+        }
+    }
+    return -1;
+}
+
+void flush(ConfigJournal &journal) {
+    ConfigJournal::PendingWrite write;
+    if (journal.takePendingWrite(write)) {
+        journal.finishWrite(write, journal.writePending(write));
+    }
+}
+
+// A storage holding code storedCode, channel 3 and tracker A with ID 0
+void storePairing(FlakyStorage &storage) {
+    ConfigJournal journal(storage);
+    TEST_ASSERT_TRUE(journal.load());
+    ConfigJournal::Transaction transaction;
+    transaction.setSecurityCode(storedCode);
+    transaction.setWifiChannel(3);
+    transaction.pair(macA);
+    transaction.assignTrackerId(macA, 0);
+    journal.commit(transaction);
+    flush(journal);
+}
+
+// What the dongle does at boot without storage: generates a code, and
+// pairs tracker B with the lowest free ID, 0
+void pairWhileClosed(ConfigJournal &journal) {
+    ConfigJournal::Transaction code;
+    code.setSecurityCode(generatedCode);
+    journal.commit(code);
+    ConfigJournal::Transaction pairing;
+    pairing.pair(macB);
+    pairing.assignTrackerId(macB, 0);
+    journal.commit(pairing);
+}
+
+void test_stored_pairing_survives_late_open() {
+    FlakyStorage storage;
+    storePairing(storage);
+
+    storage.failedOpens = 1;
+    ConfigJournal journal(storage);
+    TEST_ASSERT_FALSE(journal.load());
+    pairWhileClosed(journal);
+    flush(journal);
+    TEST_ASSERT_FALSE(journal.isOpen());
+
+    TEST_ASSERT_TRUE(journal.openStorage());
+    journal.finishOpen();
+    flush(journal);
+
+    // Read back as the next boot would
+    ConfigJournal reloaded(storage);
+    TEST_ASSERT_TRUE(reloaded.load());
+    for (const ConfigJournal *loaded : {&journal, &reloaded}) {
+        const ConfigJournal::State &state = loaded->getState();
+        TEST_ASSERT_TRUE(state.hasSecurityCode);
+        TEST_ASSERT_EQUAL(0, memcmp(state.securityCode.data(), storedCode, 8));
+        TEST_ASSERT_TRUE(state.hasWifiChannel);
+        TEST_ASSERT_EQUAL(3, state.wifiChannel);
+        TEST_ASSERT_EQUAL(2, state.pairedMacs.size());
+        TEST_ASSERT_EQUAL(0, trackerIdOf(state, macA));
+        TEST_ASSERT_EQUAL(1, trackerIdOf(state, macB));
+    }
+}
+
+// Nothing was stored, so the code the trackers paired with is kept
+void test_code_kept_without_stored_one() {
+    FlakyStorage storage;
+    storage.failedOpens = 1;
+    ConfigJournal journal(storage);
+    TEST_ASSERT_FALSE(journal.load());
+    pairWhileClosed(journal);
+
+    TEST_ASSERT_TRUE(journal.openStorage());
+    journal.finishOpen();
+    flush(journal);
+
+    ConfigJournal reloaded(storage);
+    TEST_ASSERT_TRUE(reloaded.load());
+    const ConfigJournal::State &state = reloaded.getState();
+    TEST_ASSERT_TRUE(state.hasSecurityCode);
+    TEST_ASSERT_EQUAL(0, memcmp(state.securityCode.data(), generatedCode, 8));
+    TEST_ASSERT_FALSE(state.hasWifiChannel);
+    TEST_ASSERT_EQUAL(0, trackerIdOf(state, macB));
+}
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_stored_pairing_survives_late_open);
+    RUN_TEST(test_code_kept_without_stored_one);
+    return UNITY_END();
+}
@@ -0,0 +1,49 @@
+// Replays trace.txt through the dongle core and compares what it sent over
+// HID and the radio with golden.txt, so any change to the receive and HID
+// pipeline's output fails here. Run with: pio test -e native_test
+//
+// When a change to the output is intended, regenerate the golden file with
+// the replay program and commit it with the change:
+//
+//   pio run -e native && .pio/build/native/program test/test_replay/trace.txt --output test/test_replay/golden.txt
+
+#include <unity.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "native/TraceReplay.h"
+
+namespace {
+// The trace and the golden output sit next to this file
+std::string testFile(const char *name) {
+    std::string path = __FILE__;
+    return path.substr(0, path.find_last_of('/') + 1) + name;
+}
+
+void test_replay_matches_golden() {
+    std::vector<TraceReplay::Frame> frames;
+    TEST_ASSERT_TRUE_MESSAGE(TraceReplay::loadTrace(testFile("trace.txt"), frames), "Couldn't load trace.txt");
+
+    std::ifstream file(testFile("golden.txt"));
+    TEST_ASSERT_TRUE_MESSAGE(static_cast<bool>(file), "Couldn't open golden.txt");
+    std::string golden((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    std::string output;
+    TEST_ASSERT_TRUE_MESSAGE(TraceReplay::run("trace.txt", std::move(frames), TraceReplay::Options(), output), "ESPNowCommunication::begin() failed");
+
+    std::string difference = TraceReplay::firstDifference(output, golden);
+    TEST_ASSERT_TRUE_MESSAGE(difference.empty(), ("Output differs from golden.txt at " + difference).c_str());
+}
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_replay_matches_golden);
+    return UNITY_END();
+}
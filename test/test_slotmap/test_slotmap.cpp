@@ -0,0 +1,79 @@
+// SlotMap handles, and an insert racing a removal the way a handshake in the
+// WiFi task races the radio task disconnecting a tracker. Run with:
+// pio test -e native_test
+
+#include <unity.h>
+
+#include <atomic>
+#include <thread>
+
+#include "SlotMap.h"
+
+namespace {
+void test_removed_handle_stays_stale() {
+    SlotMap<int, 4> map;
+    SlotHandle first = map.insert(1);
+    TEST_ASSERT_TRUE(map.remove(first));
+    SlotHandle second = map.insert(2);
+
+    // Same slot, new element
+    TEST_ASSERT_EQUAL(first.index(), second.index());
+    TEST_ASSERT_NULL(map.get(first));
+    TEST_ASSERT_FALSE(map.remove(first));
+    TEST_ASSERT_NOT_NULL(map.get(second));
+    TEST_ASSERT_EQUAL(2, *map.get(second));
+}
+
+// One slot, so the insert can only take the slot the other thread frees. A
+// handle from an insert that saw the slot free must resolve afterwards.
+void test_insert_racing_release() {
+    constexpr int rounds = 200000;
+    SlotMap<int, 1> map;
+    SlotHandle toRemove;
+    std::atomic<int> startedRound{-1};
+    std::atomic<int> removedRound{-1};
+
+    std::thread remover([&] {
+        for (int round = 0; round < rounds; round++) {
+            while (startedRound.load(std::memory_order_acquire) != round) {
+                std::this_thread::yield();
+            }
+            map.remove(toRemove);
+            removedRound.store(round, std::memory_order_release);
+        }
+    });
+
+    int staleHandles = 0;
+    for (int round = 0; round < rounds; round++) {
+        toRemove = map.insert(round);
+        startedRound.store(round, std::memory_order_release);
+
+        SlotHandle inserted;
+        while (!(inserted = map.insert(-round)).valid()) {
+            std::this_thread::yield();
+        }
+        while (removedRound.load(std::memory_order_acquire) != round) {
+            std::this_thread::yield();
+        }
+        if (map.get(inserted) == nullptr) {
+            staleHandles++;
+        }
+        // Also frees the slot if the handle went stale
+        map.clear();
+    }
+    remover.join();
+
+    TEST_ASSERT_EQUAL(0, staleHandles);
+}
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_removed_handle_stays_stale);
+    RUN_TEST(test_insert_racing_release);
+    return UNITY_END();
+}
@@ -0,0 +1,263 @@
+// Converts a packet capture dump from the dongle ("capture dump" console
+// command, saved with nodeProgram/captureDump.js) into a pcap file and prints
+// summary statistics.
+//
+// Build: g++ -std=c++17 -O2 -o capture2pcap tools/capture2pcap.cpp
+//
+// Usage: capture2pcap [--raw] [--stats] <dump.bin> [out.pcap]
+//
+// By default packets are written as 802.11 vendor-specific action frames with
+// a radiotap header carrying channel and RSSI, which Wireshark decodes with
+// its ESP-NOW dissector. --raw writes the dongle's own record header followed
+// by the payload under LINKTYPE_USER0 instead. Timestamps are the dongle's
+// uptime at reception. --stats only prints the statistics.
+//
+// The dump format is described in src/espnow/PacketCapture.h.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../src/native/CaptureDump.h"
+
+namespace {
+
+using namespace CaptureDump;
+
+constexpr uint32_t linkTypeUser0 = 147;
+constexpr uint32_t linkTypeRadiotap = 127;
+
+constexpr uint8_t espressifOui[3] = {0x18, 0xFE, 0x34};
+
+const char *messageTypeNames[] = {
+    "PAIRING_REQUEST", "PAIRING_RESPONSE", "HANDSHAKE_REQUEST", "HANDSHAKE_RESPONSE",
+    "HEARTBEAT_ECHO", "HEARTBEAT_RESPONSE", "TRACKER_DATA", "PAIRING_ANNOUNCEMENT",
+    "UNPAIR", "TRACKER_RATE", "ENTER_OTA_MODE", "ENTER_OTA_ACK",
+};
+
+struct SourceStats {
+    size_t packets = 0;
+    size_t bytes = 0;
+    int rssiMin = 127;
+    int rssiMax = -128;
+    long rssiSum = 0;
+    uint64_t lastTimestampUs = 0;
+    uint64_t maxGapUs = 0;
+};
+
+void writeLe16(std::vector<uint8_t> &out, uint16_t v) {
+    out.push_back(v & 0xFF);
+    out.push_back(v >> 8);
+}
+
+void writeLe32(std::vector<uint8_t> &out, uint32_t v) {
+    writeLe16(out, v & 0xFFFF);
+    writeLe16(out, v >> 16);
+}
+
+uint16_t channelFrequency(uint8_t channel) {
+    return channel == 14 ? 2484 : 2407 + 5 * channel;
+}
+
+// Radiotap header with channel and antenna signal, followed by the action
+// frame the ESP-NOW payload travelled in
+void buildRadiotapFrame(const Capture &capture, const Packet &packet, uint16_t sequence, std::vector<uint8_t> &out, size_t &originalLength) {
+    out.clear();
+    out.insert(out.end(), {0x00, 0x00});  // Version, padding
+    writeLe16(out, 13);                   // Header length
+    writeLe32(out, (1u << 3) | (1u << 5));  // Channel, dBm antenna signal
+    writeLe16(out, channelFrequency(packet.channel));
+    writeLe16(out, 0x00C0);  // 2 GHz, OFDM
+    out.push_back(static_cast<uint8_t>(packet.rssi));
+
+    out.insert(out.end(), {0xD0, 0x00, 0x00, 0x00});  // Action frame, duration
+    out.insert(out.end(), capture.header.dongleMac, capture.header.dongleMac + 6);
+    out.insert(out.end(), packet.mac, packet.mac + 6);
+    out.insert(out.end(), 6, 0xFF);  // ESP-NOW uses the broadcast BSSID
+    writeLe16(out, sequence << 4);
+
+    out.push_back(0x7F);  // Vendor-specific action
+    out.insert(out.end(), espressifOui, espressifOui + 3);
+    out.insert(out.end(), 4, 0x00);  // Random value, not captured
+    out.push_back(0xDD);             // Vendor-specific element
+    out.push_back(5 + packet.length);
+    out.insert(out.end(), espressifOui, espressifOui + 3);
+    out.push_back(0x04);  // ESP-NOW
+    out.push_back(0x01);  // Version
+
+    originalLength = out.size() + packet.length;
+    out.insert(out.end(), packet.payload.begin(), packet.payload.end());
+}
+
+void buildRawFrame(const Packet &packet, std::vector<uint8_t> &out, size_t &originalLength) {
+    out.clear();
+    for (int i = 0; i < 8; i++) {
+        out.push_back(packet.timestampUs >> (8 * i));
+    }
+    out.insert(out.end(), packet.mac, packet.mac + 6);
+    out.push_back(static_cast<uint8_t>(packet.rssi));
+    out.push_back(packet.channel);
+    out.push_back(packet.length);
+    out.push_back(packet.payload.size());
+    originalLength = out.size() + packet.length;
+    out.insert(out.end(), packet.payload.begin(), packet.payload.end());
+}
+
+bool writePcap(const Capture &capture, const std::string &path, bool raw) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    std::vector<uint8_t> out;
+    writeLe32(out, 0xA1B2C3D4);  // Microsecond timestamps
+    writeLe16(out, 2);
+    writeLe16(out, 4);
+    writeLe32(out, 0);  // GMT offset
+    writeLe32(out, 0);  // Timestamp accuracy
+    writeLe32(out, 65535);
+    writeLe32(out, raw ? linkTypeUser0 : linkTypeRadiotap);
+    file.write(reinterpret_cast<const char *>(out.data()), out.size());
+
+    std::vector<uint8_t> frame;
+    uint16_t sequence = 0;
+    for (const Packet &packet : capture.packets) {
+        size_t originalLength;
+        if (raw) {
+            buildRawFrame(packet, frame, originalLength);
+        } else {
+            buildRadiotapFrame(capture, packet, sequence++ & 0x0FFF, frame, originalLength);
+        }
+
+        out.clear();
+        writeLe32(out, packet.timestampUs / 1000000);
+        writeLe32(out, packet.timestampUs % 1000000);
+        writeLe32(out, frame.size());
+        writeLe32(out, originalLength);
+        file.write(reinterpret_cast<const char *>(out.data()), out.size());
+        file.write(reinterpret_cast<const char *>(frame.data()), frame.size());
+    }
+    return static_cast<bool>(file);
+}
+
+void printStats(const Capture &capture) {
+    if (capture.hasHeader) {
+        const uint8_t *mac = capture.header.dongleMac;
+        printf("Dongle %02x:%02x:%02x:%02x:%02x:%02x, channel %u, snap length %u\n", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5], capture.header.channel, capture.header.snapLength);
+        if (capture.header.overwrittenCount > 0) {
+            printf("%u older packets were overwritten before the dump\n", capture.header.overwrittenCount);
+        }
+    } else {
+        printf("Warning: no capture header found\n");
+    }
+    if (!capture.hasEnd) {
+        printf("Warning: dump is incomplete, no end frame found\n");
+    }
+    if (capture.hasHeader && capture.packets.size() != capture.header.recordCount) {
+        printf("Warning: expected %u packets, decoded %zu\n", capture.header.recordCount, capture.packets.size());
+    }
+    if (capture.badFrames > 0 || capture.skippedBytes > 0) {
+        printf("%zu malformed frames, %zu bytes skipped\n", capture.badFrames, capture.skippedBytes);
+    }
+
+    if (capture.packets.empty()) {
+        printf("No packets captured\n");
+        return;
+    }
+
+    std::map<std::vector<uint8_t>, SourceStats> sources;
+    std::map<int, size_t> types;
+    size_t truncated = 0;
+    for (const Packet &packet : capture.packets) {
+        SourceStats &stats = sources[std::vector<uint8_t>(packet.mac, packet.mac + 6)];
+        if (stats.packets > 0) {
+            stats.maxGapUs = std::max(stats.maxGapUs, packet.timestampUs - stats.lastTimestampUs);
+        }
+        stats.packets++;
+        stats.bytes += packet.length;
+        stats.rssiMin = std::min<int>(stats.rssiMin, packet.rssi);
+        stats.rssiMax = std::max<int>(stats.rssiMax, packet.rssi);
+        stats.rssiSum += packet.rssi;
+        stats.lastTimestampUs = packet.timestampUs;
+
+        types[packet.payload.empty() ? -1 : packet.payload[0]]++;
+        if (packet.payload.size() < packet.length) {
+            truncated++;
+        }
+    }
+
+    double seconds = (capture.packets.back().timestampUs - capture.packets.front().timestampUs) / 1e6;
+    printf("%zu packets over %.3f s", capture.packets.size(), seconds);
+    if (seconds > 0) {
+        printf(" (%.1f packets/s)", capture.packets.size() / seconds);
+    }
+    printf(", %zu truncated\n\n", truncated);
+
+    printf("%-17s %8s %10s %8s %6s %6s %6s %10s\n", "Source", "Packets", "Bytes", "Pkt/s", "RSSI<", "RSSI~", "RSSI>", "MaxGap ms");
+    for (const auto &[mac, stats] : sources) {
+        printf("%02x:%02x:%02x:%02x:%02x:%02x %8zu %10zu %8.1f %6d %6.1f %6d %10.1f\n",
+            mac[0], mac[1], mac[2], mac[3], mac[4], mac[5],
+            stats.packets, stats.bytes, seconds > 0 ? stats.packets / seconds : 0.0,
+            stats.rssiMin, static_cast<double>(stats.rssiSum) / stats.packets, stats.rssiMax,
+            stats.maxGapUs / 1000.0);
+    }
+
+    printf("\n%-22s %8s\n", "Message type", "Packets");
+    for (const auto &[type, count] : types) {
+        if (type < 0) {
+            printf("%-22s %8zu\n", "(empty)", count);
+        } else if (type < static_cast<int>(std::size(messageTypeNames))) {
+            printf("%-22s %8zu\n", messageTypeNames[type], count);
+        } else {
+            printf("UNKNOWN_%-14d %8zu\n", type, count);
+        }
+    }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    bool raw = false;
+    bool statsOnly = false;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--raw") {
+            raw = true;
+        } else if (arg == "--stats") {
+            statsOnly = true;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+
+    if (paths.empty() || paths.size() > 2 || (!statsOnly && paths.size() != 2)) {
+        fprintf(stderr, "Usage: %s [--raw] [--stats] <dump.bin> [out.pcap]\n", argv[0]);
+        return 2;
+    }
+
+    std::ifstream input(paths[0], std::ios::binary);
+    if (!input) {
+        fprintf(stderr, "Couldn't open %s\n", paths[0].c_str());
+        return 1;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+    Capture capture = parse(data);
+    printStats(capture);
+
+    if (!statsOnly) {
+        if (!writePcap(capture, paths[1], raw)) {
+            fprintf(stderr, "Couldn't write %s\n", paths[1].c_str());
+            return 1;
+        }
+        printf("\nWrote %zu packets to %s\n", capture.packets.size(), paths[1].c_str());
+    }
+    return 0;
+}
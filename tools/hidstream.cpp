@@ -0,0 +1,510 @@
+// Reads the 64-byte HID input reports the dongle delivers to the PC and
+// prints what they carried: per-tracker report rates and gaps, RSSI, and how
+// many sub-report slots went to registrations, zero padding or repeats.
+//
+// Build: g++ -std=c++17 -O2 -o hidstream tools/hidstream.cpp
+//
+// Usage: hidstream [options] <input>...
+//
+//   <input>            /dev/hidrawN to read live (Linux), a dump written by
+//                      --record, or the output of the native replay program
+//                      (its "<time us> HID <hex>..." lines are used). A
+//                      dongle built with HID_INTERFACES above 1 has a hidraw
+//                      node per interface; pass them all, in interface order,
+//                      to read them as one stream.
+//   --record FILE      while reading hidraw, also save every report to FILE
+//   --duration-s N     stop reading hidraw after N seconds, default: Ctrl+C
+//   --trackers         only print the per-tracker table
+//
+// A legacy transfer is 4 sub-reports of 16 bytes, assembled by
+// PacketHandling::tick: byte 0 is the packet type and byte 1 the tracker ID.
+// 0xff marks a registration carrying the tracker's MAC in bytes 2-7. Types 0,
+// 2 and 3 carry the negated RSSI in byte 15. An all-zero sub-report is
+// padding. A repeat is a data sub-report identical to the previous one of the
+// same type from the same tracker. Compact transfers, see src/CompactReport.h,
+// are decoded back into type 1 sub-reports, 7 slots per transfer.
+//
+// Dump format: the 8 bytes "SVRHID\x02\x00", then per transfer an 8-byte
+// little-endian timestamp in microseconds, the interface number and the 64
+// report bytes. Version 1 dumps have no interface byte.
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../src/CompactReport.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr size_t transferSize = 64;
+constexpr size_t reportSize = 16;
+constexpr size_t reportsPerTransfer = transferSize / reportSize;
+constexpr uint8_t registrationType = 0xff;
+constexpr char dumpMagic[8] = {'S', 'V', 'R', 'H', 'I', 'D', 2, 0};
+constexpr size_t dumpVersionOffset = 6;
+
+const char *packetTypeNames[] = {
+    "device info", "rotation+accel", "compact rotation", "status", "rotation+mag",
+};
+
+// Gap histogram bucket upper bounds in ms, the last bucket takes the rest
+constexpr double gapBucketsMs[] = {1, 2, 5, 10, 20, 50, 100};
+
+struct Transfer {
+    uint64_t timeUs;
+    uint8_t interface;
+    std::array<uint8_t, transferSize> data;
+};
+
+using Report = std::array<uint8_t, reportSize>;
+
+struct TrackerStats {
+    size_t reports = 0;
+    size_t byType[std::size(packetTypeNames)] = {};
+    size_t repeats = 0;
+    size_t registrations = 0;
+    uint8_t mac[6] = {};
+    bool hasMac = false;
+    int rssiMin = 0;
+    int rssiMax = -128;
+    long rssiSum = 0;
+    size_t rssiCount = 0;
+    uint64_t firstUs = 0;
+    uint64_t lastUs = 0;
+    std::vector<uint64_t> gapsUs;
+    std::map<uint8_t, Report> lastByType;
+};
+
+volatile sig_atomic_t stopRequested = 0;
+
+void onSignal(int) {
+    stopRequested = 1;
+}
+
+// The transfer's sub-reports, a compact transfer's decoded, with zeros for
+// its padding
+std::vector<Report> splitTransfer(const Transfer &transfer) {
+    std::vector<Report> reports;
+    if (CompactReport::isCompactTransfer(transfer.data.data())) {
+        size_t count = CompactReport::entryCount(transfer.data.data());
+        reports.resize(CompactReport::entriesPerTransfer);
+        for (size_t i = 0; i < count; i++) {
+            CompactReport::decode(CompactReport::entryAt(transfer.data.data(), i), reports[i].data());
+        }
+        return reports;
+    }
+    reports.resize(reportsPerTransfer);
+    for (size_t slot = 0; slot < reportsPerTransfer; slot++) {
+        memcpy(reports[slot].data(), &transfer.data[slot * reportSize], reportSize);
+    }
+    return reports;
+}
+
+bool isZero(const uint8_t *report) {
+    return std::all_of(report, report + reportSize, [](uint8_t b) { return b == 0; });
+}
+
+uint64_t percentile(std::vector<uint64_t> sorted, double fraction) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    std::sort(sorted.begin(), sorted.end());
+    return sorted[static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5)];
+}
+
+bool isDump(const std::vector<uint8_t> &data) {
+    return data.size() >= sizeof(dumpMagic) && memcmp(data.data(), dumpMagic, dumpVersionOffset) == 0 && data[dumpVersionOffset] >= 1 &&
+           data[dumpVersionOffset] <= dumpMagic[dumpVersionOffset];
+}
+
+void readDump(const std::vector<uint8_t> &data, std::vector<Transfer> &transfers) {
+    bool hasInterface = data[dumpVersionOffset] >= 2;
+    size_t recordSize = 8 + hasInterface + transferSize;
+    size_t offset = sizeof(dumpMagic);
+    for (; offset + recordSize <= data.size(); offset += recordSize) {
+        Transfer transfer;
+        transfer.timeUs = 0;
+        for (int i = 0; i < 8; i++) {
+            transfer.timeUs |= static_cast<uint64_t>(data[offset + i]) << (8 * i);
+        }
+        transfer.interface = hasInterface ? data[offset + 8] : 0;
+        memcpy(transfer.data.data(), &data[offset + 8 + hasInterface], transferSize);
+        transfers.push_back(transfer);
+    }
+    if (offset != data.size()) {
+        fprintf(stderr, "Warning: %zu trailing bytes in the dump\n", data.size() - offset);
+    }
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// "<time us> HID <hex> <hex> ..." lines from src/native/Replay.cpp, HID1,
+// HID2... for the other interfaces
+void readReplayOutput(const std::vector<uint8_t> &data, std::vector<Transfer> &transfers) {
+    std::istringstream input(std::string(data.begin(), data.end()));
+    std::string line;
+    size_t badLines = 0;
+    while (std::getline(input, line)) {
+        std::istringstream fields(line);
+        uint64_t timeUs;
+        std::string kind;
+        if (!(fields >> timeUs >> kind) || kind.rfind("HID", 0) != 0) {
+            continue;
+        }
+        int interface = kind.size() > 3 ? atoi(kind.c_str() + 3) : 0;
+        std::string hex, chunk;
+        while (fields >> chunk) {
+            hex += chunk;
+        }
+        if (hex.size() != 2 * transferSize) {
+            badLines++;
+            continue;
+        }
+        Transfer transfer;
+        transfer.timeUs = timeUs;
+        transfer.interface = interface;
+        bool valid = true;
+        for (size_t i = 0; i < transferSize && valid; i++) {
+            int hi = hexValue(hex[2 * i]);
+            int lo = hexValue(hex[2 * i + 1]);
+            valid = hi >= 0 && lo >= 0;
+            transfer.data[i] = (hi << 4) | lo;
+        }
+        if (valid) {
+            transfers.push_back(transfer);
+        } else {
+            badLines++;
+        }
+    }
+    if (badLines > 0) {
+        fprintf(stderr, "Warning: skipped %zu malformed HID lines\n", badLines);
+    }
+}
+
+#ifdef __linux__
+uint64_t monotonicUs() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+void closeAll(const std::vector<pollfd> &fds) {
+    for (const pollfd &fd : fds) {
+        close(fd.fd);
+    }
+}
+
+// Reads the hidraw nodes of all interfaces at once, the index in paths is the
+// interface number
+bool readHidraw(const std::vector<std::string> &paths, const std::string &recordPath, uint64_t durationUs, std::vector<Transfer> &transfers) {
+    std::vector<pollfd> fds;
+    for (const std::string &path : paths) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            fprintf(stderr, "Couldn't open %s: %s\n", path.c_str(), strerror(errno));
+            closeAll(fds);
+            return false;
+        }
+        fds.push_back({fd, POLLIN, 0});
+    }
+    std::ofstream record;
+    if (!recordPath.empty()) {
+        record.open(recordPath, std::ios::binary);
+        if (!record) {
+            fprintf(stderr, "Couldn't write %s\n", recordPath.c_str());
+            closeAll(fds);
+            return false;
+        }
+        record.write(dumpMagic, sizeof(dumpMagic));
+    }
+
+    // No SA_RESTART, so Ctrl+C interrupts the blocking poll
+    struct sigaction action = {};
+    action.sa_handler = onSignal;
+    sigaction(SIGINT, &action, nullptr);
+
+    fprintf(stderr, "Reading %zu hidraw device%s, Ctrl+C to stop\n", paths.size(), paths.size() == 1 ? "" : "s");
+    uint64_t startUs = monotonicUs();
+    uint8_t buffer[transferSize + 1];
+    bool failed = false;
+    while (!stopRequested && !failed && (durationUs == 0 || monotonicUs() - startUs < durationUs)) {
+        // Wake up now and then to check the duration
+        if (poll(fds.data(), fds.size(), 100) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "Poll failed: %s\n", strerror(errno));
+            break;
+        }
+        for (size_t interface = 0; interface < fds.size() && !failed; interface++) {
+            if ((fds[interface].revents & (POLLIN | POLLERR | POLLHUP)) == 0) {
+                continue;
+            }
+            ssize_t len = read(fds[interface].fd, buffer, sizeof(buffer));
+            if (len < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                fprintf(stderr, "Read from %s failed: %s\n", paths[interface].c_str(), strerror(errno));
+                failed = true;
+                break;
+            }
+            if (static_cast<size_t>(len) != transferSize) {
+                fprintf(stderr, "Warning: %zd byte report, expected %zu\n", len, transferSize);
+                continue;
+            }
+            Transfer transfer;
+            transfer.timeUs = monotonicUs() - startUs;
+            transfer.interface = interface;
+            memcpy(transfer.data.data(), buffer, transferSize);
+            transfers.push_back(transfer);
+            if (record) {
+                uint8_t header[9];
+                for (int i = 0; i < 8; i++) {
+                    header[i] = transfer.timeUs >> (8 * i);
+                }
+                header[8] = transfer.interface;
+                record.write(reinterpret_cast<const char *>(header), sizeof(header));
+                record.write(reinterpret_cast<const char *>(buffer), transferSize);
+            }
+        }
+    }
+    closeAll(fds);
+    return true;
+}
+#endif
+
+void printAnalysis(const std::vector<Transfer> &transfers, bool trackersOnly) {
+    if (transfers.empty()) {
+        printf("No HID reports\n");
+        return;
+    }
+
+    std::map<uint8_t, TrackerStats> trackers;
+    size_t dataSlots = 0;
+    size_t registrationSlots = 0;
+    size_t paddingSlots = 0;
+    size_t repeatSlots = 0;
+    size_t unknownSlots = 0;
+    size_t registrationOnlyTransfers = 0;
+    size_t compactTransfers = 0;
+    size_t slots = 0;
+    // Per interface, each has its own endpoint and poll interval
+    std::map<uint8_t, std::vector<uint64_t>> transferGapsUs;
+    std::map<uint8_t, size_t> transfersByInterface;
+    std::map<uint8_t, uint64_t> lastTransferUs;
+
+    for (size_t t = 0; t < transfers.size(); t++) {
+        const Transfer &transfer = transfers[t];
+        if (transfersByInterface[transfer.interface]++ > 0) {
+            transferGapsUs[transfer.interface].push_back(transfer.timeUs - lastTransferUs[transfer.interface]);
+        }
+        lastTransferUs[transfer.interface] = transfer.timeUs;
+        bool carriedData = false;
+        std::vector<Report> reports = splitTransfer(transfer);
+        slots += reports.size();
+        compactTransfers += CompactReport::isCompactTransfer(transfer.data.data());
+        for (const Report &bytes : reports) {
+            const uint8_t *report = bytes.data();
+            if (isZero(report)) {
+                paddingSlots++;
+                continue;
+            }
+            uint8_t type = report[0];
+            TrackerStats &tracker = trackers[report[1]];
+            if (type == registrationType) {
+                registrationSlots++;
+                tracker.registrations++;
+                memcpy(tracker.mac, &report[2], sizeof(tracker.mac));
+                tracker.hasMac = true;
+                continue;
+            }
+            if (type >= std::size(packetTypeNames)) {
+                unknownSlots++;
+                continue;
+            }
+
+            carriedData = true;
+            dataSlots++;
+            auto last = tracker.lastByType.find(type);
+            if (last != tracker.lastByType.end() && last->second == bytes) {
+                tracker.repeats++;
+                repeatSlots++;
+            }
+            tracker.lastByType[type] = bytes;
+
+            if (tracker.reports == 0) {
+                tracker.firstUs = transfer.timeUs;
+            } else {
+                tracker.gapsUs.push_back(transfer.timeUs - tracker.lastUs);
+            }
+            tracker.lastUs = transfer.timeUs;
+            tracker.reports++;
+            tracker.byType[type]++;
+            if (type != 1 && type != 4) {
+                int rssi = -static_cast<int>(report[15]);
+                tracker.rssiMin = std::min(tracker.rssiMin, rssi);
+                tracker.rssiMax = std::max(tracker.rssiMax, rssi);
+                tracker.rssiSum += rssi;
+                tracker.rssiCount++;
+            }
+        }
+        if (!carriedData) {
+            registrationOnlyTransfers++;
+        }
+    }
+
+    double seconds = (transfers.back().timeUs - transfers.front().timeUs) / 1e6;
+    auto perSecond = [seconds](size_t count) { return seconds > 0 ? count / seconds : 0.0; };
+    auto share = [slots](size_t count) { return 100.0 * count / slots; };
+
+    if (!trackersOnly) {
+        for (const auto &[interface, count] : transfersByInterface) {
+            const std::vector<uint64_t> &gapsUs = transferGapsUs[interface];
+            if (transfersByInterface.size() > 1) {
+                printf("Interface %u: ", interface);
+            }
+            printf("%zu transfers over %.3f s (%.1f/s), interval p50 %.2f ms, p99 %.2f ms, max %.2f ms\n", count, seconds, perSecond(count), percentile(gapsUs, 0.5) / 1000.0,
+                percentile(gapsUs, 0.99) / 1000.0, percentile(gapsUs, 1.0) / 1000.0);
+        }
+        printf("Slots: %zu data (%.1f%%), %zu registration (%.1f%%), %zu padding (%.1f%%), %zu unknown\n", dataSlots, share(dataSlots), registrationSlots, share(registrationSlots), paddingSlots, share(paddingSlots), unknownSlots);
+        if (compactTransfers != 0) {
+            printf("Compact: %zu transfers (%.1f%%), %.2f slots per transfer\n", compactTransfers, 100.0 * compactTransfers / transfers.size(), static_cast<double>(slots) / transfers.size());
+        }
+        printf("Waste: %zu repeated data reports (%.1f%%), %zu transfers without data (%.1f%%), %.1f registrations/s\n\n", repeatSlots, share(repeatSlots), registrationOnlyTransfers, 100.0 * registrationOnlyTransfers / transfers.size(), perSecond(registrationSlots));
+    }
+
+    printf("%-3s %-17s %8s %8s %8s %8s %8s %8s %6s %6s %6s %6s\n", "ID", "MAC", "Reports", "Rep/s", "Gap p50", "Gap p99", "Gap max", "Repeats", "Regs", "RSSI<", "RSSI~", "RSSI>");
+    std::vector<uint64_t> allGapsUs;
+    for (const auto &[id, tracker] : trackers) {
+        char mac[18] = "-";
+        if (tracker.hasMac) {
+            snprintf(mac, sizeof(mac), "%02x:%02x:%02x:%02x:%02x:%02x", tracker.mac[0], tracker.mac[1], tracker.mac[2], tracker.mac[3], tracker.mac[4], tracker.mac[5]);
+        }
+        double span = (tracker.lastUs - tracker.firstUs) / 1e6;
+        printf("%-3u %-17s %8zu %8.1f %8.2f %8.2f %8.2f %8zu %6zu", id, mac, tracker.reports, span > 0 ? (tracker.reports - 1) / span : 0.0,
+            percentile(tracker.gapsUs, 0.5) / 1000.0, percentile(tracker.gapsUs, 0.99) / 1000.0, percentile(tracker.gapsUs, 1.0) / 1000.0, tracker.repeats, tracker.registrations);
+        if (tracker.rssiCount > 0) {
+            printf(" %6d %6.1f %6d\n", tracker.rssiMin, static_cast<double>(tracker.rssiSum) / tracker.rssiCount, tracker.rssiMax);
+        } else {
+            printf(" %6s %6s %6s\n", "-", "-", "-");
+        }
+        allGapsUs.insert(allGapsUs.end(), tracker.gapsUs.begin(), tracker.gapsUs.end());
+    }
+    if (trackersOnly) {
+        return;
+    }
+
+    printf("\n%-22s %8s\n", "Packet type", "Reports");
+    for (size_t type = 0; type < std::size(packetTypeNames); type++) {
+        size_t count = 0;
+        for (const auto &[id, tracker] : trackers) {
+            count += tracker.byType[type];
+        }
+        if (count > 0) {
+            printf("%zu %-20s %8zu\n", type, packetTypeNames[type], count);
+        }
+    }
+
+    if (allGapsUs.empty()) {
+        return;
+    }
+    printf("\nGaps between a tracker's data reports, all trackers:\n");
+    double lowerMs = 0;
+    for (size_t bucket = 0; bucket <= std::size(gapBucketsMs); bucket++) {
+        bool last = bucket == std::size(gapBucketsMs);
+        size_t count = std::count_if(allGapsUs.begin(), allGapsUs.end(), [&](uint64_t gapUs) {
+            double gapMs = gapUs / 1000.0;
+            return gapMs >= lowerMs && (last || gapMs < gapBucketsMs[bucket]);
+        });
+        char label[32];
+        if (last) {
+            snprintf(label, sizeof(label), ">= %g ms", lowerMs);
+        } else {
+            snprintf(label, sizeof(label), "%g-%g ms", lowerMs, gapBucketsMs[bucket]);
+            lowerMs = gapBucketsMs[bucket];
+        }
+        printf("  %-12s %8zu %5.1f%%\n", label, count, 100.0 * count / allGapsUs.size());
+    }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    std::vector<std::string> inputPaths;
+    std::string recordPath;
+    uint64_t durationUs = 0;
+    bool trackersOnly = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--record" && hasValue) {
+            recordPath = argv[++i];
+        } else if (arg == "--duration-s" && hasValue) {
+            durationUs = strtoull(argv[++i], nullptr, 10) * 1000000;
+        } else if (arg == "--trackers") {
+            trackersOnly = true;
+        } else if (arg[0] != '-') {
+            inputPaths.push_back(arg);
+        } else {
+            inputPaths.clear();
+            break;
+        }
+    }
+    size_t devices = std::count_if(inputPaths.begin(), inputPaths.end(), [](const std::string &path) { return path.rfind("/dev/", 0) == 0; });
+    if (inputPaths.empty() || (inputPaths.size() > 1 && devices != inputPaths.size())) {
+        fprintf(stderr, "Usage: %s [--record FILE] [--duration-s N] [--trackers] <hidraw device...|dump|replay output>\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<Transfer> transfers;
+    if (devices > 0) {
+#ifdef __linux__
+        if (!readHidraw(inputPaths, recordPath, durationUs, transfers)) {
+            return 1;
+        }
+#else
+        fprintf(stderr, "Reading a device needs Linux hidraw\n");
+        return 1;
+#endif
+    } else {
+        const std::string &inputPath = inputPaths.front();
+        std::ifstream input(inputPath, std::ios::binary);
+        if (!input) {
+            fprintf(stderr, "Couldn't open %s\n", inputPath.c_str());
+            return 1;
+        }
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        if (isDump(data)) {
+            readDump(data, transfers);
+        } else {
+            readReplayOutput(data, transfers);
+        }
+    }
+
+    printAnalysis(transfers, trackersOnly);
+    return 0;
+}